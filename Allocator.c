@@ -0,0 +1,243 @@
+/**
+ * @file Allocator.c
+ * @brief Pluggable memory allocation with accounting.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "Allocator.h"
+
+/** Size of the chunk header, rounded up to keep the chunk data aligned */
+#define CHUNK_HEADER_SIZE   ((sizeof(AllocatorChunk) + ALLOCATOR_ALIGNMENT - 1) & ~(size_t)(ALLOCATOR_ALIGNMENT - 1))
+
+/**
+ * Round a size up to the alignment of the arena and pool allocators
+ * @param size the size
+ * @return the aligned size
+ */
+static size_t alignSize(size_t size) {
+    return (size + ALLOCATOR_ALIGNMENT - 1) & ~(size_t)(ALLOCATOR_ALIGNMENT - 1);
+}
+
+void *allocMemory(Allocator *allocator, size_t size) {
+    if(!allocator) {
+        return malloc(size);
+    }
+    void *memory = allocator->allocate(allocator, size);
+    if(memory) {
+        AllocatorStats *stats = &allocator->stats;
+        stats->bytesInUse += size;
+        stats->totalBytes += size;
+        stats->allocations++;
+        if(stats->bytesInUse > stats->peakBytes) {
+            stats->peakBytes = stats->bytesInUse;
+        }
+    }
+    return memory;
+}
+
+void *allocZeroedMemory(Allocator *allocator, size_t size) {
+    if(!allocator) {
+        return calloc(1, size);
+    }
+    void *memory = allocMemory(allocator, size);
+    if(memory) {
+        memset(memory, 0, size);
+    }
+    return memory;
+}
+
+void *reallocMemory(Allocator *allocator, void *memory, size_t oldSize, size_t newSize) {
+    if(!allocator) {
+        return realloc(memory, newSize);
+    }
+    void *newMemory = allocMemory(allocator, newSize);
+    if(newMemory && memory) {
+        memcpy(newMemory, memory, oldSize < newSize ? oldSize : newSize);
+        freeMemory(allocator, memory, oldSize);
+    }
+    return newMemory;
+}
+
+void freeMemory(Allocator *allocator, void *memory, size_t size) {
+    if(!memory) {
+        return;
+    }
+    if(!allocator) {
+        free(memory);
+        return;
+    }
+    allocator->release(allocator, memory, size);
+    allocator->stats.bytesInUse -= size;
+    allocator->stats.releases++;
+}
+
+/**
+ * Allocate function of the tracking allocator: from the parent
+ */
+static void *trackingAllocate(Allocator *allocator, size_t size) {
+    return allocMemory(((TrackingAllocator*)allocator)->parent, size);
+}
+
+/**
+ * Release function of the tracking allocator: to the parent
+ */
+static void trackingRelease(Allocator *allocator, void *memory, size_t size) {
+    freeMemory(((TrackingAllocator*)allocator)->parent, memory, size);
+}
+
+void initTrackingAllocator(TrackingAllocator *tracking, const char *name, Allocator *parent) {
+    memset(tracking, 0, sizeof(TrackingAllocator));
+    tracking->base.name = name;
+    tracking->base.allocate = trackingAllocate;
+    tracking->base.release = trackingRelease;
+    tracking->parent = parent;
+}
+
+/**
+ * Take a new chunk from a parent allocator, and put it in front of the chain
+ * @param parent the allocator to take the chunk from
+ * @param chunks the chain of chunks
+ * @param size the usable size of the chunk
+ * @return the chunk, 0 if allocation failed
+ */
+static AllocatorChunk *newChunk(Allocator *parent, AllocatorChunk **chunks, size_t size) {
+    AllocatorChunk *chunk = (AllocatorChunk*)allocMemory(parent, CHUNK_HEADER_SIZE + size);
+    if(chunk) {
+        chunk->size = size;
+        chunk->used = 0;
+        chunk->next = *chunks;
+        *chunks = chunk;
+    }
+    return chunk;
+}
+
+/**
+ * Allocate function of the arena allocator: from the end of the current chunk
+ */
+static void *arenaAllocate(Allocator *allocator, size_t size) {
+    ArenaAllocator *arena = (ArenaAllocator*)allocator;
+    size = alignSize(size);
+    AllocatorChunk *chunk = arena->chunks;
+    if(!chunk || chunk->size - chunk->used < size) {
+        size_t chunkSize = size > arena->chunkSize ? size : arena->chunkSize;
+        if(!(chunk = newChunk(arena->parent, &arena->chunks, chunkSize))) {
+            return 0;
+        }
+        arena->reservedBytes += chunkSize;
+    }
+    void *memory = (char*)chunk + CHUNK_HEADER_SIZE + chunk->used;
+    chunk->used += size;
+    return memory;
+}
+
+/**
+ * Release function of the arena allocator: only the last allocation is given back
+ */
+static void arenaRelease(Allocator *allocator, void *memory, size_t size) {
+    ArenaAllocator *arena = (ArenaAllocator*)allocator;
+    AllocatorChunk *chunk = arena->chunks;
+    size = alignSize(size);
+    if(chunk && (char*)memory + size == (char*)chunk + CHUNK_HEADER_SIZE + chunk->used) {
+        chunk->used -= size;
+    }
+}
+
+void initArenaAllocator(ArenaAllocator *arena, const char *name, size_t chunkSize, Allocator *parent) {
+    memset(arena, 0, sizeof(ArenaAllocator));
+    arena->base.name = name;
+    arena->base.allocate = arenaAllocate;
+    arena->base.release = arenaRelease;
+    arena->parent = parent;
+    arena->chunkSize = chunkSize ? alignSize(chunkSize) : ALLOCATOR_CHUNK_SIZE;
+}
+
+void resetArenaAllocator(ArenaAllocator *arena) {
+    // Keep the oldest chunk, release the others
+    while (arena->chunks && arena->chunks->next) {
+        AllocatorChunk *next = arena->chunks->next;
+        arena->reservedBytes -= arena->chunks->size;
+        freeMemory(arena->parent, arena->chunks, CHUNK_HEADER_SIZE + arena->chunks->size);
+        arena->chunks = next;
+    }
+    if(arena->chunks) {
+        arena->chunks->used = 0;
+    }
+    arena->base.stats.releases += arena->base.stats.allocations - arena->base.stats.releases;
+    arena->base.stats.bytesInUse = 0;
+}
+
+void releaseArenaAllocator(ArenaAllocator *arena) {
+    resetArenaAllocator(arena);
+    if(arena->chunks) {
+        freeMemory(arena->parent, arena->chunks, CHUNK_HEADER_SIZE + arena->chunks->size);
+        arena->chunks = 0;
+        arena->reservedBytes = 0;
+    }
+}
+
+/**
+ * Allocate function of the pool allocator: a free block, or the next block of the current chunk
+ */
+static void *poolAllocate(Allocator *allocator, size_t size) {
+    PoolAllocator *pool = (PoolAllocator*)allocator;
+    if(size > pool->blockSize) {
+        return allocMemory(pool->parent, size);
+    }
+    if(pool->freeBlocks) {
+        void *block = pool->freeBlocks;
+        pool->freeBlocks = *(void**)block;
+        return block;
+    }
+    AllocatorChunk *chunk = pool->chunks;
+    if(!chunk || chunk->size - chunk->used < pool->blockSize) {
+        if(!(chunk = newChunk(pool->parent, &pool->chunks, pool->chunkSize))) {
+            return 0;
+        }
+        pool->reservedBytes += pool->chunkSize;
+    }
+    void *block = (char*)chunk + CHUNK_HEADER_SIZE + chunk->used;
+    chunk->used += pool->blockSize;
+    return block;
+}
+
+/**
+ * Release function of the pool allocator: the block goes on the free list
+ */
+static void poolRelease(Allocator *allocator, void *memory, size_t size) {
+    PoolAllocator *pool = (PoolAllocator*)allocator;
+    if(size > pool->blockSize) {
+        freeMemory(pool->parent, memory, size);
+        return;
+    }
+    *(void**)memory = pool->freeBlocks;
+    pool->freeBlocks = memory;
+}
+
+void initPoolAllocator(PoolAllocator *pool, const char *name, size_t blockSize, Allocator *parent) {
+    memset(pool, 0, sizeof(PoolAllocator));
+    pool->base.name = name;
+    pool->base.allocate = poolAllocate;
+    pool->base.release = poolRelease;
+    pool->parent = parent;
+    pool->blockSize = alignSize(blockSize < sizeof(void*) ? sizeof(void*) : blockSize);
+    pool->chunkSize = pool->blockSize > ALLOCATOR_CHUNK_SIZE / 16 ? pool->blockSize * 16 : ALLOCATOR_CHUNK_SIZE;
+}
+
+void releasePoolAllocator(PoolAllocator *pool) {
+    while (pool->chunks) {
+        AllocatorChunk *next = pool->chunks->next;
+        freeMemory(pool->parent, pool->chunks, CHUNK_HEADER_SIZE + pool->chunks->size);
+        pool->chunks = next;
+    }
+    pool->freeBlocks = 0;
+    pool->reservedBytes = 0;
+}
+
+void printAllocatorStats(FILE *file, Allocator *allocator) {
+    AllocatorStats *stats = &allocator->stats;
+    fprintf(file, "%-12s in use: %lu bytes, peak: %lu bytes, total: %lu bytes, allocations: %ld, releases: %ld\n",
+            allocator->name ? allocator->name : "allocator",
+            (unsigned long)stats->bytesInUse, (unsigned long)stats->peakBytes, (unsigned long)stats->totalBytes,
+            stats->allocations, stats->releases);
+}
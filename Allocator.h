@@ -0,0 +1,174 @@
+/**
+ * @file Allocator.h
+ * @brief Pluggable memory allocation with accounting, used by List, Map and the searches.
+ *
+ * An Allocator is a pair of allocate / release functions, and statistics of the memory it
+ * handed out. Three implementations are provided:
+ *  - tracking: forwards to a parent allocator, only to count the memory of one subsystem
+ *  - arena: bump allocation in large chunks, release is free, reset gives back all at once
+ *  - pool: fixed size blocks with a free list, for many equal allocations (list nodes)
+ * Wherever an allocator can be given, 0 means malloc / free without accounting.
+ * Allocators are not thread safe, use one per thread.
+ */
+#ifndef ADVANCED_C_CLASS_ALLOCATOR_H
+#define ADVANCED_C_CLASS_ALLOCATOR_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include "status.h"
+
+/** Alignment of all allocations from the arena and pool allocators */
+#define ALLOCATOR_ALIGNMENT     (16)
+/** Default chunk size of the arena and pool allocators */
+#define ALLOCATOR_CHUNK_SIZE    (64 * 1024)
+
+/**
+ * Statistics of an allocator, on the sizes asked by its users
+ */
+typedef struct AllocatorStats {
+    size_t bytesInUse;
+    size_t peakBytes;
+    size_t totalBytes;
+    long allocations;
+    long releases;
+}AllocatorStats;
+
+/**
+ * Allocator interface: the functions of the implementation and its statistics
+ */
+typedef struct Allocator {
+    const char *name;
+    void *(*allocate)(struct Allocator *allocator, size_t size);
+    void (*release)(struct Allocator *allocator, void *memory, size_t size);
+    AllocatorStats stats;
+}Allocator;
+
+/**
+ * Tracking allocator: counts the memory of a subsystem, allocated from its parent
+ */
+typedef struct TrackingAllocator {
+    Allocator base;
+    Allocator *parent;
+}TrackingAllocator;
+
+/**
+ * Chunk of an arena or pool allocator
+ */
+typedef struct AllocatorChunk {
+    struct AllocatorChunk *next;
+    size_t size;
+    size_t used;
+}AllocatorChunk;
+
+/**
+ * Arena allocator: memory is taken from the end of the current chunk, and only given back by a reset
+ */
+typedef struct ArenaAllocator {
+    Allocator base;
+    Allocator *parent;
+    AllocatorChunk *chunks;
+    size_t chunkSize;
+    size_t reservedBytes;
+}ArenaAllocator;
+
+/**
+ * Pool allocator: blocks of blockSize from chunks, released blocks are reused.
+ * Allocations of another size are forwarded to the parent.
+ */
+typedef struct PoolAllocator {
+    Allocator base;
+    Allocator *parent;
+    AllocatorChunk *chunks;
+    size_t blockSize;
+    size_t chunkSize;
+    void *freeBlocks;
+    size_t reservedBytes;
+}PoolAllocator;
+
+/**
+ * Allocate memory
+ * @param allocator the allocator, 0 for malloc
+ * @param size the number of bytes
+ * @return the memory, 0 if allocation failed
+ */
+void *allocMemory(Allocator *allocator, size_t size);
+
+/**
+ * Allocate memory filled with zeros
+ * @param allocator the allocator, 0 for calloc
+ * @param size the number of bytes
+ * @return the memory, 0 if allocation failed
+ */
+void *allocZeroedMemory(Allocator *allocator, size_t size);
+
+/**
+ * Resize memory, keeping its content
+ * @param allocator the allocator the memory came from, 0 for realloc
+ * @param memory the memory to resize, may be 0
+ * @param oldSize the current size of the memory
+ * @param newSize the new size
+ * @return the resized memory, 0 if allocation failed (the old memory is unchanged then)
+ */
+void *reallocMemory(Allocator *allocator, void *memory, size_t oldSize, size_t newSize);
+
+/**
+ * Release memory
+ * @param allocator the allocator the memory came from, 0 for free
+ * @param memory the memory to release, may be 0
+ * @param size the size the memory was allocated with
+ */
+void freeMemory(Allocator *allocator, void *memory, size_t size);
+
+/**
+ * Initialise a tracking allocator
+ * @param tracking the allocator to initialise
+ * @param name name of the subsystem, for the statistics
+ * @param parent the allocator to take the memory from, 0 for malloc
+ */
+void initTrackingAllocator(TrackingAllocator *tracking, const char *name, Allocator *parent);
+
+/**
+ * Initialise an arena allocator
+ * @param arena the allocator to initialise
+ * @param name name of the subsystem, for the statistics
+ * @param chunkSize size of the chunks, 0 for ALLOCATOR_CHUNK_SIZE
+ * @param parent the allocator to take the chunks from, 0 for malloc
+ */
+void initArenaAllocator(ArenaAllocator *arena, const char *name, size_t chunkSize, Allocator *parent);
+
+/**
+ * Give back all memory of the arena at once: everything allocated from it becomes invalid.
+ * The first chunk is kept, so a reused arena does not allocate again.
+ * @param arena the arena to reset
+ */
+void resetArenaAllocator(ArenaAllocator *arena);
+
+/**
+ * Release all chunks of the arena to its parent
+ * @param arena the arena to release
+ */
+void releaseArenaAllocator(ArenaAllocator *arena);
+
+/**
+ * Initialise a pool allocator
+ * @param pool the allocator to initialise
+ * @param name name of the subsystem, for the statistics
+ * @param blockSize size of the pooled blocks
+ * @param parent the allocator to take the chunks and other sizes from, 0 for malloc
+ */
+void initPoolAllocator(PoolAllocator *pool, const char *name, size_t blockSize, Allocator *parent);
+
+/**
+ * Release all chunks of the pool to its parent: all blocks become invalid
+ * @param pool the pool to release
+ */
+void releasePoolAllocator(PoolAllocator *pool);
+
+/**
+ * Print the statistics of an allocator as one line
+ * @param file the file to print to
+ * @param allocator the allocator
+ */
+void printAllocatorStats(FILE *file, Allocator *allocator);
+
+#endif //ADVANCED_C_CLASS_ALLOCATOR_H
@@ -0,0 +1,328 @@
+/**
+ * @file ArcFlags.c
+ * @brief Arc-flags: goal directed pruning of the edges searched by findRoute().
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <string.h>
+#include "ArcFlags.h"
+#include "Graph.h"
+#include "Heap.h"
+
+/**
+ * City while partitioning: its position and id
+ */
+typedef struct PositionedCity {
+    int latitude;
+    int longitude;
+    int cityId;
+}PositionedCity;
+
+/**
+ * State shared by the threads of one build: the graph, its reverse, and the boundary cities to search from
+ */
+typedef struct ArcFlagsBuild {
+    Graph *graph;
+    Graph *reverse;
+    int *boundary;
+    int boundaryCount;
+    int nextBoundary;       // Next boundary city to search from, only accessed atomically
+    int failed;             // Set when a thread could not allocate, only accessed atomically
+    ArcFlags *arcFlags;
+}ArcFlagsBuild;
+
+/**
+ * Functions to compare two PositionedCities on latitude or longitude, then on id
+ * @param c1 the first city to compare
+ * @param c2 the second city to compare
+ * @return <0 if c1 is less than c2
+ * @return 0 if c1 equals c2
+ * @return >0 otherwise
+ */
+static int compOnLatitude(const void *c1, const void *c2) {
+    const PositionedCity *city1 = (const PositionedCity*)c1;
+    const PositionedCity *city2 = (const PositionedCity*)c2;
+    if(city1->latitude != city2->latitude) {
+        return (city1->latitude > city2->latitude) - (city1->latitude < city2->latitude);
+    }
+    return (city1->cityId > city2->cityId) - (city1->cityId < city2->cityId);
+}
+
+static int compOnLongitude(const void *c1, const void *c2) {
+    const PositionedCity *city1 = (const PositionedCity*)c1;
+    const PositionedCity *city2 = (const PositionedCity*)c2;
+    if(city1->longitude != city2->longitude) {
+        return (city1->longitude > city2->longitude) - (city1->longitude < city2->longitude);
+    }
+    return (city1->cityId > city2->cityId) - (city1->cityId < city2->cityId);
+}
+
+/**
+ * Partition cities in regions of about equal size: split along the widest coordinate,
+ * in proportion to the number of regions on each side
+ * @param cities the cities to partition, reordered
+ * @param count the number of cities
+ * @param firstRegion the first region to give
+ * @param regionCount the number of regions to give
+ * @param cityRegion (out) the region of every city id
+ */
+static void partitionCities(PositionedCity *cities, int count, int firstRegion, int regionCount,
+                            unsigned char *cityRegion) {
+    if(regionCount == 1 || count <= 1) {
+        for (int i = 0; i < count; i++) {
+            cityRegion[cities[i].cityId] = (unsigned char)firstRegion;
+        }
+        return;
+    }
+    int minLatitude = cities[0].latitude, maxLatitude = cities[0].latitude;
+    int minLongitude = cities[0].longitude, maxLongitude = cities[0].longitude;
+    for (int i = 1; i < count; i++) {
+        minLatitude = cities[i].latitude < minLatitude ? cities[i].latitude : minLatitude;
+        maxLatitude = cities[i].latitude > maxLatitude ? cities[i].latitude : maxLatitude;
+        minLongitude = cities[i].longitude < minLongitude ? cities[i].longitude : minLongitude;
+        maxLongitude = cities[i].longitude > maxLongitude ? cities[i].longitude : maxLongitude;
+    }
+    qsort(cities, count, sizeof(PositionedCity),
+          (long)maxLatitude - minLatitude >= (long)maxLongitude - minLongitude ? compOnLatitude : compOnLongitude);
+
+    int lowRegions = regionCount / 2;
+    int lowCount = (int)((long long)count * lowRegions / regionCount);
+    partitionCities(cities, lowCount, firstRegion, lowRegions, cityRegion);
+    partitionCities(cities + lowCount, count - lowCount, firstRegion + lowRegions, regionCount - lowRegions,
+                    cityRegion);
+}
+
+/**
+ * Set the flag of an edge for a region, thread safe
+ * @param arcFlags the flags
+ * @param edge the edge
+ * @param region the region
+ */
+static void setArcFlag(ArcFlags *arcFlags, int edge, int region) {
+    uint64_t bit = (uint64_t)edge * arcFlags->regionCount + region;
+    uint32_t mask = 1u << (bit & 31);
+    if(!(__atomic_load_n(&arcFlags->flagWords[bit >> 5], __ATOMIC_RELAXED) & mask)) {
+        __atomic_fetch_or(&arcFlags->flagWords[bit >> 5], mask, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * Distance from every city to a target city: Dijkstra over the reverse graph
+ * @param build the build
+ * @param target the city to search to
+ * @param distances (out) the distance to the target per city, UNREACHABLE_DISTANCE if none
+ * @param heap an empty heap
+ * @return ERRALLOC if memory allocation failed
+ * @return OK otherwise
+ */
+static status backwardDistances(ArcFlagsBuild *build, int target, int *distances, Heap *heap) {
+    for (int city = 0; city < build->graph->cityCount; city++) {
+        distances[city] = UNREACHABLE_DISTANCE;
+    }
+    distances[target] = 0;
+    status ret = pushHeap(heap, 0, target);
+    HeapEntry entry;
+    while (ret == OK && popHeap(heap, &entry) == OK) {
+        if(entry.key > distances[entry.cityId]) {
+            continue;
+        }
+        Graph *reverse = build->reverse;
+        for (int edge = reverse->edgeStart[entry.cityId]; edge < reverse->edgeStart[entry.cityId + 1]; edge++) {
+            int distance = entry.key + reverse->edgeDistance[edge];
+            int city = reverse->edgeCity[edge];
+            if(distance < distances[city]) {
+                distances[city] = distance;
+                if((ret = pushHeap(heap, distance, city)) != OK) {
+                    break;
+                }
+            }
+        }
+    }
+    clearHeap(heap);
+    return ret;
+}
+
+/**
+ * Thread function: search back from boundary cities until all are done,
+ * and flag the edges on a shortest path to them for their region
+ * @param argument the ArcFlagsBuild
+ * @return 0
+ */
+static void *flagBoundaryCities(void *argument) {
+    ArcFlagsBuild *build = (ArcFlagsBuild*)argument;
+    Graph *graph = build->graph;
+    ArcFlags *arcFlags = build->arcFlags;
+    Heap heap;
+    int *distances = (int*)malloc(sizeof(int) * graph->cityCount);
+    if(!distances || initHeap(&heap, graph->cityCount) != OK) {
+        free(distances);
+        __atomic_store_n(&build->failed, 1, __ATOMIC_RELAXED);
+        return 0;
+    }
+
+    int index;
+    while (!__atomic_load_n(&build->failed, __ATOMIC_RELAXED)
+           && (index = __atomic_fetch_add(&build->nextBoundary, 1, __ATOMIC_RELAXED)) < build->boundaryCount) {
+        int target = build->boundary[index];
+        if(backwardDistances(build, target, distances, &heap) != OK) {
+            __atomic_store_n(&build->failed, 1, __ATOMIC_RELAXED);
+            break;
+        }
+        // An edge u -> v is on a shortest path to the target when it is tight: d(u) = c(u, v) + d(v)
+        int region = arcFlags->cityRegion[target];
+        for (int city = 0; city < graph->cityCount; city++) {
+            if(distances[city] == UNREACHABLE_DISTANCE) {
+                continue;
+            }
+            for (int edge = graph->edgeStart[city]; edge < graph->edgeStart[city + 1]; edge++) {
+                int next = graph->edgeCity[edge];
+                if(distances[next] != UNREACHABLE_DISTANCE
+                   && (long long)distances[next] + graph->edgeDistance[edge] == distances[city]) {
+                    setArcFlag(arcFlags, edge, region);
+                }
+            }
+        }
+    }
+    freeHeap(&heap);
+    free(distances);
+    return 0;
+}
+
+/**
+ * Allocate the flags of a graph, and partition its cities
+ * @param cityMap the map, for the positions and the allocator
+ * @param graph the graph of the map
+ * @param regionCount the number of regions
+ * @param arcFlags (out) the flags, all cleared
+ * @return ERRALLOC if memory allocation failed
+ * @return OK otherwise
+ */
+static status newArcFlags(CityMap *cityMap, Graph *graph, int regionCount, ArcFlags **arcFlags) {
+    Allocator *allocator = &cityMap->memory.base;
+    ArcFlags *newFlags = (ArcFlags*)allocZeroedMemory(allocator, sizeof(ArcFlags));
+    if(!(*arcFlags = newFlags)) {
+        return ERRALLOC;
+    }
+    newFlags->allocator = allocator;
+    newFlags->cityCount = graph->cityCount;
+    newFlags->edgeCount = graph->edgeCount;
+    newFlags->regionCount = regionCount;
+    size_t wordCount = ((uint64_t)graph->edgeCount * regionCount + 31) / 32 + 1;
+    newFlags->edgeStart = (int*)allocMemory(allocator, sizeof(int) * (graph->cityCount + 1));
+    newFlags->cityRegion = (unsigned char*)allocMemory(allocator, graph->cityCount ? graph->cityCount : 1);
+    newFlags->flagWords = (uint32_t*)allocZeroedMemory(allocator, sizeof(uint32_t) * wordCount);
+    PositionedCity *cities = (PositionedCity*)malloc(sizeof(PositionedCity) * (graph->cityCount ? graph->cityCount : 1));
+    if(!newFlags->edgeStart || !newFlags->cityRegion || !newFlags->flagWords || !cities) {
+        free(cities);
+        return ERRALLOC;
+    }
+    memcpy(newFlags->edgeStart, graph->edgeStart, sizeof(int) * (graph->cityCount + 1));
+    for (int id = 0; id < graph->cityCount; id++) {
+        cities[id].latitude = cityMap->cities[id]->latitude;
+        cities[id].longitude = cityMap->cities[id]->longitude;
+        cities[id].cityId = id;
+    }
+    partitionCities(cities, graph->cityCount, 0, regionCount, newFlags->cityRegion);
+    free(cities);
+    return OK;
+}
+
+status buildArcFlags(CityMap *cityMap, int regionCount, int threadCount) {
+    regionCount = regionCount ? regionCount : ARC_FLAGS_DEFAULT_REGIONS;
+    if(regionCount < 1 || regionCount > ARC_FLAGS_MAX_REGIONS) {
+        return ERRINDEX;
+    }
+    threadCount = threadCount < 1 ? 1 : threadCount;
+
+    ArcFlagsBuild build;
+    memset(&build, 0, sizeof(ArcFlagsBuild));
+    status ret = createGraph(cityMap, &build.graph);
+    if(ret == OK) {
+        ret = newArcFlags(cityMap, build.graph, regionCount, &build.arcFlags);
+    }
+    if(ret == OK) {
+        ret = createReverseGraph(build.graph, &build.reverse);
+    }
+    Graph *graph = build.graph;
+    ArcFlags *arcFlags = build.arcFlags;
+    if(ret == OK && !(build.boundary = (int*)malloc(sizeof(int) * (graph->cityCount ? graph->cityCount : 1)))) {
+        ret = ERRALLOC;
+    }
+
+    if(ret == OK) {
+        // Edges inside a region are flagged for it, cities with an edge coming in from another region are boundary
+        for (int city = 0; city < graph->cityCount; city++) {
+            int region = arcFlags->cityRegion[city];
+            int isBoundary = 0;
+            for (int edge = graph->edgeStart[city]; edge < graph->edgeStart[city + 1]; edge++) {
+                if(arcFlags->cityRegion[graph->edgeCity[edge]] == region) {
+                    setArcFlag(arcFlags, edge, region);
+                }
+            }
+            for (int edge = build.reverse->edgeStart[city]; edge < build.reverse->edgeStart[city + 1]; edge++) {
+                isBoundary |= arcFlags->cityRegion[build.reverse->edgeCity[edge]] != region;
+            }
+            if(isBoundary) {
+                build.boundary[build.boundaryCount++] = city;
+            }
+        }
+        arcFlags->boundaryCount = build.boundaryCount;
+
+        // Search from the boundary cities in parallel, this thread takes part
+        pthread_t *threads = (pthread_t*)malloc(sizeof(pthread_t) * threadCount);
+        int started = 0;
+        while (threads && started < threadCount - 1
+               && pthread_create(&threads[started], 0, flagBoundaryCities, &build) == 0) {
+            started++;
+        }
+        flagBoundaryCities(&build);
+        for (int thread = 0; thread < started; thread++) {
+            pthread_join(threads[thread], 0);
+        }
+        free(threads);
+        ret = build.failed ? ERRALLOC : OK;
+    }
+
+    free(build.boundary);
+    destroyGraph(build.reverse);
+    destroyGraph(graph);
+    if(ret != OK) {
+        destroyArcFlags(arcFlags);
+        return ret;
+    }
+    destroyArcFlags(cityMap->arcFlags);
+    cityMap->arcFlags = arcFlags;
+    return OK;
+}
+
+double arcFlagsDensity(ArcFlags *arcFlags) {
+    uint64_t bitCount = (uint64_t)arcFlags->edgeCount * arcFlags->regionCount;
+    uint64_t setCount = 0;
+    for (uint64_t bit = 0; bit < bitCount; bit++) {
+        setCount += (arcFlags->flagWords[bit >> 5] >> (bit & 31)) & 1;
+    }
+    return bitCount ? (double)setCount / bitCount : 0.0;
+}
+
+size_t arcFlagsSize(ArcFlags *arcFlags) {
+    if(!arcFlags) {
+        return 0;
+    }
+    size_t wordCount = ((uint64_t)arcFlags->edgeCount * arcFlags->regionCount + 31) / 32 + 1;
+    return sizeof(ArcFlags)
+           + sizeof(int) * (arcFlags->cityCount + 1)
+           + (arcFlags->cityCount ? arcFlags->cityCount : 1)
+           + sizeof(uint32_t) * wordCount;
+}
+
+void destroyArcFlags(ArcFlags *arcFlags) {
+    if(!arcFlags) {
+        return;
+    }
+    size_t wordCount = ((uint64_t)arcFlags->edgeCount * arcFlags->regionCount + 31) / 32 + 1;
+    freeMemory(arcFlags->allocator, arcFlags->edgeStart, sizeof(int) * (arcFlags->cityCount + 1));
+    freeMemory(arcFlags->allocator, arcFlags->cityRegion, arcFlags->cityCount ? arcFlags->cityCount : 1);
+    freeMemory(arcFlags->allocator, arcFlags->flagWords, sizeof(uint32_t) * wordCount);
+    freeMemory(arcFlags->allocator, arcFlags, sizeof(ArcFlags));
+}
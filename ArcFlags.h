@@ -0,0 +1,88 @@
+/**
+ * @file ArcFlags.h
+ * @brief Arc-flags: goal directed pruning of the edges searched by findRoute().
+ *
+ * The cities are partitioned in regions, by recursive bisection on their position.
+ * Every edge gets a flag per region, set when the edge lies on a shortest path to a city of
+ * that region. A search to a goal only has to follow the edges flagged for the goal's region,
+ * whatever its heuristic: the edges leading away from the goal are skipped.
+ *
+ * The flags are found with a backward Dijkstra from every boundary city of a region
+ * (a city with an edge coming in from another region), run in parallel over the boundary cities.
+ * The edges inside a region are flagged for it. Edges are numbered as in createGraph():
+ * the neighbours of city 0, then those of city 1, ..., in the order findRoute() reads them.
+ */
+#ifndef ADVANCED_C_CLASS_ARCFLAGS_H
+#define ADVANCED_C_CLASS_ARCFLAGS_H
+
+#include <stdint.h>
+#include "Map.h"
+
+/** Default number of regions */
+#define ARC_FLAGS_DEFAULT_REGIONS   (16)
+/** Maximal number of regions, a region id fits in a byte */
+#define ARC_FLAGS_MAX_REGIONS       (256)
+/** Default number of threads for the backward searches */
+#define ARC_FLAGS_DEFAULT_THREADS   (4)
+
+/**
+ * The flags of all edges: regionCount bits per edge, bit (edge * regionCount + region),
+ * in 32 bit words
+ */
+typedef struct ArcFlags {
+    int cityCount;
+    int edgeCount;
+    int regionCount;
+    int boundaryCount;
+    int *edgeStart;             // First edge of every city, cityCount + 1 entries
+    unsigned char *cityRegion;  // Region of every city
+    uint32_t *flagWords;
+    Allocator *allocator;
+}ArcFlags;
+
+/**
+ * Build the arc-flags of a map, and attach them to it: findRoute() uses them from then on.
+ * Flags built before packMap() stay valid, packing keeps the order of the edges.
+ *
+ * @param cityMap The map, existing flags are replaced
+ * @param regionCount The number of regions (1..ARC_FLAGS_MAX_REGIONS), 0 for ARC_FLAGS_DEFAULT_REGIONS
+ * @param threadCount The number of threads for the backward searches, at least 1
+ * @return ERRINDEX if regionCount is out of range
+ * @return ERRALLOC if memory allocation failed, the map is unchanged then
+ * @return OK otherwise
+ */
+status buildArcFlags(CityMap *cityMap, int regionCount, int threadCount);
+
+/**
+ * Tell if an edge is flagged for a region
+ * @param arcFlags The flags
+ * @param edge The edge number: arcFlags->edgeStart[city] + index of the neighbour
+ * @param region The region
+ * @return non zero if the edge lies on a shortest path into the region
+ */
+static inline int arcFlag(ArcFlags *arcFlags, int edge, int region) {
+    uint64_t bit = (uint64_t)edge * arcFlags->regionCount + region;
+    return (arcFlags->flagWords[bit >> 5] >> (bit & 31)) & 1;
+}
+
+/**
+ * Fraction of the flags which are set, the part of the edges a search has to follow on average
+ * @param arcFlags The flags
+ * @return the fraction, 0..1
+ */
+double arcFlagsDensity(ArcFlags *arcFlags);
+
+/**
+ * Amount of memory used by the flags
+ * @param arcFlags The flags
+ * @return the size in bytes
+ */
+size_t arcFlagsSize(ArcFlags *arcFlags);
+
+/**
+ * Clean up arc-flags
+ * @param arcFlags The flags to destroy, may be 0
+ */
+void destroyArcFlags(ArcFlags *arcFlags);
+
+#endif //ADVANCED_C_CLASS_ARCFLAGS_H
@@ -0,0 +1,164 @@
+/**
+ * @file Components.c
+ * @brief Weakly connected components by union-find, strongly connected components by Tarjan's algorithm.
+ */
+
+#include <string.h>
+#include "Components.h"
+#include "Graph.h"
+
+/**
+ * Root of the set of a city, halving the path to it
+ * @param parents the parent of every city in its set
+ * @param city the city
+ * @return the root
+ */
+static int findRoot(int *parents, int city) {
+    while (parents[city] != city) {
+        parents[city] = parents[parents[city]];
+        city = parents[city];
+    }
+    return city;
+}
+
+/**
+ * Number the weakly connected components, in order of their first city
+ * @param graph the graph
+ * @param component (out) the component of every city, used as the union-find parents first
+ * @return the number of components
+ */
+static int weakComponents(Graph *graph, int *component) {
+    for (int city = 0; city < graph->cityCount; city++) {
+        component[city] = city;
+    }
+    for (int city = 0; city < graph->cityCount; city++) {
+        for (int edge = graph->edgeStart[city]; edge < graph->edgeStart[city + 1]; edge++) {
+            int root = findRoot(component, city);
+            int otherRoot = findRoot(component, graph->edgeCity[edge]);
+            // The lowest city is the root, so a root comes before the cities of its set
+            if(root < otherRoot) {
+                component[otherRoot] = root;
+            }
+            else {
+                component[root] = otherRoot;
+            }
+        }
+    }
+    for (int city = 0; city < graph->cityCount; city++) {
+        component[city] = findRoot(component, city);
+    }
+    // A root is numbered before the other cities of its set
+    int count = 0;
+    for (int city = 0; city < graph->cityCount; city++) {
+        component[city] = component[city] == city ? count++ : component[component[city]];
+    }
+    return count;
+}
+
+/**
+ * Number the strongly connected components by Tarjan's algorithm, without recursion
+ * @param graph the graph
+ * @param strongComponent (out) the component of every city, in order of completion
+ * @param work room for 4 * cityCount ints
+ * @return the number of components
+ */
+static int strongComponents(Graph *graph, int *strongComponent, int *work) {
+    int cityCount = graph->cityCount;
+    int *order = work;                      // Visiting order of every city, -1 before the visit
+    int *lowest = work + cityCount;         // Lowest order reachable on the stack
+    int *stack = work + 2 * cityCount;      // Cities visited, not in a component yet
+    int *path = work + 3 * cityCount;       // Cities of the depth first path
+    int stackCount = 0;
+    int visited = 0;
+    int count = 0;
+    memset(order, 0xff, sizeof(int) * cityCount);
+
+    for (int root = 0; root < cityCount; root++) {
+        if(order[root] >= 0) {
+            continue;
+        }
+        int pathCount = 0;
+        path[pathCount++] = root;
+        order[root] = lowest[root] = visited++;
+        stack[stackCount++] = root;
+        // The next edge of a city on the path is kept in strongComponent until it completes
+        strongComponent[root] = graph->edgeStart[root];
+        while (pathCount > 0) {
+            int city = path[pathCount - 1];
+            if(strongComponent[city] < graph->edgeStart[city + 1]) {
+                int next = graph->edgeCity[strongComponent[city]++];
+                if(order[next] < 0) {
+                    path[pathCount++] = next;
+                    order[next] = lowest[next] = visited++;
+                    stack[stackCount++] = next;
+                    strongComponent[next] = graph->edgeStart[next];
+                }
+                else if(order[next] < INT_MAX && order[next] < lowest[city]) {
+                    // On the stack
+                    lowest[city] = order[next];
+                }
+                continue;
+            }
+            pathCount--;
+            if(lowest[city] == order[city]) {
+                // The root of a component: its cities are on the stack from it on
+                int member;
+                do {
+                    member = stack[--stackCount];
+                    strongComponent[member] = count;
+                    order[member] = INT_MAX;
+                } while (member != city);
+                count++;
+            }
+            if(pathCount > 0 && lowest[city] < lowest[path[pathCount - 1]]) {
+                lowest[path[pathCount - 1]] = lowest[city];
+            }
+        }
+    }
+    return count;
+}
+
+status buildComponents(CityMap *cityMap) {
+    destroyComponents(cityMap->components);
+    cityMap->components = 0;
+
+    Allocator *allocator = &cityMap->memory.base;
+    int cityCount = cityMap->cityCount;
+    size_t arraySize = sizeof(int) * (cityCount ? cityCount : 1);
+    Graph *graph = 0;
+    int *work = (int*)malloc(4 * arraySize);
+    Components *components = (Components*)allocMemory(allocator, sizeof(Components));
+    status ret = work && components ? createGraph(cityMap, &graph) : ERRALLOC;
+    if(ret == OK) {
+        components->allocator = allocator;
+        components->cityCount = cityCount;
+        components->component = (int*)allocMemory(allocator, arraySize);
+        components->strongComponent = (int*)allocMemory(allocator, arraySize);
+        if(!components->component || !components->strongComponent) {
+            destroyComponents(components);
+            components = 0;
+            ret = ERRALLOC;
+        }
+    }
+    if(ret == OK) {
+        components->componentCount = weakComponents(graph, components->component);
+        components->strongComponentCount = strongComponents(graph, components->strongComponent, work);
+        cityMap->components = components;
+    }
+    else if(components) {
+        freeMemory(allocator, components, sizeof(Components));
+    }
+    destroyGraph(graph);
+    free(work);
+    return ret;
+}
+
+void destroyComponents(Components *components) {
+    if(!components) {
+        return;
+    }
+    size_t arraySize = sizeof(int) * (components->cityCount ? components->cityCount : 1);
+    freeMemory(components->allocator, components->component, arraySize);
+    freeMemory(components->allocator, components->strongComponent, arraySize);
+    freeMemory(components->allocator, components, sizeof(Components));
+}
@@ -0,0 +1,60 @@
+/**
+ * @file Components.h
+ * @brief Connected components of a map, to reject a route between cities which cannot reach each other at once.
+ *
+ * Two numbers per city, computed once when the map is created:
+ *  - its weakly connected component, by union-find over the edges in both directions:
+ *    cities in different components are not connected at all
+ *  - its strongly connected component, by Tarjan's algorithm: the components are numbered in the order
+ *    Tarjan completes them, so an edge from one component to another always goes to a lower number
+ *
+ * A route from a city to another can only exist when they share the weak component and the goal's strong
+ * component number is not above the start's: mayReach() tells in O(1). It never rejects a route which
+ * exists, it can accept one which does not (a one way edge the other way round).
+ */
+#ifndef ADVANCED_C_CLASS_COMPONENTS_H
+#define ADVANCED_C_CLASS_COMPONENTS_H
+
+#include "Map.h"
+
+/**
+ * The components of all cities
+ */
+typedef struct Components {
+    int cityCount;
+    int componentCount;
+    int strongComponentCount;
+    int *component;             // Weakly connected component of every city
+    int *strongComponent;       // Strongly connected component of every city, in Tarjan's order
+    Allocator *allocator;
+}Components;
+
+/**
+ * Compute the components of a map, and attach them to it (replacing those it has).
+ * createMap() and mergeMaps() do so, needed again after adding cities or neighbours otherwise.
+ * @param cityMap The map
+ * @return ERRALLOC if memory allocation failed, the map has no components then
+ * @return OK otherwise
+ */
+status buildComponents(CityMap *cityMap);
+
+/**
+ * Tell if a route can exist between two cities
+ * @param components The components, 0 when unknown
+ * @param fromCityId The city to start from
+ * @param toCityId The city to go to
+ * @return 0 if there is no route, non zero if there may be
+ */
+static inline int mayReach(Components *components, int fromCityId, int toCityId) {
+    return !components
+           || (components->component[fromCityId] == components->component[toCityId]
+               && components->strongComponent[toCityId] <= components->strongComponent[fromCityId]);
+}
+
+/**
+ * Clean up components
+ * @param components The components to destroy, may be 0
+ */
+void destroyComponents(Components *components);
+
+#endif //ADVANCED_C_CLASS_COMPONENTS_H
@@ -0,0 +1,360 @@
+/**
+ * @file DeltaStepping.c
+ * @brief Parallel single source shortest paths over a Graph, using delta-stepping.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include "DeltaStepping.h"
+
+/**
+ * Growing array of city ids
+ */
+typedef struct Bucket {
+    int *cityIds;
+    int count;
+    int capacity;
+}Bucket;
+
+struct DeltaSteppingRun;
+
+/**
+ * State owned by one thread: a cyclic array of buckets, the cities taken from the
+ * current bucket and the cities settled in the current bucket (for the heavy edges).
+ * A thread owns the cities with cityId % threadCount == index: it settles and expands them.
+ * Cities it relaxes go to the outbox of their owner, merged into the owner's buckets at the barrier.
+ */
+typedef struct DeltaWorker {
+    struct DeltaSteppingRun *run;
+    int index;
+    Bucket *buckets;
+    Bucket *outboxes;           // One per thread, written by this thread, emptied by the owner
+    Bucket frontier;
+    Bucket settled;
+    int settledCount;           // Number of cities settled by this thread
+}DeltaWorker;
+
+/**
+ * State shared between all threads of one delta-stepping run
+ */
+typedef struct DeltaSteppingRun {
+    Graph *graph;
+    int delta;
+    int threadCount;
+    int bucketCount;            // Size of the cyclic bucket window
+    int *distances;             // Only accessed atomically during the run
+    int *settledInBucket;       // Bucket in which a city was last settled, to add it once
+    int *workerValue;           // Per thread value for reductions (minimal bucket, bucket size)
+    int failed;
+    int started;                // Set once all threads are created, threadCount is final then
+    pthread_mutex_t startLock;
+    pthread_cond_t startCondition;
+    pthread_barrier_t barrier;
+    DeltaWorker *workers;
+}DeltaSteppingRun;
+
+/**
+ * Add a city id to a bucket
+ * @param bucket the bucket
+ * @param cityId the id to add
+ * @return ERRALLOC if memory allocation failed
+ * @return OK otherwise
+ */
+static status pushBucket(Bucket *bucket, int cityId) {
+    if(bucket->count == bucket->capacity) {
+        int capacity = bucket->capacity ? bucket->capacity * 2 : 16;
+        int *cityIds = (int*)realloc(bucket->cityIds, sizeof(int) * capacity);
+        if(!cityIds) {
+            return ERRALLOC;
+        }
+        bucket->cityIds = cityIds;
+        bucket->capacity = capacity;
+    }
+    bucket->cityIds[bucket->count++] = cityId;
+    return OK;
+}
+
+/**
+ * Lower the distance of a city if the new distance is shorter, and put it in the outbox
+ * for the thread owning the city when it was lowered.
+ * @param worker the relaxing thread
+ * @param cityId the city to relax
+ * @param distance the new distance
+ */
+static void relaxCity(DeltaWorker *worker, int cityId, int distance) {
+    DeltaSteppingRun *run = worker->run;
+    int current = __atomic_load_n(&run->distances[cityId], __ATOMIC_RELAXED);
+    while (distance < current) {
+        if(__atomic_compare_exchange_n(&run->distances[cityId], &current, distance, 0,
+                                       __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            if(pushBucket(&worker->outboxes[cityId % run->threadCount], cityId) != OK) {
+                __atomic_store_n(&run->failed, 1, __ATOMIC_RELAXED);
+            }
+            return;
+        }
+        // current is updated by the failed exchange, try again while still shorter
+    }
+}
+
+/**
+ * Relax the light (distance <= delta) or heavy edges of a city
+ * @param worker the relaxing thread
+ * @param cityId the city to expand
+ * @param light 1 for the light edges, 0 for the heavy edges
+ */
+static void relaxEdges(DeltaWorker *worker, int cityId, int light) {
+    DeltaSteppingRun *run = worker->run;
+    Graph *graph = run->graph;
+    int distance = __atomic_load_n(&run->distances[cityId], __ATOMIC_RELAXED);
+    for (int edge = graph->edgeStart[cityId]; edge < graph->edgeStart[cityId + 1]; edge++) {
+        int edgeDistance = graph->edgeDistance[edge];
+        if((edgeDistance <= run->delta) == light) {
+            relaxCity(worker, graph->edgeCity[edge], distance + edgeDistance);
+        }
+    }
+}
+
+/**
+ * Move the cities relaxed for a thread by all threads into its buckets, on their distance now.
+ * Only between barriers: no thread relaxes meanwhile.
+ * @param worker the owning thread
+ */
+static void mergeOutboxes(DeltaWorker *worker) {
+    DeltaSteppingRun *run = worker->run;
+    for (int thread = 0; thread < run->threadCount; thread++) {
+        Bucket *outbox = &run->workers[thread].outboxes[worker->index];
+        for (int i = 0; i < outbox->count; i++) {
+            int cityId = outbox->cityIds[i];
+            int distance = __atomic_load_n(&run->distances[cityId], __ATOMIC_RELAXED);
+            if(pushBucket(&worker->buckets[(distance / run->delta) % run->bucketCount], cityId) != OK) {
+                __atomic_store_n(&run->failed, 1, __ATOMIC_RELAXED);
+            }
+        }
+        outbox->count = 0;
+    }
+}
+
+/**
+ * Find the lowest bucket which is not empty in the window of a thread
+ * @param worker the thread
+ * @param from the bucket to start from
+ * @return the bucket number, INT_MAX if all buckets are empty
+ */
+static int lowestBucket(DeltaWorker *worker, int from) {
+    DeltaSteppingRun *run = worker->run;
+    for (int bucket = from; bucket < from + run->bucketCount; bucket++) {
+        if(worker->buckets[bucket % run->bucketCount].count) {
+            return bucket;
+        }
+    }
+    return INT_MAX;
+}
+
+/**
+ * Thread function: process the buckets in order together with the other threads
+ * @param arg the DeltaWorker of the thread
+ * @return 0
+ */
+static void *deltaSteppingWorker(void *arg) {
+    DeltaWorker *worker = (DeltaWorker*)arg;
+    DeltaSteppingRun *run = worker->run;
+
+    // Wait until all threads are created
+    pthread_mutex_lock(&run->startLock);
+    while (!run->started) {
+        pthread_cond_wait(&run->startCondition, &run->startLock);
+    }
+    pthread_mutex_unlock(&run->startLock);
+    if(worker->index >= run->threadCount) {
+        return 0;
+    }
+
+    int current = 0;
+    while (1) {
+        // Agree on the lowest bucket which is not empty
+        run->workerValue[worker->index] = lowestBucket(worker, current);
+        pthread_barrier_wait(&run->barrier);
+        current = INT_MAX;
+        for (int thread = 0; thread < run->threadCount; thread++) {
+            if(run->workerValue[thread] < current) {
+                current = run->workerValue[thread];
+            }
+        }
+        pthread_barrier_wait(&run->barrier);
+        if(current == INT_MAX) {
+            break;  // All buckets empty: done
+        }
+
+        // Light edges, repeat until the bucket stays empty for all threads
+        Bucket *bucket = &worker->buckets[current % run->bucketCount];
+        while (1) {
+            // Take the bucket as frontier
+            Bucket frontier = *bucket;
+            *bucket = worker->frontier;
+            bucket->count = 0;
+            worker->frontier = frontier;
+
+            for (int i = 0; i < worker->frontier.count; i++) {
+                int cityId = worker->frontier.cityIds[i];
+                int distance = __atomic_load_n(&run->distances[cityId], __ATOMIC_RELAXED);
+                if(distance / run->delta != current) {
+                    continue;   // Outdated entry, the city moved to another bucket
+                }
+                if(__atomic_exchange_n(&run->settledInBucket[cityId], current, __ATOMIC_RELAXED) != current) {
+                    worker->settledCount++;
+                    if(pushBucket(&worker->settled, cityId) != OK) {
+                        __atomic_store_n(&run->failed, 1, __ATOMIC_RELAXED);
+                    }
+                }
+                relaxEdges(worker, cityId, 1);
+            }
+            pthread_barrier_wait(&run->barrier);
+            mergeOutboxes(worker);
+
+            run->workerValue[worker->index] = bucket->count;
+            pthread_barrier_wait(&run->barrier);
+            int remaining = 0;
+            for (int thread = 0; thread < run->threadCount; thread++) {
+                remaining += run->workerValue[thread];
+            }
+            if(!remaining) {
+                break;
+            }
+        }
+
+        // Heavy edges of all cities settled in this bucket, these end in later buckets
+        for (int i = 0; i < worker->settled.count; i++) {
+            relaxEdges(worker, worker->settled.cityIds[i], 0);
+        }
+        worker->settled.count = 0;
+        pthread_barrier_wait(&run->barrier);
+        mergeOutboxes(worker);
+    }
+    return 0;
+}
+
+int suggestDelta(Graph *graph) {
+    if(!graph->cityCount || !graph->edgeCount) {
+        return 1;
+    }
+    int averageNeighbours = (graph->edgeCount + graph->cityCount - 1) / graph->cityCount;
+    int delta = graph->maxDistance / averageNeighbours;
+    return delta > 0 ? delta : 1;
+}
+
+status deltaStepping(Graph *graph, int startCityId, int delta, int threadCount, int *distances) {
+    return deltaSteppingWithCounts(graph, startCityId, delta, threadCount, distances, 0);
+}
+
+status deltaSteppingWithCounts(Graph *graph, int startCityId, int delta, int threadCount, int *distances,
+                               int *settledCounts) {
+    if(startCityId < 0 || startCityId >= graph->cityCount) {
+        return ERRINDEX;
+    }
+    if(delta <= 0) {
+        delta = suggestDelta(graph);
+    }
+    if(threadCount <= 0) {
+        threadCount = DELTA_STEPPING_DEFAULT_THREADS;
+    }
+
+    // Pending distances are at most maxDistance above the current bucket, so this window is enough
+    DeltaSteppingRun run;
+    run.graph = graph;
+    run.delta = delta;
+    run.threadCount = threadCount;
+    run.bucketCount = graph->maxDistance / delta + 2;
+    run.distances = distances;
+    run.failed = 0;
+    run.settledInBucket = (int*)malloc(sizeof(int) * (graph->cityCount ? graph->cityCount : 1));
+    run.workerValue = (int*)malloc(sizeof(int) * threadCount);
+    run.workers = (DeltaWorker*)calloc(threadCount, sizeof(DeltaWorker));
+    pthread_t *threads = (pthread_t*)malloc(sizeof(pthread_t) * threadCount);
+
+    status ret = OK;
+    if(!run.settledInBucket || !run.workerValue || !run.workers || !threads) {
+        ret = ERRALLOC;
+    }
+    for (int thread = 0; ret == OK && thread < threadCount; thread++) {
+        run.workers[thread].run = &run;
+        run.workers[thread].index = thread;
+        run.workers[thread].buckets = (Bucket*)calloc(run.bucketCount, sizeof(Bucket));
+        run.workers[thread].outboxes = (Bucket*)calloc(threadCount, sizeof(Bucket));
+        if(!run.workers[thread].buckets || !run.workers[thread].outboxes) {
+            ret = ERRALLOC;
+        }
+    }
+
+    if(ret == OK) {
+        for (int id = 0; id < graph->cityCount; id++) {
+            distances[id] = UNREACHABLE_DISTANCE;
+            run.settledInBucket[id] = -1;
+        }
+        distances[startCityId] = 0;
+    }
+
+    // Run all threads, and wait until they are done.
+    // When fewer threads could be created, the created ones do all the work.
+    if(ret == OK) {
+        run.started = 0;
+        pthread_mutex_init(&run.startLock, 0);
+        pthread_cond_init(&run.startCondition, 0);
+        int created = 0;
+        for (; created < threadCount; created++) {
+            if(pthread_create(&threads[created], 0, deltaSteppingWorker, &run.workers[created]) != 0) {
+                break;
+            }
+        }
+        run.threadCount = created;
+        if(created && pthread_barrier_init(&run.barrier, 0, created) != 0) {
+            run.threadCount = 0;    // Threads return at once without work
+        }
+        // The start city goes to its owner, now that the number of threads is known
+        if(run.threadCount && pushBucket(&run.workers[startCityId % run.threadCount].buckets[0], startCityId) != OK) {
+            run.failed = 1;
+        }
+
+        pthread_mutex_lock(&run.startLock);
+        run.started = 1;
+        pthread_cond_broadcast(&run.startCondition);
+        pthread_mutex_unlock(&run.startLock);
+        for (int thread = 0; thread < created; thread++) {
+            pthread_join(threads[thread], 0);
+        }
+
+        if(run.threadCount) {
+            pthread_barrier_destroy(&run.barrier);
+        }
+        else {
+            ret = ERRUNABLE;
+        }
+        pthread_cond_destroy(&run.startCondition);
+        pthread_mutex_destroy(&run.startLock);
+    }
+    if(ret == OK && run.failed) {
+        ret = ERRALLOC;
+    }
+    for (int thread = 0; ret == OK && settledCounts && thread < threadCount; thread++) {
+        settledCounts[thread] = run.workers[thread].settledCount;
+    }
+
+    // Cleanup
+    for (int thread = 0; run.workers && thread < threadCount; thread++) {
+        DeltaWorker *worker = &run.workers[thread];
+        for (int bucket = 0; worker->buckets && bucket < run.bucketCount; bucket++) {
+            free(worker->buckets[bucket].cityIds);
+        }
+        free(worker->buckets);
+        for (int outbox = 0; worker->outboxes && outbox < threadCount; outbox++) {
+            free(worker->outboxes[outbox].cityIds);
+        }
+        free(worker->outboxes);
+        free(worker->frontier.cityIds);
+        free(worker->settled.cityIds);
+    }
+    free(run.workers);
+    free(run.workerValue);
+    free(run.settledInBucket);
+    free(threads);
+    return ret;
+}
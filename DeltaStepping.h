@@ -0,0 +1,59 @@
+/**
+ * @file DeltaStepping.h
+ * @brief Parallel single source shortest paths over a Graph, using delta-stepping.
+ *
+ * Cities are kept in buckets of width delta on their tentative distance. All cities of the
+ * lowest bucket are expanded in parallel: first the light edges (distance <= delta) until the
+ * bucket stays empty, then the heavy edges of all cities removed from the bucket.
+ * Every thread owns the cities with cityId % threadCount equal to its index, and its own bucket array:
+ * it settles and expands only its cities. A relaxed city is sent to its owner, through a per thread
+ * outbox merged into the owner's buckets at the next barrier. Distances are relaxed with atomic
+ * compare and swap.
+ * The resulting distances are equal to findAllDistances().
+ */
+#ifndef ADVANCED_C_CLASS_DELTASTEPPING_H
+#define ADVANCED_C_CLASS_DELTASTEPPING_H
+
+#include "Graph.h"
+
+/** Amount of threads used when no thread count is given */
+#define DELTA_STEPPING_DEFAULT_THREADS  (4)
+
+/**
+ * Choose a bucket width for the graph: the maximum edge distance divided by the average
+ * number of neighbours, which keeps the buckets small without too many phases.
+ * @param graph The graph to search
+ * @return the suggested delta, at least 1
+ */
+int suggestDelta(Graph *graph);
+
+/**
+ * Compute the distance from one city to all cities, using multiple threads.
+ *
+ * @param graph The graph to search
+ * @param startCityId The id of the city to start from
+ * @param delta The bucket width, <=0 to use suggestDelta()
+ * @param threadCount The amount of threads to use, <=0 for DELTA_STEPPING_DEFAULT_THREADS
+ * @param distances (out) cityCount distances, UNREACHABLE_DISTANCE for unreachable cities
+ * @return ERRINDEX if the start city is not in the graph
+ * @return ERRALLOC if memory allocation failed
+ * @return ERRUNABLE if the threads could not be started
+ * @return OK otherwise
+ */
+status deltaStepping(Graph *graph, int startCityId, int delta, int threadCount, int *distances);
+
+/**
+ * Same as deltaStepping(), also counting the cities settled by every thread.
+ * @param graph The graph to search
+ * @param startCityId The id of the city to start from
+ * @param delta The bucket width, <=0 to use suggestDelta()
+ * @param threadCount The amount of threads to use, <=0 for DELTA_STEPPING_DEFAULT_THREADS
+ * @param distances (out) cityCount distances, UNREACHABLE_DISTANCE for unreachable cities
+ * @param settledCounts (out) the number of cities settled by every thread, one entry per thread asked for
+ *        (0 for threads which could not be created); may be 0
+ * @return the same as deltaStepping()
+ */
+status deltaSteppingWithCounts(Graph *graph, int startCityId, int delta, int threadCount, int *distances,
+                               int *settledCounts);
+
+#endif //ADVANCED_C_CLASS_DELTASTEPPING_H
@@ -0,0 +1,273 @@
+/**
+ * @file DistanceTable.c
+ * @brief All-pairs distance tables: built in parallel into a mapped file, and mapped for findRoute().
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "DistanceTable.h"
+#include "Heap.h"
+
+/** Magic number of a table file, "DTBL" in native byte order */
+#define DISTANCE_TABLE_MAGIC    (0x4c425444)
+
+/**
+ * Header of a table file, followed by the distances and the next hops
+ */
+typedef struct DistanceTableHeader {
+    uint32_t magic;
+    int32_t cityCount;
+    int32_t edgeCount;
+    int32_t hasNextHops;
+    uint64_t fingerprint;           // graphFingerprint() of the map
+}DistanceTableHeader;
+
+/**
+ * State shared by the threads of one build: the graph, the rows to fill and the next start city
+ */
+typedef struct DistanceTableBuild {
+    Graph *graph;
+    int32_t *distances;
+    int32_t *nextHops;              // 0 without next hops
+    int nextStart;                  // Next start city to search from, only accessed atomically
+    int failed;                     // Set when a thread could not allocate, only accessed atomically
+}DistanceTableBuild;
+
+uint64_t graphFingerprint(Graph *graph) {
+    // FNV-1a over the counts and the edges
+    uint64_t hash = 14695981039346656037ull;
+    int counts[] = {graph->cityCount, graph->edgeCount};
+    int *arrays[] = {counts, graph->edgeStart, graph->edgeCity, graph->edgeDistance};
+    int lengths[] = {2, graph->cityCount + 1, graph->edgeCount, graph->edgeCount};
+    for (int arrayNr = 0; arrayNr < 4; arrayNr++) {
+        for (int i = 0; i < lengths[arrayNr]; i++) {
+            uint32_t value = (uint32_t)arrays[arrayNr][i];
+            for (int byte = 0; byte < 4; byte++) {
+                hash ^= (value >> (8 * byte)) & 0xff;
+                hash *= 1099511628211ull;
+            }
+        }
+    }
+    return hash;
+}
+
+/**
+ * Dijkstra from one city, filling its row of distances and of next hops
+ * @param build the build
+ * @param start the start city
+ * @param heap (work) a heap for the cities of the graph, empty
+ * @param firstHop (work) cityCount entries, only needed for the next hops
+ * @return ERRALLOC if memory allocation failed
+ * @return OK otherwise
+ */
+static status fillRow(DistanceTableBuild *build, int start, Heap *heap, int *firstHop) {
+    Graph *graph = build->graph;
+    int32_t *distances = build->distances + (size_t)start * graph->cityCount;
+    for (int city = 0; city < graph->cityCount; city++) {
+        distances[city] = UNREACHABLE_DISTANCE;
+    }
+    distances[start] = 0;
+    status ret = pushHeap(heap, 0, start);
+
+    // Settle the closest city, skip outdated heap entries. The first hop of a city is that of its
+    // predecessor, or the city itself next to the start
+    HeapEntry entry;
+    while (ret == OK && popHeap(heap, &entry) == OK) {
+        if(entry.key > distances[entry.cityId]) {
+            continue;
+        }
+        for (int edge = graph->edgeStart[entry.cityId]; edge < graph->edgeStart[entry.cityId + 1]; edge++) {
+            int distance = entry.key + graph->edgeDistance[edge];
+            int city = graph->edgeCity[edge];
+            if(distance < distances[city]) {
+                distances[city] = distance;
+                if(firstHop) {
+                    firstHop[city] = entry.cityId == start ? city : firstHop[entry.cityId];
+                }
+                if((ret = pushHeap(heap, distance, city)) != OK) {
+                    break;
+                }
+            }
+        }
+    }
+    clearHeap(heap);
+
+    if(ret == OK && build->nextHops) {
+        int32_t *nextHops = build->nextHops + (size_t)start * graph->cityCount;
+        for (int city = 0; city < graph->cityCount; city++) {
+            nextHops[city] = city == start || distances[city] == UNREACHABLE_DISTANCE ? -1 : firstHop[city];
+        }
+    }
+    return ret;
+}
+
+/**
+ * Thread function: fill the rows of start cities until all are done
+ * @param argument the DistanceTableBuild
+ * @return 0
+ */
+static void *fillRows(void *argument) {
+    DistanceTableBuild *build = (DistanceTableBuild*)argument;
+    int cityCount = build->graph->cityCount;
+    Heap heap;
+    int *firstHop = build->nextHops ? (int*)malloc(sizeof(int) * (cityCount ? cityCount : 1)) : 0;
+    if((build->nextHops && !firstHop) || initHeap(&heap, cityCount) != OK) {
+        free(firstHop);
+        __atomic_store_n(&build->failed, 1, __ATOMIC_RELAXED);
+        return 0;
+    }
+
+    int start;
+    while (!__atomic_load_n(&build->failed, __ATOMIC_RELAXED)
+           && (start = __atomic_fetch_add(&build->nextStart, 1, __ATOMIC_RELAXED)) < cityCount) {
+        if(fillRow(build, start, &heap, firstHop) != OK) {
+            __atomic_store_n(&build->failed, 1, __ATOMIC_RELAXED);
+            break;
+        }
+    }
+    freeHeap(&heap);
+    free(firstHop);
+    return 0;
+}
+
+status buildDistanceTable(CityMap *cityMap, int threadCount, int withNextHops, char *path) {
+    if(cityMap->cityCount > DISTANCE_TABLE_MAX_CITIES) {
+        return ERRINDEX;
+    }
+    threadCount = threadCount < 1 ? 1 : threadCount;
+
+    DistanceTableBuild build;
+    memset(&build, 0, sizeof(DistanceTableBuild));
+    status ret = createGraph(cityMap, &build.graph);
+    if(ret != OK) {
+        destroyGraph(build.graph);
+        return ret;
+    }
+    Graph *graph = build.graph;
+    size_t rowsSize = sizeof(int32_t) * (size_t)graph->cityCount * graph->cityCount;
+    size_t fileSize = sizeof(DistanceTableHeader) + rowsSize * (withNextHops ? 2 : 1);
+
+    // The rows are written into the mapped file, the table is never in memory twice
+    int file = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if(file < 0) {
+        printf("Error while opening: %s\n", path);
+        destroyGraph(graph);
+        return ERROPEN;
+    }
+    void *mapping = MAP_FAILED;
+    if(posix_fallocate(file, 0, (off_t)fileSize) != 0
+       || (mapping = mmap(0, fileSize, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0)) == MAP_FAILED) {
+        ret = ERRACCESS;
+    }
+
+    if(ret == OK) {
+        DistanceTableHeader *header = (DistanceTableHeader*)mapping;
+        build.distances = (int32_t*)(header + 1);
+        build.nextHops = withNextHops ? build.distances + (size_t)graph->cityCount * graph->cityCount : 0;
+
+        // Search from every city in parallel, this thread takes part
+        pthread_t *threads = (pthread_t*)malloc(sizeof(pthread_t) * threadCount);
+        int started = 0;
+        while (threads && started < threadCount - 1 && pthread_create(&threads[started], 0, fillRows, &build) == 0) {
+            started++;
+        }
+        fillRows(&build);
+        for (int thread = 0; thread < started; thread++) {
+            pthread_join(threads[thread], 0);
+        }
+        free(threads);
+        ret = build.failed ? ERRALLOC : OK;
+
+        // The header last: a file left by a failed build is not a table
+        if(ret == OK) {
+            header->cityCount = graph->cityCount;
+            header->edgeCount = graph->edgeCount;
+            header->hasNextHops = withNextHops ? 1 : 0;
+            header->fingerprint = graphFingerprint(graph);
+            header->magic = DISTANCE_TABLE_MAGIC;
+        }
+        if(msync(mapping, fileSize, MS_SYNC) != 0 && ret == OK) {
+            ret = ERRACCESS;
+        }
+    }
+    if(mapping != MAP_FAILED) {
+        munmap(mapping, fileSize);
+    }
+    if(close(file) != 0 && ret == OK) {
+        ret = ERRACCESS;
+    }
+    destroyGraph(graph);
+    return ret;
+}
+
+status loadDistanceTable(CityMap *cityMap, char *path) {
+    int file = open(path, O_RDONLY);
+    if(file < 0) {
+        printf("Error while opening: %s\n", path);
+        return ERROPEN;
+    }
+    struct stat fileStat;
+    void *mapping = MAP_FAILED;
+    size_t fileSize = 0;
+    if(fstat(file, &fileStat) == 0 && fileStat.st_size >= (off_t)sizeof(DistanceTableHeader)) {
+        fileSize = (size_t)fileStat.st_size;
+        mapping = mmap(0, fileSize, PROT_READ, MAP_SHARED, file, 0);
+    }
+    close(file);    // The mapping stays
+    if(mapping == MAP_FAILED) {
+        return ERRACCESS;
+    }
+
+    // A table of this byte order, as large as its header says
+    DistanceTableHeader *header = (DistanceTableHeader*)mapping;
+    size_t rowsSize = sizeof(int32_t) * (size_t)(header->cityCount > 0 ? header->cityCount : 0) * header->cityCount;
+    if(header->magic != DISTANCE_TABLE_MAGIC || header->cityCount < 0 || header->cityCount > DISTANCE_TABLE_MAX_CITIES
+       || fileSize != sizeof(DistanceTableHeader) + rowsSize * (header->hasNextHops ? 2 : 1)) {
+        munmap(mapping, fileSize);
+        return ERRACCESS;
+    }
+
+    // Built from the same edges
+    Graph *graph = 0;
+    status ret = createGraph(cityMap, &graph);
+    if(ret == OK && (header->cityCount != graph->cityCount || header->edgeCount != graph->edgeCount
+                     || header->fingerprint != graphFingerprint(graph))) {
+        ret = ERRUNABLE;
+    }
+    destroyGraph(graph);
+    Allocator *allocator = &cityMap->memory.base;
+    DistanceTable *table = ret == OK ? (DistanceTable*)allocMemory(allocator, sizeof(DistanceTable)) : 0;
+    if(ret == OK && !table) {
+        ret = ERRALLOC;
+    }
+    if(ret != OK) {
+        munmap(mapping, fileSize);
+        return ret;
+    }
+
+    // Queries read single values all over the table
+    posix_madvise(mapping, fileSize, POSIX_MADV_RANDOM);
+    table->cityCount = header->cityCount;
+    table->distances = (const int32_t*)(header + 1);
+    table->nextHops = header->hasNextHops ? table->distances + (size_t)header->cityCount * header->cityCount : 0;
+    table->mapping = mapping;
+    table->mappingSize = fileSize;
+    table->allocator = allocator;
+    destroyDistanceTable(cityMap->distanceTable);
+    cityMap->distanceTable = table;
+    return OK;
+}
+
+void destroyDistanceTable(DistanceTable *table) {
+    if(!table) {
+        return;
+    }
+    munmap(table->mapping, table->mappingSize);
+    freeMemory(table->allocator, table, sizeof(DistanceTable));
+}
@@ -0,0 +1,107 @@
+/**
+ * @file DistanceTable.h
+ * @brief Precomputed all-pairs distances of a map, in a file mapped into memory.
+ *
+ * For maps of a few thousand cities the distance between every pair fits in memory: a query is one read.
+ * buildDistanceTable() runs a Dijkstra from every city, in parallel, and writes the rows straight into
+ * the mapped file. The file holds, in native byte order after a header:
+ *  - the distances: cityCount rows of cityCount int32 values, row per start city, UNREACHABLE_DISTANCE
+ *    for a city which cannot be reached
+ *  - optionally the next hops: cityCount rows of cityCount int32 values, the city after the start on a
+ *    shortest route to the goal, -1 for the start itself and for a city which cannot be reached
+ * The header holds a fingerprint of the edges (as createGraph() numbers them), so a table is only loaded
+ * for the map it was built from.
+ *
+ * A map with a table attached (loadDistanceTable()) has findRoute() and findNearestRoute() answered from it:
+ * the distance is read, the route follows the next hops, or without them the neighbours whose edge and table
+ * distance add up to the distance. No search is run.
+ */
+#ifndef ADVANCED_C_CLASS_DISTANCETABLE_H
+#define ADVANCED_C_CLASS_DISTANCETABLE_H
+
+#include <stdint.h>
+#include "Map.h"
+#include "Graph.h"
+
+/** Most cities of a map with a table: the distances take 4 * cityCount^2 bytes */
+#define DISTANCE_TABLE_MAX_CITIES       (32768)
+/** Default number of threads for the searches */
+#define DISTANCE_TABLE_DEFAULT_THREADS  (4)
+/** Extension of the table file of a map, next to the map file */
+#define DISTANCE_TABLE_EXTENSION        ".dist"
+
+/**
+ * A table mapped from its file
+ */
+typedef struct DistanceTable {
+    int cityCount;
+    const int32_t *distances;       // cityCount * cityCount, row per start city
+    const int32_t *nextHops;        // cityCount * cityCount, row per start city, 0 when not in the file
+    void *mapping;
+    size_t mappingSize;
+    Allocator *allocator;
+}DistanceTable;
+
+/**
+ * Build the table of a map and write it to a file
+ * @param cityMap The map, with its neighbours in lists, packed or paged
+ * @param threadCount The number of threads for the searches, at least 1
+ * @param withNextHops Non zero to write the next hops, doubling the size of the file
+ * @param path Location of the file to write
+ * @return ERRINDEX if the map has more than DISTANCE_TABLE_MAX_CITIES cities
+ * @return ERROPEN if the file cannot be created
+ * @return ERRACCESS if the file cannot be sized or mapped
+ * @return ERRALLOC if memory allocation failed
+ * @return OK otherwise
+ */
+status buildDistanceTable(CityMap *cityMap, int threadCount, int withNextHops, char *path);
+
+/**
+ * Map the table file of a map, and attach it to the map: findRoute() answers from it from then on.
+ * Renumbering or merging the map drops the table.
+ * @param cityMap The map, an attached table is replaced
+ * @param path Location of the table file
+ * @return ERROPEN if the file cannot be opened
+ * @return ERRACCESS if it cannot be mapped or is not a table (of this byte order)
+ * @return ERRUNABLE if the table was built for another map
+ * @return ERRALLOC if memory allocation failed
+ * @return OK otherwise
+ */
+status loadDistanceTable(CityMap *cityMap, char *path);
+
+/**
+ * Distance between two cities
+ * @param table The table
+ * @param fromCityId The start city
+ * @param toCityId The goal city
+ * @return the distance, UNREACHABLE_DISTANCE if the goal cannot be reached
+ */
+static inline int tableDistance(DistanceTable *table, int fromCityId, int toCityId) {
+    return table->distances[(size_t)fromCityId * table->cityCount + toCityId];
+}
+
+/**
+ * City after the start on a shortest route to the goal
+ * @param table The table, with next hops
+ * @param fromCityId The start city
+ * @param toCityId The goal city
+ * @return the city, -1 if the start is the goal or the goal cannot be reached
+ */
+static inline int tableNextHop(DistanceTable *table, int fromCityId, int toCityId) {
+    return table->nextHops[(size_t)fromCityId * table->cityCount + toCityId];
+}
+
+/**
+ * Fingerprint of the edges of a graph, as stored in a table file
+ * @param graph The graph
+ * @return the fingerprint
+ */
+uint64_t graphFingerprint(Graph *graph);
+
+/**
+ * Unmap a table
+ * @param table The table to destroy, may be 0
+ */
+void destroyDistanceTable(DistanceTable *table);
+
+#endif //ADVANCED_C_CLASS_DISTANCETABLE_H
@@ -0,0 +1,161 @@
+/**
+ * @file DistanceTableBenchmark.c
+ * @brief Build the distance table of a map (DistanceTable.h), and compare findRoute() with and without it.
+ *
+ * The table is written next to the map as map.dist, with next hops: FindRoute loads it with the map from then on.
+ * A table without next hops is built in a temporary file. The same routes are searched:
+ *  - on the map without table
+ *  - on the map with the table without next hops: the route follows the neighbours
+ *  - on the map with the table and next hops
+ * For every table the build time and size are printed, for every run the mean and 99th percentile latency
+ * of a route; the route distances are checked to be the same as without table.
+ * Usage: distanceTableBenchmark map [route count, Default=1000] [thread count, Default=4]
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <string.h>
+#include "DistanceTable.h"
+#include "Route.h"
+#include "LatencyStats.h"
+
+/**
+ * Function to compare two latencies, for qsort()
+ * @param l1 the first latency
+ * @param l2 the second latency
+ * @return <0, 0 or >0 as l1 is less, equal or greater
+ */
+static int compLatencies(const void *l1, const void *l2) {
+    uint64_t latency1 = *(const uint64_t*)l1;
+    uint64_t latency2 = *(const uint64_t*)l2;
+    return (latency1 > latency2) - (latency1 < latency2);
+}
+
+/**
+ * Search the routes, and print the latencies
+ * @param name the name of the run
+ * @param cityMap the map
+ * @param starts the start city names of the routes
+ * @param goals the goal city names of the routes
+ * @param routeCount the number of routes
+ * @param distances (in/out) the distance of every route, -1 if not found
+ * @param latencies (work) routeCount latencies
+ * @param fill non zero to fill distances, 0 to compare with them
+ * @return the number of routes with another distance than in distances
+ */
+static int runRoutes(char *name, CityMap *cityMap, char **starts, char **goals, int routeCount, int *distances,
+                     uint64_t *latencies, int fill) {
+    Route *route = 0;
+    if(newRoute(cityMap->cityCount, &route) != OK) {
+        return routeCount;
+    }
+    int differences = 0;
+    double total = 0;
+    for (int i = 0; i < routeCount; i++) {
+        uint64_t start = latencyNow();
+        int distance = findRoute(starts[i], goals[i], cityMap, route) == OK ? route->totalDistance : -1;
+        latencies[i] = latencyNow() - start;
+        total += latencies[i];
+        if(fill) {
+            distances[i] = distance;
+        }
+        else if(distance != distances[i]) {
+            differences++;
+        }
+    }
+    qsort(latencies, routeCount, sizeof(uint64_t), compLatencies);
+    printf("%-18s %10.2f us mean %10.2f us p99\n", name, total / routeCount / 1000.0,
+           latencies[(routeCount * 99) / 100] / 1000.0);
+    destroyRoute(route);
+    return differences;
+}
+
+/**
+ * Build a table, attach it to the map and search the routes
+ * @param name the name of the run
+ * @param cityMap the map
+ * @param threadCount the number of threads of the build
+ * @param withNextHops non zero to build the next hops
+ * @param path location of the table file
+ * @param starts the start city names of the routes
+ * @param goals the goal city names of the routes
+ * @param routeCount the number of routes
+ * @param distances the distance of every route without table
+ * @param latencies (work) routeCount latencies
+ * @return the number of routes with another distance, or of failures
+ */
+static int runTable(char *name, CityMap *cityMap, int threadCount, int withNextHops, char *path, char **starts,
+                    char **goals, int routeCount, int *distances, uint64_t *latencies) {
+    uint64_t start = latencyNow();
+    status ret = buildDistanceTable(cityMap, threadCount, withNextHops, path);
+    uint64_t built = latencyNow();
+    if(ret == OK) {
+        ret = loadDistanceTable(cityMap, path);
+    }
+    if(ret != OK) {
+        printf("%s: %s\n", name, message(ret));
+        return 1;
+    }
+    printf("%-18s built in %.1f ms with %d threads, %lu bytes\n", name, (built - start) / 1000000.0, threadCount,
+           (unsigned long)cityMap->distanceTable->mappingSize);
+    int differences = runRoutes(name, cityMap, starts, goals, routeCount, distances, latencies, 0);
+    if(differences) {
+        printf("%s: %d routes differ from the search\n", name, differences);
+    }
+    destroyDistanceTable(cityMap->distanceTable);
+    cityMap->distanceTable = 0;
+    return differences;
+}
+
+int main(int argc, char** args) {
+    int routeCount = argc > 2 ? atoi(args[2]) : 1000;
+    int threadCount = argc > 3 ? atoi(args[3]) : DISTANCE_TABLE_DEFAULT_THREADS;
+    if(argc < 2 || routeCount <= 0 || threadCount <= 0) {
+        printf("Usage: distanceTableBenchmark map [route count] [thread count]\n");
+        return 1;
+    }
+    char tablePath[4096];
+    char noHopsPath[4096];
+    snprintf(tablePath, sizeof(tablePath), "%s%s", args[1], DISTANCE_TABLE_EXTENSION);
+    snprintf(noHopsPath, sizeof(noHopsPath), "%s.nohops%s", args[1], DISTANCE_TABLE_EXTENSION);
+
+    CityMap *cityMap = 0;
+    status ret = createMap(args[1], &cityMap);
+    char **starts = (char**)malloc(sizeof(char*) * routeCount);
+    char **goals = (char**)malloc(sizeof(char*) * routeCount);
+    int *distances = (int*)malloc(sizeof(int) * routeCount);
+    uint64_t *latencies = (uint64_t*)malloc(sizeof(uint64_t) * routeCount);
+    if(ret == OK && (!starts || !goals || !distances || !latencies)) {
+        ret = ERRALLOC;
+    }
+    if(ret != OK) {
+        printf("Error: %s\n", message(ret));
+        destroyMap(cityMap);
+        return 1;
+    }
+
+    // The same pairs of cities for every run
+    unsigned int seed = 2463534242u;
+    for (int i = 0; i < routeCount; i++) {
+        seed = seed * 1103515245u + 12345u;
+        starts[i] = cityMap->cities[(seed >> 8) % cityMap->cityCount]->cityName;
+        seed = seed * 1103515245u + 12345u;
+        goals[i] = cityMap->cities[(seed >> 8) % cityMap->cityCount]->cityName;
+    }
+    printf("%d cities, %d routes\n", cityMap->cityCount, routeCount);
+    runRoutes("search", cityMap, starts, goals, routeCount, distances, latencies, 1);
+
+    int failures = runTable("table", cityMap, threadCount, 0, noHopsPath, starts, goals, routeCount, distances,
+                            latencies);
+    remove(noHopsPath);
+    failures += runTable("table + next hops", cityMap, threadCount, 1, tablePath, starts, goals, routeCount,
+                         distances, latencies);
+
+    free(starts);
+    free(goals);
+    free(distances);
+    free(latencies);
+    destroyMap(cityMap);
+    return failures ? 1 : 0;
+}
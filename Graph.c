@@ -0,0 +1,208 @@
+/**
+ * @file Graph.c
+ * @brief Flat (compressed sparse row) snapshot of a CityMap.
+ */
+
+#include <string.h>
+#include "Graph.h"
+#include "Heap.h"
+#include "PackedGraph.h"
+#include "PagedGraph.h"
+#include "Route.h"
+
+/** Number of goals checked from every start by validateHeuristic() */
+#define VALIDATION_GOALS_PER_START  (16)
+
+status createGraph(CityMap *cityMap, Graph **graph) {
+    *graph = (Graph*)calloc(1, sizeof(Graph));
+    if(!*graph) {
+        return ERRALLOC;
+    }
+    Graph *newGraph = *graph;
+    newGraph->cityCount = cityMap->cityCount;
+
+    // Count the edges, to allocate all arrays at once
+    int edgeCount = 0;
+    for (int id = 0; !cityMap->packed && !cityMap->paged && id < cityMap->cityCount; id++) {
+        List *neighbours = cityMap->cities[id]->neighbour;
+        edgeCount += neighbours ? neighbours->nelts : 0;
+    }
+    if(cityMap->packed) {
+        edgeCount = cityMap->packed->edgeCount;
+    }
+    if(cityMap->paged) {
+        edgeCount = cityMap->paged->edgeCount;
+    }
+    newGraph->edgeCount = edgeCount;
+    newGraph->edgeStart = (int*)malloc(sizeof(int) * (newGraph->cityCount + 1));
+    newGraph->edgeCity = (int*)malloc(sizeof(int) * (edgeCount ? edgeCount : 1));
+    newGraph->edgeDistance = (int*)malloc(sizeof(int) * (edgeCount ? edgeCount : 1));
+    if(!newGraph->edgeStart || !newGraph->edgeCity || !newGraph->edgeDistance) {
+        destroyGraph(newGraph);
+        *graph = 0;
+        return ERRALLOC;
+    }
+
+    // Copy the neighbours of every city, in list order or from the packed or paged graph
+    int edge = 0;
+    for (int id = 0; id < cityMap->cityCount; id++) {
+        newGraph->edgeStart[id] = edge;
+        if(cityMap->packed || cityMap->paged) {
+            int count = cityMap->packed ? unpackNeighbours(cityMap->packed, id, newGraph->edgeCity + edge,
+                                                           newGraph->edgeDistance + edge)
+                                        : pagedNeighbours(cityMap->paged, id, newGraph->edgeCity + edge,
+                                                          newGraph->edgeDistance + edge);
+            if(count < 0 || edge + count > edgeCount) {
+                destroyGraph(newGraph);
+                *graph = 0;
+                return ERRACCESS;
+            }
+            edge += count;
+            for (int packedEdge = newGraph->edgeStart[id]; packedEdge < edge; packedEdge++) {
+                if(newGraph->edgeDistance[packedEdge] > newGraph->maxDistance) {
+                    newGraph->maxDistance = newGraph->edgeDistance[packedEdge];
+                }
+            }
+            continue;
+        }
+        List *neighbours = cityMap->cities[id]->neighbour;
+        for (Node *node = neighbours ? neighbours->head : 0; node; node = node->next) {
+            Neighbour *neighbour = (Neighbour*)node->val;
+            newGraph->edgeCity[edge] = neighbour->city->id;
+            newGraph->edgeDistance[edge] = neighbour->distance;
+            if(neighbour->distance > newGraph->maxDistance) {
+                newGraph->maxDistance = neighbour->distance;
+            }
+            edge++;
+        }
+    }
+    newGraph->edgeStart[newGraph->cityCount] = edge;
+    return OK;
+}
+
+status createReverseGraph(Graph *graph, Graph **reverse) {
+    *reverse = (Graph*)calloc(1, sizeof(Graph));
+    if(!*reverse) {
+        return ERRALLOC;
+    }
+    Graph *newGraph = *reverse;
+    int edgeCount = graph->edgeCount ? graph->edgeCount : 1;
+    newGraph->cityCount = graph->cityCount;
+    newGraph->edgeCount = graph->edgeCount;
+    newGraph->maxDistance = graph->maxDistance;
+    newGraph->edgeStart = (int*)calloc(graph->cityCount + 1, sizeof(int));
+    newGraph->edgeCity = (int*)malloc(sizeof(int) * edgeCount);
+    newGraph->edgeDistance = (int*)malloc(sizeof(int) * edgeCount);
+    int *next = (int*)malloc(sizeof(int) * (graph->cityCount + 1));
+    if(!newGraph->edgeStart || !newGraph->edgeCity || !newGraph->edgeDistance || !next) {
+        free(next);
+        destroyGraph(newGraph);
+        *reverse = 0;
+        return ERRALLOC;
+    }
+
+    // Count the edges coming in to every city, then fill them in order of the city they leave
+    for (int edge = 0; edge < graph->edgeCount; edge++) {
+        newGraph->edgeStart[graph->edgeCity[edge] + 1]++;
+    }
+    for (int city = 0; city < graph->cityCount; city++) {
+        newGraph->edgeStart[city + 1] += newGraph->edgeStart[city];
+    }
+    memcpy(next, newGraph->edgeStart, sizeof(int) * (graph->cityCount + 1));
+    for (int city = 0; city < graph->cityCount; city++) {
+        for (int edge = graph->edgeStart[city]; edge < graph->edgeStart[city + 1]; edge++) {
+            int slot = next[graph->edgeCity[edge]]++;
+            newGraph->edgeCity[slot] = city;
+            newGraph->edgeDistance[slot] = graph->edgeDistance[edge];
+        }
+    }
+    free(next);
+    return OK;
+}
+
+void destroyGraph(Graph *graph) {
+    if(!graph) {
+        return;
+    }
+    free(graph->edgeStart);
+    free(graph->edgeCity);
+    free(graph->edgeDistance);
+    free(graph);
+}
+
+status findAllDistances(Graph *graph, int startCityId, int *distances) {
+    if(startCityId < 0 || startCityId >= graph->cityCount) {
+        return ERRINDEX;
+    }
+    for (int id = 0; id < graph->cityCount; id++) {
+        distances[id] = UNREACHABLE_DISTANCE;
+    }
+
+    Heap heap;
+    if(initHeap(&heap, graph->cityCount) != OK) {
+        return ERRALLOC;
+    }
+    distances[startCityId] = 0;
+    status ret = pushHeap(&heap, 0, startCityId);
+
+    // Settle the closest city, skip outdated heap entries
+    HeapEntry entry;
+    while (ret == OK && popHeap(&heap, &entry) == OK) {
+        if(entry.key > distances[entry.cityId]) {
+            continue;
+        }
+        for (int edge = graph->edgeStart[entry.cityId]; edge < graph->edgeStart[entry.cityId + 1]; edge++) {
+            int distance = entry.key + graph->edgeDistance[edge];
+            int city = graph->edgeCity[edge];
+            if(distance < distances[city]) {
+                distances[city] = distance;
+                if((ret = pushHeap(&heap, distance, city)) != OK) {
+                    break;
+                }
+            }
+        }
+    }
+    freeHeap(&heap);
+    return ret;
+}
+
+status validateHeuristic(CityMap *cityMap, Graph *graph, int sampleCount, int *nonOptimal) {
+    *nonOptimal = 0;
+    if(graph->cityCount == 0 || sampleCount <= 0) {
+        return OK;
+    }
+    int goalsPerStart = sampleCount < VALIDATION_GOALS_PER_START ? sampleCount : VALIDATION_GOALS_PER_START;
+    int startCount = (sampleCount + goalsPerStart - 1) / goalsPerStart;
+    int *distances = (int*)malloc(sizeof(int) * graph->cityCount);
+    Route *route = 0;
+    if(!distances || newRoute(cityMap->cityCount, &route) != OK) {
+        free(distances);
+        return ERRALLOC;
+    }
+
+    status ret = OK;
+    for (int startNr = 0; ret == OK && startNr < startCount; startNr++) {
+        int start = (int)((long long)startNr * graph->cityCount / startCount);
+        if((ret = findAllDistances(graph, start, distances)) != OK) {
+            break;
+        }
+        for (int goalNr = 0; goalNr < goalsPerStart; goalNr++) {
+            // Goals spread over the map, shifted for every start
+            int goal = (int)(((long long)goalNr * graph->cityCount / goalsPerStart + startNr) % graph->cityCount);
+            if(distances[goal] == UNREACHABLE_DISTANCE) {
+                continue;
+            }
+            status found = findRoute(cityMap->cities[start]->cityName, cityMap->cities[goal]->cityName, cityMap, route);
+            if(found == ERRALLOC) {
+                ret = found;
+                break;
+            }
+            if(found != OK || route->totalDistance != distances[goal]) {
+                (*nonOptimal)++;
+            }
+        }
+    }
+    destroyRoute(route);
+    free(distances);
+    return ret;
+}
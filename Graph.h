@@ -0,0 +1,84 @@
+/**
+ * @file Graph.h
+ * @brief Flat (compressed sparse row) snapshot of a CityMap, for searches over the whole map.
+ *
+ * The edges of city i are edgeCity[edgeStart[i]] .. edgeCity[edgeStart[i+1]-1],
+ * with the matching distance in edgeDistance. Cities are referred to by their id.
+ */
+#ifndef ADVANCED_C_CLASS_GRAPH_H
+#define ADVANCED_C_CLASS_GRAPH_H
+
+#include <limits.h>
+#include "Map.h"
+
+/** Distance of a city which can not be reached */
+#define UNREACHABLE_DISTANCE    (INT_MAX)
+
+/**
+ * Graph structure with the edges of all cities stored in contiguous arrays
+ */
+typedef struct Graph {
+    int cityCount;
+    int edgeCount;
+    int maxDistance;
+    int *edgeStart;
+    int *edgeCity;
+    int *edgeDistance;
+}Graph;
+
+/**
+ * Create a flat graph from the cities and neighbours of a map.
+ * The map is not changed and may be destroyed before the graph.
+ *
+ * @param cityMap The map to take the cities and neighbours from
+ * @param graph Pointer to graph pointer which will be assigned to the created graph
+ * @return ERRACCESS if the neighbours of a paged map could not be read
+ * @return ERRALLOC if memory allocation failed
+ * @return OK otherwise
+ */
+status createGraph(CityMap *cityMap, Graph **graph);
+
+/**
+ * Create the reverse of a graph: the edges coming in to every city, from the city they leave
+ *
+ * @param graph The graph to reverse
+ * @param reverse Pointer to graph pointer which will be assigned to the reverse graph
+ * @return ERRALLOC if memory allocation failed
+ * @return OK otherwise
+ */
+status createReverseGraph(Graph *graph, Graph **reverse);
+
+/**
+ * Clean up a graph created with createGraph
+ * @param graph The graph to destroy, may be 0
+ */
+void destroyGraph(Graph *graph);
+
+/**
+ * Compute the distance from one city to all cities (sequential Dijkstra, O((N+E) log N)).
+ *
+ * @param graph The graph to search
+ * @param startCityId The id of the city to start from
+ * @param distances (out) cityCount distances, UNREACHABLE_DISTANCE for unreachable cities
+ * @return ERRINDEX if the start city is not in the graph
+ * @return ERRALLOC if memory allocation failed
+ * @return OK otherwise
+ */
+status findAllDistances(Graph *graph, int startCityId, int *distances);
+
+/**
+ * Check sampled routes of findRoute() against Dijkstra: with an admissible heuristic
+ * (see calibrateHeuristic()) every found route is a shortest one.
+ * The starts are spread over the map, every start is checked against sampleCount / startCount goals.
+ * Pairs without a route are skipped.
+ *
+ * @param cityMap The map to search with findRoute()
+ * @param graph The graph created from the map
+ * @param sampleCount The number of routes to check
+ * @param nonOptimal (out) the number of routes longer than the shortest, or not found
+ * @return ERRALLOC if memory allocation failed
+ * @return OK otherwise
+ */
+status validateHeuristic(CityMap *cityMap, Graph *graph, int sampleCount, int *nonOptimal);
+
+#endif //ADVANCED_C_CLASS_GRAPH_H
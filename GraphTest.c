@@ -0,0 +1,1533 @@
+/**
+ * @file GraphTest.c
+ * @brief Test program for the searches over a whole map: application to FRANCE.MAP.
+ *
+ * Every search is compared with the sequential one to all search (findAllDistances).
+ * Usage: graphTest [filepathMap, Default='./FRANCE.MAP']
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include "DeltaStepping.h"
+#include "PackedGraph.h"
+#include "TravelTime.h"
+#include "ArcFlags.h"
+#include "HubLabels.h"
+#include "ShardedMap.h"
+#include "RoutePool.h"
+#include "LatencyStats.h"
+#include "Renumber.h"
+#include "SearchTrace.h"
+#include "Components.h"
+#include "MultiStop.h"
+#include "PagedGraph.h"
+#include "MapHandle.h"
+#include "DistanceTable.h"
+#include "StringArena.h"
+#include "Heap.h"
+
+/**
+ * Compare two distance arrays, and print the first difference
+ * @param expected the expected distances
+ * @param found the distances to test
+ * @param count the amount of distances
+ * @param mssg the name of the tested search
+ * @return 1 if equal, 0 otherwise
+ */
+static int sameDistances(int *expected, int *found, int count, char *mssg) {
+    for (int id = 0; id < count; id++) {
+        if(expected[id] != found[id]) {
+            printf("%s: distance of city %d is %d, expected %d\n", mssg, id, found[id], expected[id]);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * Test delta-stepping from every city, with several deltas and thread counts
+ * @param graph the graph to test
+ * @return the number of failures
+ */
+static int testDeltaStepping(Graph *graph) {
+    int deltas[] = {1, 50, 0, 100000};
+    int threadCounts[] = {1, 3, 16};
+    int *expected = (int*)malloc(sizeof(int) * graph->cityCount);
+    int *found = (int*)malloc(sizeof(int) * graph->cityCount);
+    int settledCounts[16];
+    int failures = 0;
+
+    for (int start = 0; start < graph->cityCount; start++) {
+        findAllDistances(graph, start, expected);
+        int reachable = 0;
+        for (int city = 0; city < graph->cityCount; city++) {
+            reachable += expected[city] != UNREACHABLE_DISTANCE;
+        }
+        for (int d = 0; d < sizeof(deltas) / sizeof(int); d++) {
+            for (int t = 0; t < sizeof(threadCounts) / sizeof(int); t++) {
+                status ret = deltaSteppingWithCounts(graph, start, deltas[d], threadCounts[t], found, settledCounts);
+                if(ret != OK || !sameDistances(expected, found, graph->cityCount, "deltaStepping")) {
+                    printf("deltaStepping() failed from %d (delta %d, %d threads): %s\n",
+                           start, deltas[d], threadCounts[t], message(ret));
+                    failures++;
+                    continue;
+                }
+
+                // Every reachable city is settled once, by its owner: the work is spread over the threads
+                int settled = 0;
+                int busyThreads = 0;
+                for (int thread = 0; thread < threadCounts[t]; thread++) {
+                    settled += settledCounts[thread];
+                    busyThreads += settledCounts[thread] > 0;
+                }
+                if(settled != reachable || (reachable > threadCounts[t] && threadCounts[t] > 1 && busyThreads < 2)) {
+                    printf("deltaStepping() from %d (delta %d, %d threads): %d cities settled by %d threads\n",
+                           start, deltas[d], threadCounts[t], settled, busyThreads);
+                    failures++;
+                }
+            }
+        }
+    }
+    printf("deltaStepping: %s\n", failures ? "FAILED" : "OK");
+    free(expected);
+    free(found);
+    return failures;
+}
+
+/**
+ * Test the calibration of the heuristic: the scale is the smallest distance per coordinate unit
+ * of the edges, and findRoute() finds shortest routes with it
+ * @param cityMap the map, calibrated when created
+ * @param graph the graph created from the map
+ * @return the number of failures
+ */
+static int testHeuristic(CityMap *cityMap, Graph *graph) {
+    int failures = 0;
+    int tight = 0;
+    double scale = cityMap->heuristicScale;
+    for (int city = 0; city < graph->cityCount; city++) {
+        for (int edge = graph->edgeStart[city]; edge < graph->edgeStart[city + 1]; edge++) {
+            City *from = cityMap->cities[city];
+            City *to = cityMap->cities[graph->edgeCity[edge]];
+            int coordinateDistance = abs(from->latitude - to->latitude) + abs(from->longitude - to->longitude);
+            failures += calculateHValue(from, to, scale) > graph->edgeDistance[edge];
+            tight += coordinateDistance > 0 && graph->edgeDistance[edge] == (int)(scale * coordinateDistance + 0.5);
+        }
+    }
+    failures += calibrateHeuristic(cityMap) != scale || !tight;
+
+    int nonOptimal = 0;
+    failures += validateHeuristic(cityMap, graph, 256, &nonOptimal) != OK || nonOptimal;
+    printf("Heuristic scale: %.4f, %d non optimal routes\n", scale, nonOptimal);
+    printf("heuristic: %s\n", failures ? "FAILED" : "OK");
+    return failures;
+}
+
+/**
+ * Test the memory-bounded search: with room for all cities, and with room for fewer cities than the map has
+ * (so nodes are dropped and expanded again), the routes must be as short as findAllDistances()
+ * @param cityMap the map to search
+ * @param graph the graph created from the map
+ * @return the number of failures
+ */
+static int testBoundedRoute(CityMap *cityMap, Graph *graph) {
+    int failures = 0;
+    int bounds[] = {graph->cityCount, 2 * graph->cityCount / 3};
+    int *expected = (int*)malloc(sizeof(int) * graph->cityCount);
+    Route *route = 0;
+    if(!expected || newRoute(graph->cityCount, &route) != OK) {
+        printf("boundedRoute: FAILED (allocation)\n");
+        return 1;
+    }
+    for (int boundNr = 0; boundNr < 2; boundNr++) {
+        RouteOptions options = {0};
+        options.maxNodes = bounds[boundNr];
+        for (int start = 0; start < graph->cityCount; start++) {
+            findAllDistances(graph, start, expected);
+            for (int goal = 0; goal < graph->cityCount; goal++) {
+                status ret = findRouteWithOptions(cityMap->cities[start]->cityName, cityMap->cities[goal]->cityName,
+                                                  cityMap, route, &options);
+                if(ret != OK || route->totalDistance != expected[goal]) {
+                    printf("boundedRoute %d nodes %d -> %d: %d, expected %d\n", bounds[boundNr], start, goal,
+                           ret == OK ? route->totalDistance : -1, expected[goal]);
+                    failures++;
+                }
+            }
+        }
+    }
+    printf("boundedRoute: %s\n", failures ? "FAILED" : "OK");
+    destroyRoute(route);
+    free(expected);
+    return failures;
+}
+
+/**
+ * Test the nearest of several goals: findNearestRoute() must reach a goal at the smallest distance
+ * @param cityMap the map to search
+ * @param graph the graph created from the map
+ * @return the number of failures
+ */
+static int testNearestRoute(CityMap *cityMap, Graph *graph) {
+    int failures = 0;
+    int goalCount = graph->cityCount / 4 + 1;
+    char **goalNames = (char**)malloc(sizeof(char*) * goalCount);
+    int *goalIds = (int*)malloc(sizeof(int) * goalCount);
+    int *expected = (int*)malloc(sizeof(int) * graph->cityCount);
+    Route *route = 0;
+    if(!goalNames || !goalIds || !expected || newRoute(graph->cityCount, &route) != OK) {
+        printf("nearestRoute: FAILED (allocation)\n");
+        return 1;
+    }
+    for (int start = 0; start < graph->cityCount; start++) {
+        // Every 4th city is a goal, shifted with the start
+        for (int goalNr = 0; goalNr < goalCount; goalNr++) {
+            goalIds[goalNr] = (start + 4 * goalNr + 1) % graph->cityCount;
+            goalNames[goalNr] = cityMap->cities[goalIds[goalNr]]->cityName;
+        }
+        findAllDistances(graph, start, expected);
+        int nearest = UNREACHABLE_DISTANCE;
+        for (int goalNr = 0; goalNr < goalCount; goalNr++) {
+            if(expected[goalIds[goalNr]] < nearest) {
+                nearest = expected[goalIds[goalNr]];
+            }
+        }
+        if(nearest == UNREACHABLE_DISTANCE) {
+            continue;
+        }
+        int goalIndex = -1;
+        status ret = findNearestRoute(cityMap->cities[start]->cityName, goalNames, goalCount, cityMap, route, 0,
+                                      &goalIndex);
+        if(ret != OK || route->totalDistance != nearest || goalIndex < 0
+           || route->cityIds[route->cityCount - 1] != goalIds[goalIndex]) {
+            printf("findNearestRoute from %d: %d, expected %d\n", start, route->totalDistance, nearest);
+            failures++;
+        }
+    }
+    printf("nearestRoute: %s\n", failures ? "FAILED" : "OK");
+    destroyRoute(route);
+    free(goalNames);
+    free(goalIds);
+    free(expected);
+    return failures;
+}
+
+/**
+ * Callback of the queries of testRoutePool(): count the queries done
+ * @param query the query done
+ * @param context the counter
+ */
+static void countQuery(RouteQuery *query, void *context) {
+    __atomic_add_fetch((int*)context, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * Test the asynchronous queries: all routes of the pool must be shortest, and a query
+ * past its deadline or cancelled must stop
+ * @param cityMap the map to search
+ * @param graph the graph created from the map
+ * @return the number of failures
+ */
+static int testRoutePool(CityMap *cityMap, Graph *graph) {
+    RoutePool *pool = 0;
+    int queryCount = graph->cityCount * graph->cityCount;
+    RouteQuery **queries = (RouteQuery**)calloc(queryCount, sizeof(RouteQuery*));
+    int *expected = (int*)malloc(sizeof(int) * graph->cityCount);
+    if(!queries || !expected || newRoutePool(cityMap, ROUTE_POOL_DEFAULT_THREADS, &pool) != OK) {
+        printf("routePool: FAILED (allocation)\n");
+        return 1;
+    }
+
+    // All pairs, with a deadline far away
+    int failures = 0;
+    int doneCount = 0;
+    struct timespec deadline;
+    deadlineAfter(&deadline, 60000);
+    for (int queryNr = 0; queryNr < queryCount; queryNr++) {
+        failures += submitRoute(pool, cityMap->cities[queryNr / graph->cityCount]->cityName,
+                                cityMap->cities[queryNr % graph->cityCount]->cityName, &deadline,
+                                countQuery, &doneCount, &queries[queryNr]) != OK;
+    }
+    for (int start = 0; !failures && start < graph->cityCount; start++) {
+        findAllDistances(graph, start, expected);
+        for (int goal = 0; goal < graph->cityCount; goal++) {
+            RouteQuery *query = queries[start * graph->cityCount + goal];
+            status ret = waitRoute(query);
+            if(!pollRoute(query) || (expected[goal] == UNREACHABLE_DISTANCE ? ret != ERRALGORTIHM
+                                     : ret != OK || query->route->totalDistance != expected[goal])) {
+                printf("submitRoute %d -> %d: %s, %d, expected %d\n", start, goal, message(ret),
+                       query->route->totalDistance, expected[goal]);
+                failures++;
+            }
+        }
+    }
+    failures += __atomic_load_n(&doneCount, __ATOMIC_RELAXED) != queryCount;
+    for (int queryNr = 0; queryNr < queryCount; queryNr++) {
+        releaseRoute(queries[queryNr]);
+    }
+
+    // A passed deadline stops the search before it starts, a cancelled query stops or was done
+    RouteQuery *query = 0;
+    char *start = cityMap->cities[0]->cityName;
+    char *goal = cityMap->cities[graph->cityCount - 1]->cityName;
+    deadlineAfter(&deadline, -1);
+    failures += submitRoute(pool, start, goal, &deadline, 0, 0, &query) != OK || waitRoute(query) != ERRTIMEOUT;
+    releaseRoute(query);
+    if(submitRoute(pool, start, goal, 0, 0, 0, &query) == OK) {
+        cancelRoute(query);
+        status ret = waitRoute(query);
+        failures += ret != OK && ret != ERRCANCELLED;
+    }
+    releaseRoute(query);
+
+    printf("routePool: %s (%d queries, %d workers)\n", failures ? "FAILED" : "OK", queryCount, pool->threadCount);
+    destroyRoutePool(pool);
+    free(queries);
+    free(expected);
+    return failures;
+}
+
+/**
+ * Thread recording one lookup sample, then ending
+ * @param argument unused
+ * @return 0
+ */
+static void *recordOneLatency(void *argument) {
+    recordLatency(LatencyMetric_Lookup, 1000);
+    return argument;
+}
+
+/**
+ * Test the latency histograms: percentiles within the precision of the buckets, the
+ * samples of the searches of all threads merged, and the slots of ended threads reused
+ * @return the number of failures
+ */
+static int testLatencyStats(void) {
+    int failures = 0;
+    LatencyHistogram *histogram = (LatencyHistogram*)calloc(1, sizeof(LatencyHistogram));
+    if(!histogram) {
+        printf("latencyStats: FAILED (allocation)\n");
+        return 1;
+    }
+    for (uint64_t value = 1; value <= 100000; value++) {
+        addToHistogram(histogram, value);
+    }
+    double fractions[] = {0.5, 0.99, 0.999};
+    for (int i = 0; i < 3; i++) {
+        double exact = fractions[i] * 100000;
+        double found = (double)histogramPercentile(histogram, fractions[i]);
+        failures += found < exact || found > exact * (1 + 1.0 / LATENCY_SUB_BUCKETS);
+    }
+    failures += histogramPercentile(histogram, 1.0) != 100000 || histogram->count != 100000;
+
+    mergeLatencyStats(LatencyMetric_FindRoute, histogram);
+    failures += histogram->count == 0 || histogramPercentile(histogram, 0.5) > histogramPercentile(histogram, 0.99)
+                || histogramPercentile(histogram, 0.999) > histogram->max;
+
+    // Threads one after the other share a slot, and their samples are all kept
+    mergeLatencyStats(LatencyMetric_Lookup, histogram);
+    uint64_t lookups = histogram->count;
+    int slots = -1;
+    for (int thread = 0; thread < 32; thread++) {
+        pthread_t recorder;
+        if(pthread_create(&recorder, 0, recordOneLatency, 0) != 0 || pthread_join(recorder, 0) != 0) {
+            failures++;
+            break;
+        }
+        if(thread == 0) {
+            slots = latencyStatsSlotCount();
+        }
+    }
+    mergeLatencyStats(LatencyMetric_Lookup, histogram);
+    failures += latencyStatsSlotCount() != slots || histogram->count != lookups + 32;
+    printLatencyStats(stdout);
+    printf("latencyStats: %s\n", failures ? "FAILED" : "OK");
+    free(histogram);
+    return failures;
+}
+
+/**
+ * Write a part of the cities of a graph as a region .MAP file, neighbours in other regions by name
+ * @param path the file to write
+ * @param cityMap the map, for the names and positions
+ * @param graph the graph created from the map
+ * @param firstCity the first city of the region
+ * @param endCity the city after the last city of the region
+ * @return non zero if the file could not be written
+ */
+static int writeShard(char *path, CityMap *cityMap, Graph *graph, int firstCity, int endCity) {
+    FILE *file = fopen(path, "w");
+    if(!file) {
+        return 1;
+    }
+    for (int city = firstCity; city < endCity; city++) {
+        fprintf(file, "%s\t\t%d\t%d\n", cityMap->cities[city]->cityName,
+                cityMap->cities[city]->latitude, cityMap->cities[city]->longitude);
+        for (int edge = graph->edgeStart[city]; edge < graph->edgeStart[city + 1]; edge++) {
+            fprintf(file, "%s\t\t%d\n", cityMap->cities[graph->edgeCity[edge]]->cityName, graph->edgeDistance[edge]);
+        }
+    }
+    return fclose(file) != 0;
+}
+
+/**
+ * Test loading the map from region files: the stitched map must have the same cities, positions
+ * and distances as the map, matched by name
+ * @param cityMap the map to split in regions
+ * @param graph the graph created from the map
+ * @return the number of failures
+ */
+static int testShardedMap(CityMap *cityMap, Graph *graph) {
+    char *shardPaths[] = {"graphTest_region0.MAP", "graphTest_region1.MAP", "graphTest_region2.MAP"};
+    char *manifestPath = "graphTest_regions.manifest";
+    int shardCount = sizeof(shardPaths) / sizeof(shardPaths[0]);
+    int failures = 0;
+
+    FILE *manifest = fopen(manifestPath, "w");
+    if(!manifest) {
+        printf("shardedMap: FAILED (writing %s)\n", manifestPath);
+        return 1;
+    }
+    fprintf(manifest, "# Regions of the test map\n");
+    for (int shardNr = 0; shardNr < shardCount; shardNr++) {
+        fprintf(manifest, "%s\n", shardPaths[shardNr]);
+        failures += writeShard(shardPaths[shardNr], cityMap, graph, shardNr * graph->cityCount / shardCount,
+                               (shardNr + 1) * graph->cityCount / shardCount);
+    }
+    failures += fclose(manifest) != 0;
+
+    CityMap *shardedMap = 0;
+    Graph *shardedGraph = 0;
+    status ret = createShardedMap(manifestPath, &shardedMap);
+    if(ret != OK || (ret = createGraph(shardedMap, &shardedGraph)) != OK) {
+        printf("createShardedMap: %s\n", message(ret));
+        failures++;
+    }
+    int *expected = (int*)malloc(sizeof(int) * graph->cityCount);
+    int *found = (int*)malloc(sizeof(int) * graph->cityCount);
+    if(!failures && (shardedMap->cityCount != cityMap->cityCount || shardedGraph->edgeCount != graph->edgeCount
+                     || shardedMap->heuristicScale != cityMap->heuristicScale)) {
+        failures++;
+    }
+    for (int start = 0; !failures && start < graph->cityCount; start++) {
+        City *shardedStart = findCityInMap(cityMap->cities[start]->cityName, shardedMap);
+        findAllDistances(graph, start, expected);
+        findAllDistances(shardedGraph, shardedStart->id, found);
+        for (int city = 0; city < graph->cityCount; city++) {
+            City *shardedCity = findCityInMap(cityMap->cities[city]->cityName, shardedMap);
+            if(shardedCity->latitude != cityMap->cities[city]->latitude
+               || shardedCity->longitude != cityMap->cities[city]->longitude
+               || found[shardedCity->id] != expected[city]) {
+                printf("shardedMap %d -> %d: %d, expected %d\n", start, city, found[shardedCity->id], expected[city]);
+                failures++;
+                break;
+            }
+        }
+    }
+    destroyGraph(shardedGraph);
+    destroyMap(shardedMap);
+
+    // A city defined at (0,0) keeps its position, a city only named as neighbour has none
+    FILE *region0 = fopen(shardPaths[0], "w");
+    FILE *region1 = fopen(shardPaths[1], "w");
+    if(region0) {
+        fprintf(region0, "Nullpoint\t\t0\t0\nBorder\t\t7\n");
+    }
+    if(region1) {
+        fprintf(region1, "Border\t\t3\t4\nNullpoint\t\t7\nNowhere\t\t2\n");
+    }
+    failures += !region0 || fclose(region0) != 0 || !region1 || fclose(region1) != 0;
+    CityMap *regionMaps[2] = {0, 0};
+    ret = createShardMap(shardPaths[1], &regionMaps[0]);
+    if(ret == OK) {
+        ret = createShardMap(shardPaths[0], &regionMaps[1]);
+    }
+    if(ret == OK) {
+        ret = mergeMaps(regionMaps[0], regionMaps + 1, 1);
+    }
+    City *nullpoint = ret == OK ? findCityInMap("Nullpoint", regionMaps[0]) : 0;
+    City *border = ret == OK ? findCityInMap("Border", regionMaps[0]) : 0;
+    City *nowhere = ret == OK ? findCityInMap("Nowhere", regionMaps[0]) : 0;
+    if(!nullpoint || !border || !nowhere || !nullpoint->hasPosition || nullpoint->latitude || nullpoint->longitude
+       || !border->hasPosition || border->latitude != 3 || border->longitude != 4 || nowhere->hasPosition
+       || regionMaps[0]->cityCount != 3 || !regionMaps[0]->components) {
+        printf("mergeMaps of region maps: %s, positions not kept\n", message(ret));
+        failures++;
+    }
+    destroyMap(regionMaps[0]);
+    destroyMap(regionMaps[1]);
+
+    printf("shardedMap: %s\n", failures ? "FAILED" : "OK");
+    free(expected);
+    free(found);
+    for (int shardNr = 0; shardNr < shardCount; shardNr++) {
+        remove(shardPaths[shardNr]);
+    }
+    remove(manifestPath);
+    return failures;
+}
+
+/**
+ * Test packing the map: the graph created from the packed map must give the same distances
+ * @param cityMap the map to pack
+ * @param graph the graph created before packing
+ * @return the number of failures
+ */
+static int testPackedGraph(CityMap *cityMap, Graph *graph) {
+    int failures = 0;
+    Graph *packedGraph = 0;
+    status ret = packMap(cityMap);
+    if(ret != OK || (ret = createGraph(cityMap, &packedGraph)) != OK) {
+        printf("packMap: FAILED (%s)\n", message(ret));
+        return 1;
+    }
+    printf("Packed neighbours: %lu bytes for %d edges (%d distance bits)\n",
+           (unsigned long)packedGraphSize(cityMap->packed), cityMap->packed->edgeCount,
+           cityMap->packed->distanceBitCount);
+
+    int *expected = (int*)malloc(sizeof(int) * graph->cityCount);
+    int *found = (int*)malloc(sizeof(int) * graph->cityCount);
+    if(packedGraph->edgeCount != graph->edgeCount || packedGraph->maxDistance != graph->maxDistance) {
+        failures++;
+    }
+    for (int start = 0; !failures && start < graph->cityCount; start++) {
+        findAllDistances(graph, start, expected);
+        findAllDistances(packedGraph, start, found);
+        failures += !sameDistances(expected, found, graph->cityCount, "packMap");
+    }
+    printf("packMap: %s\n", failures ? "FAILED" : "OK");
+    free(expected);
+    free(found);
+    destroyGraph(packedGraph);
+    return failures;
+}
+
+/**
+ * Test loading a map packed: without neighbour lists, the graph must have the same edges as the graph of the map
+ * loaded with lists, and the map must take no more memory than the map packed after loading
+ * @param mapFilePath the map to load packed
+ * @param cityMap the map, packed by testPackedGraph()
+ * @param graph the graph created before packing
+ * @return the number of failures
+ */
+static int testPackedLoad(char *mapFilePath, CityMap *cityMap, Graph *graph) {
+    CityMap *loaded = 0;
+    Graph *loadedGraph = 0;
+    status ret = createPackedMap(mapFilePath, &loaded);
+    if(ret != OK || (ret = createGraph(loaded, &loadedGraph)) != OK) {
+        printf("packedLoad: FAILED (%s)\n", message(ret));
+        destroyMap(loaded);
+        return 1;
+    }
+    int failures = !loaded->packed || loaded->maxNeighbours != cityMap->maxNeighbours
+                   || loaded->heuristicScale != cityMap->heuristicScale || loadedGraph->edgeCount != graph->edgeCount
+                   || mapFootprint(loaded) > mapFootprint(cityMap);
+    for (int id = 0; !failures && id < loaded->cityCount; id++) {
+        failures += loaded->cities[id]->neighbour != 0;
+    }
+    if(!failures) {
+        failures += memcmp(loadedGraph->edgeStart, graph->edgeStart, sizeof(int) * (graph->cityCount + 1)) != 0
+                    || memcmp(loadedGraph->edgeCity, graph->edgeCity, sizeof(int) * graph->edgeCount) != 0
+                    || memcmp(loadedGraph->edgeDistance, graph->edgeDistance, sizeof(int) * graph->edgeCount) != 0;
+    }
+    printf("packedLoad: %s (%lu bytes)\n", failures ? "FAILED" : "OK", (unsigned long)mapFootprint(loaded));
+    destroyGraph(loadedGraph);
+    destroyMap(loaded);
+    return failures;
+}
+
+/**
+ * Distances from a city over the edges flagged for a region only (Dijkstra)
+ * @param graph the graph the flags were built for
+ * @param arcFlags the flags
+ * @param region the region
+ * @param start the city to start from
+ * @param distances (out) the distance per city
+ */
+static void findFlaggedDistances(Graph *graph, ArcFlags *arcFlags, int region, int start, int *distances) {
+    Heap heap;
+    initHeap(&heap, graph->cityCount);
+    for (int id = 0; id < graph->cityCount; id++) {
+        distances[id] = UNREACHABLE_DISTANCE;
+    }
+    distances[start] = 0;
+    pushHeap(&heap, 0, start);
+    HeapEntry entry;
+    while (popHeap(&heap, &entry) == OK) {
+        if(entry.key > distances[entry.cityId]) {
+            continue;
+        }
+        for (int edge = graph->edgeStart[entry.cityId]; edge < graph->edgeStart[entry.cityId + 1]; edge++) {
+            int city = graph->edgeCity[edge];
+            if(arcFlag(arcFlags, edge, region) && entry.key + graph->edgeDistance[edge] < distances[city]) {
+                distances[city] = entry.key + graph->edgeDistance[edge];
+                pushHeap(&heap, distances[city], city);
+            }
+        }
+    }
+    freeHeap(&heap);
+}
+
+/**
+ * Test arc-flags, built on the packed map: the flags of a region must keep a shortest path
+ * to all its cities, in the edge order of the graph created before packing
+ * @param cityMap the map
+ * @param graph the graph created before packing
+ * @return the number of failures
+ */
+static int testArcFlags(CityMap *cityMap, Graph *graph) {
+    int regionCount = graph->cityCount < 64 ? 4 : ARC_FLAGS_DEFAULT_REGIONS;
+    if(buildArcFlags(cityMap, regionCount, 3) != OK) {
+        printf("arcFlags: FAILED (build)\n");
+        return 1;
+    }
+    ArcFlags *arcFlags = cityMap->arcFlags;
+    printf("Arc-flags: %d regions, %d boundary cities, %.1f%% of the flags set, %lu bytes\n",
+           arcFlags->regionCount, arcFlags->boundaryCount, 100.0 * arcFlagsDensity(arcFlags),
+           (unsigned long)arcFlagsSize(arcFlags));
+
+    int failures = 0;
+    int *expected = (int*)malloc(sizeof(int) * graph->cityCount);
+    int *found = (int*)malloc(sizeof(int) * graph->cityCount);
+    for (int start = 0; start < graph->cityCount; start++) {
+        findAllDistances(graph, start, expected);
+        for (int region = 0; region < regionCount; region++) {
+            findFlaggedDistances(graph, arcFlags, region, start, found);
+            for (int goal = 0; goal < graph->cityCount; goal++) {
+                if(arcFlags->cityRegion[goal] == region && found[goal] != expected[goal]) {
+                    printf("arcFlags %d -> %d: %d, expected %d\n", start, goal, found[goal], expected[goal]);
+                    failures++;
+                }
+            }
+        }
+    }
+
+    // The search must find a route wherever it finds one without the flags
+    Route *route = 0;
+    newRoute(graph->cityCount, &route);
+    RouteOptions options = {0, 1};
+    for (int goal = 1; route && goal < graph->cityCount; goal++) {
+        char *start = cityMap->cities[0]->cityName;
+        char *goalName = cityMap->cities[goal]->cityName;
+        status withoutFlags = findRouteWithOptions(start, goalName, cityMap, route, &options);
+        failures += findRoute(start, goalName, cityMap, route) != withoutFlags;
+    }
+    printf("arcFlags: %s\n", failures ? "FAILED" : "OK");
+    destroyRoute(route);
+    free(expected);
+    free(found);
+    return failures;
+}
+
+/**
+ * Compare the distances of hub labels with those of Dijkstra, for all pairs
+ * @param labels the labels
+ * @param graph the graph of the labels
+ * @param mssg the name of the test
+ * @return the number of failures
+ */
+static int sameHubDistances(HubLabels *labels, Graph *graph, char *mssg) {
+    int failures = 0;
+    int *expected = (int*)malloc(sizeof(int) * graph->cityCount);
+    for (int start = 0; !failures && start < graph->cityCount; start++) {
+        findAllDistances(graph, start, expected);
+        for (int goal = 0; goal < graph->cityCount; goal++) {
+            if(hubDistance(labels, start, goal) != expected[goal]) {
+                printf("%s %d -> %d: %d, expected %d\n", mssg, start, goal, hubDistance(labels, start, goal),
+                       expected[goal]);
+                failures++;
+            }
+        }
+    }
+    free(expected);
+    return failures;
+}
+
+/**
+ * Test hub labels: exact distances for all pairs, also after writing and reading them
+ * @param graph the graph to label
+ * @return the number of failures
+ */
+static int testHubLabels(Graph *graph) {
+    HubLabels *labels = 0;
+    HubLabels *readLabels = 0;
+    if(buildHubLabels(graph, &labels) != OK) {
+        printf("hubLabels: FAILED (build)\n");
+        return 1;
+    }
+    HubLabelStats stats;
+    hubLabelStats(labels, &stats);
+    printf("Hub labels: %.1f entries per label on average, largest %d out / %d in, %lu bytes\n",
+           stats.averageLabel, stats.maxOutLabel, stats.maxInLabel, (unsigned long)stats.bytes);
+
+    int failures = sameHubDistances(labels, graph, "hubDistance");
+    FILE *file = tmpfile();
+    if(!file || writeHubLabels(file, labels) != OK) {
+        failures++;
+    }
+    else {
+        rewind(file);
+        failures += readHubLabels(file, &readLabels) != OK || sameHubDistances(readLabels, graph, "readHubLabels");
+        // A truncated file is refused
+        rewind(file);
+        fputc(0, file);
+        rewind(file);
+        HubLabels *badLabels = 0;
+        failures += readHubLabels(file, &badLabels) != ERRACCESS || badLabels;
+    }
+    if(file) {
+        fclose(file);
+    }
+    printf("hubLabels: %s\n", failures ? "FAILED" : "OK");
+    destroyHubLabels(labels);
+    destroyHubLabels(readLabels);
+    return failures;
+}
+
+/**
+ * Test the time dependent search: without profiles it must find the static distances,
+ * with every travel time doubled the doubled distances, and profiles must interpolate.
+ * @param cityMap the map the graph was created from
+ * @param graph the graph to test
+ * @return the number of failures
+ */
+static int testTravelTimes(CityMap *cityMap, Graph *graph) {
+    TravelTimes *travelTimes = 0;
+    Route *route = 0;
+    int *expected = (int*)malloc(sizeof(int) * graph->cityCount);
+    if(newTravelTimes(graph, &travelTimes) != OK || newRoute(graph->cityCount, &route) != OK || !expected) {
+        printf("travelTimes: FAILED (allocation)\n");
+        return 1;
+    }
+
+    int failures = 0;
+    for (int factor = 1; factor <= 2; factor++) {
+        if(factor == 2) {
+            // Double every edge, at every hour
+            for (int city = 0; city < graph->cityCount; city++) {
+                for (int edge = graph->edgeStart[city]; edge < graph->edgeStart[city + 1]; edge++) {
+                    int times[] = {0, 600};
+                    int costs[] = {2 * graph->edgeDistance[edge], 2 * graph->edgeDistance[edge]};
+                    failures += setEdgeProfile(travelTimes, city, graph->edgeCity[edge], times, costs, 2) != OK;
+                }
+            }
+        }
+        for (int start = 0; start < graph->cityCount; start++) {
+            findAllDistances(graph, start, expected);
+            for (int goal = 0; goal < graph->cityCount; goal++) {
+                status ret = findTimeDependentRoute(travelTimes, cityMap, start, goal, 480, route);
+                if(expected[goal] == UNREACHABLE_DISTANCE ? ret != ERRALGORTIHM
+                                                          : ret != OK || route->totalDistance != factor * expected[goal]) {
+                    printf("findTimeDependentRoute %d -> %d: %d, expected %d\n", start, goal,
+                           route->totalDistance, factor * expected[goal]);
+                    failures++;
+                }
+            }
+        }
+    }
+
+    // Rush hour profile: 100 at night, 200 from 8:00, back to 100 at 10:00, periodic
+    int times[] = {420, 480, 600};
+    int costs[] = {100, 200, 100};
+    int edge = graph->edgeStart[0];
+    failures += setEdgeProfile(travelTimes, 0, graph->edgeCity[edge], times, costs, 3) != OK;
+    failures += edgeTravelTime(travelTimes, edge, 450) != 150;
+    failures += edgeTravelTime(travelTimes, edge, 540) != 150;
+    failures += edgeTravelTime(travelTimes, edge, 60) != 100;
+    failures += edgeTravelTime(travelTimes, edge, 480 + TRAVEL_TIME_PERIOD) != 200;
+    int fasterLater[] = {100, 10};
+    failures += setEdgeProfile(travelTimes, 0, graph->edgeCity[edge], times, fasterLater, 2) != ERRUNABLE;
+
+    printf("travelTimes: %s (%d profiles)\n", failures ? "FAILED" : "OK", travelTimes->profileCount);
+    destroyTravelTimes(travelTimes);
+    destroyRoute(route);
+    free(expected);
+    return failures;
+}
+
+/**
+ * Test renumbering the cities: every city keeps its name and position, the ids and names agree,
+ * the neighbour lists stay sorted on id, the city list follows the ids, no map memory is lost
+ * and the distances between cities are the same
+ * @param mapFilePath the map to load and renumber in every order
+ * @param cityMap the map in file order, for the names of the cities
+ * @param graph the graph of the map in file order
+ * @return the number of failures
+ */
+static int testRenumber(char *mapFilePath, CityMap *cityMap, Graph *graph) {
+    CityOrder orders[] = {CityOrder_Hilbert, CityOrder_BreadthFirst};
+    int *expected = (int*)malloc(sizeof(int) * graph->cityCount);
+    int *found = (int*)malloc(sizeof(int) * graph->cityCount);
+    int failures = !expected || !found;
+    for (int orderNr = 0; !failures && orderNr < 2; orderNr++) {
+        CityMap *renumbered = 0;
+        Graph *renumberedGraph = 0;
+        status ret = createMap(mapFilePath, &renumbered);
+        size_t bytesInUse = ret == OK ? renumbered->memory.base.stats.bytesInUse : 0;
+        if(ret == OK) {
+            ret = renumberMap(renumbered, orders[orderNr]);
+        }
+        if(ret != OK || (ret = createGraph(renumbered, &renumberedGraph)) != OK) {
+            printf("renumberMap: %s\n", message(ret));
+            failures++;
+            destroyMap(renumbered);
+            break;
+        }
+        // The cities are copied in the new order and the old ones freed, the city list follows the ids
+        failures += renumbered->memory.base.stats.bytesInUse != bytesInUse;
+        int listed = 0;
+        for (Node *node = renumbered->cityList->head; node; node = node->next, listed++) {
+            failures += node->val != renumbered->cities[listed];
+        }
+        failures += listed != renumbered->cityCount;
+        for (int id = 0; id < renumbered->cityCount; id++) {
+            City *city = renumbered->cities[id];
+            failures += city->id != id || strcmp(stringOfId(renumbered->names, id), city->cityName) != 0;
+            for (int edge = renumberedGraph->edgeStart[id] + 1; edge < renumberedGraph->edgeStart[id + 1]; edge++) {
+                failures += renumberedGraph->edgeCity[edge - 1] > renumberedGraph->edgeCity[edge];
+            }
+        }
+        for (int start = 0; !failures && start < graph->cityCount; start++) {
+            City *renumberedStart = findCityInMap(cityMap->cities[start]->cityName, renumbered);
+            findAllDistances(graph, start, expected);
+            findAllDistances(renumberedGraph, renumberedStart->id, found);
+            for (int city = 0; city < graph->cityCount; city++) {
+                City *renumberedCity = findCityInMap(cityMap->cities[city]->cityName, renumbered);
+                if(renumberedCity->latitude != cityMap->cities[city]->latitude
+                   || found[renumberedCity->id] != expected[city]) {
+                    printf("renumber %d -> %d: %d, expected %d\n", start, city, found[renumberedCity->id], expected[city]);
+                    failures++;
+                    break;
+                }
+            }
+        }
+        // Packed maps cannot be renumbered, packing afterwards gives the same distances
+        failures += packMap(renumbered) != OK || renumberMap(renumbered, orders[orderNr]) != ERRUNABLE;
+        destroyGraph(renumberedGraph);
+        renumberedGraph = 0;
+        if(!failures && createGraph(renumbered, &renumberedGraph) == OK) {
+            City *renumberedStart = findCityInMap(cityMap->cities[0]->cityName, renumbered);
+            findAllDistances(renumberedGraph, renumberedStart->id, found);
+            findAllDistances(graph, 0, expected);
+            for (int city = 0; city < graph->cityCount; city++) {
+                failures += found[findCityInMap(cityMap->cities[city]->cityName, renumbered)->id] != expected[city];
+            }
+        }
+        destroyGraph(renumberedGraph);
+        destroyMap(renumbered);
+    }
+    printf("renumber: %s\n", failures ? "FAILED" : "OK");
+    free(expected);
+    free(found);
+    return failures;
+}
+
+/**
+ * Thread tracing one event, then ending
+ * @param argument unused
+ * @return 0
+ */
+static void *traceOneEvent(void *argument) {
+    TRACE_SEARCH(TraceEvent_Start, 0, 0, 0, 1);
+    return argument;
+}
+
+/**
+ * Test tracing the searches: a traced route search writes a start, its expansions and its goal,
+ * the trace reads back from a file the same, and the rings of ended threads are reused
+ * @param cityMap the map to search
+ * @param graph the graph created from the map
+ * @return the number of failures
+ */
+static int testSearchTrace(CityMap *cityMap, Graph *graph) {
+    int failures = 0;
+    int searchCount = 0;
+    Route *route = 0;
+    int *expected = (int*)malloc(sizeof(int) * graph->cityCount);
+    FILE *file = tmpfile();
+    if(!expected || !file || newRoute(graph->cityCount, &route) != OK) {
+        printf("searchTrace: FAILED (allocation)\n");
+        return 1;
+    }
+    clearSearchTrace();
+    enableSearchTracing(0);
+    findAllDistances(graph, 0, expected);
+    for (int goal = 0; goal < graph->cityCount; goal++) {
+        failures += findRoute(cityMap->cities[0]->cityName, cityMap->cities[goal]->cityName, cityMap, route) != OK;
+        searchCount++;
+    }
+    disableSearchTracing();
+    findRoute(cityMap->cities[0]->cityName, cityMap->cities[1]->cityName, cityMap, route);
+    failures += writeSearchTrace(file) != OK;
+
+    TraceRecord *records = 0;
+    int count = 0;
+    rewind(file);
+    failures += readSearchTrace(file, &records, &count) != OK;
+    int search = 0;
+    for (int i = 0; !failures && i < count; i++) {
+        TraceRecord *record = &records[i];
+        if(record->event == TraceEvent_Start) {
+            // Every search starts at city 0, with one goal
+            search++;
+            failures += record->search != (uint32_t)search || record->cityId != 0 || record->f != 1;
+        }
+        else if(record->event == TraceEvent_Goal) {
+            failures += record->search != (uint32_t)search || record->g != expected[record->cityId];
+        }
+        // No event has a distance below the shortest one
+        failures += record->event >= TRACE_EVENT_COUNT || record->g < expected[record->cityId];
+    }
+    failures += search != searchCount;
+
+    // Threads one after the other share a ring, until the rings are freed
+    enableSearchTracing(0);
+    int rings = -1;
+    for (int thread = 0; thread < 32; thread++) {
+        pthread_t tracer;
+        if(pthread_create(&tracer, 0, traceOneEvent, 0) != 0 || pthread_join(tracer, 0) != 0) {
+            failures++;
+            break;
+        }
+        if(thread == 0) {
+            rings = searchTraceRingCount();
+        }
+    }
+    failures += rings < 1 || searchTraceRingCount() != rings;
+    freeSearchTraces();
+    failures += searchTraceRingCount() != 0;
+    traceOneEvent(0);
+    failures += searchTraceRingCount() != 1;
+    disableSearchTracing();
+    printf("searchTrace: %s (%d records)\n", failures ? "FAILED" : "OK", count);
+    clearSearchTrace();
+    free(records);
+    fclose(file);
+    destroyRoute(route);
+    free(expected);
+    return failures;
+}
+
+/**
+ * Check the components of a map against the distances: every route which exists has to be allowed
+ * @param cityMap the map
+ * @param graph the graph created from the map
+ * @param exact non zero if mayReach() has to reject every route which does not exist as well
+ * @return the number of failures
+ */
+static int checkComponents(CityMap *cityMap, Graph *graph, int exact) {
+    int failures = !cityMap->components;
+    int *distances = (int*)malloc(sizeof(int) * graph->cityCount);
+    for (int start = 0; !failures && distances && start < graph->cityCount; start++) {
+        findAllDistances(graph, start, distances);
+        for (int goal = 0; goal < graph->cityCount; goal++) {
+            int reachable = distances[goal] != UNREACHABLE_DISTANCE;
+            int allowed = mayReach(cityMap->components, start, goal) != 0;
+            failures += reachable ? !allowed : (exact && allowed);
+        }
+    }
+    free(distances);
+    return failures + !distances;
+}
+
+/**
+ * Test the components: on the map, and on a map of two islands with a one way road,
+ * where a route between the islands or against the road is rejected without a search
+ * @param cityMap the map
+ * @param graph the graph created from the map
+ * @return the number of failures
+ */
+static int testComponents(CityMap *cityMap, Graph *graph) {
+    char *islandsPath = "graphTest_islands.MAP";
+    int failures = checkComponents(cityMap, graph, 0);
+
+    // Ouest <-> Centre -> Est -> Phare, Ile <-> Port
+    FILE *file = fopen(islandsPath, "w");
+    if(!file) {
+        printf("components: FAILED (writing %s)\n", islandsPath);
+        return 1;
+    }
+    fprintf(file, "Ouest\t\t0\t0\nCentre\t\t10\n");
+    fprintf(file, "Centre\t\t10\t0\nOuest\t\t10\nEst\t\t10\n");
+    fprintf(file, "Est\t\t20\t0\nPhare\t\t10\n");
+    fprintf(file, "Phare\t\t30\t0\n");
+    fprintf(file, "Ile\t\t100\t100\nPort\t\t5\n");
+    fprintf(file, "Port\t\t110\t100\nIle\t\t5\n");
+    failures += fclose(file) != 0;
+
+    CityMap *islands = 0;
+    Graph *islandsGraph = 0;
+    Route *route = 0;
+    status ret = createMap(islandsPath, &islands);
+    if(ret != OK || (ret = createGraph(islands, &islandsGraph)) != OK || (ret = newRoute(islands->cityCount, &route)) != OK) {
+        printf("components: %s\n", message(ret));
+        failures++;
+    }
+    if(!failures) {
+        failures += islands->components->componentCount != 2 || islands->components->strongComponentCount != 4;
+        failures += checkComponents(islands, islandsGraph, 1);
+        failures += findRoute("Ouest", "Phare", islands, route) != OK || route->totalDistance != 30;
+        failures += findRoute("Phare", "Ouest", islands, route) != ERRALGORTIHM;
+        failures += findRoute("Ouest", "Port", islands, route) != ERRALGORTIHM;
+    }
+    printf("components: %s (%d components)\n", failures ? "FAILED" : "OK",
+           cityMap->components ? cityMap->components->componentCount : 0);
+    destroyRoute(route);
+    destroyGraph(islandsGraph);
+    destroyMap(islands);
+    remove(islandsPath);
+    return failures;
+}
+
+/**
+ * Length of the shortest order of stops, by trying all orders (permutations of order[position..])
+ * @param table distance from point i to point j at [i * pointCount + j], the start 0 and the end pointCount-1
+ * @param pointCount the start, the stops and the end
+ * @param order the stops, permuted in place and restored
+ * @param position the first stop to permute
+ * @return the shortest length
+ */
+static long long shortestOrder(long long *table, int pointCount, int *order, int position) {
+    int stopCount = pointCount - 2;
+    if(position == stopCount) {
+        long long length = 0;
+        int previous = 0;
+        for (int i = 0; i < stopCount; i++) {
+            length += table[previous * pointCount + order[i]];
+            previous = order[i];
+        }
+        return length + table[previous * pointCount + pointCount - 1];
+    }
+    long long best = -1;
+    for (int i = position; i < stopCount; i++) {
+        int swap = order[position];
+        order[position] = order[i];
+        order[i] = swap;
+        long long length = shortestOrder(table, pointCount, order, position + 1);
+        if(best < 0 || length < best) {
+            best = length;
+        }
+        order[i] = order[position];
+        order[position] = swap;
+    }
+    return best;
+}
+
+/**
+ * Check a multi-stop route: from the start to the end over edges of the graph, with the distances
+ * of the edges, visiting the stops in the given order and as long as the legs between them
+ * @param graph the graph
+ * @param route the route
+ * @param table the distances between the points, the start 0 and the end pointCount-1
+ * @param points the city of every point
+ * @param pointCount the start, the stops and the end
+ * @param stopOrder the stops (0..pointCount-3) in the order visited
+ * @return 1 if the route is valid, 0 otherwise
+ */
+static int validMultiStopRoute(Graph *graph, Route *route, long long *table, int *points, int pointCount,
+                               int *stopOrder) {
+    if(route->cityCount < 1 || route->cityIds[0] != points[0] || route->distances[0] != 0
+       || route->cityIds[route->cityCount - 1] != points[pointCount - 1]
+       || route->totalDistance != route->distances[route->cityCount - 1]) {
+        return 0;
+    }
+    for (int i = 1; i < route->cityCount; i++) {
+        int from = route->cityIds[i - 1];
+        int edge = graph->edgeStart[from];
+        while (edge < graph->edgeStart[from + 1] && (graph->edgeCity[edge] != route->cityIds[i]
+               || graph->edgeDistance[edge] != route->distances[i] - route->distances[i - 1])) {
+            edge++;
+        }
+        if(edge == graph->edgeStart[from + 1]) {
+            return 0;
+        }
+    }
+    // The stops, in order, at the distance of the legs before them
+    long long length = 0;
+    int previous = 0;
+    int position = 0;
+    for (int stop = 0; stop <= pointCount - 2; stop++) {
+        int point = stop == pointCount - 2 ? pointCount - 1 : stopOrder[stop] + 1;
+        length += table[previous * pointCount + point];
+        while (position < route->cityCount && (route->cityIds[position] != points[point]
+               || route->distances[position] != length)) {
+            position++;
+        }
+        if(position == route->cityCount) {
+            return 0;
+        }
+        previous = point;
+    }
+    return 1;
+}
+
+/**
+ * Test the multi-stop routes: exact for a few stops (compared with all orders), and for all cities
+ * as stops (local search) valid and not longer than the stops in the given order
+ * @param cityMap the map
+ * @param graph the graph created from the map
+ * @return the number of failures
+ */
+static int testMultiStop(CityMap *cityMap, Graph *graph) {
+    int failures = 0;
+    int cityCount = graph->cityCount;
+    int pointCount = cityCount;
+    int *points = (int*)malloc(sizeof(int) * pointCount);
+    int *order = (int*)malloc(sizeof(int) * pointCount);
+    int *distances = (int*)malloc(sizeof(int) * cityCount);
+    char **stopNames = (char**)malloc(sizeof(char*) * pointCount);
+    long long *table = (long long*)malloc(sizeof(long long) * pointCount * pointCount);
+    Route *route = 0;
+    if(!points || !order || !distances || !stopNames || !table || newRoute(cityCount * pointCount, &route) != OK) {
+        printf("multiStop: FAILED (allocation)\n");
+        return 1;
+    }
+    int stopCounts[] = {0, 1, 6, cityCount - 2};
+    for (int countNr = 0; countNr < 4; countNr++) {
+        for (int start = 0; start < cityCount; start += 3) {
+            // The start, every other city as stop (all for the last count), the end
+            int count = stopCounts[countNr] + 2;
+            int step = count == cityCount ? 1 : 2;
+            for (int point = 0; point < count; point++) {
+                points[point] = (start + point * step) % cityCount;
+            }
+            for (int from = 0; from < count; from++) {
+                findAllDistances(graph, points[from], distances);
+                for (int to = 0; to < count; to++) {
+                    table[from * count + to] = distances[points[to]];
+                }
+            }
+            for (int stop = 0; stop < count - 2; stop++) {
+                stopNames[stop] = cityMap->cities[points[stop + 1]]->cityName;
+                order[stop] = stop + 1;
+            }
+            // Exact: the shortest of all orders, otherwise at most the given order
+            long long expected = count - 2 <= MULTI_STOP_EXACT_LIMIT ? shortestOrder(table, count, order, 0)
+                                                                     : shortestOrder(table, count, order, count - 2);
+            status ret = findMultiStopRoute(cityMap->cities[points[0]]->cityName,
+                                            cityMap->cities[points[count - 1]]->cityName,
+                                            stopNames, count - 2, cityMap, countNr % 2 ? graph : 0, route, order);
+            if(ret != OK || !validMultiStopRoute(graph, route, table, points, count, order)
+               || (count - 2 <= MULTI_STOP_EXACT_LIMIT ? route->totalDistance != expected
+                                                       : route->totalDistance > expected)) {
+                printf("multiStop %d stops from %d: %d, expected %lld\n", count - 2, start,
+                       ret == OK ? route->totalDistance : -1, expected);
+                failures++;
+            }
+        }
+    }
+    failures += findMultiStopRoute(cityMap->cities[0]->cityName, "Nowhere", stopNames, 1, cityMap, 0, route, 0)
+                != ERRABSENT;
+    printf("multiStop: %s\n", failures ? "FAILED" : "OK");
+    destroyRoute(route);
+    free(points);
+    free(order);
+    free(distances);
+    free(stopNames);
+    free(table);
+    return failures;
+}
+
+/**
+ * Test paged maps: written with small pages and loaded with a cache of two pages, the graph must have the same
+ * edges and findRoute() the same distances as on the map in memory, with pages replaced in the cache
+ * @param cityMap the map
+ * @param graph the graph created from the map
+ * @return the number of failures
+ */
+static int testPagedGraph(CityMap *cityMap, Graph *graph) {
+    char *pagedPath = "graphTest.pmap";
+    int failures = writePagedMap(cityMap, PAGED_MAP_MIN_PAGE_SIZE - 1, pagedPath) != ERRINDEX;
+    status ret = writePagedMap(cityMap, 2 * PAGED_MAP_MIN_PAGE_SIZE, pagedPath);
+    CityMap *paged = 0;
+    Graph *pagedGraph = 0;
+    Route *route = 0;
+    int *expected = (int*)malloc(sizeof(int) * graph->cityCount);
+    if(ret != OK || (ret = loadPagedMap(pagedPath, 2, &paged)) != OK || (ret = createGraph(paged, &pagedGraph)) != OK
+       || (ret = newRoute(graph->cityCount, &route)) != OK || !expected) {
+        printf("pagedGraph: FAILED (%s)\n", message(ret));
+        destroyMap(paged);
+        remove(pagedPath);
+        return 1;
+    }
+    failures += paged->cityCount != cityMap->cityCount || pagedGraph->edgeCount != graph->edgeCount;
+    for (int id = 0; !failures && id < cityMap->cityCount; id++) {
+        failures += strcmp(paged->cities[id]->cityName, cityMap->cities[id]->cityName) != 0
+                    || paged->cities[id]->latitude != cityMap->cities[id]->latitude
+                    || paged->cities[id]->longitude != cityMap->cities[id]->longitude;
+    }
+    if(!failures) {
+        failures += memcmp(pagedGraph->edgeStart, graph->edgeStart, sizeof(int) * (graph->cityCount + 1)) != 0
+                    || memcmp(pagedGraph->edgeCity, graph->edgeCity, sizeof(int) * graph->edgeCount) != 0
+                    || memcmp(pagedGraph->edgeDistance, graph->edgeDistance, sizeof(int) * graph->edgeCount) != 0;
+    }
+    resetPagedGraphStats(paged->paged);
+    for (int start = 0; !failures && start < graph->cityCount; start++) {
+        findAllDistances(graph, start, expected);
+        for (int goal = 0; goal < graph->cityCount; goal++) {
+            ret = findRoute(paged->cities[start]->cityName, paged->cities[goal]->cityName, paged, route);
+            if(ret != OK || route->totalDistance != expected[goal]) {
+                printf("pagedGraph %d -> %d: %d, expected %d\n", start, goal, ret == OK ? route->totalDistance : -1,
+                       expected[goal]);
+                failures++;
+            }
+        }
+    }
+    PagedGraphStats stats;
+    pagedGraphStats(paged->paged, &stats);
+    failures += stats.misses == 0 || stats.hits == 0 || stats.cachedPages != 2
+                || (stats.pageCount > 2 && stats.evictions == 0);
+    failures += packMap(paged) != ERRUNABLE || renumberMap(paged, CityOrder_Hilbert) != ERRUNABLE;
+    printf("pagedGraph: %s (%d pages, %ld hits, %ld misses)\n", failures ? "FAILED" : "OK", stats.pageCount,
+           stats.hits, stats.misses);
+    free(expected);
+    destroyRoute(route);
+    destroyGraph(pagedGraph);
+    destroyMap(paged);
+    remove(pagedPath);
+    return failures;
+}
+
+/**
+ * Callback of the first query of testDistanceTable(): hold the worker until the test releases it
+ * @param query the query done
+ * @param context the int flag, set to release the worker
+ */
+static void holdWorker(RouteQuery *query, void *context) {
+    struct timespec pause = {0, 1000000};
+    while (!__atomic_load_n((int*)context, __ATOMIC_ACQUIRE)) {
+        nanosleep(&pause, 0);
+    }
+}
+
+/**
+ * Test the distance tables, with and without next hops: attached to the map, findRoute() must find routes
+ * over its edges as short as findAllDistances(), and findNearestRoute() the nearest goal. A query of a pool
+ * cancelled while queued, or expired, is stopped and not answered from the table. A table is refused
+ * for another map, and a file which is not a table
+ * @param cityMap the map, its table is detached again
+ * @param graph the graph created from the map
+ * @return the number of failures
+ */
+static int testDistanceTable(CityMap *cityMap, Graph *graph) {
+    char *tablePath = "graphTest.dist";
+    int *expected = (int*)malloc(sizeof(int) * graph->cityCount);
+    Route *route = 0;
+    status ret = expected ? newRoute(graph->cityCount, &route) : ERRALLOC;
+    if(ret != OK) {
+        printf("distanceTable: FAILED (%s)\n", message(ret));
+        free(expected);
+        return 1;
+    }
+
+    int failures = 0;
+    for (int withNextHops = 0; withNextHops <= 1; withNextHops++) {
+        if((ret = buildDistanceTable(cityMap, 3, withNextHops, tablePath)) != OK
+           || (ret = loadDistanceTable(cityMap, tablePath)) != OK) {
+            printf("distanceTable: FAILED (%s)\n", message(ret));
+            failures++;
+            break;
+        }
+        failures += !cityMap->distanceTable->nextHops != !withNextHops;
+        for (int start = 0; start < graph->cityCount; start++) {
+            findAllDistances(graph, start, expected);
+            for (int goal = 0; goal < graph->cityCount; goal++) {
+                ret = findRoute(cityMap->cities[start]->cityName, cityMap->cities[goal]->cityName, cityMap, route);
+                if(expected[goal] == UNREACHABLE_DISTANCE) {
+                    failures += ret != ERRALGORTIHM;
+                    continue;
+                }
+                long long legs[4] = {0, expected[goal], expected[goal], 0};
+                int points[2] = {start, goal};
+                if(ret != OK || route->totalDistance != expected[goal]
+                   || !validMultiStopRoute(graph, route, legs, points, 2, 0)) {
+                    printf("table route %d -> %d: %s, %d, expected %d\n", start, goal, message(ret),
+                           route->totalDistance, expected[goal]);
+                    failures++;
+                }
+            }
+
+            // The nearest of three goals
+            char *goals[3];
+            int nearest = UNREACHABLE_DISTANCE;
+            for (int goalNr = 0; goalNr < 3; goalNr++) {
+                int goal = (start + 1 + goalNr * 5) % graph->cityCount;
+                goals[goalNr] = cityMap->cities[goal]->cityName;
+                nearest = expected[goal] < nearest ? expected[goal] : nearest;
+            }
+            int goalIndex = -1;
+            ret = findNearestRoute(cityMap->cities[start]->cityName, goals, 3, cityMap, route, 0, &goalIndex);
+            failures += nearest == UNREACHABLE_DISTANCE ? ret != ERRALGORTIHM
+                        : ret != OK || route->totalDistance != nearest || goalIndex < 0
+                          || strcmp(cityMap->cities[route->cityIds[route->cityCount - 1]]->cityName,
+                                    goals[goalIndex]) != 0;
+        }
+    }
+
+    // A query cancelled while queued behind a held worker is not answered from the table, nor is an expired one
+    RoutePool *pool = 0;
+    if(cityMap->distanceTable && newRoutePool(cityMap, 1, &pool) == OK) {
+        int released = 0;
+        RouteQuery *held = 0;
+        RouteQuery *queued = 0;
+        char *start = cityMap->cities[0]->cityName;
+        char *goal = cityMap->cities[graph->cityCount - 1]->cityName;
+        failures += submitRoute(pool, start, goal, 0, holdWorker, &released, &held) != OK
+                    || submitRoute(pool, start, goal, 0, 0, 0, &queued) != OK;
+        cancelRoute(queued);
+        __atomic_store_n(&released, 1, __ATOMIC_RELEASE);
+        failures += waitRoute(queued) != ERRCANCELLED;
+        releaseRoute(held);
+        releaseRoute(queued);
+        struct timespec deadline;
+        deadlineAfter(&deadline, -1);
+        failures += submitRoute(pool, start, goal, &deadline, 0, 0, &queued) != OK || waitRoute(queued) != ERRTIMEOUT;
+        releaseRoute(queued);
+        destroyRoutePool(pool);
+    }
+    else {
+        failures++;
+    }
+
+    // Refused for another map, and for a file which is not a table
+    CityMap *empty = 0;
+    if(createEmptyMap(&empty, 0) == OK) {
+        failures += loadDistanceTable(empty, tablePath) != ERRUNABLE || empty->distanceTable;
+    }
+    destroyMap(empty);
+    FILE *file = fopen(tablePath, "wb");
+    if(file) {
+        fputs("not a distance table, not at all", file);
+        fclose(file);
+    }
+    failures += loadDistanceTable(cityMap, tablePath) != ERRACCESS;
+
+    printf("distanceTable: %s (%d cities, %lu bytes with next hops)\n", failures ? "FAILED" : "OK", graph->cityCount,
+           cityMap->distanceTable ? (unsigned long)cityMap->distanceTable->mappingSize : 0ul);
+    destroyDistanceTable(cityMap->distanceTable);
+    cityMap->distanceTable = 0;
+    remove(tablePath);
+    destroyRoute(route);
+    free(expected);
+    return failures;
+}
+
+/**
+ * Callback of the queries of testMapHandle(): count the queries answered on a map of another size
+ * @param query the query, done
+ * @param context the int counter, and the city count after it
+ */
+static void checkQueryMap(RouteQuery *query, void *context) {
+    int *counters = (int*)context;
+    if(query->cityMap->cityCount != counters[1] || (query->result == OK && query->route->cityCount
+       && strcmp(query->cityMap->cities[query->route->cityIds[0]]->cityName, query->startCityName) != 0)) {
+        __atomic_add_fetch(&counters[0], 1, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * Test the map handle: a pinned map stays readable after a reload replaced it, and is destroyed when unpinned;
+ * queries of a pool on the handle find the right routes while the map is reloaded under them
+ * @param mapFilePath the map to load and reload
+ * @param names the map loaded from it, for the names of the cities
+ * @param graph the graph created from the map
+ * @return the number of failures
+ */
+static int testMapHandle(char *mapFilePath, CityMap *names, Graph *graph) {
+    CityMap *cityMap = 0;
+    MapHandle *handle = 0;
+    RoutePool *pool = 0;
+    Route *route = 0;
+    int queryCount = graph->cityCount * graph->cityCount;
+    RouteQuery **queries = (RouteQuery**)calloc(queryCount, sizeof(RouteQuery*));
+    int *expected = (int*)malloc(sizeof(int) * queryCount);
+    status ret = createMap(mapFilePath, &cityMap);
+    if(ret != OK || (ret = newMapHandle(cityMap, 2, &handle)) != OK || (ret = newRoute(graph->cityCount, &route)) != OK
+       || (ret = newRoutePoolOnHandle(handle, ROUTE_POOL_DEFAULT_THREADS, &pool)) != OK || !queries || !expected) {
+        printf("mapHandle: FAILED (%s)\n", message(ret));
+        if(!handle) {
+            destroyMap(cityMap);
+        }
+        destroyMapHandle(handle);
+        destroyRoute(route);
+        free(queries);
+        free(expected);
+        return 1;
+    }
+    for (int start = 0; start < graph->cityCount; start++) {
+        findAllDistances(graph, start, expected + start * graph->cityCount);
+    }
+
+    // The old map stays pinned, and searchable, until unpinned
+    int failures = 0;
+    int oldPin;
+    CityMap *oldMap = pinMap(handle, &oldPin);
+    failures += oldMap != cityMap || reloadMap(handle, mapFilePath, 0) != OK;
+    failures += reloadMap(handle, mapFilePath, 0) != ERRUNABLE;
+    struct timespec interval = {0, 1000000};
+    while (__atomic_load_n(&handle->cityMap, __ATOMIC_ACQUIRE) == oldMap) {
+        nanosleep(&interval, 0);
+    }
+    int pin;
+    CityMap *newMap = pinMap(handle, &pin);
+    char *start = oldMap->cities[0]->cityName;
+    char *goal = oldMap->cities[graph->cityCount - 1]->cityName;
+    failures += newMap == oldMap || pin == oldPin || !mapReloading(handle);
+    failures += findRoute(start, goal, oldMap, route) != OK
+                || route->totalDistance != expected[graph->cityCount - 1];
+    unpinMap(handle, pin);
+    unpinMap(handle, oldPin);
+    failures += waitMapReload(handle) != OK || mapReloading(handle) || handle->retired || handle->reloads != 1;
+
+    // Queries answered while the map is reloaded, each on the map it pinned
+    int counters[2] = {0, graph->cityCount};
+    for (int reload = 0; reload < 3; reload++) {
+        failures += reloadMap(handle, mapFilePath, 0) != OK;
+        for (int queryNr = 0; queryNr < queryCount; queryNr++) {
+            failures += submitRoute(pool, names->cities[queryNr / graph->cityCount]->cityName,
+                                    names->cities[queryNr % graph->cityCount]->cityName, 0, checkQueryMap, counters,
+                                    &queries[queryNr]) != OK;
+        }
+        for (int queryNr = 0; queryNr < queryCount; queryNr++) {
+            if(!queries[queryNr]) {
+                continue;
+            }
+            ret = waitRoute(queries[queryNr]);
+            failures += expected[queryNr] == UNREACHABLE_DISTANCE ? ret != ERRALGORTIHM
+                        : ret != OK || queries[queryNr]->route->totalDistance != expected[queryNr];
+            releaseRoute(queries[queryNr]);
+            queries[queryNr] = 0;
+        }
+        failures += waitMapReload(handle) != OK || handle->retired;
+    }
+    failures += counters[0];
+
+    // A failed reload keeps the map
+    newMap = handle->cityMap;
+    failures += reloadMap(handle, "graphTest.missing.map", 0) != OK || waitMapReload(handle) != ERROPEN;
+    failures += handle->cityMap != newMap || handle->reloads != 4;
+
+    printf("mapHandle: %s (%ld reloads, %d queries each)\n", failures ? "FAILED" : "OK", handle->reloads, queryCount);
+    destroyRoutePool(pool);
+    destroyMapHandle(handle);
+    destroyRoute(route);
+    free(queries);
+    free(expected);
+    return failures;
+}
+
+/**
+ * Test the allocators: a map must give all its memory back to its parent, also when packed,
+ * and a search in a scratch arena must find the same routes as one with malloc.
+ * @param mapFilePath the map to load
+ * @param graph the graph of the map, for the cities to search
+ * @return the number of failures
+ */
+static int testAllocators(char *mapFilePath, Graph *graph) {
+    TrackingAllocator tracking;
+    ArenaAllocator scratch;
+    PoolAllocator pool;
+    initTrackingAllocator(&tracking, "test", 0);
+    initArenaAllocator(&scratch, "query", 0, 0);
+    initPoolAllocator(&pool, "pool", sizeof(Node), &tracking.base);
+
+    CityMap *cityMap = 0;
+    Route *expected = 0;
+    Route *found = 0;
+    if(createMapWithAllocator(mapFilePath, &cityMap, &tracking.base) != OK
+       || newRoute(graph->cityCount, &expected) != OK || newRoute(graph->cityCount, &found) != OK) {
+        printf("allocators: FAILED (allocation)\n");
+        return 1;
+    }
+    int failures = tracking.base.stats.bytesInUse != mapFootprint(cityMap);
+    size_t listFootprint = mapFootprint(cityMap);
+    failures += packMap(cityMap) != OK;
+    printf("Map footprint: %lu bytes with neighbour lists, %lu bytes packed\n",
+           (unsigned long)listFootprint, (unsigned long)mapFootprint(cityMap));
+
+    RouteOptions options = {&scratch.base};
+    for (int goal = 1; goal < graph->cityCount; goal++) {
+        char *start = cityMap->cities[0]->cityName;
+        char *goalName = cityMap->cities[goal]->cityName;
+        status expectedRet = findRoute(start, goalName, cityMap, expected);
+        status foundRet = findRouteWithOptions(start, goalName, cityMap, found, &options);
+        if(foundRet != expectedRet || (foundRet == OK && (found->cityCount != expected->cityCount
+           || memcmp(found->cityIds, expected->cityIds, sizeof(int) * found->cityCount) != 0))) {
+            printf("findRouteWithOptions 0 -> %d: different route\n", goal);
+            failures++;
+        }
+        resetArenaAllocator(&scratch);
+        failures += scratch.base.stats.bytesInUse != 0;
+    }
+    printAllocatorStats(stdout, &scratch.base);
+    printAllocatorStats(stdout, &cityMap->memory.base);
+    destroyMap(cityMap);
+
+    // Pooled list nodes are reused after a release
+    List *list = newListWithAllocator(ListKind_Linked, 0, 0, 0, 0, &pool.base);
+    for (int i = 0; list && i < 1000; i++) {
+        void *element;
+        failures += addListAt(list, 0, list) != OK;
+        failures += i % 2 && remFromListAt(list, 0, &element) != OK;
+    }
+    failures += !list || pool.reservedBytes != ALLOCATOR_CHUNK_SIZE;
+    if(list) delList(list);
+    failures += pool.base.stats.bytesInUse != 0;
+    releasePoolAllocator(&pool);
+
+    failures += tracking.base.stats.bytesInUse != 0;
+    printf("allocators: %s\n", failures ? "FAILED" : "OK");
+    releaseArenaAllocator(&scratch);
+    destroyRoute(expected);
+    destroyRoute(found);
+    return failures;
+}
+
+/**
+ * test program: load the map, then compare all searches.
+ */
+int main(int argc, char** args) {
+    char *mapFilePath = argc > 1 ? args[1] : "./FRANCE.MAP";
+
+    CityMap *cityMap = 0;
+    status ret = createMap(mapFilePath, &cityMap);
+    if(ret != OK) {
+        printf("While populating map from %s\nError: %s\n", mapFilePath, message(ret));
+        destroyMap(cityMap);
+        return 1;
+    }
+    Graph *graph = 0;
+    if((ret = createGraph(cityMap, &graph)) != OK) {
+        printf("Error: %s\n", message(ret));
+        destroyMap(cityMap);
+        return 1;
+    }
+    printf("Cities: %d, edges: %d\n", graph->cityCount, graph->edgeCount);
+
+    int failures = 0;
+    failures += testDeltaStepping(graph);
+    failures += testPackedGraph(cityMap, graph);
+    failures += testPackedLoad(mapFilePath, cityMap, graph);
+    failures += testHeuristic(cityMap, graph);
+    failures += testArcFlags(cityMap, graph);
+    failures += testNearestRoute(cityMap, graph);
+    failures += testBoundedRoute(cityMap, graph);
+    failures += testRoutePool(cityMap, graph);
+    failures += testShardedMap(cityMap, graph);
+    failures += testHubLabels(graph);
+    failures += testTravelTimes(cityMap, graph);
+    failures += testAllocators(mapFilePath, graph);
+    failures += testRenumber(mapFilePath, cityMap, graph);
+    failures += testSearchTrace(cityMap, graph);
+    failures += testComponents(cityMap, graph);
+    failures += testMultiStop(cityMap, graph);
+    failures += testPagedGraph(cityMap, graph);
+    failures += testMapHandle(mapFilePath, cityMap, graph);
+    failures += testDistanceTable(cityMap, graph);
+    failures += testLatencyStats();
+
+    destroyGraph(graph);
+    destroyMap(cityMap);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,82 @@
+/**
+ * @file Heap.c
+ * @brief Binary min-heap of (key, city id) pairs.
+ */
+
+#include <stdlib.h>
+#include "Heap.h"
+
+status initHeap(Heap *heap, int capacity) {
+    if(capacity < 1) {
+        capacity = 1;
+    }
+    heap->entries = (HeapEntry*)malloc(sizeof(HeapEntry) * capacity);
+    heap->count = 0;
+    heap->capacity = heap->entries ? capacity : 0;
+    return heap->entries ? OK : ERRALLOC;
+}
+
+void freeHeap(Heap *heap) {
+    free(heap->entries);
+    heap->entries = 0;
+    heap->count = 0;
+    heap->capacity = 0;
+}
+
+void clearHeap(Heap *heap) {
+    heap->count = 0;
+}
+
+status pushHeap(Heap *heap, int key, int cityId) {
+    // Grow the entries when full
+    if(heap->count == heap->capacity) {
+        int capacity = heap->capacity ? heap->capacity * 2 : 16;
+        HeapEntry *entries = (HeapEntry*)realloc(heap->entries, sizeof(HeapEntry) * capacity);
+        if(!entries) {
+            return ERRALLOC;
+        }
+        heap->entries = entries;
+        heap->capacity = capacity;
+    }
+
+    // Sift the new entry up to its place
+    int pos = heap->count++;
+    while (pos > 0) {
+        int parent = (pos - 1) / 2;
+        if(heap->entries[parent].key <= key) {
+            break;
+        }
+        heap->entries[pos] = heap->entries[parent];
+        pos = parent;
+    }
+    heap->entries[pos].key = key;
+    heap->entries[pos].cityId = cityId;
+    return OK;
+}
+
+status popHeap(Heap *heap, HeapEntry *entry) {
+    if(heap->count == 0) {
+        return ERREMPTY;
+    }
+    *entry = heap->entries[0];
+
+    // Move the last entry down from the top
+    HeapEntry last = heap->entries[--heap->count];
+    int pos = 0;
+    while (1) {
+        int child = pos * 2 + 1;
+        if(child >= heap->count) {
+            break;
+        }
+        if(child + 1 < heap->count && heap->entries[child + 1].key < heap->entries[child].key) {
+            child++;
+        }
+        if(last.key <= heap->entries[child].key) {
+            break;
+        }
+        heap->entries[pos] = heap->entries[child];
+        pos = child;
+    }
+    heap->entries[pos] = last;
+    return OK;
+}
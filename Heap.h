@@ -0,0 +1,70 @@
+/**
+ * @file Heap.h
+ * @brief Binary min-heap of (key, city id) pairs, used by the searches working on city ids.
+ *
+ * Entries are never updated in place: a city whose key improves is pushed again,
+ * and outdated entries are skipped by the caller when popped (lazy deletion).
+ */
+#ifndef ADVANCED_C_CLASS_HEAP_H
+#define ADVANCED_C_CLASS_HEAP_H
+
+#include "status.h"
+
+/**
+ * Heap entry, ordered on key
+ */
+typedef struct HeapEntry {
+    int key;
+    int cityId;
+}HeapEntry;
+
+/**
+ * The heap embeds the entries array, which grows when needed
+ */
+typedef struct Heap {
+    HeapEntry *entries;
+    int count;
+    int capacity;
+}Heap;
+
+/**
+ * Initialise an empty heap (O(1)).
+ * @param heap the heap to initialise
+ * @param capacity the initial amount of entries to allocate
+ * @return ERRALLOC if memory allocation failed
+ * @return OK otherwise
+ */
+status initHeap(Heap *heap, int capacity);
+
+/**
+ * Release the entries of the heap, the heap itself is not freed (O(1)).
+ * @param heap the heap to release
+ */
+void freeHeap(Heap *heap);
+
+/**
+ * Remove all entries, keeping the allocated memory (O(1)).
+ * @param heap the heap to clear
+ */
+void clearHeap(Heap *heap);
+
+/**
+ * Add an entry to the heap (O(log N)).
+ * @param heap the heap
+ * @param key the key to order on
+ * @param cityId the id of the city
+ * @return ERRALLOC if memory allocation failed
+ * @return OK otherwise
+ */
+status pushHeap(Heap *heap, int key, int cityId);
+
+/**
+ * Remove the entry with the smallest key (O(log N)).
+ * @param heap the heap
+ * @param entry (out) the removed entry
+ * @return ERREMPTY if the heap is empty
+ * @return OK otherwise
+ */
+status popHeap(Heap *heap, HeapEntry *entry);
+
+#endif //ADVANCED_C_CLASS_HEAP_H
@@ -0,0 +1,521 @@
+/**
+ * @file HubLabels.c
+ * @brief Hub labeling: exact distance queries between two cities in a merge of two short arrays.
+ */
+
+#include <string.h>
+#include "HubLabels.h"
+#include "Heap.h"
+
+/** Number of shortest path trees sampled to order the cities */
+#define HUB_ORDER_SAMPLES   (32)
+/** Magic number at the start of a labels file: "HUBL" */
+#define HUB_LABELS_MAGIC    (0x4C425548)
+
+/**
+ * Growing label of one city while building
+ */
+typedef struct LabelArray {
+    int *hubs;
+    int *distances;
+    int count;
+    int capacity;
+}LabelArray;
+
+/**
+ * State of a build: the labels so far, and the buffers of the pruned searches
+ */
+typedef struct LabelBuild {
+    int cityCount;
+    LabelArray *out;
+    LabelArray *in;
+    int *rootDistance;      // Distance per hub rank from (or to) the root of the search, UNREACHABLE_DISTANCE if none
+    int *distances;         // Tentative distance per city
+    int *touched;           // Cities with a tentative distance, to reset them
+    int touchedCount;
+    Heap heap;
+}LabelBuild;
+
+/**
+ * Add an entry at the end of a label
+ * @param label the label
+ * @param hub the rank of the hub
+ * @param distance the distance to (or from) the hub
+ * @return ERRALLOC if memory allocation failed
+ * @return OK otherwise
+ */
+static status appendLabel(LabelArray *label, int hub, int distance) {
+    if(label->count == label->capacity) {
+        int capacity = label->capacity ? label->capacity * 2 : 4;
+        int *hubs = (int*)realloc(label->hubs, sizeof(int) * capacity);
+        if(!hubs) {
+            return ERRALLOC;
+        }
+        label->hubs = hubs;
+        int *distances = (int*)realloc(label->distances, sizeof(int) * capacity);
+        if(!distances) {
+            return ERRALLOC;
+        }
+        label->distances = distances;
+        label->capacity = capacity;
+    }
+    label->hubs[label->count] = hub;
+    label->distances[label->count] = distance;
+    label->count++;
+    return OK;
+}
+
+/**
+ * Merge two sorted labels: the shortest distance over their common hubs
+ * @param outHubs the hubs of the out label of the city to start from
+ * @param outDistances the distances to those hubs
+ * @param outCount the size of the out label
+ * @param inHubs the hubs of the in label of the city to go to
+ * @param inDistances the distances from those hubs
+ * @param inCount the size of the in label
+ * @return the distance, UNREACHABLE_DISTANCE if they have no common hub
+ */
+static int mergeLabels(const int *outHubs, const int *outDistances, int outCount,
+                       const int *inHubs, const int *inDistances, int inCount) {
+    long long best = UNREACHABLE_DISTANCE;
+    int i = 0;
+    int j = 0;
+    while (i < outCount && j < inCount) {
+        if(outHubs[i] < inHubs[j]) {
+            i++;
+        }
+        else if(outHubs[i] > inHubs[j]) {
+            j++;
+        }
+        else {
+            long long distance = (long long)outDistances[i++] + inDistances[j++];
+            best = distance < best ? distance : best;
+        }
+    }
+    return (int)best;
+}
+
+/**
+ * Pruned Dijkstra from the hub of a rank, adding it to the labels of the cities it is not pruned at.
+ * Forward it fills the in labels (distance from the hub), backward the out labels (distance to the hub).
+ * @param build the build
+ * @param graph the graph to search: the graph forward, its reverse backward
+ * @param rank the rank of the hub
+ * @param root the city of the hub
+ * @param rootLabel the label of the root already known: its out label forward, in label backward
+ * @param labels the labels to fill: in labels forward, out labels backward
+ * @return ERRALLOC if memory allocation failed
+ * @return OK otherwise
+ */
+static status prunedSearch(LabelBuild *build, Graph *graph, int rank, int root, LabelArray *rootLabel,
+                           LabelArray *labels) {
+    for (int i = 0; i < rootLabel->count; i++) {
+        build->rootDistance[rootLabel->hubs[i]] = rootLabel->distances[i];
+    }
+    build->distances[root] = 0;
+    build->touched[build->touchedCount++] = root;
+    status ret = pushHeap(&build->heap, 0, root);
+
+    HeapEntry entry;
+    while (ret == OK && popHeap(&build->heap, &entry) == OK) {
+        int city = entry.cityId;
+        if(entry.key > build->distances[city]) {
+            continue;
+        }
+        // Pruned when the labels so far give a distance as short through a hub of a lower rank
+        LabelArray *label = &labels[city];
+        int pruned = 0;
+        for (int i = 0; i < label->count && !pruned; i++) {
+            int rootDistance = build->rootDistance[label->hubs[i]];
+            pruned = rootDistance != UNREACHABLE_DISTANCE && (long long)rootDistance + label->distances[i] <= entry.key;
+        }
+        if(pruned) {
+            continue;
+        }
+        if((ret = appendLabel(label, rank, entry.key)) != OK) {
+            break;
+        }
+        for (int edge = graph->edgeStart[city]; edge < graph->edgeStart[city + 1]; edge++) {
+            int next = graph->edgeCity[edge];
+            int distance = entry.key + graph->edgeDistance[edge];
+            if(distance < build->distances[next]) {
+                if(build->distances[next] == UNREACHABLE_DISTANCE) {
+                    build->touched[build->touchedCount++] = next;
+                }
+                build->distances[next] = distance;
+                if((ret = pushHeap(&build->heap, distance, next)) != OK) {
+                    break;
+                }
+            }
+        }
+    }
+
+    // Reset the buffers for the next search
+    clearHeap(&build->heap);
+    for (int i = 0; i < build->touchedCount; i++) {
+        build->distances[build->touched[i]] = UNREACHABLE_DISTANCE;
+    }
+    build->touchedCount = 0;
+    for (int i = 0; i < rootLabel->count; i++) {
+        build->rootDistance[rootLabel->hubs[i]] = UNREACHABLE_DISTANCE;
+    }
+    return ret;
+}
+
+/**
+ * City while ranking: the number of sampled shortest paths through it, its degree and id
+ */
+typedef struct RankedCity {
+    long coverage;
+    int degree;
+    int cityId;
+}RankedCity;
+
+/**
+ * Function to compare two RankedCities on coverage, then degree (highest first), then on id
+ * @param c1 the first city to compare
+ * @param c2 the second city to compare
+ * @return <0 if c1 is ranked before c2
+ * @return 0 if c1 equals c2
+ * @return >0 otherwise
+ */
+static int compCitiesOnCoverage(const void *c1, const void *c2) {
+    const RankedCity *city1 = (const RankedCity*)c1;
+    const RankedCity *city2 = (const RankedCity*)c2;
+    if(city1->coverage != city2->coverage) {
+        return (city1->coverage < city2->coverage) - (city1->coverage > city2->coverage);
+    }
+    if(city1->degree != city2->degree) {
+        return (city1->degree < city2->degree) - (city1->degree > city2->degree);
+    }
+    return (city1->cityId > city2->cityId) - (city1->cityId < city2->cityId);
+}
+
+/**
+ * Add to the coverage of every city the size of its subtree in the shortest path tree of a root
+ * @param graph the graph
+ * @param root the root of the tree
+ * @param cities the cities, coverage is added to
+ * @param buffers room for 3 * cityCount ints
+ * @param heap an empty heap
+ * @return ERRALLOC if memory allocation failed
+ * @return OK otherwise
+ */
+static status addTreeCoverage(Graph *graph, int root, RankedCity *cities, int *buffers, Heap *heap) {
+    int *distances = buffers;
+    int *parents = buffers + graph->cityCount;
+    int *settled = buffers + 2 * graph->cityCount;
+    int settledCount = 0;
+    for (int city = 0; city < graph->cityCount; city++) {
+        distances[city] = UNREACHABLE_DISTANCE;
+        parents[city] = -1;
+    }
+    distances[root] = 0;
+    status ret = pushHeap(heap, 0, root);
+    HeapEntry entry;
+    while (ret == OK && popHeap(heap, &entry) == OK) {
+        if(entry.key > distances[entry.cityId]) {
+            continue;
+        }
+        settled[settledCount++] = entry.cityId;
+        for (int edge = graph->edgeStart[entry.cityId]; edge < graph->edgeStart[entry.cityId + 1]; edge++) {
+            int next = graph->edgeCity[edge];
+            int distance = entry.key + graph->edgeDistance[edge];
+            if(distance < distances[next]) {
+                distances[next] = distance;
+                parents[next] = entry.cityId;
+                if((ret = pushHeap(heap, distance, next)) != OK) {
+                    break;
+                }
+            }
+        }
+    }
+    clearHeap(heap);
+
+    // Subtree sizes, leaves first: the distances buffer is reused for them
+    for (int i = 0; i < settledCount; i++) {
+        distances[settled[i]] = 1;
+    }
+    for (int i = settledCount - 1; i > 0; i--) {
+        int city = settled[i];
+        distances[parents[city]] += distances[city];
+        cities[city].coverage += distances[city];
+    }
+    return ret;
+}
+
+/**
+ * Order the cities on the number of shortest paths through them, in the shortest path trees
+ * of HUB_ORDER_SAMPLES roots: cities covering most shortest paths prune most searches.
+ * Degree breaks the ties.
+ * @param graph the graph
+ * @param reverse the reverse of the graph
+ * @param order (out) the city of every rank
+ * @return ERRALLOC if memory allocation failed
+ * @return OK otherwise
+ */
+static status rankCities(Graph *graph, Graph *reverse, int *order) {
+    int cityCount = graph->cityCount;
+    RankedCity *cities = (RankedCity*)malloc(sizeof(RankedCity) * (cityCount ? cityCount : 1));
+    int *buffers = (int*)malloc(sizeof(int) * 3 * (cityCount ? cityCount : 1));
+    Heap heap;
+    if(!cities || !buffers || initHeap(&heap, cityCount) != OK) {
+        free(cities);
+        free(buffers);
+        return ERRALLOC;
+    }
+    for (int city = 0; city < cityCount; city++) {
+        cities[city].coverage = 0;
+        cities[city].degree = graph->edgeStart[city + 1] - graph->edgeStart[city]
+                              + reverse->edgeStart[city + 1] - reverse->edgeStart[city];
+        cities[city].cityId = city;
+    }
+    status ret = OK;
+    int sampleCount = cityCount < HUB_ORDER_SAMPLES ? cityCount : HUB_ORDER_SAMPLES;
+    for (int sample = 0; ret == OK && sample < sampleCount; sample++) {
+        ret = addTreeCoverage(graph, (int)((long long)sample * cityCount / sampleCount), cities, buffers, &heap);
+    }
+    qsort(cities, cityCount, sizeof(RankedCity), compCitiesOnCoverage);
+    for (int rank = 0; rank < cityCount; rank++) {
+        order[rank] = cities[rank].cityId;
+    }
+    freeHeap(&heap);
+    free(buffers);
+    free(cities);
+    return ret;
+}
+
+/**
+ * Allocate labels, with their arrays for the given amounts of entries
+ * @param cityCount the number of cities
+ * @param outEntries the number of entries of all out labels
+ * @param inEntries the number of entries of all in labels
+ * @param labels Pointer to labels pointer which will be assigned to the labels
+ * @return ERRALLOC if memory allocation failed
+ * @return OK otherwise
+ */
+static status newHubLabels(int cityCount, long outEntries, long inEntries, HubLabels **labels) {
+    HubLabels *newLabels = (HubLabels*)calloc(1, sizeof(HubLabels));
+    if(!(*labels = newLabels)) {
+        return ERRALLOC;
+    }
+    newLabels->cityCount = cityCount;
+    newLabels->hubCity = (int*)malloc(sizeof(int) * (cityCount ? cityCount : 1));
+    newLabels->outStart = (int*)malloc(sizeof(int) * (cityCount + 1));
+    newLabels->inStart = (int*)malloc(sizeof(int) * (cityCount + 1));
+    newLabels->outHub = (int*)malloc(sizeof(int) * (outEntries ? outEntries : 1));
+    newLabels->outDistance = (int*)malloc(sizeof(int) * (outEntries ? outEntries : 1));
+    newLabels->inHub = (int*)malloc(sizeof(int) * (inEntries ? inEntries : 1));
+    newLabels->inDistance = (int*)malloc(sizeof(int) * (inEntries ? inEntries : 1));
+    if(!newLabels->hubCity || !newLabels->outStart || !newLabels->inStart || !newLabels->outHub
+       || !newLabels->outDistance || !newLabels->inHub || !newLabels->inDistance) {
+        destroyHubLabels(newLabels);
+        *labels = 0;
+        return ERRALLOC;
+    }
+    return OK;
+}
+
+/**
+ * Copy growing labels into the contiguous arrays of the labels
+ * @param arrays the growing labels, one per city
+ * @param cityCount the number of cities
+ * @param start (out) the first entry of every city
+ * @param hubs (out) the hubs of all labels
+ * @param distances (out) the distances of all labels
+ */
+static void compactLabels(LabelArray *arrays, int cityCount, int *start, int *hubs, int *distances) {
+    int entry = 0;
+    for (int city = 0; city < cityCount; city++) {
+        start[city] = entry;
+        memcpy(hubs + entry, arrays[city].hubs, sizeof(int) * arrays[city].count);
+        memcpy(distances + entry, arrays[city].distances, sizeof(int) * arrays[city].count);
+        entry += arrays[city].count;
+    }
+    start[cityCount] = entry;
+}
+
+status buildHubLabels(Graph *graph, HubLabels **labels) {
+    *labels = 0;
+    int cityCount = graph->cityCount;
+    LabelBuild build;
+    memset(&build, 0, sizeof(LabelBuild));
+    build.cityCount = cityCount;
+    Graph *reverse = 0;
+    int *order = (int*)malloc(sizeof(int) * (cityCount ? cityCount : 1));
+    build.out = (LabelArray*)calloc(cityCount ? cityCount : 1, sizeof(LabelArray));
+    build.in = (LabelArray*)calloc(cityCount ? cityCount : 1, sizeof(LabelArray));
+    build.rootDistance = (int*)malloc(sizeof(int) * (cityCount ? cityCount : 1));
+    build.distances = (int*)malloc(sizeof(int) * (cityCount ? cityCount : 1));
+    build.touched = (int*)malloc(sizeof(int) * (cityCount ? cityCount : 1));
+    status ret = ERRALLOC;
+    if(order && build.out && build.in && build.rootDistance && build.distances && build.touched
+       && createReverseGraph(graph, &reverse) == OK && initHeap(&build.heap, cityCount) == OK) {
+        ret = OK;
+    }
+
+    if(ret == OK) {
+        for (int city = 0; city < cityCount; city++) {
+            build.rootDistance[city] = UNREACHABLE_DISTANCE;
+            build.distances[city] = UNREACHABLE_DISTANCE;
+        }
+        ret = rankCities(graph, reverse, order);
+
+        // Forward search fills the in labels, backward search the out labels
+        for (int rank = 0; ret == OK && rank < cityCount; rank++) {
+            int root = order[rank];
+            ret = prunedSearch(&build, graph, rank, root, &build.out[root], build.in);
+            if(ret == OK) {
+                ret = prunedSearch(&build, reverse, rank, root, &build.in[root], build.out);
+            }
+        }
+    }
+
+    if(ret == OK) {
+        long outEntries = 0;
+        long inEntries = 0;
+        for (int city = 0; city < cityCount; city++) {
+            outEntries += build.out[city].count;
+            inEntries += build.in[city].count;
+        }
+        if((ret = newHubLabels(cityCount, outEntries, inEntries, labels)) == OK) {
+            memcpy((*labels)->hubCity, order, sizeof(int) * cityCount);
+            compactLabels(build.out, cityCount, (*labels)->outStart, (*labels)->outHub, (*labels)->outDistance);
+            compactLabels(build.in, cityCount, (*labels)->inStart, (*labels)->inHub, (*labels)->inDistance);
+        }
+    }
+
+    for (int city = 0; city < cityCount; city++) {
+        if(build.out) {
+            free(build.out[city].hubs);
+            free(build.out[city].distances);
+        }
+        if(build.in) {
+            free(build.in[city].hubs);
+            free(build.in[city].distances);
+        }
+    }
+    free(build.out);
+    free(build.in);
+    free(build.rootDistance);
+    free(build.distances);
+    free(build.touched);
+    freeHeap(&build.heap);
+    destroyGraph(reverse);
+    free(order);
+    return ret;
+}
+
+int hubDistance(HubLabels *labels, int fromCityId, int toCityId) {
+    int outStart = labels->outStart[fromCityId];
+    int inStart = labels->inStart[toCityId];
+    return mergeLabels(labels->outHub + outStart, labels->outDistance + outStart,
+                       labels->outStart[fromCityId + 1] - outStart,
+                       labels->inHub + inStart, labels->inDistance + inStart,
+                       labels->inStart[toCityId + 1] - inStart);
+}
+
+void hubLabelStats(HubLabels *labels, HubLabelStats *stats) {
+    memset(stats, 0, sizeof(HubLabelStats));
+    for (int city = 0; city < labels->cityCount; city++) {
+        int outSize = labels->outStart[city + 1] - labels->outStart[city];
+        int inSize = labels->inStart[city + 1] - labels->inStart[city];
+        stats->maxOutLabel = outSize > stats->maxOutLabel ? outSize : stats->maxOutLabel;
+        stats->maxInLabel = inSize > stats->maxInLabel ? inSize : stats->maxInLabel;
+    }
+    stats->outEntries = labels->outStart[labels->cityCount];
+    stats->inEntries = labels->inStart[labels->cityCount];
+    stats->averageLabel = labels->cityCount
+                          ? (double)(stats->outEntries + stats->inEntries) / (2.0 * labels->cityCount) : 0.0;
+    stats->bytes = sizeof(HubLabels)
+                   + sizeof(int) * (3 * (size_t)labels->cityCount + 2)
+                   + sizeof(int) * 2 * (size_t)(stats->outEntries + stats->inEntries);
+}
+
+status writeHubLabels(FILE *file, HubLabels *labels) {
+    int cityCount = labels->cityCount;
+    int outEntries = labels->outStart[cityCount];
+    int inEntries = labels->inStart[cityCount];
+    int header[] = {HUB_LABELS_MAGIC, cityCount, outEntries, inEntries};
+    fwrite(header, sizeof(int), 4, file);
+    fwrite(labels->hubCity, sizeof(int), cityCount, file);
+    fwrite(labels->outStart, sizeof(int), cityCount + 1, file);
+    fwrite(labels->outHub, sizeof(int), outEntries, file);
+    fwrite(labels->outDistance, sizeof(int), outEntries, file);
+    fwrite(labels->inStart, sizeof(int), cityCount + 1, file);
+    fwrite(labels->inHub, sizeof(int), inEntries, file);
+    fwrite(labels->inDistance, sizeof(int), inEntries, file);
+    return ferror(file) ? ERRACCESS : OK;
+}
+
+/**
+ * Check that label start offsets are ascending from 0 to the number of entries,
+ * and that all hubs are ranks
+ * @param cityCount the number of cities
+ * @param start the first entry of every city
+ * @param hubs the hubs of all labels
+ * @param entries the number of entries
+ * @return 1 if valid, 0 otherwise
+ */
+static int validLabels(int cityCount, int *start, int *hubs, int entries) {
+    if(start[0] != 0 || start[cityCount] != entries) {
+        return 0;
+    }
+    for (int city = 0; city < cityCount; city++) {
+        if(start[city + 1] < start[city]) {
+            return 0;
+        }
+    }
+    for (int entry = 0; entry < entries; entry++) {
+        if(hubs[entry] < 0 || hubs[entry] >= cityCount) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+status readHubLabels(FILE *file, HubLabels **labels) {
+    *labels = 0;
+    int header[4];
+    if(fread(header, sizeof(int), 4, file) != 4 || header[0] != HUB_LABELS_MAGIC
+       || header[1] < 0 || header[2] < 0 || header[3] < 0) {
+        return ERRACCESS;
+    }
+    int cityCount = header[1];
+    int outEntries = header[2];
+    int inEntries = header[3];
+    status ret = newHubLabels(cityCount, outEntries, inEntries, labels);
+    if(ret != OK) {
+        return ret;
+    }
+    HubLabels *newLabels = *labels;
+    size_t read = fread(newLabels->hubCity, sizeof(int), cityCount, file);
+    read += fread(newLabels->outStart, sizeof(int), cityCount + 1, file);
+    read += fread(newLabels->outHub, sizeof(int), outEntries, file);
+    read += fread(newLabels->outDistance, sizeof(int), outEntries, file);
+    read += fread(newLabels->inStart, sizeof(int), cityCount + 1, file);
+    read += fread(newLabels->inHub, sizeof(int), inEntries, file);
+    read += fread(newLabels->inDistance, sizeof(int), inEntries, file);
+    if(read != (size_t)3 * cityCount + 2 + 2 * (size_t)outEntries + 2 * (size_t)inEntries
+       || !validLabels(cityCount, newLabels->outStart, newLabels->outHub, outEntries)
+       || !validLabels(cityCount, newLabels->inStart, newLabels->inHub, inEntries)) {
+        destroyHubLabels(newLabels);
+        *labels = 0;
+        return ERRACCESS;
+    }
+    return OK;
+}
+
+void destroyHubLabels(HubLabels *labels) {
+    if(!labels) {
+        return;
+    }
+    free(labels->hubCity);
+    free(labels->outStart);
+    free(labels->outHub);
+    free(labels->outDistance);
+    free(labels->inStart);
+    free(labels->inHub);
+    free(labels->inDistance);
+    free(labels);
+}
@@ -0,0 +1,99 @@
+/**
+ * @file HubLabels.h
+ * @brief Hub labeling: exact distance queries between two cities in a merge of two short arrays.
+ *
+ * Every city gets an out label (hubs it reaches, with the distance) and an in label (hubs that
+ * reach it). For every pair a city on a shortest path between them is a hub in both labels, so
+ * distance(from, to) = min over common hubs h of out(from)[h] + in(to)[h].
+ *
+ * The labels are built by pruned landmark labeling: cities are taken in order of decreasing
+ * importance (how many sampled shortest paths pass them), and a forward and a backward
+ * Dijkstra from each city stop at every city whose distance is already answered by the
+ * labels so far. Hubs are stored as their rank in that
+ * order, so every label is sorted on hub without sorting, and the labels of all cities are
+ * stored in contiguous arrays.
+ */
+#ifndef ADVANCED_C_CLASS_HUBLABELS_H
+#define ADVANCED_C_CLASS_HUBLABELS_H
+
+#include <stdio.h>
+#include "Graph.h"
+
+/**
+ * Labels of all cities: the out label of city i is outHub / outDistance [outStart[i] .. outStart[i+1]-1],
+ * the in label likewise. Hubs are ranks, hubCity gives the city of a rank.
+ */
+typedef struct HubLabels {
+    int cityCount;
+    int *hubCity;
+    int *outStart;
+    int *outHub;
+    int *outDistance;
+    int *inStart;
+    int *inHub;
+    int *inDistance;
+}HubLabels;
+
+/**
+ * Size statistics of the labels
+ */
+typedef struct HubLabelStats {
+    long outEntries;
+    long inEntries;
+    int maxOutLabel;
+    int maxInLabel;
+    double averageLabel;    // Average of the out and in label sizes
+    size_t bytes;
+}HubLabelStats;
+
+/**
+ * Build the labels of a graph
+ * @param graph The graph
+ * @param labels Pointer to labels pointer which will be assigned to the new labels
+ * @return ERRALLOC if memory allocation failed
+ * @return OK otherwise
+ */
+status buildHubLabels(Graph *graph, HubLabels **labels);
+
+/**
+ * Shortest distance between two cities, from the labels (O(label size))
+ * @param labels The labels
+ * @param fromCityId The city to start from
+ * @param toCityId The city to go to
+ * @return the distance, UNREACHABLE_DISTANCE if there is no route
+ */
+int hubDistance(HubLabels *labels, int fromCityId, int toCityId);
+
+/**
+ * Get the size statistics of the labels
+ * @param labels The labels
+ * @param stats (out) the statistics
+ */
+void hubLabelStats(HubLabels *labels, HubLabelStats *stats);
+
+/**
+ * Write the labels to a file, as int32 values in native byte order after a magic number
+ * @param file The file to write to, opened in binary mode
+ * @param labels The labels
+ * @return ERRACCESS if writing failed
+ * @return OK otherwise
+ */
+status writeHubLabels(FILE *file, HubLabels *labels);
+
+/**
+ * Read labels written by writeHubLabels()
+ * @param file The file to read from, opened in binary mode
+ * @param labels Pointer to labels pointer which will be assigned to the read labels
+ * @return ERRACCESS if reading failed or the file holds no labels (of this byte order)
+ * @return ERRALLOC if memory allocation failed
+ * @return OK otherwise
+ */
+status readHubLabels(FILE *file, HubLabels **labels);
+
+/**
+ * Clean up labels
+ * @param labels The labels to destroy, may be 0
+ */
+void destroyHubLabels(HubLabels *labels);
+
+#endif //ADVANCED_C_CLASS_HUBLABELS_H
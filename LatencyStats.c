@@ -0,0 +1,203 @@
+/**
+ * @file LatencyStats.c
+ * @brief Per thread latency histograms, merged on demand.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "LatencyStats.h"
+
+/**
+ * A slot of histograms on the list of all slots. Only the thread owning it writes it.
+ * When its thread ends the slot is released with its samples, and the next thread which records
+ * takes it over and adds to them: the list only grows to the most threads recording at once.
+ */
+typedef struct ThreadLatencyStats {
+    LatencyHistogram histograms[LATENCY_METRIC_COUNT];
+    int inUse;                      // Set while a thread owns the slot, only accessed atomically
+    struct ThreadLatencyStats *next;
+}ThreadLatencyStats;
+
+/** Histograms of the calling thread, 0 until it records */
+static __thread ThreadLatencyStats *threadStats;
+/** Histograms of all threads which recorded */
+static ThreadLatencyStats *allThreadStats;
+/** Key with the slot of every recording thread, releasing it when the thread ends */
+static pthread_key_t threadStatsKey;
+static pthread_once_t threadStatsKeyOnce = PTHREAD_ONCE_INIT;
+static int threadStatsKeyCreated;
+
+/** Names of the metrics, for printing */
+static const char *metricNames[LATENCY_METRIC_COUNT] = {
+        "map load (us)",
+        "lookup (us)",
+        "findRoute (us)",
+        "expansions"
+};
+
+uint64_t latencyNow(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+/**
+ * Bucket of a value: the value itself when small, else its leading bit and the next LATENCY_SUB_BUCKET_BITS bits
+ * @param value the value
+ * @return the bucket
+ */
+static int bucketOf(uint64_t value) {
+    if(value < LATENCY_SUB_BUCKETS) {
+        return (int)value;
+    }
+    int exponent = 63 - __builtin_clzll(value);
+    int shift = exponent - LATENCY_SUB_BUCKET_BITS;
+    return (shift + 1) * LATENCY_SUB_BUCKETS + (int)((value >> shift) & (LATENCY_SUB_BUCKETS - 1));
+}
+
+/**
+ * Highest value of a bucket
+ * @param bucket the bucket
+ * @return the value
+ */
+static uint64_t bucketHighest(int bucket) {
+    if(bucket < LATENCY_SUB_BUCKETS) {
+        return (uint64_t)bucket;
+    }
+    int shift = bucket / LATENCY_SUB_BUCKETS - 1;
+    uint64_t lowest = (uint64_t)(LATENCY_SUB_BUCKETS + bucket % LATENCY_SUB_BUCKETS) << shift;
+    return lowest + (((uint64_t)1 << shift) - 1);
+}
+
+/**
+ * Add a value to a histogram with a single writer: the counters are stored atomically,
+ * so mergeLatencyStats() can read them from other threads
+ * @param histogram the histogram of the calling thread
+ * @param value the value
+ */
+static void addSample(LatencyHistogram *histogram, uint64_t value) {
+    uint64_t *bucket = &histogram->buckets[bucketOf(value)];
+    __atomic_store_n(bucket, *bucket + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&histogram->sum, histogram->sum + value, __ATOMIC_RELAXED);
+    if(value > histogram->max) {
+        __atomic_store_n(&histogram->max, value, __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&histogram->count, histogram->count + 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * Destructor of the key: release the slot of an ending thread, its samples stay
+ * @param stats the slot of the thread
+ */
+static void releaseThreadStats(void *stats) {
+    __atomic_store_n(&((ThreadLatencyStats*)stats)->inUse, 0, __ATOMIC_RELEASE);
+}
+
+/**
+ * Create the key releasing the slots, once
+ */
+static void createThreadStatsKey(void) {
+    threadStatsKeyCreated = pthread_key_create(&threadStatsKey, releaseThreadStats) == 0;
+}
+
+/**
+ * Take a released slot for the calling thread, or add a new one to the list of all slots
+ * @return the slot, 0 if memory allocation failed
+ */
+static ThreadLatencyStats *acquireThreadStats(void) {
+    pthread_once(&threadStatsKeyOnce, createThreadStatsKey);
+    ThreadLatencyStats *stats;
+    for (stats = __atomic_load_n(&allThreadStats, __ATOMIC_ACQUIRE); stats; stats = stats->next) {
+        int released = 0;
+        if(__atomic_compare_exchange_n(&stats->inUse, &released, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            break;
+        }
+    }
+    if(!stats) {
+        if(!(stats = (ThreadLatencyStats*)calloc(1, sizeof(ThreadLatencyStats)))) {
+            return 0;
+        }
+        stats->inUse = 1;
+        stats->next = __atomic_load_n(&allThreadStats, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&allThreadStats, &stats->next, stats, 0,
+                                            __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+        }
+    }
+    // Without the key the slot stays with the thread, as before it ends
+    if(threadStatsKeyCreated) {
+        pthread_setspecific(threadStatsKey, stats);
+    }
+    return stats;
+}
+
+void recordLatency(LatencyMetric metric, uint64_t value) {
+    if(!threadStats && !(threadStats = acquireThreadStats())) {
+        return;     // The sample is lost, the statistics are no reason to fail
+    }
+    addSample(&threadStats->histograms[metric], value);
+}
+
+void addToHistogram(LatencyHistogram *histogram, uint64_t value) {
+    addSample(histogram, value);
+}
+
+void mergeLatencyStats(LatencyMetric metric, LatencyHistogram *merged) {
+    memset(merged, 0, sizeof(LatencyHistogram));
+    for (ThreadLatencyStats *stats = __atomic_load_n(&allThreadStats, __ATOMIC_ACQUIRE); stats; stats = stats->next) {
+        LatencyHistogram *histogram = &stats->histograms[metric];
+        for (int bucket = 0; bucket < LATENCY_BUCKET_COUNT; bucket++) {
+            merged->buckets[bucket] += __atomic_load_n(&histogram->buckets[bucket], __ATOMIC_RELAXED);
+        }
+        merged->sum += __atomic_load_n(&histogram->sum, __ATOMIC_RELAXED);
+        uint64_t max = __atomic_load_n(&histogram->max, __ATOMIC_RELAXED);
+        if(max > merged->max) {
+            merged->max = max;
+        }
+    }
+    // Count the buckets read, so the percentiles add up while threads record
+    for (int bucket = 0; bucket < LATENCY_BUCKET_COUNT; bucket++) {
+        merged->count += merged->buckets[bucket];
+    }
+}
+
+int latencyStatsSlotCount(void) {
+    int count = 0;
+    for (ThreadLatencyStats *stats = __atomic_load_n(&allThreadStats, __ATOMIC_ACQUIRE); stats; stats = stats->next) {
+        count++;
+    }
+    return count;
+}
+
+uint64_t histogramPercentile(LatencyHistogram *histogram, double fraction) {
+    if(histogram->count == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)(fraction * histogram->count + 0.5);
+    rank = rank < 1 ? 1 : rank;
+    uint64_t seen = 0;
+    for (int bucket = 0; bucket < LATENCY_BUCKET_COUNT; bucket++) {
+        seen += histogram->buckets[bucket];
+        if(seen >= rank) {
+            uint64_t highest = bucketHighest(bucket);
+            return highest < histogram->max ? highest : histogram->max;
+        }
+    }
+    return histogram->max;
+}
+
+void printLatencyStats(FILE *file) {
+    fprintf(file, "%-16s %10s %10s %10s %10s %10s %10s\n", "", "count", "p50", "p99", "p999", "max", "mean");
+    for (int metric = 0; metric < LATENCY_METRIC_COUNT; metric++) {
+        LatencyHistogram histogram;
+        mergeLatencyStats((LatencyMetric)metric, &histogram);
+        double unit = metric == LatencyMetric_Expansions ? 1.0 : 1000.0;
+        fprintf(file, "%-16s %10llu %10.1f %10.1f %10.1f %10.1f %10.1f\n", metricNames[metric],
+                (unsigned long long)histogram.count,
+                histogramPercentile(&histogram, 0.5) / unit, histogramPercentile(&histogram, 0.99) / unit,
+                histogramPercentile(&histogram, 0.999) / unit, histogram.max / unit,
+                histogram.count ? (double)histogram.sum / histogram.count / unit : 0.0);
+    }
+}
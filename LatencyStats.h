@@ -0,0 +1,94 @@
+/**
+ * @file LatencyStats.h
+ * @brief Latency histograms of map loading, city lookup and route searches, cheap enough to keep on.
+ *
+ * Every thread records in histograms of its own, without locks: a sample is a clock read and an
+ * increment. The histograms of all threads are merged when the statistics are read. When a thread
+ * ends, its histograms are passed on with their samples to the next thread which records, so
+ * threads started over and over (reloads, pool workers) do not add histograms.
+ *
+ * Histograms are HDR style (log-linear): values below LATENCY_SUB_BUCKETS have a bucket each, above
+ * every power of two is split in LATENCY_SUB_BUCKETS buckets, so a percentile is within 1/16 (6%)
+ * of the exact value, over the full 64 bit range, in LATENCY_BUCKET_COUNT counters.
+ */
+#ifndef ADVANCED_C_CLASS_LATENCYSTATS_H
+#define ADVANCED_C_CLASS_LATENCYSTATS_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/** Bits of the value kept below the leading bit: the precision of the histograms */
+#define LATENCY_SUB_BUCKET_BITS (4)
+#define LATENCY_SUB_BUCKETS     (1 << LATENCY_SUB_BUCKET_BITS)
+/** Buckets of a histogram: the exact values, then LATENCY_SUB_BUCKETS per power of two */
+#define LATENCY_BUCKET_COUNT    ((64 - LATENCY_SUB_BUCKET_BITS + 1) * LATENCY_SUB_BUCKETS)
+
+/**
+ * What is measured: latencies in nanoseconds, expansions as a count
+ */
+typedef enum LatencyMetric {
+    LatencyMetric_MapLoad,          // createMap()
+    LatencyMetric_Lookup,           // Finding the cities of a route search by name
+    LatencyMetric_FindRoute,        // A whole route search, lookup included
+    LatencyMetric_Expansions,       // Cities expanded by a route search
+    LATENCY_METRIC_COUNT
+}LatencyMetric;
+
+/**
+ * Histogram of the values of a metric
+ */
+typedef struct LatencyHistogram {
+    uint64_t buckets[LATENCY_BUCKET_COUNT];
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max;
+}LatencyHistogram;
+
+/**
+ * The current time, for latencies
+ * @return the CLOCK_MONOTONIC time in nanoseconds
+ */
+uint64_t latencyNow(void);
+
+/**
+ * Record a value of a metric, in the histograms of the calling thread (lock free)
+ * @param metric The metric
+ * @param value The value: nanoseconds for a latency (see latencyNow())
+ */
+void recordLatency(LatencyMetric metric, uint64_t value);
+
+/**
+ * Add a value to a histogram, not thread safe (see recordLatency())
+ * @param histogram The histogram
+ * @param value The value
+ */
+void addToHistogram(LatencyHistogram *histogram, uint64_t value);
+
+/**
+ * Merge the histograms of all threads for a metric. Samples recorded while merging may be left out.
+ * @param metric The metric
+ * @param merged (out) the merged histogram
+ */
+void mergeLatencyStats(LatencyMetric metric, LatencyHistogram *merged);
+
+/**
+ * Number of histogram slots: at most the number of threads which recorded at the same time
+ * @return the number of slots
+ */
+int latencyStatsSlotCount(void);
+
+/**
+ * Value below which a fraction of the samples of a histogram is
+ * @param histogram The histogram
+ * @param fraction The fraction, 0..1 (0.99 for p99)
+ * @return the highest value of the bucket of the percentile, at most the largest value; 0 without samples
+ */
+uint64_t histogramPercentile(LatencyHistogram *histogram, double fraction);
+
+/**
+ * Print count, p50, p99, p999, maximum and mean of every metric, latencies in microseconds
+ * @param file The file to print to
+ */
+void printLatencyStats(FILE *file);
+
+#endif //ADVANCED_C_CLASS_LATENCYSTATS_H
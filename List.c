@@ -5,32 +5,598 @@
  */
 
 #include "List.h"
+
+/** Maximum number of index levels above the node chain of an ordered list */
+#define SKIP_MAX_LEVEL  (24)
+
+/** Forward link of a skip list level, span is the number of nodes it passes (rank difference) */
+typedef struct SkipLink {
+    struct SkipNode *next;
+    int span;
+} SkipLink;
+
+/** Node of an ordered list: a Node (level 0) followed by the links of its levels above it */
+typedef struct SkipNode {
+    Node node;
+    struct SkipNode *prev;          // Previous node in the chain, the head node for the first one
+    struct SkipNode *bucketNext;    // Next node in the same hash bucket (hashed lists)
+    unsigned int hash;              // Hash of the element (hashed lists)
+    unsigned int sequence;          // Order of adding, orders equal elements: newest first
+    int levelCount;
+    SkipLink links[];       // links[l-1] is level l
+} SkipNode;
+
+/** Index of an ordered list: a head node with links on all levels.
+ * sorted is cleared when addListAt() breaks the order, searches on value are linear from then on.
+ * Hashed lists also keep a hash table of all nodes, chained through bucketNext. */
+typedef struct SkipList {
+    int levelCount;
+    int sorted;
+    unsigned int seed;
+    unsigned int nextSequence;
+    SkipNode *head;
+    hashFun hash;
+    SkipNode **buckets;
+    int bucketCount;
+} SkipList;
+
+/** Initial number of hash buckets, doubled when the list has more elements than buckets */
+#define HASH_INITIAL_BUCKETS    (16)
+
+/**
+ * Size of a node of an ordered list
+ * @param levels the number of levels above the node chain
+ * @return the size in bytes
+ */
+static size_t skipNodeSize(int levels) {
+    return sizeof(SkipNode) + sizeof(SkipLink) * levels;
+}
+
+/**
+ * Give the memory of a node back to the allocator of the list
+ * @param list the list
+ * @param node the node, a SkipNode for ordered lists
+ */
+static void freeNode(List *list, Node *node) {
+    if(list->skip) {
+        freeMemory(list->allocator, node, skipNodeSize(((SkipNode*)node)->levelCount));
+    }
+    else {
+        freeMemory(list->allocator, node, sizeof(Node));
+    }
+}
+
+/**
+ * Next node on a level
+ * @param node the node (or the head)
+ * @param level the level, 0 is the node chain
+ * @return the next node, 0 if none
+ */
+static SkipNode *skipNext(SkipNode *node, int level) {
+    return level ? node->links[level - 1].next : (SkipNode*)node->node.next;
+}
+
+/**
+ * Number of nodes passed by the link on a level
+ * @param node the node (or the head)
+ * @param level the level, 0 is the node chain
+ * @return the span of the link
+ */
+static int skipSpan(SkipNode *node, int level) {
+    return level ? node->links[level - 1].span : 1;
+}
+
+/**
+ * Draw the number of levels of a new node: each level with chance 1/4 (xorshift generator)
+ * @param skip the index of the list
+ * @return the number of levels above the node chain
+ */
+static int skipRandomLevels(SkipList *skip) {
+    int levels = 0;
+    while (levels < SKIP_MAX_LEVEL) {
+        skip->seed ^= skip->seed << 13;
+        skip->seed ^= skip->seed >> 17;
+        skip->seed ^= skip->seed << 5;
+        if(skip->seed & 3) {
+            break;
+        }
+        levels++;
+    }
+    return levels;
+}
+
+static void skipFindRank(List *list, int targetRank, SkipNode **update, int *rankAt);
+
+/**
+ * Find on every level the last node before the insertion point of an element (O(log N)).
+ * The insertion point is before the first element e with addComp(element, e) <= 0.
+ * @param list the ordered list
+ * @param pVoid the element
+ * @param update (out) the last node before the insertion point, per level
+ * @param rankAt (out) the rank of the nodes in update, the head has rank 0
+ */
+static void skipFindValue(List *list, void *pVoid, SkipNode **update, int *rankAt) {
+    SkipNode *node = list->skip->head;
+    int rank = 0;
+    if(!list->skip->sorted) {
+        // Not in order anymore: walk the node chain like addList() does, then find the levels on rank
+        while (skipNext(node, 0) && list->addComp(pVoid, skipNext(node, 0)->node.val) > 0) {
+            node = skipNext(node, 0);
+            rank++;
+        }
+        skipFindRank(list, rank + 1, update, rankAt);
+        return;
+    }
+    for (int level = list->skip->levelCount; level >= 0; level--) {
+        SkipNode *next;
+        while ((next = skipNext(node, level)) && list->addComp(pVoid, next->node.val) > 0) {
+            rank += skipSpan(node, level);
+            node = next;
+        }
+        update[level] = node;
+        rankAt[level] = rank;
+    }
+}
+
+/**
+ * Find on every level the last node before the given rank (O(log N)).
+ * @param list the ordered list
+ * @param targetRank the rank searched, the first element has rank 1
+ * @param update (out) the last node before targetRank, per level
+ * @param rankAt (out) the rank of the nodes in update, the head has rank 0
+ */
+static void skipFindRank(List *list, int targetRank, SkipNode **update, int *rankAt) {
+    SkipNode *node = list->skip->head;
+    int rank = 0;
+    for (int level = list->skip->levelCount; level >= 0; level--) {
+        while (skipNext(node, level) && rank + skipSpan(node, level) < targetRank) {
+            rank += skipSpan(node, level);
+            node = skipNext(node, level);
+        }
+        update[level] = node;
+        rankAt[level] = rank;
+    }
+}
+
+/**
+ * Add a node to the hash table, doubling the table when it has fewer buckets than elements
+ * @param list the hashed list
+ * @param node the node to add
+ * @return ERRALLOC if memory allocation failed
+ * @return OK otherwise
+ */
+static status skipAddToHash(List *list, SkipNode *node) {
+    SkipList *skip = list->skip;
+    if(list->nelts >= skip->bucketCount) {
+        int bucketCount = skip->bucketCount * 2;
+        SkipNode **buckets = (SkipNode**)allocZeroedMemory(list->allocator, bucketCount * sizeof(SkipNode*));
+        if(!buckets) {
+            return ERRALLOC;
+        }
+        for (SkipNode *other = skipNext(skip->head, 0); other; other = skipNext(other, 0)) {
+            SkipNode **bucket = &buckets[other->hash & (unsigned int)(bucketCount - 1)];
+            other->bucketNext = *bucket;
+            *bucket = other;
+        }
+        freeMemory(list->allocator, skip->buckets, skip->bucketCount * sizeof(SkipNode*));
+        skip->buckets = buckets;
+        skip->bucketCount = bucketCount;
+    }
+    node->hash = skip->hash(node->node.val);
+    SkipNode **bucket = &skip->buckets[node->hash & (unsigned int)(skip->bucketCount - 1)];
+    node->bucketNext = *bucket;
+    *bucket = node;
+    return OK;
+}
+
+/**
+ * Remove a node from the hash table
+ * @param list the hashed list
+ * @param node the node to remove
+ */
+static void skipRemoveFromHash(List *list, SkipNode *node) {
+    SkipList *skip = list->skip;
+    SkipNode **link = &skip->buckets[node->hash & (unsigned int)(skip->bucketCount - 1)];
+    while (*link != node) {
+        link = &(*link)->bucketNext;
+    }
+    *link = node->bucketNext;
+}
+
+/**
+ * Tells if a node comes before another one in a sorted list: on addComp, then newest first
+ * @param list the ordered list
+ * @param node1 the first node
+ * @param node2 the second node
+ * @return 1 if node1 is before node2, 0 otherwise
+ */
+static int skipBefore(List *list, SkipNode *node1, SkipNode *node2) {
+    int comp = list->addComp(node1->node.val, node2->node.val);
+    return comp < 0 || (comp == 0 && node1->sequence > node2->sequence);
+}
+
+/**
+ * Find the node equal to an element in the hash table (O(1) expected).
+ * Of equal elements the first one in the list is returned, as long as the list is sorted.
+ * @param list the hashed list
+ * @param pVoid the element
+ * @return the node, 0 if not found
+ */
+static SkipNode *skipHashFind(List *list, void *pVoid) {
+    SkipList *skip = list->skip;
+    unsigned int hash = skip->hash(pVoid);
+    SkipNode *found = 0;
+    for (SkipNode *node = skip->buckets[hash & (unsigned int)(skip->bucketCount - 1)]; node; node = node->bucketNext) {
+        if(node->hash == hash && list->getComp(pVoid, node->node.val) == 0
+           && (!found || (skip->sorted && skipBefore(list, node, found)))) {
+            found = node;
+        }
+    }
+    return found;
+}
+
+/**
+ * Find on every level the last node before a given node of the list (O(log N) when sorted).
+ * @param list the ordered list
+ * @param target the node
+ * @param update (out) the last node before target, per level
+ */
+static void skipFindNode(List *list, SkipNode *target, SkipNode **update) {
+    SkipNode *node = list->skip->head;
+    if(!list->skip->sorted) {
+        // Not in order anymore: find the rank on the node chain
+        int rank = 1;
+        for (node = skipNext(node, 0); node != target; node = skipNext(node, 0)) {
+            rank++;
+        }
+        int rankAt[SKIP_MAX_LEVEL + 1];
+        skipFindRank(list, rank, update, rankAt);
+        return;
+    }
+    for (int level = list->skip->levelCount; level >= 0; level--) {
+        SkipNode *next;
+        while ((next = skipNext(node, level)) && next != target && skipBefore(list, next, target)) {
+            node = next;
+        }
+        update[level] = node;
+    }
+}
+
+/**
+ * Link a new element after the nodes found by skipFindValue or skipFindRank
+ * @param list the ordered list
+ * @param pVoid the element to add
+ * @param update the last node before the insertion point, per level
+ * @param rankAt the rank of the nodes in update
+ * @return ERRALLOC if memory allocation failed
+ * @return OK otherwise
+ */
+static status skipInsert(List *list, void *pVoid, SkipNode **update, int *rankAt) {
+    SkipList *skip = list->skip;
+    int levels = skipRandomLevels(skip);
+    SkipNode *newNode = (SkipNode*)allocMemory(list->allocator, skipNodeSize(levels));
+    if(!newNode) {
+        return ERRALLOC;
+    }
+    newNode->node.val = pVoid;
+    newNode->levelCount = levels;
+    newNode->sequence = skip->nextSequence++;
+    if(skip->hash && skipAddToHash(list, newNode) != OK) {
+        freeNode(list, &newNode->node);
+        return ERRALLOC;
+    }
+
+    // New levels start at the head, spanning the whole list
+    for (int level = skip->levelCount + 1; level <= levels; level++) {
+        update[level] = skip->head;
+        rankAt[level] = 0;
+        skip->head->links[level - 1].next = 0;
+        skip->head->links[level - 1].span = list->nelts;
+    }
+    if(levels > skip->levelCount) {
+        skip->levelCount = levels;
+    }
+
+    // Link on all levels of the node, longer spans over the node on the levels above
+    newNode->node.next = update[0]->node.next;
+    update[0]->node.next = &newNode->node;
+    newNode->prev = update[0];
+    if(newNode->node.next) {
+        ((SkipNode*)newNode->node.next)->prev = newNode;
+    }
+    else {
+        list->tail = &newNode->node;
+    }
+    for (int level = 1; level <= levels; level++) {
+        SkipLink *link = &update[level]->links[level - 1];
+        newNode->links[level - 1].next = link->next;
+        newNode->links[level - 1].span = link->span - (rankAt[0] - rankAt[level]);
+        link->next = newNode;
+        link->span = rankAt[0] - rankAt[level] + 1;
+    }
+    for (int level = levels + 1; level <= skip->levelCount; level++) {
+        update[level]->links[level - 1].span++;
+    }
+
+    ++list->nelts;
+    list->head = skip->head->node.next;
+    return OK;
+}
+
+/**
+ * Unlink and free the node after update[0]
+ * @param list the ordered list
+ * @param update the last node before the node to remove, per level
+ * @return the element of the removed node
+ */
+static void *skipRemove(List *list, SkipNode **update) {
+    SkipList *skip = list->skip;
+    SkipNode *node = skipNext(update[0], 0);
+    for (int level = 1; level <= skip->levelCount; level++) {
+        SkipLink *link = &update[level]->links[level - 1];
+        if(link->next == node) {
+            link->span += node->links[level - 1].span - 1;
+            link->next = node->links[level - 1].next;
+        }
+        else {
+            link->span--;
+        }
+    }
+    update[0]->node.next = node->node.next;
+    if(node->node.next) {
+        ((SkipNode*)node->node.next)->prev = update[0];
+    }
+    else {
+        list->tail = update[0] == skip->head ? 0 : &update[0]->node;
+    }
+    if(skip->hash) {
+        skipRemoveFromHash(list, node);
+    }
+    while (skip->levelCount > 0 && !skip->head->links[skip->levelCount - 1].next) {
+        skip->levelCount--;
+    }
+
+    void *pVoid = node->node.val;
+    freeNode(list, &node->node);
+    --list->nelts;
+    list->head = skip->head->node.next;
+    return pVoid;
+}
+
+/**
+ * Find the first node equal to an element, using the getComp function.
+ * @param list the ordered list
+ * @param pVoid the element
+ * @param update (out) the last node before the found node, per level
+ * @return 1 if found, 0 otherwise
+ */
+static int skipFindEqual(List *list, void *pVoid, SkipNode **update) {
+    int rankAt[SKIP_MAX_LEVEL + 1];
+    SkipNode *node;
+    if(list->skip->hash) {
+        // Hashed: find the node, then its place on the levels
+        if(!(node = skipHashFind(list, pVoid))) {
+            return 0;
+        }
+        skipFindNode(list, node, update);
+        return 1;
+    }
+    if(list->getComp == list->addComp && list->skip->sorted) {
+        // Ordered on the searched key: the first equal is at the insertion point
+        skipFindValue(list, pVoid, update, rankAt);
+        node = skipNext(update[0], 0);
+        return node && list->getComp(pVoid, node->node.val) == 0;
+    }
+
+    // Ordered on another key: search the node chain, then the levels on its rank
+    int rank = 1;
+    for (node = skipNext(list->skip->head, 0); node; node = skipNext(node, 0), rank++) {
+        if(list->getComp(pVoid, node->node.val) == 0) {
+            skipFindRank(list, rank, update, rankAt);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Stable merge sort of a node chain, bottom up: runs of 1, 2, 4... nodes are merged in place (O(N log N))
+ * @param first the first node of the chain, 0 if empty
+ * @param comp the comparison function
+ * @param last (out) the last node of the sorted chain, 0 if empty
+ * @return the first node of the sorted chain
+ */
+static Node *sortNodes(Node *first, compFun comp, Node **last) {
+    *last = 0;
+    for (int runSize = 1; first; runSize *= 2) {
+        Node *remaining = first;
+        Node *sortedLast = 0;
+        int merges = 0;
+        first = 0;
+        while (remaining) {
+            // Merge the next two runs, the left one first on equal elements
+            Node *left = remaining;
+            Node *right = remaining;
+            int leftSize = 0;
+            int rightSize = runSize;
+            while (leftSize < runSize && right) {
+                right = right->next;
+                leftSize++;
+            }
+            while (leftSize > 0 || (rightSize > 0 && right)) {
+                Node *next;
+                if(leftSize == 0 || (rightSize > 0 && right && comp(right->val, left->val) < 0)) {
+                    next = right;
+                    right = right->next;
+                    rightSize--;
+                }
+                else {
+                    next = left;
+                    left = left->next;
+                    leftSize--;
+                }
+                if(sortedLast) {
+                    sortedLast->next = next;
+                }
+                else {
+                    first = next;
+                }
+                sortedLast = next;
+            }
+            remaining = right;
+            merges++;
+        }
+        sortedLast->next = 0;
+        if(merges == 1) {
+            *last = sortedLast;
+            break;
+        }
+    }
+    return first;
+}
+
+/**
+ * Rebuild the index of an ordered list after its node chain was relinked (O(N)):
+ * prev pointers, links and spans of every level, and sequences so equal elements keep their place
+ * @param list the ordered list, head is the first node of the chain
+ * @param sorted non zero if the chain is in order of addComp
+ */
+static void skipRebuild(List *list, int sorted) {
+    SkipList *skip = list->skip;
+    SkipNode *last[SKIP_MAX_LEVEL + 1];
+    int lastRank[SKIP_MAX_LEVEL + 1];
+    for (int level = 1; level <= skip->levelCount; level++) {
+        last[level] = skip->head;
+        lastRank[level] = 0;
+    }
+    skip->head->node.next = list->head;
+    SkipNode *prev = skip->head;
+    int rank = 1;
+    for (SkipNode *node = skipNext(skip->head, 0); node; node = skipNext(node, 0), rank++) {
+        node->prev = prev;
+        node->sequence = (unsigned int)(list->nelts - rank);    // Earlier first among equals
+        for (int level = 1; level <= node->levelCount; level++) {
+            last[level]->links[level - 1].next = node;
+            last[level]->links[level - 1].span = rank - lastRank[level];
+            last[level] = node;
+            lastRank[level] = rank;
+        }
+        prev = node;
+    }
+    for (int level = 1; level <= skip->levelCount; level++) {
+        last[level]->links[level - 1].next = 0;
+        last[level]->links[level - 1].span = list->nelts - lastRank[level];
+    }
+    skip->nextSequence = (unsigned int)list->nelts;
+    skip->sorted = sorted;
+}
+
 List *newList(compFun getCompfun, compFun addCompFun, prFun fun1) {
+    return newListWithAllocator(ListKind_Linked, getCompfun, addCompFun, fun1, 0, 0);
+}
+
+List *newOrderedList(compFun getCompfun, compFun addCompFun, prFun fun1) {
+    return newListWithAllocator(ListKind_Ordered, getCompfun, addCompFun, fun1, 0, 0);
+}
+
+List *newHashedList(compFun getCompfun, compFun addCompFun, prFun fun1, hashFun hash) {
+    return newListWithAllocator(ListKind_Hashed, getCompfun, addCompFun, fun1, hash, 0);
+}
+
+List *newListWithAllocator(ListKind kind, compFun getCompfun, compFun addCompFun, prFun fun1, hashFun hash,
+                           Allocator *allocator) {
     // Allocate the memory, set the functions for printing and comparing
-    List* newList = (List*)malloc(sizeof(List));
-    if(newList)
-    {
-        newList->getComp = getCompfun;
-        newList->addComp = addCompFun;
-        newList->pr = fun1;
-        newList->head = 0;
-        newList->nelts = 0;
+    List* newList = (List*)allocMemory(allocator, sizeof(List));
+    if(!newList) {
+        return 0;
+    }
+    newList->getComp = getCompfun;
+    newList->addComp = addCompFun;
+    newList->pr = fun1;
+    newList->head = 0;
+    newList->tail = 0;
+    newList->nelts = 0;
+    newList->skip = 0;
+    newList->allocator = allocator;
+    if(kind == ListKind_Linked) {
+        return newList;
     }
+
+    // The head node has links on all levels
+    SkipList *skip = (SkipList*)allocZeroedMemory(allocator, sizeof(SkipList));
+    SkipNode *head = (SkipNode*)allocZeroedMemory(allocator, skipNodeSize(SKIP_MAX_LEVEL));
+    SkipNode **buckets = 0;
+    if(kind == ListKind_Hashed) {
+        buckets = (SkipNode**)allocZeroedMemory(allocator, HASH_INITIAL_BUCKETS * sizeof(SkipNode*));
+    }
+    if(!skip || !head || (kind == ListKind_Hashed && !buckets)) {
+        freeMemory(allocator, buckets, HASH_INITIAL_BUCKETS * sizeof(SkipNode*));
+        freeMemory(allocator, head, skipNodeSize(SKIP_MAX_LEVEL));
+        freeMemory(allocator, skip, sizeof(SkipList));
+        freeMemory(allocator, newList, sizeof(List));
+        return 0;
+    }
+    head->levelCount = SKIP_MAX_LEVEL;
+    skip->head = head;
+    skip->levelCount = 0;
+    skip->sorted = 1;
+    skip->seed = 2463534242u;
+    skip->nextSequence = 0;
+    if(kind == ListKind_Hashed) {
+        skip->hash = hash;
+        skip->buckets = buckets;
+        skip->bucketCount = HASH_INITIAL_BUCKETS;
+    }
+    newList->skip = skip;
     return newList;
 }
 
+List *newListFromArray(ListKind kind, compFun getCompfun, compFun addCompFun, prFun fun1, hashFun hash,
+                       Allocator *allocator, void **elements, int count) {
+    List *list = newListWithAllocator(kind, getCompfun, addCompFun, fun1, hash, allocator);
+    if(!list) {
+        return 0;
+    }
+    for (int i = 0; i < count; i++) {
+        if(appendList(list, elements[i]) != OK) {
+            delList(list);
+            return 0;
+        }
+    }
+    if(addCompFun) {
+        sortList(list, addCompFun);
+    }
+    return list;
+}
+
 void delList(List *list) {
     // Remove the nodes from the list
     while (list->head) {
         Node* nodeTmp = list->head->next;
-        free(list->head);
+        freeNode(list, list->head);
         list->head = nodeTmp;
     }
     // Cleanup the final list
-    free(list);
+    if(list->skip) {
+        freeMemory(list->allocator, list->skip->buckets, list->skip->bucketCount * sizeof(SkipNode*));
+        freeMemory(list->allocator, list->skip->head, skipNodeSize(SKIP_MAX_LEVEL));
+        freeMemory(list->allocator, list->skip, sizeof(SkipList));
+    }
+    freeMemory(list->allocator, list, sizeof(List));
 }
 
 status nthInList(List *list, int i, void **pVoid) {
+    if(list->skip) {
+        if(i < 0 || i >= list->nelts) {
+            return ERRINDEX;
+        }
+        SkipNode *update[SKIP_MAX_LEVEL + 1];
+        int rankAt[SKIP_MAX_LEVEL + 1];
+        skipFindRank(list, i + 1, update, rankAt);
+        *pVoid = skipNext(update[0], 0)->node.val;
+        return OK;
+    }
+
     Node *node = list->head;
     for (int pos = 0; pos < i && node; ++pos) {
         node = node->next;
@@ -49,9 +615,15 @@ status addList(List *list, void *pVoid) {
     if(!list->addComp) {
         return ERRUNABLE;
     }
+    if(list->skip) {
+        SkipNode *update[SKIP_MAX_LEVEL + 1];
+        int rankAt[SKIP_MAX_LEVEL + 1];
+        skipFindValue(list, pVoid, update, rankAt);
+        return skipInsert(list, pVoid, update, rankAt);
+    }
 
     // Create the new node
-    Node* newNode = (Node*)malloc( sizeof(Node) );
+    Node* newNode = (Node*)allocMemory(list->allocator, sizeof(Node));
     if(!newNode) {
         return ERRALLOC;
     }
@@ -62,6 +634,7 @@ status addList(List *list, void *pVoid) {
     // Add in the list where applicable
     if(!list->head) {
         list->head = newNode;
+        list->tail = newNode;
     }
     else {
         // Compare head
@@ -84,12 +657,72 @@ status addList(List *list, void *pVoid) {
         }
         //Append as last
         node->next = newNode;
+        list->tail = newNode;
+    }
+    return OK;
+}
+status appendList(List *list, void *pVoid) {
+    if(list->skip) {
+        SkipNode *update[SKIP_MAX_LEVEL + 1];
+        int rankAt[SKIP_MAX_LEVEL + 1];
+        skipFindRank(list, list->nelts + 1, update, rankAt);
+
+        // After its equals breaks the order too: a new element goes before them
+        if(update[0] != list->skip->head && (!list->addComp || list->addComp(update[0]->node.val, pVoid) >= 0)) {
+            list->skip->sorted = 0;
+        }
+        return skipInsert(list, pVoid, update, rankAt);
+    }
+
+    Node* newNode = (Node*)allocMemory(list->allocator, sizeof(Node));
+    if(!newNode) {
+        return ERRALLOC;
+    }
+    newNode->val = pVoid;
+    newNode->next = 0;
+    if(list->tail) {
+        list->tail->next = newNode;
+    }
+    else {
+        list->head = newNode;
+    }
+    list->tail = newNode;
+    ++list->nelts;
+    return OK;
+}
+
+status sortList(List *list, compFun comp) {
+    if(!comp) {
+        return ERRUNABLE;
+    }
+    list->head = sortNodes(list->head, comp, &list->tail);
+    if(list->skip) {
+        skipRebuild(list, comp == list->addComp);
     }
     return OK;
 }
+
 status addListAt(List *list, int i, void *pVoid) {
+    if(list->skip) {
+        // Same bounds as below: at the head, or before an existing element
+        if(i < 0 || (i > 0 && i >= list->nelts)) {
+            return ERRINDEX;
+        }
+        SkipNode *update[SKIP_MAX_LEVEL + 1];
+        int rankAt[SKIP_MAX_LEVEL + 1];
+        skipFindRank(list, i + 1, update, rankAt);
+
+        // Check if the element still fits in the order between its neighbours (before its equals)
+        SkipNode *next = skipNext(update[0], 0);
+        if((update[0] != list->skip->head && list->addComp(update[0]->node.val, pVoid) >= 0)
+           || (next && list->addComp(pVoid, next->node.val) > 0)) {
+            list->skip->sorted = 0;
+        }
+        return skipInsert(list, pVoid, update, rankAt);
+    }
+
     // Create the new node, add value if succeeded.
-    Node* newNode = (Node*)malloc(sizeof(Node));
+    Node* newNode = (Node*)allocMemory(list->allocator, sizeof(Node));
     if(!newNode) {
         return ERRALLOC;
     }
@@ -99,6 +732,9 @@ status addListAt(List *list, int i, void *pVoid) {
     if(i==0) {
         newNode->next = list->head;
         list->head = newNode;
+        if(!newNode->next) {
+            list->tail = newNode;
+        }
     }
     else {
         // Iterate through the list of nodes, up to given element
@@ -114,6 +750,7 @@ status addListAt(List *list, int i, void *pVoid) {
         }
         else {
             // Node not found
+            freeNode(list, newNode);
             return ERRINDEX;
         }
     }
@@ -122,6 +759,17 @@ status addListAt(List *list, int i, void *pVoid) {
 }
 
 status remFromListAt(List *list, int i, void **pVoid) {
+    if(list->skip) {
+        if(i < 0 || i >= list->nelts) {
+            return ERRINDEX;
+        }
+        SkipNode *update[SKIP_MAX_LEVEL + 1];
+        int rankAt[SKIP_MAX_LEVEL + 1];
+        skipFindRank(list, i + 1, update, rankAt);
+        *pVoid = skipRemove(list, update);
+        return OK;
+    }
+
     // Remove head if index is 0
     if(i==0){
         if(!list->head) {
@@ -131,8 +779,11 @@ status remFromListAt(List *list, int i, void **pVoid) {
         *pVoid = list->head->val;
         // Free node, and point to the next node
         Node *tmpNode = list->head->next;
-        free(list->head);
+        freeNode(list, list->head);
         list->head = tmpNode;
+        if(!tmpNode) {
+            list->tail = 0;
+        }
     }
     else {
         // Otherwise iterate up to one place before the requested node position
@@ -146,8 +797,11 @@ status remFromListAt(List *list, int i, void **pVoid) {
             *pVoid = node->next->val;
             // Free node, and point to the next node
             Node* tmpNode = node->next->next;
-            free(node->next);
+            freeNode(list, node->next);
             node->next = tmpNode;
+            if(!tmpNode) {
+                list->tail = node;
+            }
         }
         else {
             return ERRINDEX;
@@ -161,12 +815,27 @@ status remFromList(List *list, void *pVoid) {
     // Test if comparable function is available
     if(!list->getComp)
         return ERRUNABLE;
+    if(!list->head)
+        return ERRABSENT;
+
+    if(list->skip) {
+        SkipNode *update[SKIP_MAX_LEVEL + 1];
+        if(!skipFindEqual(list, pVoid, update)) {
+            return ERRABSENT;
+        }
+        skipRemove(list, update);
+        return OK;
+    }
 
     // Compare with head, free if it is the node.
     if(list->getComp(pVoid, list->head->val) == 0 ) {
         Node* tmpNode = list->head->next;
-        free(list->head);
+        freeNode(list, list->head);
         list->head = tmpNode;
+        if(!tmpNode) {
+            list->tail = 0;
+        }
+        --list->nelts;
         return OK;
     }
     else {
@@ -176,8 +845,11 @@ status remFromList(List *list, void *pVoid) {
         {
             if(list->getComp(pVoid, node->next->val) == 0 ) {
                 Node* tmpNode = node->next->next;
-                free(node->next);
+                freeNode(list, node->next);
                 node->next = tmpNode;
+                if(!tmpNode) {
+                    list->tail = node;
+                }
                 --list->nelts;
                 return OK;
             }
@@ -206,12 +878,8 @@ void forEach(List *list, void (*pFunction)(void *)) {
 }
 
 int lengthList(List *list) {
-    int length = 0;
-    // Iterate through the nodes
-    for (Node* node = list->head; node; node = node->next) {
-        length++;
-    }
-    return length;
+    // Every List function keeps the counter
+    return list->nelts;
 }
 
 
@@ -221,6 +889,21 @@ Node *isInList(List *list, void *pVoid) {
         // Not found
         return 0;
     }
+    if(list->skip && list->skip->hash) {
+        // The predecessor is kept in the node
+        SkipNode *found = skipHashFind(list, pVoid);
+        if(!found) {
+            return 0;
+        }
+        return found->prev == list->skip->head ? (Node*)1 : &found->prev->node;
+    }
+    if(list->skip) {
+        SkipNode *update[SKIP_MAX_LEVEL + 1];
+        if(!skipFindEqual(list, pVoid, update)) {
+            return 0;
+        }
+        return update[0] == list->skip->head ? (Node*)1 : &update[0]->node;
+    }
 
     // element is at the head of the list
     if(list->getComp(pVoid, node->val) == 0 ) {
@@ -238,6 +921,10 @@ Node *isInList(List *list, void *pVoid) {
     return 0;
 }
 Node *isInListComp(List *list, void *pVoid, compFun compareFun) {
+    if(compareFun == list->getComp) {
+        // The skip list and the hash table of the list find the element
+        return isInList(list, pVoid);
+    }
     Node *node = list->head;
     if(!node) {
         // Not found
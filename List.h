@@ -12,6 +12,7 @@
 
 #include <stdlib.h>
 #include "status.h"
+#include "Allocator.h"
 
 /** Typical simple link structure: a Node is a "value / next" pair
  * @param val pointer to resource
@@ -28,18 +29,37 @@ typedef struct Node {
  */
 typedef int (*compFun)   (void* e1, void* e2);
 
+/** Hash function for list elements.
+ * Must be consistent with the getComp function: equal elements have equal hashes.
+ */
+typedef unsigned int (*hashFun)   (void* e);
+
 /** Display function for list elements */
 typedef void(*prFun)   (void*);
 
-/** The list embeds a counter for its size and the two function pointers */
+/** Index levels of an ordered list (see newOrderedList), private to List.c */
+struct SkipList;
+
+/** The list embeds a counter for its size and the two function pointers.
+ * The List functions keep the tail: nodes must not be linked or unlinked outside List.c. */
 typedef struct List {
     int nelts;
     Node * head;
+    Node * tail;                // Last node, 0 when empty
     compFun getComp;
     compFun addComp;
     prFun pr;
+    struct SkipList *skip;
+    Allocator *allocator;
 } List;
 
+/** How the nodes of a list are indexed, see newList(), newOrderedList() and newHashedList() */
+typedef enum ListKind {
+    ListKind_Linked,
+    ListKind_Ordered,
+    ListKind_Hashed
+} ListKind;
+
 
 /** Empty List creation by dynamic memory allocation (O(1)).
  * @param getComp comparison function between elements (ala strcmp())
@@ -50,11 +70,73 @@ typedef struct List {
  */
 List*	newList	(compFun getCompfun, compFun addCompFun, prFun fun1);
 
+/** Empty ordered List creation (O(1)).
+ * Same contract as newList(), but the nodes are also linked in a skip list: addList(),
+ * nthInList(), addListAt() and remFromListAt() take O(log N).
+ * remFromList() and isInList() take O(log N) when getCompfun is the same function as
+ * addCompFun (the list is ordered on the searched key), O(N) otherwise.
+ * Equal elements keep the order of addList(): a new element goes before its equals.
+ * An addListAt() which breaks the order makes the searches on value O(N), as for newList().
+ * The head / next chain is the same as for a list of newList(): forEach() and walking
+ * the nodes work unchanged, but nodes must not be linked or unlinked outside List.c.
+ * @param getCompfun comparison function between elements (ala strcmp())
+ * @param addCompFun comparison function between elements when adding (ala strcmp())
+ * @param fun1 display function for list elements
+ * @return a new (empty) list if memory allocation OK
+ * @return 0 otherwise
+ */
+List*	newOrderedList	(compFun getCompfun, compFun addCompFun, prFun fun1);
+
+/** Empty hashed List creation (O(1)).
+ * An ordered list (see newOrderedList()) which also keeps a hash table of its nodes:
+ * isInList() takes O(1) expected, remFromList() O(1) expected to find the element and
+ * O(log N) to unlink it, whatever the getComp and addComp functions.
+ * Of equal elements, the first one in the list is found (as long as addListAt() kept the order).
+ * @param getCompfun comparison function between elements (ala strcmp())
+ * @param addCompFun comparison function between elements when adding (ala strcmp())
+ * @param fun1 display function for list elements
+ * @param hash hash function for list elements, consistent with getCompfun
+ * @return a new (empty) list if memory allocation OK
+ * @return 0 otherwise
+ */
+List*	newHashedList	(compFun getCompfun, compFun addCompFun, prFun fun1, hashFun hash);
+
+/** Empty List creation with the memory of the list and its nodes from an allocator (O(1)).
+ * Lists in an arena need no delList() when the arena is reset.
+ * @param kind the kind of list: as newList(), newOrderedList() or newHashedList()
+ * @param getCompfun comparison function between elements (ala strcmp())
+ * @param addCompFun comparison function between elements when adding (ala strcmp())
+ * @param fun1 display function for list elements
+ * @param hash hash function for list elements (ListKind_Hashed only, 0 otherwise)
+ * @param allocator the allocator of the memory, 0 for malloc
+ * @return a new (empty) list if memory allocation OK
+ * @return 0 otherwise
+ */
+List*	newListWithAllocator	(ListKind kind, compFun getCompfun, compFun addCompFun, prFun fun1, hashFun hash,
+                                 Allocator *allocator);
+
+/** List creation from an array of elements (O(N log N)).
+ * The elements are appended then sorted once with sortList() on addCompFun, instead of N addList()
+ * of O(N) each. Equal elements keep their order in the array (addList() would reverse them).
+ * @param kind the kind of list: as newList(), newOrderedList() or newHashedList()
+ * @param getCompfun comparison function between elements (ala strcmp())
+ * @param addCompFun comparison function between elements when adding (ala strcmp()), 0 to keep the array order
+ * @param fun1 display function for list elements
+ * @param hash hash function for list elements (ListKind_Hashed only, 0 otherwise)
+ * @param allocator the allocator of the memory, 0 for malloc
+ * @param elements the elements
+ * @param count the number of elements
+ * @return a new list if memory allocation OK
+ * @return 0 otherwise
+ */
+List*	newListFromArray	(ListKind kind, compFun getCompfun, compFun addCompFun, prFun fun1, hashFun hash,
+                             Allocator *allocator, void **elements, int count);
+
 /** destroy the list by deallocating used memory (O(N)).
  * @param l the list to destroy */
 void 	delList	(List*);
 
-/** get the Nth element of the list (O(N)).
+/** get the Nth element of the list (O(N), O(log N) on an ordered or hashed list).
  * @param l the list
  * @param n the index of the element in list
  * @param e (out) the searched element
@@ -63,7 +145,7 @@ void 	delList	(List*);
  */
 status 	nthInList	(List*,int,void**);
 
-/** add given element to given list according to compFun function (O(N)).
+/** add given element to given list according to compFun function (O(N), O(log N) on an ordered or hashed list).
  * @param l the list (supposedly sorted according to compFun function)
  * @param e the element to add
  * @return ERRALLOC if memory allocation failed
@@ -72,7 +154,28 @@ status 	nthInList	(List*,int,void**);
  */
 status	addList	(List*,void*);
 
-/** Insert element at a given position in the list (O(N)).
+/** add given element at the end of the list, whatever its order (O(1), O(log N) for an ordered list).
+ * To fill a list with many elements: append them all, then sortList() once.
+ * On an ordered list, an element which does not fit at the end breaks the order as addListAt() does,
+ * until the list is sorted again.
+ * @param l the list
+ * @param e the element to add
+ * @return ERRALLOC if memory allocation failed
+ * @return OK otherwise
+ */
+status	appendList	(List*,void*);
+
+/** sort the list according to given compFun function (O(N log N)).
+ * Stable merge sort of the nodes in place: equal elements keep their order, no memory is allocated.
+ * An ordered list sorted on its addComp function is in order again, and searches on value take O(log N).
+ * @param l the list
+ * @param comp the comparison function (ala strcmp())
+ * @return ERRUNABLE if no comparison function has been provided
+ * @return OK otherwise
+ */
+status	sortList	(List*,compFun);
+
+/** Insert element at a given position in the list (O(N), O(log N) on an ordered or hashed list).
  * @param l the list to store the element in
  * @param p the position of the insertion point
  * @param e the element to insert
@@ -82,7 +185,7 @@ status	addList	(List*,void*);
  */
 status 	addListAt	(List*,int,void*);
 
-/** remove the element located at a given position in list (O(N)).
+/** remove the element located at a given position in list (O(N), O(log N) on an ordered or hashed list).
  * @param l the list to remove the element from
  * @param p the position of the element to remove
  * @param e (out) the removed element
@@ -91,7 +194,8 @@ status 	addListAt	(List*,int,void*);
  */
 status 	remFromListAt	(List*,int,void**);
 
-/** remove given element from given list (O(N)).
+/** remove given element from given list (O(N), O(log N) on an ordered list whose getComp is its addComp,
+ * O(1) expected to find it and O(log N) to unlink it on a hashed list).
  * implies the user has given a comparison function.
  * @param l the list to remove the element from
  * @param e the element to remove
@@ -121,7 +225,8 @@ void	forEach		(List*,void(*)(void*));
  */
 int	lengthList	(List*);
 
-/** tests whether the list contains given element (O(N)).
+/** tests whether the list contains given element (O(N), O(log N) on an ordered list whose getComp is its addComp,
+ * O(1) expected on a hashed list).
  * @param l the list
  * @param e the searched element
  * @return 0 if element is not found in list
@@ -130,7 +235,8 @@ int	lengthList	(List*);
  */
 Node*	isInList	(List*,void*);
 
-/** tests whether the list contains given element, using a custom compare (O(N)).
+/** tests whether the list contains given element, using a custom compare (O(N), as isInList() when
+ * compareFun is the getComp function of the list: the indexes only know that function).
  * @param list the list
  * @param pVoid the searched element
  * @param compareFun the function to compare elements
@@ -0,0 +1,424 @@
+/**
+ * @file ListBenchmark.c
+ * @brief Benchmark of the generic List against the typed lists of MapLists.h.
+ *
+ * Four workloads, each run on a generic List (newList, and newHashedList or newOrderedList) and on the typed list:
+ *  - open: add in order of f, test membership on id, pop the first until empty (the OPEN list)
+ *  - cities: add City pointers in order of id, test membership (a List, an ordered List and a CityList)
+ *  - neighbours: add in order of city id, test membership (Neighbour* in a List, by value typed)
+ *  - names: add in strcmp order, test membership; also built at once by newListFromArray()
+ *  - name build: only the building of the names list, one by one and at once
+ * The typed city, neighbour and name lists search with findCityList() / findNeighbourList() / findNameList(),
+ * binary searches as they are ordered on the searched key: the generic List cannot know that.
+ * The order of the popped or listed elements is checked to be the same.
+ * Usage: listBenchmark [element count, Default=4000]
+ */
+
+#include <stdio.h>
+#include <time.h>
+#include "MapLists.h"
+
+/** Number of membership tests per workload, relative to the element count */
+#define LOOKUPS_PER_ELEMENT     (4)
+
+/**
+ * Element of the OPEN list workload: a city id and its f, as the search nodes of findRoute()
+ */
+typedef struct OpenEntry {
+    int id;
+    int f;
+}OpenEntry;
+
+#define OPEN_COMPARE_F(entry1, entry2)      ((entry1)->f - (entry2)->f)
+#define OPEN_EQUAL_ID(entry1, entry2)       ((entry1)->id == (entry2)->id)
+
+DEFINE_TYPED_LIST(OpenList, OpenEntry*, OPEN_COMPARE_F, OPEN_EQUAL_ID)
+
+/**
+ * Generic compares and hash of the workloads, the same as those of the typed lists
+ */
+static int compOpenF(void *s1, void *s2) {
+    return OPEN_COMPARE_F((OpenEntry*)s1, (OpenEntry*)s2);
+}
+
+static int compOpenId(void *s1, void *s2) {
+    return (((OpenEntry*)s1)->id > ((OpenEntry*)s2)->id) - (((OpenEntry*)s1)->id < ((OpenEntry*)s2)->id);
+}
+
+static unsigned int hashOpenId(void *entry) {
+    return (unsigned int)((OpenEntry*)entry)->id * 2654435761u;
+}
+
+static int compCityId(void *s1, void *s2) {
+    return CITY_COMPARE_ID((City*)s1, (City*)s2);
+}
+
+static int compNeighbourId(void *s1, void *s2) {
+    return NEIGHBOUR_COMPARE_ID(*(Neighbour*)s1, *(Neighbour*)s2);
+}
+
+static int compName(void *s1, void *s2) {
+    return strcmp((char*)s1, (char*)s2);
+}
+
+/**
+ * Pseudo random numbers (xorshift), the same sequence for every container
+ * @param seed the state
+ * @return the next number
+ */
+static unsigned int nextRandom(unsigned int *seed) {
+    *seed ^= *seed << 13;
+    *seed ^= *seed >> 17;
+    *seed ^= *seed << 5;
+    return *seed;
+}
+
+/**
+ * Milliseconds of processor time since a start
+ * @param start the start, from clock()
+ * @return the milliseconds
+ */
+static double elapsed(clock_t start) {
+    return (double)(clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+}
+
+/**
+ * OPEN list workload on a generic list
+ * @param list the empty list, ordered on f and searched on id, deleted afterwards
+ * @param entries the entries to add
+ * @param count the number of entries
+ * @param order (out) the ids in order of popping
+ * @return the number of entries found by the membership tests
+ */
+static int openOnList(List *list, OpenEntry *entries, int count, int *order) {
+    int found = 0;
+    unsigned int seed = 7;
+    for (int i = 0; i < count; i++) {
+        addList(list, &entries[i]);
+    }
+    for (int i = 0; i < count * LOOKUPS_PER_ELEMENT; i++) {
+        found += isInList(list, &entries[nextRandom(&seed) % count]) != 0;
+    }
+    for (int i = 0; i < count; i++) {
+        OpenEntry *entry;
+        // A missing element fails the order check
+        order[i] = remFromListAt(list, 0, (void**)&entry) == OK ? entry->id : -1;
+    }
+    delList(list);
+    return found;
+}
+
+/**
+ * OPEN list workload on a typed list
+ * @param list the empty list
+ * @param entries the entries to add
+ * @param count the number of entries
+ * @param order (out) the ids in order of popping
+ * @return the number of entries found by the membership tests
+ */
+static int openOnTypedList(OpenList *list, OpenEntry *entries, int count, int *order) {
+    int found = 0;
+    unsigned int seed = 7;
+    for (int i = 0; i < count; i++) {
+        addOpenList(list, &entries[i]);
+    }
+    for (int i = 0; i < count * LOOKUPS_PER_ELEMENT; i++) {
+        found += isInOpenList(list, &entries[nextRandom(&seed) % count]) >= 0;
+    }
+    for (int i = 0; i < count; i++) {
+        OpenEntry *entry;
+        // A missing element fails the order check
+        order[i] = remFromOpenListAt(list, 0, &entry) == OK ? entry->id : -1;
+    }
+    return found;
+}
+
+/**
+ * Cities workload on a generic list
+ * @param list the empty list, ordered on city id
+ * @param cities the cities to add, in random order
+ * @param count the number of cities
+ * @param order (out) the city ids in list order
+ * @return the number of cities found by the membership tests
+ */
+static int citiesOnList(List *list, City **cities, int count, int *order) {
+    int found = 0;
+    unsigned int seed = 17;
+    for (int i = 0; i < count; i++) {
+        addList(list, cities[i]);
+    }
+    for (int i = 0; i < count * LOOKUPS_PER_ELEMENT; i++) {
+        found += isInList(list, cities[nextRandom(&seed) % count]) != 0;
+    }
+    int i = 0;
+    for (Node *node = list->head; node; node = node->next) {
+        order[i++] = ((City*)node->val)->id;
+    }
+    delList(list);
+    return found;
+}
+
+/**
+ * Cities workload on a typed list
+ * @param cities the cities to add, in random order
+ * @param count the number of cities
+ * @param order (out) the city ids in list order
+ * @return the number of cities found by the membership tests
+ */
+static int citiesOnTypedList(City **cities, int count, int *order) {
+    CityList list;
+    initCityList(&list, 0);
+    int found = 0;
+    unsigned int seed = 17;
+    for (int i = 0; i < count; i++) {
+        addCityList(&list, cities[i]);
+    }
+    for (int i = 0; i < count * LOOKUPS_PER_ELEMENT; i++) {
+        found += findCityList(&list, cities[nextRandom(&seed) % count]) >= 0;
+    }
+    for (int i = 0; i < count; i++) {
+        order[i] = list.items[i]->id;
+    }
+    freeCityList(&list);
+    return found;
+}
+
+/**
+ * Neighbours workload on a generic list: every Neighbour allocated on its own
+ * @param neighbours the neighbours to add
+ * @param count the number of neighbours
+ * @param order (out) the city ids in list order
+ * @return the number of neighbours found by the membership tests
+ */
+static int neighboursOnList(Neighbour *neighbours, int count, int *order) {
+    List *list = newList(compNeighbourId, compNeighbourId, 0);
+    int found = 0;
+    unsigned int seed = 11;
+    for (int i = 0; i < count; i++) {
+        Neighbour *neighbour = (Neighbour*)malloc(sizeof(Neighbour));
+        *neighbour = neighbours[i];
+        addList(list, neighbour);
+    }
+    for (int i = 0; i < count * LOOKUPS_PER_ELEMENT; i++) {
+        found += isInList(list, &neighbours[nextRandom(&seed) % count]) != 0;
+    }
+    int i = 0;
+    for (Node *node = list->head; node; node = node->next) {
+        order[i++] = ((Neighbour*)node->val)->city->id;
+    }
+    forEach(list, free);
+    delList(list);
+    return found;
+}
+
+/**
+ * Neighbours workload on a typed list: the Neighbours stored in place
+ * @param neighbours the neighbours to add
+ * @param count the number of neighbours
+ * @param order (out) the city ids in list order
+ * @return the number of neighbours found by the membership tests
+ */
+static int neighboursOnTypedList(Neighbour *neighbours, int count, int *order) {
+    NeighbourList list;
+    initNeighbourList(&list, 0);
+    int found = 0;
+    unsigned int seed = 11;
+    for (int i = 0; i < count; i++) {
+        addNeighbourList(&list, neighbours[i]);
+    }
+    for (int i = 0; i < count * LOOKUPS_PER_ELEMENT; i++) {
+        found += findNeighbourList(&list, neighbours[nextRandom(&seed) % count]) >= 0;
+    }
+    for (int i = 0; i < count; i++) {
+        order[i] = list.items[i].city->id;
+    }
+    freeNeighbourList(&list);
+    return found;
+}
+
+/**
+ * Generic list of names in strcmp order
+ * @param names the names to add
+ * @param count the number of names
+ * @param bulk non zero to build the list with newListFromArray(), 0 to add the names one by one
+ * @return the list, 0 if memory allocation failed
+ */
+static List *newNameList(char **names, int count, int bulk) {
+    if(bulk) {
+        return newListFromArray(ListKind_Linked, compName, compName, 0, 0, 0, (void**)names, count);
+    }
+    List *list = newList(compName, compName, 0);
+    for (int i = 0; list && i < count; i++) {
+        addList(list, names[i]);
+    }
+    return list;
+}
+
+/**
+ * Names workload on a generic list
+ * @param names the names to add
+ * @param count the number of names
+ * @param bulk non zero to build the list with newListFromArray(), 0 to add the names one by one
+ * @param order (out) the index of the names in list order
+ * @return the number of names found by the membership tests
+ */
+static int namesOnList(char **names, int count, int bulk, int *order) {
+    List *list = newNameList(names, count, bulk);
+    if(!list) {
+        return -1;
+    }
+    int found = 0;
+    unsigned int seed = 13;
+    for (int i = 0; i < count * LOOKUPS_PER_ELEMENT; i++) {
+        found += isInList(list, names[nextRandom(&seed) % count]) != 0;
+    }
+    int i = 0;
+    for (Node *node = list->head; node; node = node->next) {
+        order[i++] = atoi((char*)node->val + 1);
+    }
+    delList(list);
+    return found;
+}
+
+/**
+ * Names workload on a typed list
+ * @param names the names to add
+ * @param count the number of names
+ * @param order (out) the index of the names in list order
+ * @return the number of names found by the membership tests
+ */
+static int namesOnTypedList(char **names, int count, int *order) {
+    NameList list;
+    initNameList(&list, 0);
+    int found = 0;
+    unsigned int seed = 13;
+    for (int i = 0; i < count; i++) {
+        addNameList(&list, names[i]);
+    }
+    for (int i = 0; i < count * LOOKUPS_PER_ELEMENT; i++) {
+        found += findNameList(&list, names[nextRandom(&seed) % count]) >= 0;
+    }
+    for (int i = 0; i < count; i++) {
+        order[i] = atoi(list.items[i] + 1);
+    }
+    freeNameList(&list);
+    return found;
+}
+
+/**
+ * Print one benchmark line
+ * @param workload the name of the workload
+ * @param container the name of the container
+ * @param milliseconds the time taken
+ * @param found the number of found elements, the same for all containers
+ */
+static void printResult(char *workload, char *container, double milliseconds, int found) {
+    printf("%-12s %-14s %10.2f ms   (%d found)\n", workload, container, milliseconds, found);
+}
+
+/**
+ * Benchmark program: run every workload on every container.
+ */
+int main(int argc, char** args) {
+    int count = argc > 1 ? atoi(args[1]) : 4000;
+    if(count <= 0) {
+        printf("Usage: listBenchmark [element count]\n");
+        return 1;
+    }
+    OpenEntry *entries = (OpenEntry*)malloc(sizeof(OpenEntry) * count);
+    City *cities = (City*)calloc(count, sizeof(City));
+    City **shuffled = (City**)malloc(sizeof(City*) * count);
+    Neighbour *neighbours = (Neighbour*)malloc(sizeof(Neighbour) * count);
+    char **names = (char**)malloc(sizeof(char*) * count);
+    int *expected = (int*)malloc(sizeof(int) * count);
+    int *order = (int*)malloc(sizeof(int) * count);
+    if(!entries || !cities || !shuffled || !neighbours || !names || !expected || !order) {
+        printf("Error: %s\n", message(ERRALLOC));
+        return 1;
+    }
+    unsigned int seed = 2463534242u;
+    for (int i = 0; i < count; i++) {
+        entries[i].id = i;
+        entries[i].f = (int)(nextRandom(&seed) % 100000);
+        cities[i].id = i;
+        neighbours[i].city = &cities[nextRandom(&seed) % count];
+        neighbours[i].distance = i;
+        names[i] = (char*)malloc(16);
+        sprintf(names[i], "C%d", (int)(nextRandom(&seed) % (count * 4)));
+    }
+    for (int i = 0; i < count; i++) {
+        int other = (int)(nextRandom(&seed) % (i + 1));
+        shuffled[i] = shuffled[other];
+        shuffled[other] = &cities[i];
+    }
+    int failures = 0;
+
+    clock_t start = clock();
+    int found = openOnList(newList(compOpenId, compOpenF, 0), entries, count, expected);
+    printResult("open", "List", elapsed(start), found);
+    start = clock();
+    found = openOnList(newHashedList(compOpenId, compOpenF, 0, hashOpenId), entries, count, order);
+    printResult("open", "hashed List", elapsed(start), found);
+    failures += memcmp(expected, order, sizeof(int) * count) != 0;
+    OpenList openList;
+    initOpenList(&openList, 0);
+    start = clock();
+    found = openOnTypedList(&openList, entries, count, order);
+    printResult("open", "OpenList", elapsed(start), found);
+    failures += memcmp(expected, order, sizeof(int) * count) != 0;
+    freeOpenList(&openList);
+
+    start = clock();
+    found = citiesOnList(newList(compCityId, compCityId, 0), shuffled, count, expected);
+    printResult("cities", "List", elapsed(start), found);
+    start = clock();
+    found = citiesOnList(newOrderedList(compCityId, compCityId, 0), shuffled, count, order);
+    printResult("cities", "ordered List", elapsed(start), found);
+    failures += memcmp(expected, order, sizeof(int) * count) != 0;
+    start = clock();
+    found = citiesOnTypedList(shuffled, count, order);
+    printResult("cities", "CityList", elapsed(start), found);
+    failures += memcmp(expected, order, sizeof(int) * count) != 0;
+
+    start = clock();
+    found = neighboursOnList(neighbours, count, expected);
+    printResult("neighbours", "List", elapsed(start), found);
+    start = clock();
+    found = neighboursOnTypedList(neighbours, count, order);
+    printResult("neighbours", "NeighbourList", elapsed(start), found);
+    failures += memcmp(expected, order, sizeof(int) * count) != 0;
+
+    start = clock();
+    found = namesOnList(names, count, 0, expected);
+    printResult("names", "List", elapsed(start), found);
+    start = clock();
+    found = namesOnList(names, count, 1, order);
+    printResult("names", "List bulk", elapsed(start), found);
+    failures += memcmp(expected, order, sizeof(int) * count) != 0;
+    start = clock();
+    found = namesOnTypedList(names, count, order);
+    printResult("names", "NameList", elapsed(start), found);
+    failures += memcmp(expected, order, sizeof(int) * count) != 0;
+
+    for (int bulk = 0; bulk < 2; bulk++) {
+        start = clock();
+        List *list = newNameList(names, count, bulk);
+        printResult("name build", bulk ? "List bulk" : "List", elapsed(start), list ? list->nelts : 0);
+        if(list) {
+            delList(list);
+        }
+    }
+
+    printf("same order: %s\n", failures ? "NO" : "yes");
+    for (int i = 0; i < count; i++) {
+        free(names[i]);
+    }
+    free(entries);
+    free(cities);
+    free(shuffled);
+    free(neighbours);
+    free(names);
+    free(expected);
+    free(order);
+    return failures ? 1 : 0;
+}
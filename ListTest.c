@@ -29,6 +29,18 @@ static int compString(void *s1, void *s2) {
     return strcmp((char *) s1, (char *) s2);
 }
 
+/*************************************************************
+ * Function to hash an element (string), consistent with compString
+ * @param s the string to hash
+ * @return the hash value (djb2)
+ *************************************************************/
+static unsigned int hashString(void *s) {
+    unsigned int hash = 5381;
+    for (char *c = (char *) s; *c; c++)
+        hash = hash * 33 + (unsigned char) *c;
+    return hash;
+}
+
 /*************************************************************
  * Function to display an element of the list
  * @param s the string to display
@@ -46,6 +58,35 @@ static void prString2(void *s) {
     printf("%s\n", (char *) s);
 }
 
+/*************************************************************
+ * Function to compare two elements (strings) on their length only
+ * @param s1 the first string to compare
+ * @param s2 the second string to compare
+ * @return <0, 0 or >0 as s1 is shorter, as long or longer
+ *************************************************************/
+static int compLength(void *s1, void *s2) {
+    return (int) strlen((char *) s1) - (int) strlen((char *) s2);
+}
+
+/*************************************************************
+ * Check the nodes of a list against the expected elements (the same pointers),
+ * its length and its tail
+ * @param l the list
+ * @param expected the expected elements, in order
+ * @param count the number of expected elements
+ * @return 1 if the list holds exactly the expected elements, 0 otherwise
+ *************************************************************/
+static int checkNodes(List *l, char **expected, int count) {
+    int i = 0;
+    Node *last = 0;
+    for (Node *node = l->head; node; node = node->next, i++) {
+        if (i >= count || node->val != expected[i])
+            return 0;
+        last = node;
+    }
+    return i == count && l->nelts == count && l->tail == last;
+}
+
 /*************************************************************
  * test program: creation of a list of strings then tests
  * for main list functionalities.
@@ -144,6 +185,120 @@ int main() {
     /* final cleanup */
     delList(l);
 
+    puts("\n-----Ordered list:---------\n");
+    // Same tests on an ordered list (skip list index)
+    List *ordered = newOrderedList(compString, compString, prString);
+    if (!ordered) return 1;
+    for (i = 0; i < sizeof(tab) / sizeof(char *); i++)
+        addList(ordered, tab[i]);
+    addList(ordered, tab[3]);   // Duplicate
+    displayList(ordered);
+    putchar('\n');
+
+    // Rank access must follow the sorted order, with the duplicate next to its equal
+    char *expectedOrder[] = {"belle marquise", "d'amour", "me font", "mourir", "mourir", "vos beaux yeux"};
+    for (i = 0; i < sizeof(expectedOrder) / sizeof(char *); i++) {
+        line = 0;
+        nthInList(ordered, i, (void*)&line);
+        if(!line || strcmp(line, expectedOrder[i]) != 0) {
+            printf("nthInList() on ordered list does not work correctly, %s != %s\n", line, expectedOrder[i]);
+        }
+    }
+    if (isInList(ordered, "mourir") && !isInList(ordered, "vivre") && isInList(ordered, "belle marquise") == (Node*)1)
+        puts("isInList() on ordered list OK");
+    else
+        puts("isInList() on ordered list does not work correctly");
+
+    // Remove the head, a duplicate and by position
+    remFromList(ordered, "belle marquise");
+    remFromList(ordered, "mourir");
+    remFromListAt(ordered, 0, (void**)&pEle);
+    printf("Removed element: %s should be equal to: d'amour\n", pEle);
+    displayList(ordered);
+    printf("\nList size: %d (expected 3)\n", lengthList(ordered));
+    delList(ordered);
+
+    puts("\n-----Hashed list:---------\n");
+    // Membership through the hash table, predecessor contract unchanged
+    List *hashed = newHashedList(compString, compString, prString, hashString);
+    if (!hashed) return 1;
+    for (i = 0; i < sizeof(tab) / sizeof(char *); i++)
+        addList(hashed, tab[i]);
+    Node *pred = isInList(hashed, "me font");
+    if (isInList(hashed, "belle marquise") == (Node*)1 && pred && pred > (Node*)1
+        && strcmp((char *) pred->next->val, "me font") == 0 && !isInList(hashed, "vivre"))
+        puts("isInList() on hashed list OK");
+    else
+        puts("isInList() on hashed list does not work correctly");
+    remFromList(hashed, "belle marquise");
+    remFromList(hashed, "mourir");
+    if (remFromList(hashed, "vivre") != ERRABSENT || isInList(hashed, "mourir"))
+        puts("remFromList() on hashed list does not work correctly");
+    displayList(hashed);
+    printf("\nList size: %d (expected 3)\n", lengthList(hashed));
+    delList(hashed);
+
+    puts("\n-----Bulk building:---------\n");
+    // Distinct pointers for equal strings, to see that equal elements keep their order
+    char mourir2[] = "mourir";
+    char mourir3[] = "mourir";
+    char *bulk[] = {tab[3], tab[1], tab[0], mourir2, tab[2], tab[4]};
+    int bulkCount = sizeof(bulk) / sizeof(char *);
+    char *bulkSorted[] = {tab[0], tab[4], tab[2], tab[3], mourir2, tab[1]};
+    ListKind kinds[] = {ListKind_Linked, ListKind_Ordered, ListKind_Hashed};
+    char *kindNames[] = {"linked", "ordered", "hashed"};
+    for (int kind = 0; kind < 3; kind++) {
+        List *built = newListFromArray(kinds[kind], compString, compString, prString,
+                                       kinds[kind] == ListKind_Hashed ? hashString : 0, 0, (void **) bulk, bulkCount);
+        if (!built) return 1;
+        int ok = checkNodes(built, bulkSorted, bulkCount);
+        for (i = 0; i < bulkCount; i++) {
+            line = 0;
+            nthInList(built, i, (void*)&line);
+            ok = ok && line == bulkSorted[i];
+        }
+        // Searches on value find the first of equals, addList() goes before its equals
+        Node *found = isInList(built, "mourir");
+        ok = ok && found > (Node*)1 && found->next->val == tab[3] && !isInList(built, "vivre");
+        addList(built, mourir3);
+        nthInList(built, 3, (void*)&line);
+        ok = ok && line == mourir3 && lengthList(built) == bulkCount + 1;
+
+        // Removing the last elements moves the tail, appending after them too
+        remFromListAt(built, bulkCount, (void**)&pEle);
+        ok = ok && pEle == tab[1] && built->tail->val == mourir2;
+        remFromList(built, "mourir");
+        remFromList(built, "mourir");
+        remFromList(built, "mourir");
+        ok = ok && remFromList(built, "mourir") == ERRABSENT && built->tail->val == tab[2];
+        appendList(built, tab[1]);
+        ok = ok && built->tail->val == tab[1] && isInList(built, "vos beaux yeux");
+        while (remFromListAt(built, 0, (void**)&pEle) == OK);
+        ok = ok && !built->head && !built->tail && built->nelts == 0;
+        appendList(built, tab[1]);
+        ok = ok && built->head == built->tail && built->head->val == tab[1];
+        printf("newListFromArray() on %s list %s\n", kindNames[kind], ok ? "OK" : "does not work correctly");
+        delList(built);
+    }
+
+    // Appending keeps the order of the calls, sorting on another key is stable
+    List *appended = newOrderedList(compString, compString, prString);
+    if (!appended) return 1;
+    for (i = 0; i < sizeof(tab) / sizeof(char *); i++)
+        appendList(appended, tab[i]);
+    int ok = checkNodes(appended, tab, sizeof(tab) / sizeof(char *));
+    char *byLength[] = {tab[3], tab[2], tab[4], tab[0], tab[1]};
+    sortList(appended, compLength);
+    ok = ok && checkNodes(appended, byLength, sizeof(byLength) / sizeof(char *));
+    ok = ok && isInList(appended, "mourir") && !isInList(appended, "vivre") && sortList(appended, 0) == ERRUNABLE;
+    sortList(appended, compString);
+    addList(appended, mourir3);
+    nthInList(appended, 3, (void*)&line);
+    ok = ok && line == mourir3;
+    displayList(appended);
+    printf("\nappendList() and sortList() %s\n", ok ? "OK" : "do not work correctly");
+    delList(appended);
+
     return 0;
 }
 /*************************************************************/
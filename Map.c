@@ -6,10 +6,22 @@
  * @brief Functions for finding the optimal route between two cities using the A* algorithm.
  */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <string.h>
 #include <limits.h>
+#include <time.h>
 #include "Map.h"
+#include "PackedGraph.h"
+#include "PagedGraph.h"
+#include "ArcFlags.h"
+#include "Components.h"
+#include "DistanceTable.h"
+#include "StringArena.h"
+#include "Route.h"
+#include "LatencyStats.h"
+#include "SearchTrace.h"
 
 /**
  * Function to display the neighbours name and distance
@@ -32,16 +44,7 @@ static void displayCity(void *city) {
 }
 
 /**
- * Function to print a city with distance(G) value (distance from start city)
- * @param city The city to display
- */
-static void displayCityAndDistance(void *city) {
-    City* theCity = (City*)city;
-    printf("%s (%d)\n", theCity->cityName, theCity->g);
-}
-
-/**
- * Function to compare two Cities on Name: based on strcmp
+ * Function to compare two Cities on Name: names are interned, so equal names have equal ids
  * @param s1 the first City to compare
  * @param s2 the second City to compare
  * @return <0 if s1 is less than s2
@@ -51,146 +54,229 @@ static void displayCityAndDistance(void *city) {
 static int compCitiesBasedOnName(void *s1, void *s2) {
     City* city1 = (City*)s1;
     City* city2 = (City*)s2;
-    return strcmp(city1->cityName, city2->cityName);
+    return (city1->id > city2->id) - (city1->id < city2->id);
 }
 
 /**
- * Function to compare two Cities based on the F value
- * @param s1 the first City to compare
- * @param s2 the second City to compare
+ * Function to compare two Neighbours on the name of their City, by interned name id
+ * @param s1 the first Neighbour to compare
+ * @param s2 the second Neighbour to compare
  * @return <0 if s1 is less than s2
  * @return 0 if s1 equals s2
  * @return >0 otherwise
  */
-static int compCitiesBasedOnF(void *s1, void *s2) {
-    City* city1 = (City*)s1;
-    City* city2 = (City*)s2;
-    return (city1->f - city2->f);
+static int compNeighboursBasedOnName(void *s1, void *s2) {
+    Neighbour* neighbour1 = (Neighbour*)s1;
+    Neighbour* neighbour2 = (Neighbour*)s2;
+    return (neighbour1->city->id > neighbour2->city->id) - (neighbour1->city->id < neighbour2->city->id);
 }
+
 /**
- * Function to compare two elements, always returns equal (0)
- * @param s1 Not used
- * @param s1 Not used
- * @return 0
+ * Function to hash a City on Name, consistent with compCitiesBasedOnName
+ * @param city the City to hash
+ * @return the hash value
  */
-static int noCompare (void *s1, void *s2) {
-    return 0;
+static unsigned int hashCityOnName(void *city) {
+    return (unsigned int)((City*)city)->id * 2654435761u;   // Knuth multiplicative hash
 }
 
-/**
- * Find a specific city in a list
- * @param list The list to search in
- * @param city The city to search for, using the list compare function
- * @return 0 if city was not found
- * @return The city when the city is in the list
-  */
-City* findCityInList(List *list, City *city){
-    Node *pNode = isInList(list, city);
-    if(!pNode) {
-        return 0;
-    }
-    else if(pNode == (Node*)1) {
-        return (City*)list->head->val;  // City is in head node value
-    }
-    else {
-        return (City*)pNode->next->val;  // City is in next node value
-    }
-}
 /**
  * Find a city by name
  * @param name The name of the city to search for
- * @param list The list to search in
+ * @param cityMap The map to search in
  * @return 0 if city was not found
- * @return The city when the city is in the list
+ * @return The city when the city is in the map
   */
-City* findCityByName(char *name, List *pToCityList)
+City* findCityByName(char *name, CityMap *cityMap)
 {
-    // Dummy city for comparing
-    City dummyCity;
-    dummyCity.cityName = name;
-    return findCityInList(pToCityList, &dummyCity);
+    // The id of the interned name is the id of the city
+    int id = findString(cityMap->names, name);
+    return id < 0 ? 0 : cityMap->cities[id];
 }
 
  /**
  * Get a city based on name, if it does not exist, it creates the city.
  * @param cityName The name of the city to search for
- * @param pToCityList The list to search in
+ * @param cityMap The map to search in, and to add the city to
  * @param city Pointer to city pointer which will be assigned to allocated city.
  * @return error code if unable to get or create city
  * @return OK if city was found or created and set in city
  */
-status getOrCreateCity(char *cityName, List *pToCityList, City **city) {
-    // Search the list for the City node
-    City *foundCity = findCityByName(cityName, pToCityList);
-    if(!foundCity) {
-        // Create the new city
-        City *pNewCity = (City*)malloc(sizeof(City));
-        if(!pNewCity) {
-            return ERRALLOC;
-        }
-        // Create memory for name
-        pNewCity->cityName = (char*)malloc(MAX_CITYNAME_LENGTH);
-        if(!pNewCity->cityName) {
-            free(pNewCity);
+status getOrCreateCity(char *cityName, CityMap *cityMap, City **city) {
+    // Intern the name, a new name gets the next free id
+    int id;
+    status ret;
+    if((ret = internString(cityMap->names, cityName, &id)) != OK) {
+        return ret;
+    }
+    if(id < cityMap->cityCount) {
+        *city = cityMap->cities[id];
+        return OK;
+    }
+
+    // Make room in the index
+    if(cityMap->cityCount == cityMap->cityCapacity) {
+        int capacity = cityMap->cityCapacity ? cityMap->cityCapacity * 2 : 64;
+        City **cities = (City**)reallocMemory(&cityMap->memory.base, cityMap->cities,
+                                              sizeof(City*) * cityMap->cityCapacity, sizeof(City*) * capacity);
+        if(!cities) {
             return ERRALLOC;
         }
+        cityMap->cities = cities;
+        cityMap->cityCapacity = capacity;
+    }
 
-        // Copy the name
-        strncpy(pNewCity->cityName, cityName, MAX_CITYNAME_LENGTH);
-
-        // Add to cityList
-        status ret;
-        if((ret = addList(pToCityList, pNewCity )) != OK) {
-            // Unable to add, free it or it will be lost.
-            free(pNewCity);
-            *city = 0;
-            return ret;
-        }
-        *city = pNewCity;
+    // Create the new city
+    City *pNewCity = (City*)allocMemory(&cityMap->memory.base, sizeof(City));
+    if(!pNewCity) {
+        return ERRALLOC;
     }
-    else {
-        *city = foundCity;
+
+    // Initialise the city, position is filled in when its own line is read
+    pNewCity->id = id;
+    pNewCity->cityName = stringOfId(cityMap->names, id);
+    pNewCity->latitude = 0;
+    pNewCity->longitude = 0;
+    pNewCity->hasPosition = 0;
+    pNewCity->neighbour = 0;
+
+    // Add to cityList, in order of id
+    if((ret = appendList(cityMap->cityList, pNewCity )) != OK) {
+        // Unable to add, free it or it will be lost.
+        freeMemory(&cityMap->memory.base, pNewCity, sizeof(City));
+        *city = 0;
+        return ret;
     }
+    cityMap->cities[cityMap->cityCount++] = pNewCity;
+    *city = pNewCity;
     return OK;
 }
 /**
- * Add a neighbor to the given city
+ * Add a neighbor to the given city, at the end of its list: sortNeighbours() orders the lists once all are added
+ * @param cityMap The map the city is in
  * @param city The city to add the neighbour to
  * @param neighbourCity The city to add as a neighbour to city
  * @param distance The distance to the given neighbour
  * @return error code if unable to add neighbour
  * @return OK if neighbour was correctly added
   */
-status addNeighbour(City *city, City *neighbourCity, int distance) {
+status addNeighbour(CityMap *cityMap, City *city, City *neighbourCity, int distance) {
     // Create neighbor list if empty
+    Allocator *allocator = &cityMap->memory.base;
     if(!city->neighbour) {
-        city->neighbour = newList(compCitiesBasedOnName, compCitiesBasedOnName, displayCity);
+        city->neighbour = newListWithAllocator(ListKind_Linked, compNeighboursBasedOnName, compNeighboursBasedOnName,
+                                               displayNeighbours, 0, allocator);
         if(!city->neighbour) {
             return ERRALLOC;
         }
     }
     // Add the neighbor
-    Neighbour* newNeighbor = (Neighbour*)malloc(sizeof(Neighbour));
+    Neighbour* newNeighbor = (Neighbour*)allocMemory(allocator, sizeof(Neighbour));
     if(!newNeighbor) {
         return ERRALLOC;
     }
     // Set the neighbour values
     newNeighbor->city = neighbourCity;
     newNeighbor->distance = distance;
-    status ret = addList(city->neighbour, newNeighbor);
+    status ret = appendList(city->neighbour, newNeighbor);
     if(ret != OK) {
-        free(newNeighbor);
+        freeMemory(allocator, newNeighbor, sizeof(Neighbour));
     }
     return ret;
 }
-status createMap(char *path, List **cityMapList) {
+
+/**
+ * Sort the neighbour lists of all cities on the ids of the neighbours, once per load instead of
+ * a sorted insert per neighbour. Neighbours to the same city keep their order.
+ * @param cityMap The map
+ */
+static void sortNeighbours(CityMap *cityMap) {
+    for (int id = 0; id < cityMap->cityCount; id++) {
+        List *neighbours = cityMap->cities[id]->neighbour;
+        if(neighbours) {
+            sortList(neighbours, neighbours->addComp);
+        }
+    }
+}
+
+void releaseNeighbours(CityMap *cityMap, City *city) {
+    if(!city->neighbour) {
+        return;
+    }
+    for (Node *node = city->neighbour->head; node; node = node->next) {
+        freeMemory(&cityMap->memory.base, node->val, sizeof(Neighbour));
+    }
+    delList(city->neighbour);
+    city->neighbour = 0;
+}
+/**
+ * Find the largest number of neighbours of a city, the size of the neighbour buffer of findRoute
+ * @param cityMap The map with all cities read
+ */
+static void countMaxNeighbours(CityMap *cityMap) {
+    cityMap->maxNeighbours = cityMap->packed ? cityMap->packed->maxNeighbours : 0;
+    for (int id = 0; id < cityMap->cityCount; id++) {
+        List *neighbours = cityMap->cities[id]->neighbour;
+        if(neighbours && neighbours->nelts > cityMap->maxNeighbours) {
+            cityMap->maxNeighbours = neighbours->nelts;
+        }
+    }
+}
+
+status createMap(char *path, CityMap **cityMap) {
+    return createMapWithAllocator(path, cityMap, 0);
+}
+
+size_t mapFootprint(CityMap *cityMap) {
+    return sizeof(CityMap) + cityMap->memory.base.stats.bytesInUse;
+}
+
+status createEmptyMap(CityMap **cityMap, Allocator *allocator) {
+    *cityMap = (CityMap*)allocMemory(allocator, sizeof(CityMap));
+    if(!*cityMap) {
+        return ERRALLOC;
+    }
+    initTrackingAllocator(&(*cityMap)->memory, "map", allocator);
+    (*cityMap)->cities = 0;
+    (*cityMap)->cityCount = 0;
+    (*cityMap)->cityCapacity = 0;
+    (*cityMap)->maxNeighbours = 0;
+    (*cityMap)->names = 0;
+    (*cityMap)->packed = 0;
+    (*cityMap)->paged = 0;
+    (*cityMap)->arcFlags = 0;
+    (*cityMap)->components = 0;
+    (*cityMap)->distanceTable = 0;
+    (*cityMap)->heuristicScale = DEFAULT_HEURISTIC_SCALE;
+    (*cityMap)->cityList = newListWithAllocator(ListKind_Linked, compCitiesBasedOnName, compCitiesBasedOnName, displayCity,
+                                                0, &(*cityMap)->memory.base);
+    if(!(*cityMap)->cityList || newStringArena(&(*cityMap)->names, &(*cityMap)->memory.base) != OK) {
+        return ERRALLOC;
+    }
+    return OK;
+}
+
+/**
+ * Populate a CityMap from a .MAP file, see createMapWithAllocator()
+ * @param path Location of the input file
+ * @param cityMap Pointer to map pointer which will be assigned to populated map
+ * @param allocator The allocator of the map's memory, 0 for malloc
+ * @param finish 0 to leave the neighbours unsorted, the heuristic and the components to mergeMaps()
+ * @param pack 1 to collect the edges as read and pack them (see packEdges()), without neighbour lists
+ * @return OK if no error
+ * @return Error code when there was an error
+ */
+static status readMap(char *path, CityMap **cityMap, Allocator *allocator, int finish, int pack) {
     FILE *file;
     char cityName[MAX_CITYNAME_LENGTH];
     int mapParam1;
     int mapParam2;
 
-    // Create a new cities list
-    *cityMapList = newList(compCitiesBasedOnName, compCitiesBasedOnF, displayCity);
+    // Create the map and a new cities list
+    status ret = createEmptyMap(cityMap, allocator);
+    if(ret != OK) {
+        return ret;
+    }
 
     // Open the file
     file = fopen(path,"r");
@@ -201,8 +287,11 @@ status createMap(char *path, List **cityMapList) {
 
     // Read complete file and parse
     City *curCity = 0;
+    MapEdge *edges = 0;
+    int edgeCount = 0;
+    int edgeCapacity = 0;
     while(!feof(file)) {
-        int paramsCount = fscanf(file, "%s\t\t%d\t%d", cityName, &mapParam1, &mapParam2);
+        int paramsCount = fscanf(file, CITYNAME_FORMAT "\t\t%d\t%d", cityName, &mapParam1, &mapParam2);
         switch (paramsCount){
             case CityAndLatAndLong:
             {
@@ -212,16 +301,15 @@ status createMap(char *path, List **cityMapList) {
                 // Create the new city
                 City *city = 0;
                 status ret;
-                if((ret = getOrCreateCity(cityName, *cityMapList, &city)) != OK) {
+                if((ret = getOrCreateCity(cityName, *cityMap, &city)) != OK) {
+                    fclose(file);
+                    free(edges);
                     return ret;
                 }
                 // Initialise the city
                 city->latitude = mapParam1;
                 city->longitude = mapParam2;
-                city->g = INT_MAX;
-                city->f = 0;
-                city->neighbour = 0;
-                city->backPointer = 0;
+                city->hasPosition = 1;
                 curCity = city;
                 break;
             }
@@ -233,10 +321,31 @@ status createMap(char *path, List **cityMapList) {
                 // Check if the city is already available, if not add.
                 City *city = 0;
                 status ret;
-                if((ret = getOrCreateCity(cityName, *cityMapList, &city)) != OK) {
+                if((ret = getOrCreateCity(cityName, *cityMap, &city)) != OK) {
+                    fclose(file);
+                    free(edges);
                     return ret;
                 }
-                if((ret = addNeighbour(curCity, city, mapParam1)) != OK) {
+                if(pack) {
+                    // Edges to pack at the end, 12 bytes each instead of a Node and a Neighbour
+                    if(edgeCount == edgeCapacity) {
+                        int capacity = edgeCapacity ? 2 * edgeCapacity : 1024;
+                        MapEdge *grown = (MapEdge*)realloc(edges, sizeof(MapEdge) * capacity);
+                        if(!grown) {
+                            fclose(file);
+                            free(edges);
+                            return ERRALLOC;
+                        }
+                        edges = grown;
+                        edgeCapacity = capacity;
+                    }
+                    edges[edgeCount].fromCityId = curCity->id;
+                    edges[edgeCount].toCityId = city->id;
+                    edges[edgeCount].distance = mapParam1;
+                    edgeCount++;
+                }
+                else if((ret = addNeighbour(*cityMap, curCity, city, mapParam1)) != OK) {
+                    fclose(file);
                     return ret;
                 }
                 break;
@@ -245,38 +354,268 @@ status createMap(char *path, List **cityMapList) {
     }
     // Close the file
     fclose(file);
+    if(pack) {
+        ret = packEdges(*cityMap, edges, edgeCount);
+        free(edges);
+        if(ret != OK) {
+            return ret;
+        }
+    }
 
 #ifdef ENABLE_DEBUG_INFO
-    printf("Found cities: %d\n", lengthList(*cityMapList));
-    displayList(*cityMapList);
+    printf("Found cities: %d\n", lengthList((*cityMap)->cityList));
+    displayList((*cityMap)->cityList);
 #endif
-    return OK;
+    if(!finish) {
+        return OK;
+    }
+    sortNeighbours(*cityMap);
+    countMaxNeighbours(*cityMap);
+    calibrateHeuristic(*cityMap);
+    return buildComponents(*cityMap);
+}
+
+status createMapWithAllocator(char *path, CityMap **cityMap, Allocator *allocator) {
+    uint64_t startTime = latencyNow();
+    status ret = readMap(path, cityMap, allocator, 1, 0);
+    recordLatency(LatencyMetric_MapLoad, latencyNow() - startTime);
+    return ret;
+}
+
+status createPackedMap(char *path, CityMap **cityMap) {
+    uint64_t startTime = latencyNow();
+    status ret = readMap(path, cityMap, 0, 1, 1);
+    recordLatency(LatencyMetric_MapLoad, latencyNow() - startTime);
+    return ret;
 }
-void destroyMap(List *cityList){
-    if(!cityList){
+
+status createShardMap(char *path, CityMap **cityMap) {
+    return readMap(path, cityMap, 0, 0, 0);
+}
+
+/**
+ * Add the cities and neighbours of another map to a map, see mergeMaps()
+ * @param cityMap The map to add to
+ * @param other The map to add, not packed
+ * @return ERRALLOC if memory allocation failed
+ * @return OK otherwise
+ */
+static status mergeMap(CityMap *cityMap, CityMap *other) {
+    // The city of the merged map for every city of the other map, matched by name
+    City **merged = (City**)malloc(sizeof(City*) * (other->cityCount ? other->cityCount : 1));
+    if(!merged) {
+        return ERRALLOC;
+    }
+    status ret = OK;
+    for (int id = 0; ret == OK && id < other->cityCount; id++) {
+        City *city = other->cities[id];
+        if((ret = getOrCreateCity(city->cityName, cityMap, &merged[id])) == OK && city->hasPosition) {
+            // Only referenced as a neighbour, a border city has no position in this map
+            merged[id]->latitude = city->latitude;
+            merged[id]->longitude = city->longitude;
+            merged[id]->hasPosition = 1;
+        }
+    }
+    for (int id = 0; ret == OK && id < other->cityCount; id++) {
+        City *city = other->cities[id];
+        for (Node *node = city->neighbour ? city->neighbour->head : 0; ret == OK && node; node = node->next) {
+            Neighbour *neighbour = (Neighbour*)node->val;
+            ret = addNeighbour(cityMap, merged[id], merged[neighbour->city->id], neighbour->distance);
+        }
+    }
+    free(merged);
+    return ret;
+}
+
+status mergeMaps(CityMap *cityMap, CityMap **others, int otherCount) {
+    if(cityMap->packed || cityMap->paged) {
+        return ERRUNABLE;
+    }
+    for (int otherNr = 0; otherNr < otherCount; otherNr++) {
+        if(others[otherNr]->packed || others[otherNr]->paged) {
+            return ERRUNABLE;
+        }
+    }
+    status ret = OK;
+    for (int otherNr = 0; ret == OK && otherNr < otherCount; otherNr++) {
+        ret = mergeMap(cityMap, others[otherNr]);
+    }
+
+    // Flags of the old edges are no longer valid, the heuristic has to cover the new edges
+    destroyArcFlags(cityMap->arcFlags);
+    cityMap->arcFlags = 0;
+    destroyDistanceTable(cityMap->distanceTable);
+    cityMap->distanceTable = 0;
+    sortNeighbours(cityMap);
+    countMaxNeighbours(cityMap);
+    calibrateHeuristic(cityMap);
+    if(ret == OK) {
+        ret = buildComponents(cityMap);
+    }
+    else {
+        destroyComponents(cityMap->components);
+        cityMap->components = 0;
+    }
+    return ret;
+}
+
+void destroyMap(CityMap *cityMap){
+    if(!cityMap){
         return;
     }
+    Allocator *allocator = &cityMap->memory.base;
 
     // Free all allocated cities
-    while(cityList->head) {
-        Node *pNodeTmp = cityList->head->next;
-        free( ((City*)cityList->head->val)->cityName);     // Free allocated memory for the name
-        free(cityList->head->val);                          // Free the City
-        cityList->head = pNodeTmp;
+    for (int id = 0; id < cityMap->cityCount; id++) {
+        City *city = cityMap->cities[id];
+        releaseNeighbours(cityMap, city);   // Free the Neighbour's
+        freeMemory(allocator, city, sizeof(City));
+    }
+
+    // Free the list and the index
+    if(cityMap->cityList) {
+        delList(cityMap->cityList);
+    }
+    freeMemory(allocator, cityMap->cities, sizeof(City*) * cityMap->cityCapacity);
+    destroyStringArena(cityMap->names);     // Free all names at once
+    destroyPackedGraph(cityMap->packed);
+    destroyPagedGraph(cityMap->paged);
+    destroyArcFlags(cityMap->arcFlags);
+    destroyComponents(cityMap->components);
+    destroyDistanceTable(cityMap->distanceTable);
+    freeMemory(cityMap->memory.parent, cityMap, sizeof(CityMap));
+}
+
+int calculateHValue(City *cityFrom, City *cityTo, double scale) {
+    return (int)(scale * (abs(cityFrom->latitude - cityTo->latitude) + abs(cityFrom->longitude - cityTo->longitude)));
+}
+/**
+ * State of a city in one search: the search keeps its own g, f and back pointer per city,
+ * so searches on the same map can run in parallel
+ */
+typedef struct SearchNode {
+    City *city;
+    int g;
+    int f;
+    struct SearchNode *backPointer;
+}SearchNode;
+
+/**
+ * Function to compare two SearchNodes on their city
+ * @param s1 the first SearchNode to compare
+ * @param s2 the second SearchNode to compare
+ * @return <0 if s1 is less than s2
+ * @return 0 if s1 equals s2
+ * @return >0 otherwise
+ */
+static int compNodesBasedOnCity(void *s1, void *s2) {
+    return compCitiesBasedOnName(((SearchNode*)s1)->city, ((SearchNode*)s2)->city);
+}
+
+/**
+ * Function to compare two SearchNodes based on the F value
+ * @param s1 the first SearchNode to compare
+ * @param s2 the second SearchNode to compare
+ * @return <0 if s1 is less than s2
+ * @return 0 if s1 equals s2
+ * @return >0 otherwise
+ */
+static int compNodesBasedOnF(void *s1, void *s2) {
+    return ((SearchNode*)s1)->f - ((SearchNode*)s2)->f;
+}
+
+/**
+ * Function to hash a SearchNode on its city, consistent with compNodesBasedOnCity
+ * @param node the SearchNode to hash
+ * @return the hash value
+ */
+static unsigned int hashNodeOnCity(void *node) {
+    return hashCityOnName(((SearchNode*)node)->city);
+}
+
+/**
+ * Function to display a SearchNode
+ * @param node The SearchNode to display
+ */
+static void displayNode(void *node) {
+    SearchNode *theNode = (SearchNode*)node;
+    printf("%s, g:%d, f:%d\n", theNode->city->cityName, theNode->g, theNode->f);
+}
+
+/**
+ * Find the node of a city in a list, O(1) expected for a hashed list
+ * @param list The list to search in
+ * @param city The city to search for
+ * @return 0 if the city has no node in the list
+ * @return The node of the city otherwise
+ */
+static SearchNode* findNodeInList(List *list, City *city) {
+    SearchNode key;
+    key.city = city;
+    Node *pNode = isInList(list, &key);
+    if(!pNode) {
+        return 0;
     }
+    return (SearchNode*)(pNode == (Node*)1 ? list->head->val : pNode->next->val);
+}
 
-    // Free the list
-    delList(cityList);
+/**
+ * Release the nodes in a list, and the list
+ * @param list The list
+ * @param scratch The allocator of the nodes
+ */
+static void releaseNodes(List *list, Allocator *scratch) {
+    for (Node *node = list->head; node; node = node->next) {
+        freeMemory(scratch, node->val, sizeof(SearchNode));
+    }
+    delList(list);
 }
 
 /**
- * Function to calculate h of each city
- * @param city the City to display
- *************************************************************
+ * Fill a route with the cities from the start to a node, by its back pointers
+ * @param goalNode The node of the goal
+ * @param route (out) The route
+ * @return ERRFULL if the route has no room for all cities
+ * @return OK otherwise
  */
-int calculateHValue(City *cityFrom, City *cityTo ) {
-    return (abs(cityFrom->latitude - cityTo->latitude) + abs(cityFrom->longitude - cityTo->longitude))/4;
+static status fillRouteFromNodes(SearchNode *goalNode, Route *route) {
+    // Count the cities, to fill the route from the back
+    int count = 0;
+    for (SearchNode *node = goalNode; node; node = node->backPointer) {
+        if(++count > route->capacity) {
+            route->cityCount = 0;
+            return ERRFULL;
+        }
+    }
+
+    route->cityCount = count;
+    for (SearchNode *node = goalNode; node; node = node->backPointer) {
+        count--;
+        route->cityIds[count] = node->city->id;
+        route->distances[count] = node->g;
+    }
+    route->totalDistance = goalNode->g;
+    return OK;
 }
+
+status checkInterrupted(RouteOptions *options) {
+    if(!options) {
+        return OK;
+    }
+    if(options->cancelled && __atomic_load_n(options->cancelled, __ATOMIC_RELAXED)) {
+        return ERRCANCELLED;
+    }
+    if(options->deadline) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if(now.tv_sec > options->deadline->tv_sec
+           || (now.tv_sec == options->deadline->tv_sec && now.tv_nsec >= options->deadline->tv_nsec)) {
+            return ERRTIMEOUT;
+        }
+    }
+    return OK;
+}
+
 #ifdef ENABLE_DEBUG_INFO
 void printStatus(List *openList, List *closedList, char* mssg){
     printf("\n---> %s <---\nOPEN:\n", mssg);
@@ -287,74 +626,799 @@ void printStatus(List *openList, List *closedList, char* mssg){
 #endif
 
 /**
- * Print the route from origin city to the given goal city based on back-pointer
- * @param city The goal city
- * @return error code if unable to print route
- * @return OK if route printed successfully
-  */
-status printBackPointerRoute(City* endCity) {
-    List *pRoute = newList(noCompare, noCompare, 0);
-    if(!pRoute) {
-        printf("Error creating back-pointer list\n");
-        return(ERRALLOC);
+ * Neighbours of the city being expanded, reused for every expansion of a query
+ */
+typedef struct NeighbourBuffer {
+    int *cityIds;
+    int *distances;
+}NeighbourBuffer;
+
+/**
+ * Get the neighbours of a city, from the packed graph, the paged graph or else from its neighbour list
+ * @param cityMap The map the city is in
+ * @param city The city to get the neighbours from
+ * @param buffer (out) the neighbours, room for cityMap->maxNeighbours
+ * @return the number of neighbours, -1 if they could not be read from disk
+ */
+static int loadNeighbours(CityMap *cityMap, City *city, NeighbourBuffer *buffer) {
+    if(cityMap->paged) {
+        return pagedNeighbours(cityMap->paged, city->id, buffer->cityIds, buffer->distances);
+    }
+    if(cityMap->packed) {
+        return unpackNeighbours(cityMap->packed, city->id, buffer->cityIds, buffer->distances);
     }
+    int count = 0;
+    for (Node *node = city->neighbour ? city->neighbour->head : 0; node; node = node->next) {
+        Neighbour *neighbour = (Neighbour*)node->val;
+        buffer->cityIds[count] = neighbour->city->id;
+        buffer->distances[count] = neighbour->distance;
+        count++;
+    }
+    return count;
+}
 
-    // Iterate back over route, and save in list
-    City *city = endCity;
-    status ret;
-    while(city){
-        if((ret = addList(pRoute, (void*)city)) != OK) {
-            delList(pRoute);
-            return ret;
+double calibrateHeuristic(CityMap *cityMap) {
+    double scale = -1;
+    size_t bufferSize = sizeof(int) * (cityMap->maxNeighbours ? cityMap->maxNeighbours : 1);
+    NeighbourBuffer neighbours;
+    neighbours.cityIds = (int*)malloc(bufferSize);
+    neighbours.distances = (int*)malloc(bufferSize);
+    if(neighbours.cityIds && neighbours.distances) {
+        for (int id = 0; id < cityMap->cityCount; id++) {
+            City *city = cityMap->cities[id];
+            int neighbourCount = loadNeighbours(cityMap, city, &neighbours);
+            for (int neighbourNr = 0; neighbourNr < neighbourCount; neighbourNr++) {
+                // Every edge bounds the scale by its distance per coordinate unit
+                City *neighbourCity = cityMap->cities[neighbours.cityIds[neighbourNr]];
+                int coordinateDistance = abs(city->latitude - neighbourCity->latitude)
+                                         + abs(city->longitude - neighbourCity->longitude);
+                if(coordinateDistance > 0) {
+                    double edgeScale = (double)neighbours.distances[neighbourNr] / coordinateDistance;
+                    if(scale < 0 || edgeScale < scale) {
+                        scale = edgeScale;
+                    }
+                }
+            }
         }
-        city = city->backPointer;
     }
+    else {
+        scale = 0;      // Unable to check the edges: no heuristic is always a lower bound
+    }
+    free(neighbours.cityIds);
+    free(neighbours.distances);
+    cityMap->heuristicScale = scale < 0 ? DEFAULT_HEURISTIC_SCALE : scale;
+    return cityMap->heuristicScale;
+}
 
-    // Print the list
-    printf("Shortest route:\n");
-    forEach(pRoute, displayCityAndDistance);
+City* findCityInMap(char *name, CityMap *cityMap) {
+    return findCityByName(name, cityMap);
+}
+
+status findRoute(char *startCityName, char *goalCityName, CityMap *cityMap, Route *route) {
+    return findRouteWithOptions(startCityName, goalCityName, cityMap, route, 0);
+}
+
+status findRouteWithOptions(char *startCityName, char *goalCityName, CityMap *cityMap, Route *route,
+                            RouteOptions *options) {
+    return findNearestRoute(startCityName, &goalCityName, 1, cityMap, route, options, 0);
+}
+
+/**
+ * Heuristic distance from a city to the nearest of the goals, a lower bound as the heuristic of every goal is
+ * @param city The city to estimate the distance from
+ * @param goals The goal cities
+ * @param goalCount The number of goals
+ * @param scale The scale of the heuristic
+ * @return the estimated distance
+ */
+static int nearestHValue(City *city, City **goals, int goalCount, double scale) {
+    int hValue = calculateHValue(city, goals[0], scale);
+    for (int goalNr = 1; goalNr < goalCount && hValue > 0; goalNr++) {
+        int goalHValue = calculateHValue(city, goals[goalNr], scale);
+        if(goalHValue < hValue) {
+            hValue = goalHValue;
+        }
+    }
+    return hValue;
+}
 
-    // Cleanup
-    delList(pRoute);
+/**
+ * Tell if an edge can be on a shortest path to one of the goals, from the arc-flags of their regions
+ * @param arcFlags The flags
+ * @param edge The edge number
+ * @param goalRegions The distinct regions of the goals
+ * @param goalRegionCount The number of regions
+ * @return non zero if the edge has to be followed
+ */
+static int flaggedForGoals(ArcFlags *arcFlags, int edge, int *goalRegions, int goalRegionCount) {
+    for (int regionNr = 0; regionNr < goalRegionCount; regionNr++) {
+        if(arcFlag(arcFlags, edge, goalRegions[regionNr])) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Index of a city in the goals
+ * @param city The city to search for
+ * @param goals The goal cities
+ * @param goalCount The number of goals
+ * @return the index of the first goal which is the city, -1 if none is
+ */
+static int goalIndexOf(City *city, City **goals, int goalCount) {
+    for (int goalNr = 0; goalNr < goalCount; goalNr++) {
+        if(goals[goalNr] == city) {
+            return goalNr;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Node of a memory-bounded search: a city reached by a path of the search tree, in a fixed pool.
+ * Nodes are linked by index, -1 for none.
+ */
+typedef struct BoundedNode {
+    City *city;
+    int g;
+    int f;                  // g + h, at least the f of the parent (pathmax)
+    int forgotten;          // Smallest f of the successors dropped from memory, INT_MAX if none
+    int expanded;
+    int parent;
+    int children;           // Successors in memory
+    int hashNext;           // Next node in the bucket of its city, or in the free pool
+    int openPos;            // Position in the OPEN heap, -1 if not in OPEN
+    int leafPos;            // Position in the leaf heap, -1 if not a leaf which may be dropped
+}BoundedNode;
+
+/**
+ * State of a memory-bounded search, all allocated at its start: maxNodes nodes, a bucket per node
+ * (rounded up to a power of two) and two heaps of node indices.
+ * OPEN holds the nodes to expand: not expanded yet, or with dropped successors, keyed on
+ * boundedKey(). The leaf heap holds the nodes of OPEN without successors in memory, worst first.
+ */
+typedef struct BoundedSearch {
+    BoundedNode *nodes;
+    int nodeCount;
+    int unusedNode;         // Nodes from here on were never used
+    int freeNode;           // Released nodes, linked by hashNext
+    int *buckets;
+    int bucketMask;
+    int *openHeap;
+    int openCount;
+    int *leafHeap;
+    int leafCount;
+}BoundedSearch;
+
+/**
+ * Key of a node in the heaps: its f until expanded, then the best f of its dropped successors
+ * @param node the node
+ * @return the key
+ */
+static int boundedKey(BoundedNode *node) {
+    return node->expanded ? node->forgotten : node->f;
+}
+
+/**
+ * Order of two nodes in a heap: OPEN takes the smallest key first, the deepest (largest g) of equals;
+ * the leaf heap takes the largest key first, the shallowest of equals
+ * @param search the search
+ * @param node1 index of the first node
+ * @param node2 index of the second node
+ * @param leaves non zero for the order of the leaf heap
+ * @return non zero if node1 goes before node2
+ */
+static int boundedBefore(BoundedSearch *search, int node1, int node2, int leaves) {
+    BoundedNode *first = &search->nodes[node1];
+    BoundedNode *second = &search->nodes[node2];
+    int key1 = boundedKey(first);
+    int key2 = boundedKey(second);
+    if(key1 != key2) {
+        return leaves ? key1 > key2 : key1 < key2;
+    }
+    return leaves ? first->g < second->g : first->g > second->g;
+}
+
+/**
+ * Move the entry at a position of a heap up or down to its place
+ * @param search the search
+ * @param leaves non zero for the leaf heap, else OPEN
+ * @param pos the position
+ */
+static void siftBounded(BoundedSearch *search, int leaves, int pos) {
+    int *heap = leaves ? search->leafHeap : search->openHeap;
+    int count = leaves ? search->leafCount : search->openCount;
+    int entry = heap[pos];
+    while (pos > 0 && boundedBefore(search, entry, heap[(pos - 1) / 2], leaves)) {
+        heap[pos] = heap[(pos - 1) / 2];
+        *(leaves ? &search->nodes[heap[pos]].leafPos : &search->nodes[heap[pos]].openPos) = pos;
+        pos = (pos - 1) / 2;
+    }
+    while (2 * pos + 1 < count) {
+        int child = 2 * pos + 1;
+        if(child + 1 < count && boundedBefore(search, heap[child + 1], heap[child], leaves)) {
+            child++;
+        }
+        if(!boundedBefore(search, heap[child], entry, leaves)) {
+            break;
+        }
+        heap[pos] = heap[child];
+        *(leaves ? &search->nodes[heap[pos]].leafPos : &search->nodes[heap[pos]].openPos) = pos;
+        pos = child;
+    }
+    heap[pos] = entry;
+    *(leaves ? &search->nodes[entry].leafPos : &search->nodes[entry].openPos) = pos;
+}
+
+/**
+ * Put a node in or out of a heap, at its place for its key
+ * @param search the search
+ * @param leaves non zero for the leaf heap, else OPEN
+ * @param index the node
+ * @param member non zero if the node belongs in the heap
+ */
+static void placeBounded(BoundedSearch *search, int leaves, int index, int member) {
+    int *heap = leaves ? search->leafHeap : search->openHeap;
+    int *count = leaves ? &search->leafCount : &search->openCount;
+    int *pos = leaves ? &search->nodes[index].leafPos : &search->nodes[index].openPos;
+    if(*pos < 0 && member) {
+        heap[*count] = index;
+        *pos = (*count)++;
+    }
+    else if(*pos >= 0 && !member) {
+        int last = heap[--*count];
+        int removed = *pos;
+        *pos = -1;
+        if(last == index) {
+            return;
+        }
+        heap[removed] = last;
+        *(leaves ? &search->nodes[last].leafPos : &search->nodes[last].openPos) = removed;
+        index = last;
+    }
+    if(*(leaves ? &search->nodes[index].leafPos : &search->nodes[index].openPos) >= 0) {
+        siftBounded(search, leaves, leaves ? search->nodes[index].leafPos : search->nodes[index].openPos);
+    }
+}
+
+/**
+ * Put a node in the heaps it belongs in after a change: OPEN when it is to be (re)expanded,
+ * the leaf heap when it is also without successors in memory and not the start
+ * @param search the search
+ * @param index the node
+ */
+static void updateBounded(BoundedSearch *search, int index) {
+    BoundedNode *node = &search->nodes[index];
+    int open = !node->expanded || node->forgotten != INT_MAX;
+    placeBounded(search, 0, index, open);
+    placeBounded(search, 1, index, open && node->children == 0 && node->parent >= 0);
+}
+
+/**
+ * Find the node of a city
+ * @param search the search
+ * @param city the city
+ * @return the index of the node, -1 if the city has none in memory
+ */
+static int findBoundedNode(BoundedSearch *search, City *city) {
+    int index = search->buckets[city->id & search->bucketMask];
+    while (index >= 0 && search->nodes[index].city != city) {
+        index = search->nodes[index].hashNext;
+    }
+    return index;
+}
+
+/**
+ * Release a node without successors in memory: out of the heaps and the buckets, back in the pool.
+ * Its parent loses a successor, and is released too when that leaves it without anything to expand.
+ * @param search the search
+ * @param index the node
+ * @param backedUp the f of the node kept by its parent, INT_MAX if nothing is left to find through it
+ */
+static void releaseBoundedNode(BoundedSearch *search, int index, int backedUp) {
+    while (index >= 0) {
+        BoundedNode *node = &search->nodes[index];
+        placeBounded(search, 0, index, 0);
+        placeBounded(search, 1, index, 0);
+        int *link = &search->buckets[node->city->id & search->bucketMask];
+        while (*link != index) {
+            link = &search->nodes[*link].hashNext;
+        }
+        *link = node->hashNext;
+        node->hashNext = search->freeNode;
+        search->freeNode = index;
+
+        int parentIndex = node->parent;
+        if(parentIndex < 0) {
+            return;
+        }
+        BoundedNode *parent = &search->nodes[parentIndex];
+        parent->children--;
+        if(backedUp < parent->forgotten) {
+            parent->forgotten = backedUp;
+        }
+        if(parent->children > 0 || !parent->expanded || parent->forgotten != INT_MAX || parent->parent < 0) {
+            updateBounded(search, parentIndex);
+            return;
+        }
+        // The parent is a dead end now
+        index = parentIndex;
+    }
+}
+
+/**
+ * Take a node from the pool for a new node, dropping the worst leaf when the pool is empty
+ * @param search the search
+ * @param f the f of the new node
+ * @return the index of the node, -1 if the pool is empty and no leaf is worse than the new node
+ */
+static int allocBoundedNode(BoundedSearch *search, int f) {
+    if(search->unusedNode < search->nodeCount) {
+        return search->unusedNode++;
+    }
+    if(search->freeNode < 0 && search->leafCount > 0 && boundedKey(&search->nodes[search->leafHeap[0]]) > f) {
+        int worst = search->leafHeap[0];
+        releaseBoundedNode(search, worst, boundedKey(&search->nodes[worst]));
+    }
+    int index = search->freeNode;
+    if(index >= 0) {
+        search->freeNode = search->nodes[index].hashNext;
+    }
+    return index;
+}
+
+/**
+ * Add a node for a city to the search, reached from a parent
+ * @param search the search
+ * @param index the node, from allocBoundedNode()
+ * @param city the city
+ * @param parent the index of the parent, -1 for the start
+ * @param g the distance from the start
+ * @param f the estimated route distance
+ */
+static void addBoundedNode(BoundedSearch *search, int index, City *city, int parent, int g, int f) {
+    BoundedNode *node = &search->nodes[index];
+    node->city = city;
+    node->g = g;
+    node->f = f;
+    node->forgotten = INT_MAX;
+    node->expanded = 0;
+    node->parent = parent;
+    node->children = 0;
+    node->openPos = -1;
+    node->leafPos = -1;
+    node->hashNext = search->buckets[city->id & search->bucketMask];
+    search->buckets[city->id & search->bucketMask] = index;
+    if(parent >= 0) {
+        search->nodes[parent].children++;
+        updateBounded(search, parent);
+    }
+    updateBounded(search, index);
+}
+
+/**
+ * Fill a route with the cities from the start to a node, by the parents
+ * @param search the search
+ * @param goal the index of the node of the goal
+ * @param route (out) The route
+ * @return ERRFULL if the route has no room for all cities
+ * @return OK otherwise
+ */
+static status fillRouteFromBoundedNodes(BoundedSearch *search, int goal, Route *route) {
+    int count = 0;
+    for (int index = goal; index >= 0; index = search->nodes[index].parent) {
+        if(++count > route->capacity) {
+            route->cityCount = 0;
+            return ERRFULL;
+        }
+    }
+    route->cityCount = count;
+    for (int index = goal; index >= 0; index = search->nodes[index].parent) {
+        count--;
+        route->cityIds[count] = search->nodes[index].city->id;
+        route->distances[count] = search->nodes[index].g;
+    }
+    route->totalDistance = search->nodes[goal].g;
+    return OK;
+}
+
+/**
+ * Memory-bounded A* (SMA*): A* with at most maxNodes search nodes in memory. When all are in use,
+ * the leaf with the largest f is dropped, and its f backed up in its parent: the parent is
+ * expanded again when that f is the smallest of OPEN. A city has at most one node, the one of its
+ * shortest path found so far. The route is optimal when its cities fit in the nodes besides
+ * the ones to reach them.
+ * @param cityMap The map
+ * @param startCity The start
+ * @param goalCities The goals
+ * @param goalCount The number of goals
+ * @param arcFlags The arc-flags to follow, 0 for all edges
+ * @param goalRegions The regions of the goals, for the arc-flags
+ * @param goalRegionCount The number of regions
+ * @param options The options, with maxNodes > 0
+ * @param route (out) The route to the nearest goal
+ * @param goalIndex (out) Index of the goal reached, may be 0
+ * @param expansions (out) The number of expansions
+ * @return ERRALLOC if memory allocation failed
+ * @return ERRALGORTIHM if no goal can be reached, or not within MAX_BOUNDED_ITERATIONS expansions
+ * @return ERRCANCELLED or ERRTIMEOUT if the search was stopped
+ * @return OK otherwise
+ */
+static status findBoundedRoute(CityMap *cityMap, City *startCity, City **goalCities, int goalCount,
+                               ArcFlags *arcFlags, int *goalRegions, int goalRegionCount,
+                               RouteOptions *options, Route *route, int *goalIndex, unsigned int *expansions) {
+    Allocator *scratch = options->scratch;
+    // A city has one node at most
+    int maxNodes = options->maxNodes < cityMap->cityCount ? options->maxNodes : cityMap->cityCount;
+    int bucketCount = 1;
+    while (bucketCount < maxNodes && bucketCount < (1 << 30)) {
+        bucketCount *= 2;
+    }
+    size_t bufferSize = sizeof(int) * (cityMap->maxNeighbours ? cityMap->maxNeighbours : 1);
+    BoundedSearch search;
+    NeighbourBuffer neighbours;
+    search.nodes = (BoundedNode*)allocMemory(scratch, sizeof(BoundedNode) * maxNodes);
+    search.buckets = (int*)allocMemory(scratch, sizeof(int) * bucketCount);
+    search.openHeap = (int*)allocMemory(scratch, sizeof(int) * maxNodes);
+    search.leafHeap = (int*)allocMemory(scratch, sizeof(int) * maxNodes);
+    neighbours.cityIds = (int*)allocMemory(scratch, bufferSize);
+    neighbours.distances = (int*)allocMemory(scratch, bufferSize);
+    status retStatus = OK;
+    if(!search.nodes || !search.buckets || !search.openHeap || !search.leafHeap
+       || !neighbours.cityIds || !neighbours.distances) {
+        retStatus = ERRALLOC;
+    }
+    else {
+        memset(search.buckets, 0xff, sizeof(int) * bucketCount);
+        search.bucketMask = bucketCount - 1;
+        search.openCount = 0;
+        search.leafCount = 0;
+        search.freeNode = -1;
+        search.unusedNode = 0;
+        search.nodeCount = maxNodes;
+        addBoundedNode(&search, allocBoundedNode(&search, 0), startCity, -1, 0, 0);
+        TRACE_SEARCH(TraceEvent_Start, startCity->id, goalCities[0]->id, 0, goalCount);
+    }
+
+    unsigned int iterationNr = 0;
+    while (retStatus == OK) {
+        if(iterationNr % ROUTE_CHECK_INTERVAL == 0 && (retStatus = checkInterrupted(options)) != OK) {
+            break;
+        }
+        if(search.openCount == 0 || iterationNr >= MAX_BOUNDED_ITERATIONS) {
+            printf("Error in route algorithm, %s.\n", search.openCount ? "reached max iterations for finding path"
+                                                                     : "no nodes in OPEN list");
+            retStatus = ERRALGORTIHM;
+            break;
+        }
+
+        // Take the best node, the goal ends the search
+        int current = search.openHeap[0];
+        BoundedNode *node = &search.nodes[current];
+        TRACE_SEARCH(TraceEvent_Pop, node->city->id, node->parent >= 0 ? search.nodes[node->parent].city->id : -1,
+                     node->g, boundedKey(node));
+        int reachedGoal = goalIndexOf(node->city, goalCities, goalCount);
+        if(reachedGoal >= 0) {
+            if(goalIndex) {
+                *goalIndex = reachedGoal;
+            }
+            TRACE_SEARCH(TraceEvent_Goal, node->city->id, startCity->id, node->g, node->f);
+            retStatus = fillRouteFromBoundedNodes(&search, current, route);
+            break;
+        }
+
+        // (Re)generate the successors: those already in memory by a path as short are kept
+        node->expanded = 1;
+        node->forgotten = INT_MAX;
+        updateBounded(&search, current);
+        int neighbourCount = loadNeighbours(cityMap, node->city, &neighbours);
+        if(neighbourCount < 0) {
+            retStatus = ERRACCESS;
+            break;
+        }
+        for (int neighbourNr = 0; neighbourNr < neighbourCount; neighbourNr++) {
+            if(arcFlags && !flaggedForGoals(arcFlags, arcFlags->edgeStart[node->city->id] + neighbourNr,
+                                            goalRegions, goalRegionCount)) {
+                continue;
+            }
+            City *neighbourCity = cityMap->cities[neighbours.cityIds[neighbourNr]];
+            int gValue = node->g + neighbours.distances[neighbourNr];
+            int fValue = gValue + nearestHValue(neighbourCity, goalCities, goalCount, cityMap->heuristicScale);
+            if(fValue < node->f) {
+                fValue = node->f;
+            }
+
+            int existing = findBoundedNode(&search, neighbourCity);
+            if(existing >= 0) {
+                BoundedNode *other = &search.nodes[existing];
+                if(other->g <= gValue) {
+                    continue;
+                }
+                // Shorter: the node moves under the current one, to be expanded again
+                int oldParent = other->parent;
+                other->g = gValue;
+                other->f = fValue;
+                other->expanded = 0;
+                other->forgotten = INT_MAX;
+                if(oldParent != current) {
+                    other->parent = current;
+                    node->children++;
+                    BoundedNode *previous = &search.nodes[oldParent];
+                    previous->children--;
+                    if(previous->children == 0 && previous->expanded && previous->forgotten == INT_MAX
+                       && previous->parent >= 0) {
+                        releaseBoundedNode(&search, oldParent, INT_MAX);
+                    }
+                    else {
+                        updateBounded(&search, oldParent);
+                    }
+                }
+                updateBounded(&search, existing);
+                updateBounded(&search, current);
+                TRACE_SEARCH(TraceEvent_Reopen, neighbourCity->id, node->city->id, gValue, fValue);
+                continue;
+            }
+
+            int index = allocBoundedNode(&search, fValue);
+            if(index < 0) {
+                // No room for a node as good as the leaves: forgotten at once, the current node is expanded again for it
+                if(fValue < node->forgotten) {
+                    node->forgotten = fValue;
+                }
+                continue;
+            }
+            addBoundedNode(&search, index, neighbourCity, current, gValue, fValue);
+            TRACE_SEARCH(TraceEvent_Relax, neighbourCity->id, node->city->id, gValue, fValue);
+        }
+        if(node->children == 0 && node->forgotten == INT_MAX && node->parent >= 0) {
+            releaseBoundedNode(&search, current, INT_MAX);
+        }
+        else {
+            updateBounded(&search, current);
+        }
+        iterationNr++;
+    }
+
+    freeMemory(scratch, search.nodes, sizeof(BoundedNode) * maxNodes);
+    freeMemory(scratch, search.buckets, sizeof(int) * bucketCount);
+    freeMemory(scratch, search.openHeap, sizeof(int) * maxNodes);
+    freeMemory(scratch, search.leafHeap, sizeof(int) * maxNodes);
+    freeMemory(scratch, neighbours.cityIds, bufferSize);
+    freeMemory(scratch, neighbours.distances, bufferSize);
+    *expansions = iterationNr;
+    return retStatus;
+}
+
+/**
+ * Read the route to the nearest goal from the distance table of the map: the goal with the smallest distance,
+ * then the cities along the next hops, or without them along the neighbours whose edge and table distance
+ * to the goal add up to the distance left
+ * @param cityMap The map, with a distance table
+ * @param startCity The city to start from
+ * @param goalCities The goal cities
+ * @param goalCount The number of goals
+ * @param scratch The allocator of the neighbour buffers
+ * @param route (out) The route
+ * @param goalIndex (out) Index of the nearest goal, may be 0
+ * @return ERRALGORTIHM if no goal can be reached, or the table does not match the edges
+ * @return ERRFULL if the route does not fit
+ * @return ERRACCESS if the neighbours could not be read from disk
+ * @return ERRALLOC if memory allocation failed
+ * @return OK otherwise
+ */
+static status findTableRoute(CityMap *cityMap, City *startCity, City **goalCities, int goalCount, Allocator *scratch,
+                             Route *route, int *goalIndex) {
+    DistanceTable *table = cityMap->distanceTable;
+    int nearest = 0;
+    for (int goalNr = 1; goalNr < goalCount; goalNr++) {
+        if(tableDistance(table, startCity->id, goalCities[goalNr]->id)
+           < tableDistance(table, startCity->id, goalCities[nearest]->id)) {
+            nearest = goalNr;
+        }
+    }
+    int goalId = goalCities[nearest]->id;
+    if(tableDistance(table, startCity->id, goalId) == UNREACHABLE_DISTANCE) {
+        printf("No route from %s: the goal cities are not connected to it.\n", startCity->cityName);
+        return ERRALGORTIHM;
+    }
+
+    size_t bufferSize = sizeof(int) * (cityMap->maxNeighbours ? cityMap->maxNeighbours : 1);
+    NeighbourBuffer neighbours = {0, 0};
+    if(!table->nextHops) {
+        neighbours.cityIds = (int*)allocMemory(scratch, bufferSize);
+        neighbours.distances = (int*)allocMemory(scratch, bufferSize);
+        if(!neighbours.cityIds || !neighbours.distances) {
+            freeMemory(scratch, neighbours.cityIds, bufferSize);
+            freeMemory(scratch, neighbours.distances, bufferSize);
+            return ERRALLOC;
+        }
+    }
+
+    status retStatus = OK;
+    int cityId = startCity->id;
+    int g = 0;
+    int count = 0;
+    while (1) {
+        if(count == route->capacity) {
+            retStatus = ERRFULL;
+            break;
+        }
+        route->cityIds[count] = cityId;
+        route->distances[count++] = g;
+        if(cityId == goalId) {
+            break;
+        }
+        int left = tableDistance(table, cityId, goalId);
+        int next = -1;
+        if(table->nextHops) {
+            next = tableNextHop(table, cityId, goalId);
+        }
+        else {
+            int neighbourCount = loadNeighbours(cityMap, cityMap->cities[cityId], &neighbours);
+            if(neighbourCount < 0) {
+                retStatus = ERRACCESS;  // A page of a paged map could not be read
+                break;
+            }
+            for (int neighbourNr = 0; neighbourNr < neighbourCount && next < 0; neighbourNr++) {
+                int neighbourLeft = tableDistance(table, neighbours.cityIds[neighbourNr], goalId);
+                if(neighbourLeft != UNREACHABLE_DISTANCE && neighbours.distances[neighbourNr] + neighbourLeft == left) {
+                    next = neighbours.cityIds[neighbourNr];
+                }
+            }
+        }
+        if(next < 0) {
+            retStatus = ERRALGORTIHM;   // Not the table of these edges
+            break;
+        }
+        g += left - tableDistance(table, next, goalId);
+        cityId = next;
+    }
+    freeMemory(scratch, neighbours.cityIds, bufferSize);
+    freeMemory(scratch, neighbours.distances, bufferSize);
+    if(retStatus != OK) {
+        route->cityCount = 0;
+        return retStatus;
+    }
+    route->cityCount = count;
+    route->totalDistance = g;
+    if(goalIndex) {
+        *goalIndex = nearest;
+    }
     return OK;
 }
 
-status findRoute(char *startCityName, char *goalCityName, List *cityList) {
+status findNearestRoute(char *startCityName, char **goalCityNames, int goalCount, CityMap *cityMap,
+                        Route *route, RouteOptions *options, int *goalIndex) {
+    uint64_t startTime = latencyNow();
+
+    // A search cancelled or expired before it starts, also one the distance table would answer
+    status interrupted = checkInterrupted(options);
+    if(interrupted != OK) {
+        return interrupted;
+    }
+
     // Validate a valid city map
-    if(!cityList) {
+    if(!cityMap || !cityMap->cityList) {
         printf("The given city map is incorrect.\n");
         return ERREMPTY;
     }
+    if(goalCount <= 0) {
+        printf("No goal cities given.\n");
+        return ERREMPTY;
+    }
     // Validate that the given names are cities in the given city map file
-    City *startCity = findCityByName(startCityName, cityList);
-    City *goalCity = findCityByName(goalCityName, cityList);
+    City *startCity = findCityInMap(startCityName, cityMap);
     if(!startCity) {
         printf("The given start city: %s does not exist on the map.\n",startCityName);
         return ERRABSENT;
     }
-    if(!goalCity) {
-        printf("The given goal city: %s does not exist on the map.\n",goalCityName);
-        return ERRABSENT;
+    Allocator *scratch = options ? options->scratch : 0;
+    City **goalCities = (City**)allocMemory(scratch, sizeof(City*) * goalCount);
+    int *goalRegions = (int*)allocMemory(scratch, sizeof(int) * goalCount);
+    if(!goalCities || !goalRegions) {
+        freeMemory(scratch, goalCities, sizeof(City*) * goalCount);
+        freeMemory(scratch, goalRegions, sizeof(int) * goalCount);
+        return ERRALLOC;
     }
+    ArcFlags *arcFlags = options && options->ignoreArcFlags ? 0 : cityMap->arcFlags;
+    int goalRegionCount = 0;
+    for (int goalNr = 0; goalNr < goalCount; goalNr++) {
+        goalCities[goalNr] = findCityInMap(goalCityNames[goalNr], cityMap);
+        if(!goalCities[goalNr]) {
+            printf("The given goal city: %s does not exist on the map.\n",goalCityNames[goalNr]);
+            freeMemory(scratch, goalCities, sizeof(City*) * goalCount);
+            freeMemory(scratch, goalRegions, sizeof(int) * goalCount);
+            return ERRABSENT;
+        }
+        // Edges flagged for any of the goal regions have to be followed
+        int region = arcFlags ? arcFlags->cityRegion[goalCities[goalNr]->id] : 0;
+        int regionNr = 0;
+        while (regionNr < goalRegionCount && goalRegions[regionNr] != region) {
+            regionNr++;
+        }
+        if(regionNr == goalRegionCount) {
+            goalRegions[goalRegionCount++] = region;
+        }
+    }
+    recordLatency(LatencyMetric_Lookup, latencyNow() - startTime);
 
-    // Create the algorithm lists OPEN and CLOSED
-    List* openList = newList(compCitiesBasedOnName, compCitiesBasedOnF, displayCity);
-    List* closedList = newList(compCitiesBasedOnName, compCitiesBasedOnF, displayCity);
-    if(!openList || !closedList) {
+    // Nothing to search when no goal can be reached from the start
+    int reachable = 0;
+    for (int goalNr = 0; goalNr < goalCount && !reachable; goalNr++) {
+        reachable = mayReach(cityMap->components, startCity->id, goalCities[goalNr]->id);
+    }
+    if(!reachable) {
+        printf("No route from %s: the goal cities are not connected to it.\n", startCityName);
+        freeMemory(scratch, goalCities, sizeof(City*) * goalCount);
+        freeMemory(scratch, goalRegions, sizeof(int) * goalCount);
+        recordLatency(LatencyMetric_FindRoute, latencyNow() - startTime);
+        return ERRALGORTIHM;
+    }
+
+    // Read from the distance table, without a search
+    if(cityMap->distanceTable) {
+        status retStatus = findTableRoute(cityMap, startCity, goalCities, goalCount, scratch, route, goalIndex);
+        freeMemory(scratch, goalCities, sizeof(City*) * goalCount);
+        freeMemory(scratch, goalRegions, sizeof(int) * goalCount);
+        recordLatency(LatencyMetric_FindRoute, latencyNow() - startTime);
+        return retStatus;
+    }
+
+    // Memory-bounded search
+    if(options && options->maxNodes > 0) {
+        unsigned int expansions = 0;
+        status retStatus = findBoundedRoute(cityMap, startCity, goalCities, goalCount, arcFlags, goalRegions,
+                                            goalRegionCount, options, route, goalIndex, &expansions);
+        freeMemory(scratch, goalCities, sizeof(City*) * goalCount);
+        freeMemory(scratch, goalRegions, sizeof(int) * goalCount);
+        recordLatency(LatencyMetric_FindRoute, latencyNow() - startTime);
+        recordLatency(LatencyMetric_Expansions, expansions);
+        return retStatus;
+    }
+
+    // Create the algorithm lists OPEN (ordered on F) and CLOSED of search nodes, hashed for O(1) membership
+    // tests, and room for the neighbours of a city
+    List* openList = newListWithAllocator(ListKind_Hashed, compNodesBasedOnCity, compNodesBasedOnF, displayNode,
+                                          hashNodeOnCity, scratch);
+    List* closedList = newListWithAllocator(ListKind_Hashed, compNodesBasedOnCity, compNodesBasedOnF, displayNode,
+                                            hashNodeOnCity, scratch);
+    size_t bufferSize = sizeof(int) * (cityMap->maxNeighbours ? cityMap->maxNeighbours : 1);
+    NeighbourBuffer neighbours;
+    neighbours.cityIds = (int*)allocMemory(scratch, bufferSize);
+    neighbours.distances = (int*)allocMemory(scratch, bufferSize);
+    SearchNode *startNode = (SearchNode*)allocMemory(scratch, sizeof(SearchNode));
+    if(!openList || !closedList || !neighbours.cityIds || !neighbours.distances || !startNode) {
         printf("Error allocating memory for OPEN or CLOSE list\n");
+        if(openList) delList(openList);
+        if(closedList) delList(closedList);
+        freeMemory(scratch, neighbours.cityIds, bufferSize);
+        freeMemory(scratch, neighbours.distances, bufferSize);
+        freeMemory(scratch, startNode, sizeof(SearchNode));
+        freeMemory(scratch, goalCities, sizeof(City*) * goalCount);
+        freeMemory(scratch, goalRegions, sizeof(int) * goalCount);
         return(ERRALLOC);
     }
 
     /////////////////////////////////
     // 1 Place n0 in OPEN. compute ˆh(n0) and set ˆg(n0) = 0. All otherˆg = INF
-    status retStatus;
-    if((retStatus = addList(openList, startCity)) != OK) {
-        return retStatus;
+    startNode->city = startCity;
+    startNode->g = 0;
+    startNode->f = 0;
+    startNode->backPointer = 0;
+    TRACE_SEARCH(TraceEvent_Start, startCity->id, goalCities[0]->id, 0, goalCount);
+    status retStatus = addList(openList, startNode);
+    if(retStatus != OK) {
+        freeMemory(scratch, startNode, sizeof(SearchNode));
     }
-    startCity->g = 0;
 
     unsigned int iterationNr = 0;
-    while (iterationNr < MAX_A_STAR_ITERATIONS) {
+    while (retStatus == OK && iterationNr < MAX_A_STAR_ITERATIONS) {
+        // Stop a cancelled or expired search, checked every ROUTE_CHECK_INTERVAL expansions
+        if(iterationNr % ROUTE_CHECK_INTERVAL == 0 && (retStatus = checkInterrupted(options)) != OK) {
+            break;
+        }
+
         // --2-- if OPEN is empty, stop (failure)
         if(lengthList(openList) == 0) {
             printf("Error in route algorithm, no nodes in OPEN list.\n");
@@ -363,59 +1427,87 @@ status findRoute(char *startCityName, char *goalCityName, List *cityList) {
         }
 
         // --3-- remove from OPEN the vertex with minimal ˆf , call it n and add it to CLOSED
-        City *minimalFCity_N;
-        remFromListAt(openList, 0, (void**)&minimalFCity_N);
-        if((retStatus = addList(closedList, minimalFCity_N)) != OK) {
+        SearchNode *minimalFNode_N;
+        remFromListAt(openList, 0, (void**)&minimalFNode_N);
+        if((retStatus = addList(closedList, minimalFNode_N)) != OK) {
+            freeMemory(scratch, minimalFNode_N, sizeof(SearchNode));
             break; // Return error after cleanup
         }
+        TRACE_SEARCH(TraceEvent_Pop, minimalFNode_N->city->id,
+                     minimalFNode_N->backPointer ? minimalFNode_N->backPointer->city->id : -1,
+                     minimalFNode_N->g, minimalFNode_N->f);
 
-        // --4-- if n is the goal, stop (success): use pointer chain to retrieve the solution path.
-        if(compCitiesBasedOnName(minimalFCity_N, goalCity) == 0 ) {
-            printBackPointerRoute(minimalFCity_N);
+        // --4-- if n is a goal, stop (success): use pointer chain to retrieve the solution path.
+        // The heuristic is a lower bound for every goal, so the first goal taken is the nearest.
+        int reachedGoal = goalIndexOf(minimalFNode_N->city, goalCities, goalCount);
+        if(reachedGoal >= 0) {
+            if(goalIndex) {
+                *goalIndex = reachedGoal;
+            }
+            TRACE_SEARCH(TraceEvent_Goal, minimalFNode_N->city->id, startCity->id, minimalFNode_N->g, minimalFNode_N->f);
+            retStatus = fillRouteFromNodes(minimalFNode_N, route);
             break; // Success
         }
 
         // --5-- For each successor si of n:
-        int neighbourCount = lengthList(minimalFCity_N->neighbour);
+        int neighbourCount = loadNeighbours(cityMap, minimalFNode_N->city, &neighbours);
+        if(neighbourCount < 0) {
+            retStatus = ERRACCESS;  // A page of a paged map could not be read
+            break;
+        }
         for (int neighbourNr = 0; neighbourNr < neighbourCount; neighbourNr++) {
 
-            // Get the neighbor
-            Neighbour *neighbour = 0;
-            if((retStatus = nthInList(minimalFCity_N->neighbour, neighbourNr, (void**)&neighbour)) != OK) {
-                break; // Return error after cleanup
+            // Skip the edges on no shortest path into the regions of the goals
+            if(arcFlags && !flaggedForGoals(arcFlags, arcFlags->edgeStart[minimalFNode_N->city->id] + neighbourNr,
+                                            goalRegions, goalRegionCount)) {
+                continue;
             }
-            City *neighbourCity = neighbour->city;
+
+            // Get the neighbor
+            City *neighbourCity = cityMap->cities[neighbours.cityIds[neighbourNr]];
 
             // --5.1-- compute ˆg(n) + c(n, si )
-            int gValue = minimalFCity_N->g + neighbour->distance;
+            int gValue = minimalFNode_N->g + neighbours.distances[neighbourNr];
 
             // --5.2-- if si is in OPEN or in CLOSED and ˆg(n) + c(n, si ) > ˆg(si ), skip to next successor
-            City *pCityInOpen = findCityInList(openList, neighbourCity);
-            City *pCityInClosed = findCityInList(closedList, neighbourCity);
-            if((pCityInOpen && gValue > pCityInOpen->g ) ||
-               (pCityInClosed && gValue > pCityInClosed->g)){
+            SearchNode *pNodeInOpen = findNodeInList(openList, neighbourCity);
+            SearchNode *pNodeInClosed = pNodeInOpen ? 0 : findNodeInList(closedList, neighbourCity);
+            if((pNodeInOpen && gValue > pNodeInOpen->g ) ||
+               (pNodeInClosed && gValue > pNodeInClosed->g)){
                 continue;
             }
 
-            // --5.3-- remove si from OPEN and CLOSED if present
+            // --5.3-- remove si from OPEN and CLOSED if present, its node is reused
             // Re-Insert puts the city in the correct (new) position.
-            if(pCityInOpen) {
-                if((retStatus = remFromList(openList, neighbourCity)) != OK) {
+            SearchNode *neighbourNode = pNodeInOpen ? pNodeInOpen : pNodeInClosed;
+            if(pNodeInOpen) {
+                if((retStatus = remFromList(openList, pNodeInOpen)) != OK) {
+                    break; // Return error after cleanup
+                }
+            }
+            if(pNodeInClosed) {
+                if((retStatus = remFromList(closedList, pNodeInClosed)) != OK) {
                     break; // Return error after cleanup
                 }
             }
-            if(pCityInClosed) {
-                if((retStatus = remFromList(closedList, neighbourCity)) != OK) {
+            if(!neighbourNode) {
+                if(!(neighbourNode = (SearchNode*)allocMemory(scratch, sizeof(SearchNode)))) {
+                    retStatus = ERRALLOC;
                     break; // Return error after cleanup
                 }
+                neighbourNode->city = neighbourCity;
             }
 
             // --5.4-- insert si in OPEN and update ˆg(si ) and back-path pointer
-            neighbourCity->g = gValue;
-            neighbourCity->f = neighbourCity->g + calculateHValue(neighbourCity, goalCity);
-            neighbourCity->backPointer = minimalFCity_N;
+            neighbourNode->g = gValue;
+            neighbourNode->f = neighbourNode->g + nearestHValue(neighbourCity, goalCities, goalCount,
+                                                                cityMap->heuristicScale);
+            neighbourNode->backPointer = minimalFNode_N;
+            TRACE_SEARCH(pNodeInOpen || pNodeInClosed ? TraceEvent_Reopen : TraceEvent_Relax, neighbourCity->id,
+                         minimalFNode_N->city->id, neighbourNode->g, neighbourNode->f);
 
-            if((retStatus = addList(openList, neighbourCity)) != OK) {
+            if((retStatus = addList(openList, neighbourNode)) != OK) {
+                freeMemory(scratch, neighbourNode, sizeof(SearchNode));
                 break; // Return error after cleanup
             }
         }
@@ -431,9 +1523,15 @@ status findRoute(char *startCityName, char *goalCityName, List *cityList) {
     printf("A* iterations: %d\n", iterationNr);
 #endif
 
-    // Cleanup the used lists
-    delList(openList);
-    delList(closedList);
+    // Cleanup the used lists, with all nodes of the search
+    releaseNodes(openList, scratch);
+    releaseNodes(closedList, scratch);
+    freeMemory(scratch, neighbours.cityIds, bufferSize);
+    freeMemory(scratch, neighbours.distances, bufferSize);
+    freeMemory(scratch, goalCities, sizeof(City*) * goalCount);
+    freeMemory(scratch, goalRegions, sizeof(int) * goalCount);
+    recordLatency(LatencyMetric_FindRoute, latencyNow() - startTime);
+    recordLatency(LatencyMetric_Expansions, iterationNr);
 
     // Return the correct status
     if(retStatus != OK){
@@ -15,22 +15,27 @@
 #include "List.h"
 
 //#define ENABLE_DEBUG_INFO
-#define MAX_CITYNAME_LENGTH     (64)
+#define MAX_CITYNAME_LENGTH     (1024)
+#define CITYNAME_FORMAT         "%1023s"     // Reads at most MAX_CITYNAME_LENGTH-1 characters
 #define MAX_A_STAR_ITERATIONS   (10000)
+#define MAX_BOUNDED_ITERATIONS  (10 * MAX_A_STAR_ITERATIONS)    // A memory-bounded search expands cities again
+#define ROUTE_CHECK_INTERVAL    (64)        // Expansions between the checks for cancellation and deadline
+#define DEFAULT_HEURISTIC_SCALE (0.25)      // Scale of the heuristic when no edge limits it
 
 /**
- * City structure containing location for heuristic calculation
- * and the current G and H values during used during A Start algorithm
- * A list of neighbour cities for path finding, and a packpointer to trace back the path
+ * City structure: its id, its interned name, its position for the heuristic (with hasPosition)
+ * and the list of its neighbour cities for path finding (0 when the map is packed or paged).
+ * Searches keep their state (g, f, predecessor) in their own SearchNodes, not in the City,
+ * so the map is not changed by searches and searches can run in parallel.
+ * The id of a city is the id of its interned name, the name itself is stored in the map's name arena.
  * */
 typedef struct City {
+    int id;
     char* cityName;
     int longitude;
     int latitude;
-    int g;
-    int f;
+    int hasPosition;            // Set when the city's own line was read, not for a city only named as neighbour
     List *neighbour;
-    struct City *backPointer;
 }City;
 
 /**
@@ -41,6 +46,39 @@ typedef struct Neighbour {
     int distance;
 }Neighbour;
 
+/**
+ * A loaded city map: the list of cities read from the .MAP file in order of id,
+ * and an index to reach every city directly by its id (0..cityCount-1)
+ * When packed (see PackedGraph.h) or paged (see PagedGraph.h), the neighbours are no longer in the City's neighbour list.
+ * All memory of the map (except the CityMap itself) is allocated through memory, which counts it.
+ */
+typedef struct CityMap {
+    List *cityList;
+    City **cities;
+    int cityCount;
+    int cityCapacity;
+    int maxNeighbours;
+    struct StringArena *names;
+    struct PackedGraph *packed;
+    struct PagedGraph *paged;           // Neighbours read from disk through a page cache, see PagedGraph.h
+    struct ArcFlags *arcFlags;
+    struct Components *components;      // Connected components of the cities, see Components.h
+    struct DistanceTable *distanceTable;    // All-pairs distances answering findRoute(), see DistanceTable.h
+    double heuristicScale;      // Distance per coordinate unit of the heuristic, see calibrateHeuristic()
+    TrackingAllocator memory;
+}CityMap;
+
+/**
+ * Options of a route search
+ */
+typedef struct RouteOptions {
+    Allocator *scratch;                 // Allocator of the search lists and buffers, 0 for malloc
+    int ignoreArcFlags;                 // Follow all edges, also when the map has arc-flags (see ArcFlags.h)
+    int *cancelled;                     // Set non zero (atomically) to stop the search with ERRCANCELLED, may be 0
+    struct timespec *deadline;          // CLOCK_MONOTONIC time to stop the search with ERRTIMEOUT, may be 0
+    int maxNodes;                       // Most search nodes in memory at once (SMA*), 0 for no bound
+}RouteOptions;
+
 /**
  * Interpretation of read number of params in a .MAP file
  */
@@ -50,38 +88,222 @@ enum MapReadParams{
 };
 
 /**
- * Populate a List with Cities with their position and neighbours.
- * Input for the list is an file which contains all the information
+ * Populate a CityMap with Cities with their position and neighbours.
+ * Input for the map is an file which contains all the information
+ * Every city gets an unique id, in order of appearance in the file.
  *
  * @param path Location of the input file
- * @param cityMapList Pointer to list pointer which will be assigned to populated list
+ * @param cityMap Pointer to map pointer which will be assigned to populated map
  * @return OK if no error
  * @return Error code when there was an error
  */
-status createMap(char *path, List **cityMapList);
+status createMap(char *path, CityMap **cityMap);
+
+/**
+ * Populate a CityMap as createMap() does, with all its memory taken from an allocator.
+ *
+ * @param path Location of the input file
+ * @param cityMap Pointer to map pointer which will be assigned to populated map
+ * @param allocator The allocator of the map's memory, 0 for malloc
+ * @return OK if no error
+ * @return Error code when there was an error
+ */
+status createMapWithAllocator(char *path, CityMap **cityMap, Allocator *allocator);
+
+/**
+ * Populate a CityMap as createMap() does, with its neighbours packed (see PackedGraph.h) as the file is read:
+ * the edges are collected in an array of 12 bytes per edge and packed at the end, the neighbour lists are
+ * never built. The map is the same as after createMap() and packMap().
+ *
+ * @param path Location of the input file
+ * @param cityMap Pointer to map pointer which will be assigned to populated map
+ * @return ERRUNABLE if a distance is negative
+ * @return OK if no error
+ * @return Error code when there was an error
+ */
+status createPackedMap(char *path, CityMap **cityMap);
+
+/**
+ * Populate a CityMap from a file as createMap() does, but only to be merged by mergeMaps(): the neighbour
+ * lists stay in file order, the heuristic is not calibrated and the components are not computed.
+ * mergeMaps() does that once for the merged map.
+ *
+ * @param path Location of the input file
+ * @param cityMap Pointer to map pointer which will be assigned to populated map
+ * @return OK if no error
+ * @return Error code when there was an error
+ */
+status createShardMap(char *path, CityMap **cityMap);
+
+/**
+ * Create a map without cities, to be filled with mergeMaps()
+ *
+ * @param cityMap Pointer to map pointer which will be assigned to the new map
+ * @param allocator The allocator of the map's memory, 0 for malloc
+ * @return ERRALLOC if memory allocation failed
+ * @return OK otherwise
+ */
+status createEmptyMap(CityMap **cityMap, Allocator *allocator);
+
+/**
+ * Add the cities and neighbours of other maps to a map, in order. Cities are matched by name: a city in
+ * several maps (a border city) gets the neighbours of all, and its position from the map which defines it
+ * (hasPosition). New cities get the next ids, in the order of the other maps. Arc-flags of the map are dropped;
+ * its neighbour lists are sorted, its heuristic is calibrated and its components are computed again, once for
+ * all maps. Its distance table is dropped. The maps may come from createShardMap().
+ *
+ * @param cityMap The map to add to
+ * @param others The maps to add, unchanged
+ * @param otherCount The number of maps to add
+ * @return ERRUNABLE if one of the maps is packed or paged
+ * @return ERRALLOC if memory allocation failed, the map is partially merged then
+ * @return OK otherwise
+ */
+status mergeMaps(CityMap *cityMap, CityMap **others, int otherCount);
+
+/**
+ * Number of bytes of memory used by a map, including its packed graph and names
+ * @param cityMap The map
+ * @return the size in bytes
+ */
+size_t mapFootprint(CityMap *cityMap);
+
+/**
+ * Get a city based on name, if it does not exist, it creates the city with the next id, without neighbours.
+ * @param cityName The name of the city to search for
+ * @param cityMap The map to search in, and to add the city to
+ * @param city Pointer to city pointer which will be assigned to allocated city.
+ * @return error code if unable to get or create city
+ * @return OK if city was found or created and set in city
+ */
+status getOrCreateCity(char *cityName, CityMap *cityMap, City **city);
+
+/**
+ * Release the neighbour list of a city, and its Neighbours
+ * @param cityMap The map the city is in
+ * @param city The city
+ */
+void releaseNeighbours(CityMap *cityMap, City *city);
+
+struct Route;
 
 /**
  * Find a Route between given cities based on the given city map
  * The algorithm uses an A* implementation to calculate the best route
  * An heuristic function based on latituda and altitude is used.
  * Max iterations of A* algorithm can be set with: MAX_A_STAR_ITERATIONS
+ * Nothing is printed for a found route, use the writers of Route.h to output it.
+ * When the map has arc-flags (see buildArcFlags()), only the edges flagged for the goal are followed.
+ * When the map has a distance table (see loadDistanceTable()), the route is read from it without a search.
  *
  * @param startCityName Name of the city to start from.
  * @param goalCityName Name of the city which is the goal.
- * @param startCityName Map containing all cities and necessary location information.
+ * @param cityMap Map containing all cities and necessary location information.
+ * @param route (out) The found route, created with room for all cities of the map (see newRoute()).
  * @return OK if no error
  * @return Error code when there was an error
  */
-status findRoute(char *startCityName, char *goalCityName, List *cityList);
+status findRoute(char *startCityName, char *goalCityName, CityMap *cityMap, struct Route *route);
+
+/**
+ * Find a Route as findRoute() does, with options for the search.
+ * With an arena as scratch allocator, the search allocates nothing else: the arena can be reset
+ * after the route is read (see resetArenaAllocator()).
+ * The cancelled flag and the deadline of the options are checked before the search starts (also before a
+ * distance table answers) and every ROUTE_CHECK_INTERVAL expansions (see checkInterrupted());
+ * a stopped search releases its lists and buffers before returning.
+ *
+ * With maxNodes set, the search is memory-bounded (SMA*): it keeps at most maxNodes nodes, about 64 bytes
+ * each, allocated from the scratch allocator at its start. When all are in use, the node with the largest f
+ * without successors in memory is dropped, and its f kept by its predecessor, which is expanded again when
+ * that f is the smallest. The route is still the shortest when the nodes suffice for the cities along it
+ * and those branching off it; with fewer, the search expands more cities again, up to MAX_BOUNDED_ITERATIONS.
+ *
+ * @param startCityName Name of the city to start from.
+ * @param goalCityName Name of the city which is the goal.
+ * @param cityMap Map containing all cities and necessary location information.
+ * @param route (out) The found route, created with room for all cities of the map (see newRoute()).
+ * @param options The options of the search, 0 for the defaults
+ * @return ERRCANCELLED if the search was cancelled
+ * @return ERRTIMEOUT if the deadline passed
+ * @return OK if no error
+ * @return Error code when there was an error
+ */
+status findRouteWithOptions(char *startCityName, char *goalCityName, CityMap *cityMap, struct Route *route,
+                            RouteOptions *options);
+
+/**
+ * Tell if a search has to stop early: cancelled by its caller, or past its deadline
+ * @param options The options of the search, may be 0
+ * @return ERRCANCELLED if the search is cancelled
+ * @return ERRTIMEOUT if the deadline has passed
+ * @return OK otherwise
+ */
+status checkInterrupted(RouteOptions *options);
+
+/**
+ * Find the route to the nearest of a set of goal cities, in one search.
+ * A* with the heuristic of the nearest goal (the smallest of the goals' heuristics, still a lower bound),
+ * which stops at the first goal taken from OPEN: no other goal can be nearer.
+ * With arc-flags, the edges flagged for any of the goals' regions are followed. With a distance table,
+ * the goal with the smallest distance in it is taken, and its route read from it.
+ *
+ * @param startCityName Name of the city to start from.
+ * @param goalCityNames Names of the goal cities.
+ * @param goalCount The number of goal cities, at least 1.
+ * @param cityMap Map containing all cities and necessary location information.
+ * @param route (out) The route to the nearest goal, created with room for all cities of the map (see newRoute()).
+ * @param options The options of the search, 0 for the defaults
+ * @param goalIndex (out) Index in goalCityNames of the nearest goal, may be 0
+ * @return ERREMPTY if there are no goals
+ * @return ERRABSENT if a city does not exist on the map
+ * @return ERRALGORTIHM if no goal can be reached
+ * @return OK if no error
+ */
+status findNearestRoute(char *startCityName, char **goalCityNames, int goalCount, CityMap *cityMap,
+                        struct Route *route, RouteOptions *options, int *goalIndex);
+
+/**
+ * Find a city by name
+ * @param name The name of the city to search for
+ * @param cityMap The map to search in
+ * @return 0 if city was not found
+ * @return The city when the city is in the map
+ */
+City* findCityInMap(char *name, CityMap *cityMap);
+
+/**
+ * Heuristic distance between two cities, based on their latitude and longitude:
+ * the coordinate distance |dLatitude| + |dLongitude| times the scale
+ * @param cityFrom The city to estimate the distance from
+ * @param cityTo The city to estimate the distance to
+ * @param scale The distance per coordinate unit, the heuristicScale of the map
+ * @return the estimated distance
+ */
+int calculateHValue(City *cityFrom, City *cityTo, double scale);
+
+/**
+ * Calibrate the heuristic of a map: set heuristicScale to the largest scale which keeps
+ * calculateHValue() a lower bound of every route, the smallest edge distance / coordinate distance
+ * over all neighbours. Edges without coordinate distance do not limit the scale, when none does
+ * the scale is DEFAULT_HEURISTIC_SCALE. createMap() calibrates, call again after changing edges.
+ *
+ * The coordinate distance obeys the triangle inequality, so the scaled heuristic of a route is at
+ * most the sum over its edges, at most its distance: findRoute() stays optimal.
+ *
+ * @param cityMap The map
+ * @return the scale
+ */
+double calibrateHeuristic(CityMap *cityMap);
 
 /**
  * Clean up of the created Map containing the City list
  * !! Should always be called to prevent memory leaks !!
  *   Even when there was an error during creating of the Map, which could be partially filled.
  *
- * @param cityList Name of the city to start from.
+ * @param cityMap The map to destroy.
  */
-void destroyMap(List *cityList);
+void destroyMap(CityMap *cityMap);
 
 
 #endif //ADVANCED_C_CLASS_CITY_H
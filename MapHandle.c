@@ -0,0 +1,186 @@
+/**
+ * @file MapHandle.c
+ * @brief Epoch based replacement of the current map.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <string.h>
+#include <sched.h>
+#include <time.h>
+#include "MapHandle.h"
+
+/** Slot where this thread found a free slot last, tried first on the next pin */
+static __thread int slotHint;
+
+status newMapHandle(CityMap *cityMap, int readerCount, MapHandle **handle) {
+    *handle = (MapHandle*)calloc(1, sizeof(MapHandle));
+    if(!*handle) {
+        return ERRALLOC;
+    }
+    MapHandle *newHandle = *handle;
+    newHandle->readerCount = readerCount > 0 ? readerCount : MAP_HANDLE_DEFAULT_READERS;
+    newHandle->readers = (ReaderSlot*)calloc(newHandle->readerCount, sizeof(ReaderSlot));
+    if(!newHandle->readers) {
+        free(newHandle);
+        *handle = 0;
+        return ERRALLOC;
+    }
+    newHandle->cityMap = cityMap;
+    newHandle->epoch = 1;
+    newHandle->reloadResult = OK;
+    pthread_mutex_init(&newHandle->lock, 0);
+    return OK;
+}
+
+CityMap* pinMap(MapHandle *handle, int *pin) {
+    int slot = slotHint < handle->readerCount ? slotHint : 0;
+    while (1) {
+        for (int tried = 0; tried < handle->readerCount; tried++) {
+            uint64_t free = 0;
+            uint64_t epoch = __atomic_load_n(&handle->epoch, __ATOMIC_SEQ_CST);
+            if(__atomic_load_n(&handle->readers[slot].epoch, __ATOMIC_RELAXED) == 0
+               && __atomic_compare_exchange_n(&handle->readers[slot].epoch, &free, epoch, 0,
+                                              __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+                // The epoch is written before the map is read: a swap after it waits for this slot
+                slotHint = slot;
+                *pin = slot;
+                return __atomic_load_n(&handle->cityMap, __ATOMIC_SEQ_CST);
+            }
+            slot = slot + 1 < handle->readerCount ? slot + 1 : 0;
+        }
+        sched_yield();  // All slots in use
+    }
+}
+
+void unpinMap(MapHandle *handle, int pin) {
+    __atomic_store_n(&handle->readers[pin].epoch, 0, __ATOMIC_RELEASE);
+}
+
+/**
+ * Destroy the replaced maps no slot can still read, see reclaimMaps()
+ * @param handle the handle, locked
+ * @return the number of replaced maps still pinned
+ */
+static int reclaimLocked(MapHandle *handle) {
+    uint64_t oldest = UINT64_MAX;
+    for (int slot = 0; slot < handle->readerCount; slot++) {
+        uint64_t epoch = __atomic_load_n(&handle->readers[slot].epoch, __ATOMIC_SEQ_CST);
+        if(epoch && epoch < oldest) {
+            oldest = epoch;
+        }
+    }
+    int pinned = 0;
+    RetiredMap **link = &handle->retired;
+    while (*link) {
+        RetiredMap *retired = *link;
+        if(retired->epoch <= oldest) {
+            *link = retired->next;
+            destroyMap(retired->cityMap);
+            free(retired);
+        }
+        else {
+            pinned++;
+            link = &retired->next;
+        }
+    }
+    return pinned;
+}
+
+status publishMap(MapHandle *handle, CityMap *cityMap) {
+    RetiredMap *retired = (RetiredMap*)malloc(sizeof(RetiredMap));
+    if(!retired) {
+        return ERRALLOC;
+    }
+    pthread_mutex_lock(&handle->lock);
+    retired->cityMap = __atomic_exchange_n(&handle->cityMap, cityMap, __ATOMIC_SEQ_CST);
+    retired->epoch = __atomic_add_fetch(&handle->epoch, 1, __ATOMIC_SEQ_CST);
+    retired->next = handle->retired;
+    handle->retired = retired;
+    handle->reloads++;
+    reclaimLocked(handle);
+    pthread_mutex_unlock(&handle->lock);
+    return OK;
+}
+
+int reclaimMaps(MapHandle *handle) {
+    pthread_mutex_lock(&handle->lock);
+    int pinned = reclaimLocked(handle);
+    pthread_mutex_unlock(&handle->lock);
+    return pinned;
+}
+
+/**
+ * Background thread of a reload: load the map, publish it, and destroy the old one when it is unpinned
+ * @param argument the MapHandle
+ * @return 0
+ */
+static void *reloadWorker(void *argument) {
+    MapHandle *handle = (MapHandle*)argument;
+    CityMap *cityMap = 0;
+    status ret = handle->loader(handle->reloadPath, &cityMap);
+    if(ret == OK) {
+        ret = publishMap(handle, cityMap);
+    }
+    if(ret != OK) {
+        destroyMap(cityMap);
+    }
+    struct timespec interval = {0, MAP_RECLAIM_INTERVAL_US * 1000L};
+    while (reclaimMaps(handle) > 0) {
+        nanosleep(&interval, 0);
+    }
+    handle->reloadResult = ret;
+    __atomic_store_n(&handle->reloading, 0, __ATOMIC_RELEASE);
+    return 0;
+}
+
+status reloadMap(MapHandle *handle, char *path, MapLoader loader) {
+    int idle = 0;
+    if(!__atomic_compare_exchange_n(&handle->reloading, &idle, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        return ERRUNABLE;
+    }
+    // The previous reloader has finished
+    if(handle->reloaderStarted) {
+        pthread_join(handle->reloader, 0);
+        handle->reloaderStarted = 0;
+    }
+    size_t size = strlen(path) + 1;
+    char *reloadPath = (char*)realloc(handle->reloadPath, size);
+    if(!reloadPath) {
+        __atomic_store_n(&handle->reloading, 0, __ATOMIC_RELEASE);
+        return ERRALLOC;
+    }
+    memcpy(reloadPath, path, size);
+    handle->reloadPath = reloadPath;
+    handle->loader = loader ? loader : createMap;
+    if(pthread_create(&handle->reloader, 0, reloadWorker, handle) != 0) {
+        __atomic_store_n(&handle->reloading, 0, __ATOMIC_RELEASE);
+        return ERRUNABLE;
+    }
+    handle->reloaderStarted = 1;
+    return OK;
+}
+
+int mapReloading(MapHandle *handle) {
+    return __atomic_load_n(&handle->reloading, __ATOMIC_ACQUIRE);
+}
+
+status waitMapReload(MapHandle *handle) {
+    if(handle->reloaderStarted) {
+        pthread_join(handle->reloader, 0);
+        handle->reloaderStarted = 0;
+    }
+    return handle->reloadResult;
+}
+
+void destroyMapHandle(MapHandle *handle) {
+    if(!handle) {
+        return;
+    }
+    waitMapReload(handle);
+    reclaimMaps(handle);
+    destroyMap(handle->cityMap);
+    pthread_mutex_destroy(&handle->lock);
+    free(handle->reloadPath);
+    free(handle->readers);
+    free(handle);
+}
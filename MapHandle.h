@@ -0,0 +1,146 @@
+/**
+ * @file MapHandle.h
+ * @brief Handle to the current map of a long running process, replaced without stopping the queries on it.
+ *
+ * Queries pin the map they search (pinMap()) and unpin it when they no longer read it or its routes.
+ * A new map is loaded by a background thread (reloadMap()) and published with an atomic swap: queries
+ * pinning after the swap get the new map, those which pinned before keep the old one. The old map is
+ * destroyed by the background thread once no query pinned it any more.
+ *
+ * Epoch based reclamation: the handle counts the swaps in an epoch. A query pins by writing the epoch into
+ * a free reader slot, then reading the map pointer; unpinning clears the slot. A map replaced at the swap
+ * to epoch E can be destroyed when no slot holds an epoch below E: a query which pinned before the swap
+ * has written an older epoch, one which pinned after can only have read the new pointer.
+ * Pinning and unpinning are a compare-and-swap and a store on a slot of their own cache line, they never
+ * wait for a reload; destroying the old map is left to the background thread, not to the last query.
+ */
+#ifndef ADVANCED_C_CLASS_MAPHANDLE_H
+#define ADVANCED_C_CLASS_MAPHANDLE_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include "Map.h"
+
+/** Default number of reader slots: queries pinned at once */
+#define MAP_HANDLE_DEFAULT_READERS      (64)
+/** Interval at which the background thread checks whether the old map is still pinned, in microseconds */
+#define MAP_RECLAIM_INTERVAL_US         (1000)
+
+/**
+ * Function loading a map, as createMap()
+ */
+typedef status (*MapLoader)(char *path, CityMap **cityMap);
+
+/**
+ * Epoch of a reader slot, alone on its cache line: 0 when free
+ */
+typedef struct ReaderSlot {
+    uint64_t epoch;
+    char padding[64 - sizeof(uint64_t)];
+}ReaderSlot;
+
+/**
+ * A replaced map, destroyed when no reader holds an epoch below its epoch
+ */
+typedef struct RetiredMap {
+    CityMap *cityMap;
+    uint64_t epoch;
+    struct RetiredMap *next;
+}RetiredMap;
+
+/**
+ * The current map, the reader slots and the reloads
+ */
+typedef struct MapHandle {
+    CityMap *cityMap;               // The current map, read and swapped atomically
+    uint64_t epoch;                 // Number of swaps + 1, read and written atomically
+    ReaderSlot *readers;
+    int readerCount;
+    pthread_mutex_t lock;           // Held by the swaps and the reclamation, never by readers
+    RetiredMap *retired;
+    long reloads;                   // Maps published after the first
+    MapLoader loader;
+    char *reloadPath;
+    pthread_t reloader;
+    int reloaderStarted;            // A reloader thread was started and not joined
+    int reloading;                  // Set while a reload runs, read and written atomically
+    status reloadResult;
+}MapHandle;
+
+/**
+ * Create a handle to a map
+ * @param cityMap The first map, destroyed by the handle from then on
+ * @param readerCount The number of queries pinned at once, 0 for MAP_HANDLE_DEFAULT_READERS
+ * @param handle Pointer to handle pointer which will be assigned to the new handle
+ * @return ERRALLOC if memory allocation failed, the map is not destroyed then
+ * @return OK otherwise
+ */
+status newMapHandle(CityMap *cityMap, int readerCount, MapHandle **handle);
+
+/**
+ * Pin the current map: it is not destroyed before unpinMap(). Never waits for a reload; only when
+ * readerCount queries are pinned already, it yields until a slot is free.
+ * @param handle The handle
+ * @param pin (out) the pin, to give to unpinMap()
+ * @return the current map
+ */
+CityMap* pinMap(MapHandle *handle, int *pin);
+
+/**
+ * Unpin a map pinned by pinMap(): the map, and routes found on it, are not to be read any more
+ * @param handle The handle
+ * @param pin The pin
+ */
+void unpinMap(MapHandle *handle, int pin);
+
+/**
+ * Make a map the current one. The old map is destroyed when no query pins it any more, by this call
+ * or by a later reclaimMaps().
+ * @param handle The handle
+ * @param cityMap The new map, destroyed by the handle from then on
+ * @return ERRALLOC if memory allocation failed, the map is not published then
+ * @return OK otherwise
+ */
+status publishMap(MapHandle *handle, CityMap *cityMap);
+
+/**
+ * Destroy the replaced maps which no query pins any more
+ * @param handle The handle
+ * @return the number of replaced maps still pinned
+ */
+int reclaimMaps(MapHandle *handle);
+
+/**
+ * Load a new map in a background thread and publish it. The thread then destroys the old map as soon as
+ * it is no longer pinned. Returns at once.
+ * @param handle The handle
+ * @param path Location of the new map, copied
+ * @param loader The function loading the map, 0 for createMap()
+ * @return ERRUNABLE if a reload is running, or its thread could not be started
+ * @return ERRALLOC if memory allocation failed
+ * @return OK otherwise
+ */
+status reloadMap(MapHandle *handle, char *path, MapLoader loader);
+
+/**
+ * Tell if a reload runs
+ * @param handle The handle
+ * @return non zero while the new map is loaded, or the old one waits to be destroyed
+ */
+int mapReloading(MapHandle *handle);
+
+/**
+ * Wait until the last reload is finished: the new map published and the old one destroyed
+ * (so not while pinning the old map). To be called by one thread at a time.
+ * @param handle The handle
+ * @return the result of loading the new map, OK if there was no reload
+ */
+status waitMapReload(MapHandle *handle);
+
+/**
+ * Wait for a reload, and destroy the handle and its maps. No map may be pinned.
+ * @param handle The handle, may be 0
+ */
+void destroyMapHandle(MapHandle *handle);
+
+#endif //ADVANCED_C_CLASS_MAPHANDLE_H
@@ -0,0 +1,28 @@
+/**
+ * @file MapLists.h
+ * @brief Typed lists (see TypedList.h) of the map's element types.
+ *
+ * CityList: City pointers, ordered and searched on the id of the city.
+ * NeighbourList: Neighbours stored by value, ordered and searched on the id of their city.
+ * NameList: city names, ordered and searched with strcmp().
+ */
+#ifndef ADVANCED_C_CLASS_MAPLISTS_H
+#define ADVANCED_C_CLASS_MAPLISTS_H
+
+#include <string.h>
+#include "Map.h"
+#include "TypedList.h"
+
+#define CITY_COMPARE_ID(city1, city2)           (((city1)->id > (city2)->id) - ((city1)->id < (city2)->id))
+#define CITY_EQUAL_ID(city1, city2)             ((city1)->id == (city2)->id)
+#define NEIGHBOUR_COMPARE_ID(neighbour1, neighbour2) \
+    (((neighbour1).city->id > (neighbour2).city->id) - ((neighbour1).city->id < (neighbour2).city->id))
+#define NEIGHBOUR_EQUAL_ID(neighbour1, neighbour2)  ((neighbour1).city->id == (neighbour2).city->id)
+#define NAME_COMPARE(name1, name2)              strcmp(name1, name2)
+#define NAME_EQUAL(name1, name2)                (strcmp(name1, name2) == 0)
+
+DEFINE_TYPED_LIST(CityList, City*, CITY_COMPARE_ID, CITY_EQUAL_ID)
+DEFINE_TYPED_LIST(NeighbourList, Neighbour, NEIGHBOUR_COMPARE_ID, NEIGHBOUR_EQUAL_ID)
+DEFINE_TYPED_LIST(NameList, char*, NAME_COMPARE, NAME_EQUAL)
+
+#endif //ADVANCED_C_CLASS_MAPLISTS_H
@@ -0,0 +1,367 @@
+/**
+ * @file MultiStop.c
+ * @brief Stop ordering by dynamic programming or local search on a distance table, and the legs between them.
+ */
+
+#include <string.h>
+#include "MultiStop.h"
+#include "Heap.h"
+
+/**
+ * State of the Dijkstra searches of a multi-stop route, reused by all of them
+ */
+typedef struct LegSearch {
+    Graph *graph;
+    Heap heap;
+    int *distances;         // UNREACHABLE_DISTANCE for every city not touched by the current search
+    int *predecessors;
+    int *touched;           // Cities of which the current search set the distance
+    int touchedCount;
+    int *targetCount;       // Number of points at every city
+}LegSearch;
+
+/**
+ * Search from a city until all targets are settled, or a single target when given
+ * @param search the state, clean from the previous search
+ * @param startCityId the city to start from
+ * @param targets the number of targets to settle (the points not at the start)
+ * @param goalCityId the only target, or -1 to settle all points (of targetCount)
+ * @return ERRALLOC if memory allocation failed
+ * @return OK otherwise
+ */
+static status searchLegs(LegSearch *search, int startCityId, int targets, int goalCityId) {
+    Graph *graph = search->graph;
+    int *distances = search->distances;
+    clearHeap(&search->heap);
+    distances[startCityId] = 0;
+    search->predecessors[startCityId] = -1;
+    search->touched[search->touchedCount++] = startCityId;
+    status ret = pushHeap(&search->heap, 0, startCityId);
+
+    HeapEntry entry;
+    while (ret == OK && targets > 0 && popHeap(&search->heap, &entry) == OK) {
+        if(entry.key > distances[entry.cityId]) {
+            continue;
+        }
+        if(goalCityId >= 0 ? entry.cityId == goalCityId : entry.cityId != startCityId) {
+            targets -= goalCityId >= 0 ? 1 : search->targetCount[entry.cityId];
+        }
+        for (int edge = graph->edgeStart[entry.cityId]; edge < graph->edgeStart[entry.cityId + 1]; edge++) {
+            int distance = entry.key + graph->edgeDistance[edge];
+            int city = graph->edgeCity[edge];
+            if(distance < distances[city]) {
+                if(distances[city] == UNREACHABLE_DISTANCE) {
+                    search->touched[search->touchedCount++] = city;
+                }
+                distances[city] = distance;
+                search->predecessors[city] = entry.cityId;
+                if((ret = pushHeap(&search->heap, distance, city)) != OK) {
+                    break;
+                }
+            }
+        }
+    }
+    return ret;
+}
+
+/**
+ * Make the state clean for the next search: only the touched cities are reset
+ * @param search the state
+ */
+static void resetLegs(LegSearch *search) {
+    for (int i = 0; i < search->touchedCount; i++) {
+        search->distances[search->touched[i]] = UNREACHABLE_DISTANCE;
+    }
+    search->touchedCount = 0;
+}
+
+/**
+ * Length of a path through the points, from the start (0) through the stops in an order to the end
+ * @param table distance from point i to point j at [i * pointCount + j]
+ * @param pointCount the start, the stops and the end
+ * @param order the stops (1..pointCount-2) in the order visited
+ * @return the length, at least UNREACHABLE_DISTANCE if a leg cannot be travelled
+ */
+static long long pathLength(int *table, int pointCount, int *order) {
+    long long length = 0;
+    int previous = 0;
+    for (int i = 0; i < pointCount - 2; i++) {
+        length += table[previous * pointCount + order[i]];
+        previous = order[i];
+    }
+    return length + table[previous * pointCount + pointCount - 1];
+}
+
+/**
+ * Shortest order of the stops, by dynamic programming over the subsets of stops (Held-Karp)
+ * @param table the distances between the points
+ * @param pointCount the start, the stops and the end
+ * @param order (out) the stops in the order visited
+ * @return ERRALLOC if memory allocation failed
+ * @return OK otherwise
+ */
+static status exactOrder(int *table, int pointCount, int *order) {
+    int stopCount = pointCount - 2;
+    size_t subsetCount = (size_t)1 << stopCount;
+    // Shortest path from the start through the stops of a subset, ending in one of them
+    long long *lengths = (long long*)malloc(sizeof(long long) * subsetCount * (stopCount ? stopCount : 1));
+    if(!lengths) {
+        return ERRALLOC;
+    }
+    for (size_t subset = 1; subset < subsetCount; subset++) {
+        for (int last = 0; last < stopCount; last++) {
+            long long *length = &lengths[subset * stopCount + last];
+            size_t rest = subset & ~((size_t)1 << last);
+            if(!(subset & ((size_t)1 << last))) {
+                continue;
+            }
+            if(!rest) {
+                *length = table[last + 1];
+                continue;
+            }
+            *length = -1;
+            for (int previous = 0; previous < stopCount; previous++) {
+                if(rest & ((size_t)1 << previous)) {
+                    long long candidate = lengths[rest * stopCount + previous]
+                                          + table[(previous + 1) * pointCount + last + 1];
+                    if(*length < 0 || candidate < *length) {
+                        *length = candidate;
+                    }
+                }
+            }
+        }
+    }
+
+    // Back from the end: the last stop of the best path, then the best before it in the rest
+    size_t subset = subsetCount - 1;
+    int next = pointCount - 1;
+    for (int position = stopCount - 1; position >= 0; position--) {
+        int best = -1;
+        long long bestLength = 0;
+        for (int last = 0; last < stopCount; last++) {
+            if(subset & ((size_t)1 << last)) {
+                long long length = lengths[subset * stopCount + last] + table[(last + 1) * pointCount + next];
+                if(best < 0 || length < bestLength) {
+                    best = last;
+                    bestLength = length;
+                }
+            }
+        }
+        order[position] = best + 1;
+        subset &= ~((size_t)1 << best);
+        next = best + 1;
+    }
+    free(lengths);
+    return OK;
+}
+
+/**
+ * Short order of the stops: nearest neighbour first, then 2-opt and Or-opt moves while they shorten it
+ * @param table the distances between the points
+ * @param pointCount the start, the stops and the end
+ * @param order (out) the stops in the order visited
+ * @return ERRALLOC if memory allocation failed
+ * @return OK otherwise
+ */
+static status localSearchOrder(int *table, int pointCount, int *order) {
+    int stopCount = pointCount - 2;
+    int *candidate = (int*)malloc(sizeof(int) * stopCount);
+    if(!candidate) {
+        return ERRALLOC;
+    }
+
+    // Nearest neighbour: from the start, always on to the closest stop not visited yet
+    for (int i = 0; i < stopCount; i++) {
+        order[i] = i + 1;
+    }
+    int previous = 0;
+    for (int position = 0; position < stopCount; position++) {
+        int best = position;
+        for (int i = position + 1; i < stopCount; i++) {
+            if(table[previous * pointCount + order[i]] < table[previous * pointCount + order[best]]) {
+                best = i;
+            }
+        }
+        int swap = order[position];
+        order[position] = order[best];
+        order[best] = swap;
+        previous = order[position];
+    }
+
+    long long length = pathLength(table, pointCount, order);
+    int improved = 1;
+    while (improved) {
+        improved = 0;
+        // 2-opt: reverse the stops from first to last
+        for (int first = 0; first < stopCount - 1; first++) {
+            for (int last = first + 1; last < stopCount; last++) {
+                memcpy(candidate, order, sizeof(int) * stopCount);
+                for (int i = first, j = last; i < j; i++, j--) {
+                    candidate[i] = order[j];
+                    candidate[j] = order[i];
+                }
+                long long candidateLength = pathLength(table, pointCount, candidate);
+                if(candidateLength < length) {
+                    memcpy(order, candidate, sizeof(int) * stopCount);
+                    length = candidateLength;
+                    improved = 1;
+                }
+            }
+        }
+        // Or-opt: move a segment of one to three stops to another position
+        for (int segment = 1; segment <= 3 && segment < stopCount; segment++) {
+            for (int first = 0; first + segment <= stopCount; first++) {
+                for (int target = 0; target + segment <= stopCount; target++) {
+                    if(target == first) {
+                        continue;
+                    }
+                    // The order without the segment, with the segment inserted at target
+                    int count = 0;
+                    for (int i = 0; i < stopCount; i++) {
+                        if(i < first || i >= first + segment) {
+                            candidate[count++] = order[i];
+                        }
+                    }
+                    memmove(candidate + target + segment, candidate + target, sizeof(int) * (count - target));
+                    memcpy(candidate + target, order + first, sizeof(int) * segment);
+                    long long candidateLength = pathLength(table, pointCount, candidate);
+                    if(candidateLength < length) {
+                        memcpy(order, candidate, sizeof(int) * stopCount);
+                        length = candidateLength;
+                        improved = 1;
+                    }
+                }
+            }
+        }
+    }
+    free(candidate);
+    return OK;
+}
+
+/**
+ * Append the leg of the last search to a city to the route, without its first city when the route has it
+ * @param search the state of the search, with the predecessors
+ * @param goalCityId the city the leg ends in
+ * @param route (out) the route, extended
+ * @return ERRFULL if the route has no room for the leg
+ * @return OK otherwise
+ */
+static status appendLeg(LegSearch *search, int goalCityId, Route *route) {
+    int offset = route->cityCount ? route->totalDistance : 0;
+    int count = 0;
+    for (int city = goalCityId; city >= 0; city = search->predecessors[city]) {
+        count++;
+    }
+    // The first city of the leg is the last of the route
+    int skip = route->cityCount ? 1 : 0;
+    if(route->cityCount + count - skip > route->capacity) {
+        return ERRFULL;
+    }
+    int position = route->cityCount + count - skip;
+    for (int city = goalCityId; position > route->cityCount; city = search->predecessors[city]) {
+        position--;
+        route->cityIds[position] = city;
+        route->distances[position] = offset + search->distances[city];
+    }
+    route->cityCount += count - skip;
+    route->totalDistance = offset + search->distances[goalCityId];
+    return OK;
+}
+
+status findMultiStopRoute(char *startCityName, char *endCityName, char **stopNames, int stopCount,
+                          CityMap *cityMap, Graph *graph, Route *route, int *stopOrder) {
+    // The points: the start, the stops, the end
+    int pointCount = stopCount + 2;
+    int *points = (int*)malloc(sizeof(int) * pointCount);
+    if(!points) {
+        return ERRALLOC;
+    }
+    for (int point = 0; point < pointCount; point++) {
+        char *name = point == 0 ? startCityName : point == pointCount - 1 ? endCityName : stopNames[point - 1];
+        City *city = findCityInMap(name, cityMap);
+        if(!city) {
+            printf("The given city: %s does not exist on the map.\n", name);
+            free(points);
+            return ERRABSENT;
+        }
+        points[point] = city->id;
+    }
+
+    LegSearch search;
+    memset(&search, 0, sizeof(search));
+    int *table = (int*)malloc(sizeof(int) * pointCount * pointCount);
+    int *order = (int*)malloc(sizeof(int) * (stopCount ? stopCount : 1));
+    search.graph = graph;
+    status ret = !table || !order ? ERRALLOC : graph ? OK : createGraph(cityMap, &search.graph);
+    if(ret == OK) {
+        int cityCount = cityMap->cityCount;
+        search.distances = (int*)malloc(sizeof(int) * cityCount);
+        search.predecessors = (int*)malloc(sizeof(int) * cityCount);
+        search.touched = (int*)malloc(sizeof(int) * cityCount);
+        search.targetCount = (int*)calloc(cityCount, sizeof(int));
+        ret = initHeap(&search.heap, 64);
+        if(!search.distances || !search.predecessors || !search.touched || !search.targetCount) {
+            ret = ERRALLOC;
+        }
+    }
+    if(ret == OK) {
+        for (int city = 0; city < cityMap->cityCount; city++) {
+            search.distances[city] = UNREACHABLE_DISTANCE;
+        }
+        for (int point = 1; point < pointCount; point++) {
+            search.targetCount[points[point]]++;
+        }
+    }
+
+    // The table: a search from the start and from every stop (not to the start: never travelled to)
+    for (int from = 0; ret == OK && from < pointCount - 1; from++) {
+        // The points at the city searched from are settled at once
+        ret = searchLegs(&search, points[from], pointCount - 1 - search.targetCount[points[from]], -1);
+        for (int to = 0; to < pointCount; to++) {
+            table[from * pointCount + to] = to == from ? 0 : search.distances[points[to]];
+        }
+        resetLegs(&search);
+    }
+    long long length = 0;
+    if(ret == OK) {
+        ret = stopCount <= MULTI_STOP_EXACT_LIMIT ? exactOrder(table, pointCount, order)
+                                                  : localSearchOrder(table, pointCount, order);
+    }
+    if(ret == OK && (length = pathLength(table, pointCount, order)) >= UNREACHABLE_DISTANCE) {
+        printf("No route from %s through all stops to %s.\n", startCityName, endCityName);
+        ret = ERRALGORTIHM;
+    }
+
+    // The legs, searched again for their cities
+    route->cityCount = 0;
+    route->totalDistance = 0;
+    for (int leg = 0; ret == OK && leg <= stopCount; leg++) {
+        int from = leg == 0 ? points[0] : points[order[leg - 1]];
+        int to = leg == stopCount ? points[pointCount - 1] : points[order[leg]];
+        if((ret = searchLegs(&search, from, 1, to)) == OK) {
+            ret = appendLeg(&search, to, route);
+        }
+        resetLegs(&search);
+    }
+    if(ret == OK && stopOrder) {
+        for (int i = 0; i < stopCount; i++) {
+            stopOrder[i] = order[i] - 1;
+        }
+    }
+    if(ret != OK) {
+        route->cityCount = 0;
+    }
+
+    freeHeap(&search.heap);
+    free(search.distances);
+    free(search.predecessors);
+    free(search.touched);
+    free(search.targetCount);
+    if(search.graph != graph) {
+        destroyGraph(search.graph);
+    }
+    free(points);
+    free(table);
+    free(order);
+    return ret;
+}
@@ -0,0 +1,44 @@
+/**
+ * @file MultiStop.h
+ * @brief Routes from a start to an end through a set of stops, in a short order of the stops.
+ *
+ * The distances between the start, the stops and the end are found with one Dijkstra search from the
+ * start and from every stop, each stopping when it has settled all stops and the end. The order of the
+ * stops is then chosen on that table:
+ *  - up to MULTI_STOP_EXACT_LIMIT stops exactly, by dynamic programming over the subsets of stops
+ *  - above, from a nearest neighbour order improved by 2-opt (reversing a part of the order) and
+ *    Or-opt (moving one to three consecutive stops elsewhere) until neither shortens it
+ * The legs of the chosen order are searched again, keeping the predecessors, and concatenated.
+ * Distances may differ per direction: every move is evaluated on the table as it is.
+ */
+#ifndef ADVANCED_C_CLASS_MULTISTOP_H
+#define ADVANCED_C_CLASS_MULTISTOP_H
+
+#include "Map.h"
+#include "Graph.h"
+#include "Route.h"
+
+/** Most stops ordered exactly, the table of the dynamic program has 2^stops * stops entries */
+#define MULTI_STOP_EXACT_LIMIT  (12)
+
+/**
+ * Find a short route from a start to an end visiting all stops, in any order
+ * @param startCityName Name of the city to start from
+ * @param endCityName Name of the city to end in, may be the start
+ * @param stopNames Names of the cities to visit, in any order
+ * @param stopCount The number of stops, may be 0
+ * @param cityMap The map
+ * @param graph The graph created from the map, kept for many calls, or 0 to create one for this call
+ * @param route (out) The route through the stops in the chosen order. It can visit a city more than once:
+ *              created with room for (stopCount + 1) * cityCount cities it always fits.
+ * @param stopOrder (out) stopCount indices in stopNames, in the order visited, may be 0
+ * @return ERRABSENT if a city does not exist on the map
+ * @return ERRALGORTIHM if a stop or the end cannot be reached
+ * @return ERRFULL if the route has not enough room
+ * @return ERRALLOC if memory allocation failed
+ * @return OK otherwise
+ */
+status findMultiStopRoute(char *startCityName, char *endCityName, char **stopNames, int stopCount,
+                          CityMap *cityMap, Graph *graph, Route *route, int *stopOrder);
+
+#endif //ADVANCED_C_CLASS_MULTISTOP_H
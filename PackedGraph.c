@@ -0,0 +1,355 @@
+/**
+ * @file PackedGraph.c
+ * @brief Compressed storage of the neighbours of all cities in a CityMap.
+ */
+
+#include <string.h>
+#include "PackedGraph.h"
+
+/**
+ * Neighbour of a city while packing
+ */
+typedef struct PackEdge {
+    int cityId;
+    int distance;
+    int position;   // Position in the neighbour list, keeps equal ids in list order
+}PackEdge;
+
+/**
+ * Function to compare two PackEdges on city id, then on list position (a stable sort:
+ * the packed edges are in the order of createGraph() on the unpacked map, which ArcFlags relies on)
+ * @param e1 the first edge to compare
+ * @param e2 the second edge to compare
+ * @return <0 if e1 is less than e2
+ * @return 0 if e1 equals e2
+ * @return >0 otherwise
+ */
+static int compEdgesBasedOnId(const void *e1, const void *e2) {
+    const PackEdge *edge1 = (const PackEdge*)e1;
+    const PackEdge *edge2 = (const PackEdge*)e2;
+    if(edge1->cityId != edge2->cityId) {
+        return (edge1->cityId > edge2->cityId) - (edge1->cityId < edge2->cityId);
+    }
+    return (edge1->position > edge2->position) - (edge1->position < edge2->position);
+}
+
+/**
+ * Write a value as varint, 7 bits per byte with the high bit set when more bytes follow
+ * @param bytes where to write, 0 to only count the bytes
+ * @param value the value to write
+ * @return the number of bytes (to be) written
+ */
+static int writeVarint(unsigned char *bytes, uint32_t value) {
+    int count = 0;
+    while (value >= 0x80) {
+        if(bytes) {
+            bytes[count] = (unsigned char)(value | 0x80);
+        }
+        value >>= 7;
+        count++;
+    }
+    if(bytes) {
+        bytes[count] = (unsigned char)value;
+    }
+    return count + 1;
+}
+
+/**
+ * Zigzag encoding of a signed difference: 0, -1, 1, -2, ... become 0, 1, 2, 3, ...
+ * @param value the difference
+ * @return the encoded value
+ */
+static uint32_t zigzag(int value) {
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+/**
+ * Sorted neighbours of a city, taken from its neighbour list
+ * @param city the city
+ * @param edges (out) room for all neighbours
+ * @return the number of neighbours
+ */
+static int sortedEdges(City *city, PackEdge *edges) {
+    int count = 0;
+    for (Node *node = city->neighbour ? city->neighbour->head : 0; node; node = node->next) {
+        Neighbour *neighbour = (Neighbour*)node->val;
+        edges[count].cityId = neighbour->city->id;
+        edges[count].distance = neighbour->distance;
+        edges[count].position = count;
+        count++;
+    }
+    qsort(edges, count, sizeof(PackEdge), compEdgesBasedOnId);
+    return count;
+}
+
+/**
+ * Sorted neighbours of a city, from the source the graph is packed from
+ * @param source the source of the neighbours
+ * @param cityId the city
+ * @param edges (out) room for all neighbours
+ * @return the number of neighbours
+ */
+typedef int (*EdgeReader)(void *source, int cityId, PackEdge *edges);
+
+/**
+ * Neighbours of the cities, grouped on city in file order, see packEdges()
+ */
+typedef struct EdgeGroups {
+    PackEdge *edges;
+    int *cityStart;     // The neighbours of city i are edges[cityStart[i] .. cityStart[i+1]-1]
+}EdgeGroups;
+
+/**
+ * EdgeReader of the neighbour lists of a map
+ * @param source the map
+ * @param cityId the city
+ * @param edges (out) room for all neighbours
+ * @return the number of neighbours
+ */
+static int listEdges(void *source, int cityId, PackEdge *edges) {
+    return sortedEdges(((CityMap*)source)->cities[cityId], edges);
+}
+
+/**
+ * EdgeReader of EdgeGroups
+ * @param source the groups
+ * @param cityId the city
+ * @param edges (out) room for all neighbours
+ * @return the number of neighbours
+ */
+static int groupedEdges(void *source, int cityId, PackEdge *edges) {
+    EdgeGroups *groups = (EdgeGroups*)source;
+    int count = groups->cityStart[cityId + 1] - groups->cityStart[cityId];
+    memcpy(edges, groups->edges + groups->cityStart[cityId], sizeof(PackEdge) * count);
+    qsort(edges, count, sizeof(PackEdge), compEdgesBasedOnId);
+    return count;
+}
+
+/**
+ * Pack the neighbours of all cities of a map
+ * @param cityMap The map, for its allocator and cities
+ * @param edgeCount The number of neighbours of all cities
+ * @param maxNeighbours The largest number of neighbours of a city
+ * @param maxDistance The longest distance, not negative
+ * @param readEdges The reader of the neighbours of a city, called twice per city in order of id
+ * @param source The source of readEdges
+ * @param result (out) The packed graph
+ * @return ERRALLOC if memory allocation failed
+ * @return OK otherwise
+ */
+static status packNeighbours(CityMap *cityMap, int edgeCount, int maxNeighbours, int maxDistance,
+                             EdgeReader readEdges, void *source, PackedGraph **result) {
+    int distanceBitCount = 1;
+    while (distanceBitCount < 31 && (maxDistance >> distanceBitCount)) {
+        distanceBitCount++;
+    }
+
+    Allocator *allocator = &cityMap->memory.base;
+    size_t edgesSize = sizeof(PackEdge) * (maxNeighbours ? maxNeighbours : 1);
+    PackEdge *edges = (PackEdge*)allocMemory(allocator, edgesSize);
+    PackedGraph *packed = (PackedGraph*)allocZeroedMemory(allocator, sizeof(PackedGraph));
+    if(!edges || !packed) {
+        freeMemory(allocator, edges, edgesSize);
+        freeMemory(allocator, packed, sizeof(PackedGraph));
+        return ERRALLOC;
+    }
+    packed->allocator = allocator;
+    packed->cityCount = cityMap->cityCount;
+    packed->edgeCount = edgeCount;
+    packed->maxNeighbours = maxNeighbours;
+    packed->distanceBitCount = distanceBitCount;
+
+    // Count the id bytes, to allocate them at once
+    uint32_t byteCount = 0;
+    for (int id = 0; id < cityMap->cityCount; id++) {
+        int count = readEdges(source, id, edges);
+        int previous = id;
+        for (int i = 0; i < count; i++) {
+            byteCount += writeVarint(0, i ? (uint32_t)(edges[i].cityId - previous) : zigzag(edges[i].cityId - id));
+            previous = edges[i].cityId;
+        }
+    }
+    size_t distanceWordCount = ((size_t)edgeCount * distanceBitCount + 31) / 32 + 1;
+    packed->byteStart = (uint32_t*)allocMemory(allocator, sizeof(uint32_t) * (cityMap->cityCount + 1));
+    packed->edgeStart = (uint32_t*)allocMemory(allocator, sizeof(uint32_t) * (cityMap->cityCount + 1));
+    packed->idBytes = (unsigned char*)allocMemory(allocator, byteCount ? byteCount : 1);
+    packed->distanceWords = (uint32_t*)allocZeroedMemory(allocator, sizeof(uint32_t) * distanceWordCount);
+    if(!packed->byteStart || !packed->edgeStart || !packed->idBytes || !packed->distanceWords) {
+        freeMemory(allocator, edges, edgesSize);
+        freeMemory(allocator, packed->byteStart, sizeof(uint32_t) * (cityMap->cityCount + 1));
+        freeMemory(allocator, packed->edgeStart, sizeof(uint32_t) * (cityMap->cityCount + 1));
+        freeMemory(allocator, packed->idBytes, byteCount ? byteCount : 1);
+        freeMemory(allocator, packed->distanceWords, sizeof(uint32_t) * distanceWordCount);
+        freeMemory(allocator, packed, sizeof(PackedGraph));
+        return ERRALLOC;
+    }
+
+    // Write the ids and the distances
+    uint32_t byte = 0;
+    uint64_t bit = 0;
+    uint32_t edge = 0;
+    for (int id = 0; id < cityMap->cityCount; id++) {
+        packed->byteStart[id] = byte;
+        packed->edgeStart[id] = edge;
+        int count = readEdges(source, id, edges);
+        int previous = id;
+        for (int i = 0; i < count; i++) {
+            byte += writeVarint(packed->idBytes + byte,
+                                i ? (uint32_t)(edges[i].cityId - previous) : zigzag(edges[i].cityId - id));
+            previous = edges[i].cityId;
+
+            uint64_t value = (uint64_t)edges[i].distance << (bit & 31);
+            packed->distanceWords[bit >> 5] |= (uint32_t)value;
+            packed->distanceWords[(bit >> 5) + 1] |= (uint32_t)(value >> 32);
+            bit += distanceBitCount;
+            edge++;
+        }
+    }
+    packed->byteStart[cityMap->cityCount] = byte;
+    packed->edgeStart[cityMap->cityCount] = edge;
+    freeMemory(allocator, edges, edgesSize);
+    *result = packed;
+    return OK;
+}
+
+status packMap(CityMap *cityMap) {
+    if(cityMap->packed) {
+        return OK;  // Already packed, the neighbour lists are gone
+    }
+    if(cityMap->paged) {
+        return ERRUNABLE;   // The neighbours are on disk
+    }
+
+    // Find the sizes: neighbours, bytes for the ids and bits for the distances
+    int edgeCount = 0;
+    int maxNeighbours = 0;
+    int maxDistance = 0;
+    for (int id = 0; id < cityMap->cityCount; id++) {
+        List *neighbours = cityMap->cities[id]->neighbour;
+        int count = neighbours ? neighbours->nelts : 0;
+        edgeCount += count;
+        maxNeighbours = count > maxNeighbours ? count : maxNeighbours;
+        for (Node *node = neighbours ? neighbours->head : 0; node; node = node->next) {
+            int distance = ((Neighbour*)node->val)->distance;
+            if(distance < 0) {
+                return ERRUNABLE;
+            }
+            maxDistance = distance > maxDistance ? distance : maxDistance;
+        }
+    }
+    PackedGraph *packed = 0;
+    status ret = packNeighbours(cityMap, edgeCount, maxNeighbours, maxDistance, listEdges, cityMap, &packed);
+    if(ret != OK) {
+        return ret;
+    }
+
+    // The neighbour lists are not needed anymore
+    for (int id = 0; id < cityMap->cityCount; id++) {
+        releaseNeighbours(cityMap, cityMap->cities[id]);
+    }
+    cityMap->packed = packed;
+    return OK;
+}
+
+status packEdges(CityMap *cityMap, MapEdge *edges, int edgeCount) {
+    if(cityMap->packed || cityMap->paged) {
+        return ERRUNABLE;
+    }
+
+    // Group the edges on their city, keeping the file order: a counting sort
+    int *cityStart = (int*)calloc(cityMap->cityCount + 1, sizeof(int));
+    PackEdge *grouped = (PackEdge*)malloc(sizeof(PackEdge) * (edgeCount ? edgeCount : 1));
+    status ret = cityStart && grouped ? OK : ERRALLOC;
+    int maxNeighbours = 0;
+    int maxDistance = 0;
+    for (int edge = 0; ret == OK && edge < edgeCount; edge++) {
+        if(edges[edge].distance < 0) {
+            ret = ERRUNABLE;
+        }
+        cityStart[edges[edge].fromCityId + 1]++;
+        maxDistance = edges[edge].distance > maxDistance ? edges[edge].distance : maxDistance;
+    }
+    if(ret == OK) {
+        for (int id = 0; id < cityMap->cityCount; id++) {
+            maxNeighbours = cityStart[id + 1] > maxNeighbours ? cityStart[id + 1] : maxNeighbours;
+            cityStart[id + 1] += cityStart[id];
+        }
+        // Fill from the starts, which then are the ends: shift them back
+        for (int edge = 0; edge < edgeCount; edge++) {
+            int slot = cityStart[edges[edge].fromCityId]++;
+            grouped[slot].cityId = edges[edge].toCityId;
+            grouped[slot].distance = edges[edge].distance;
+            grouped[slot].position = slot;
+        }
+        memmove(cityStart + 1, cityStart, sizeof(int) * cityMap->cityCount);
+        cityStart[0] = 0;
+
+        EdgeGroups groups = {grouped, cityStart};
+        PackedGraph *packed = 0;
+        ret = packNeighbours(cityMap, edgeCount, maxNeighbours, maxDistance, groupedEdges, &groups, &packed);
+        if(ret == OK) {
+            cityMap->packed = packed;
+            cityMap->maxNeighbours = maxNeighbours;
+        }
+    }
+    free(cityStart);
+    free(grouped);
+    return ret;
+}
+
+int unpackNeighbours(PackedGraph *packed, int cityId, int *cityIds, int *distances) {
+    const unsigned char *bytes = packed->idBytes + packed->byteStart[cityId];
+    uint32_t firstEdge = packed->edgeStart[cityId];
+    int count = (int)(packed->edgeStart[cityId + 1] - firstEdge);
+    uint64_t bit = (uint64_t)firstEdge * packed->distanceBitCount;
+    uint32_t mask = (1u << packed->distanceBitCount) - 1;
+
+    int previous = cityId;
+    for (int i = 0; i < count; i++) {
+        // Varint, nearly always a single byte
+        uint32_t value = *bytes++;
+        if(value & 0x80) {
+            value &= 0x7f;
+            int shift = 7;
+            uint32_t next;
+            do {
+                next = *bytes++;
+                value |= (next & 0x7f) << shift;
+                shift += 7;
+            } while (next & 0x80);
+        }
+        previous = i ? previous + (int)value : cityId + (int)((value >> 1) ^ (0u - (value & 1)));
+        cityIds[i] = previous;
+
+        // Distance bits, may be spread over two words
+        uint64_t word = packed->distanceWords[bit >> 5] | ((uint64_t)packed->distanceWords[(bit >> 5) + 1] << 32);
+        distances[i] = (int)((word >> (bit & 31)) & mask);
+        bit += packed->distanceBitCount;
+    }
+    return count;
+}
+
+size_t packedGraphSize(PackedGraph *packed) {
+    if(!packed) {
+        return 0;
+    }
+    size_t distanceWordCount = ((size_t)packed->edgeCount * packed->distanceBitCount + 31) / 32 + 1;
+    return sizeof(PackedGraph)
+           + sizeof(uint32_t) * 2 * (packed->cityCount + 1)
+           + packed->byteStart[packed->cityCount]
+           + sizeof(uint32_t) * distanceWordCount;
+}
+
+void destroyPackedGraph(PackedGraph *packed) {
+    if(!packed) {
+        return;
+    }
+    // The sizes are those of packMap()
+    size_t byteCount = packed->byteStart[packed->cityCount];
+    size_t distanceWordCount = ((size_t)packed->edgeCount * packed->distanceBitCount + 31) / 32 + 1;
+    freeMemory(packed->allocator, packed->byteStart, sizeof(uint32_t) * (packed->cityCount + 1));
+    freeMemory(packed->allocator, packed->edgeStart, sizeof(uint32_t) * (packed->cityCount + 1));
+    freeMemory(packed->allocator, packed->idBytes, byteCount ? byteCount : 1);
+    freeMemory(packed->allocator, packed->distanceWords, sizeof(uint32_t) * distanceWordCount);
+    freeMemory(packed->allocator, packed, sizeof(PackedGraph));
+}
@@ -0,0 +1,93 @@
+/**
+ * @file PackedGraph.h
+ * @brief Compressed storage of the neighbours of all cities in a CityMap.
+ *
+ * The neighbours of a city are sorted on id and stored as varints (7 bits per byte):
+ * the first one as zigzag encoded difference with the city's own id, the following ones as
+ * difference with the previous neighbour. The distances are bit-packed in a separate array,
+ * with the amount of bits needed for the longest distance.
+ * Most neighbours are close in id, so an edge takes about 1 byte plus the distance bits,
+ * instead of a Node, a Neighbour and their allocation overhead.
+ */
+#ifndef ADVANCED_C_CLASS_PACKEDGRAPH_H
+#define ADVANCED_C_CLASS_PACKEDGRAPH_H
+
+#include <stdint.h>
+#include "Map.h"
+
+/**
+ * Packed neighbours of all cities.
+ * Neighbours of city i: bytes from idBytes[byteStart[i]], distances from edge edgeStart[i],
+ * with edgeStart[i+1]-edgeStart[i] neighbours
+ */
+typedef struct PackedGraph {
+    int cityCount;
+    int edgeCount;
+    int maxNeighbours;
+    int distanceBitCount;
+    uint32_t *byteStart;
+    uint32_t *edgeStart;
+    unsigned char *idBytes;
+    uint32_t *distanceWords;
+    Allocator *allocator;
+}PackedGraph;
+
+/**
+ * Pack the neighbours of all cities of the map, and release their neighbour lists.
+ * The packed graph is allocated from the map's allocator, and counted in its footprint.
+ * findRoute() and createGraph() take the neighbours from the packed graph from then on.
+ *
+ * @param cityMap The map to pack
+ * @return ERRALLOC if memory allocation failed, the map is unchanged then
+ * @return ERRUNABLE if a distance is negative, or the map is paged
+ * @return OK otherwise
+ */
+status packMap(CityMap *cityMap);
+
+/**
+ * Edge of a map read without neighbour lists, see packEdges()
+ */
+typedef struct MapEdge {
+    int fromCityId;
+    int toCityId;
+    int distance;
+}MapEdge;
+
+/**
+ * Pack the edges of a map whose cities have no neighbour lists, as a loader read them (see createPackedMap()):
+ * the neighbour lists are never built. The neighbours of a city are in the order of packMap(), on id and
+ * then in the order of the edges. Sets the maxNeighbours of the map.
+ *
+ * @param cityMap The map to pack, without neighbour lists
+ * @param edges All edges of the map, in file order
+ * @param edgeCount The number of edges
+ * @return ERRALLOC if memory allocation failed, the map is unchanged then
+ * @return ERRUNABLE if a distance is negative, or the map is packed or paged
+ * @return OK otherwise
+ */
+status packEdges(CityMap *cityMap, MapEdge *edges, int edgeCount);
+
+/**
+ * Decode the neighbours of a city
+ * @param packed The packed graph
+ * @param cityId The city to decode the neighbours of
+ * @param cityIds (out) the ids of the neighbours, room for maxNeighbours
+ * @param distances (out) the distance to each neighbour, room for maxNeighbours
+ * @return the number of neighbours
+ */
+int unpackNeighbours(PackedGraph *packed, int cityId, int *cityIds, int *distances);
+
+/**
+ * Amount of memory used by the packed graph
+ * @param packed The packed graph
+ * @return the size in bytes
+ */
+size_t packedGraphSize(PackedGraph *packed);
+
+/**
+ * Clean up a packed graph
+ * @param packed The packed graph to destroy, may be 0
+ */
+void destroyPackedGraph(PackedGraph *packed);
+
+#endif //ADVANCED_C_CLASS_PACKEDGRAPH_H
@@ -0,0 +1,155 @@
+/**
+ * @file PagedBenchmark.c
+ * @brief Benchmark of paged maps (PagedGraph.h): route latency and page cache hits against the cache size.
+ *
+ * The map is loaded in memory and written as paged map, then the same routes are searched:
+ *  - on the map in memory
+ *  - on the paged map, with a cache of 1/64, 1/16, 1/4 and all of the pages: the kernel is asked to drop
+ *    the file from its own cache first, so every run starts cold
+ * For every run the memory of the map, the mean and 99th percentile latency of a route, and the page hits
+ * and misses are printed; the route distances are checked to be the same as in memory.
+ * Usage: pagedBenchmark map pagedMap [route count, Default=200] [page size, Default=4096]
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include "PagedGraph.h"
+#include "Route.h"
+#include "LatencyStats.h"
+
+/**
+ * Function to compare two latencies, for qsort()
+ * @param l1 the first latency
+ * @param l2 the second latency
+ * @return <0, 0 or >0 as l1 is less, equal or greater
+ */
+static int compLatencies(const void *l1, const void *l2) {
+    uint64_t latency1 = *(const uint64_t*)l1;
+    uint64_t latency2 = *(const uint64_t*)l2;
+    return (latency1 > latency2) - (latency1 < latency2);
+}
+
+/**
+ * Search the routes, and print the latencies
+ * @param name the name of the run
+ * @param cityMap the map
+ * @param starts the start city names of the routes
+ * @param goals the goal city names of the routes
+ * @param routeCount the number of routes
+ * @param distances (in/out) the distance of every route, -1 if not found
+ * @param latencies (work) routeCount latencies
+ * @param fill non zero to fill distances, 0 to compare with them
+ * @return the number of routes with another distance than in distances
+ */
+static int runRoutes(char *name, CityMap *cityMap, char **starts, char **goals, int routeCount, int *distances,
+                     uint64_t *latencies, int fill) {
+    Route *route = 0;
+    if(newRoute(cityMap->cityCount, &route) != OK) {
+        return routeCount;
+    }
+    int differences = 0;
+    double total = 0;
+    for (int i = 0; i < routeCount; i++) {
+        uint64_t start = latencyNow();
+        int distance = findRoute(starts[i], goals[i], cityMap, route) == OK ? route->totalDistance : -1;
+        latencies[i] = latencyNow() - start;
+        total += latencies[i];
+        if(fill) {
+            distances[i] = distance;
+        }
+        else if(distance != distances[i]) {
+            differences++;
+        }
+    }
+    qsort(latencies, routeCount, sizeof(uint64_t), compLatencies);
+    printf("%-14s %10lu bytes %10.1f us mean %10.1f us p99", name, (unsigned long)mapFootprint(cityMap),
+           total / routeCount / 1000.0, latencies[(routeCount * 99) / 100] / 1000.0);
+    if(cityMap->paged) {
+        PagedGraphStats stats;
+        pagedGraphStats(cityMap->paged, &stats);
+        printf(" %10ld hits %8ld misses %5.1f%% hits", stats.hits, stats.misses,
+               stats.hits + stats.misses ? 100.0 * stats.hits / (stats.hits + stats.misses) : 0.0);
+    }
+    printf("\n");
+    destroyRoute(route);
+    return differences;
+}
+
+int main(int argc, char** args) {
+    int routeCount = argc > 3 ? atoi(args[3]) : 200;
+    int pageSize = argc > 4 ? atoi(args[4]) : PAGED_MAP_DEFAULT_PAGE_SIZE;
+    if(argc < 3 || routeCount <= 0) {
+        printf("Usage: pagedBenchmark map pagedMap [route count] [page size]\n");
+        return 1;
+    }
+    CityMap *cityMap = 0;
+    status ret = createMap(args[1], &cityMap);
+    if(ret == OK) {
+        ret = writePagedMap(cityMap, pageSize, args[2]);
+    }
+    char **starts = (char**)malloc(sizeof(char*) * routeCount);
+    char **goals = (char**)malloc(sizeof(char*) * routeCount);
+    int *distances = (int*)malloc(sizeof(int) * routeCount);
+    uint64_t *latencies = (uint64_t*)malloc(sizeof(uint64_t) * routeCount);
+    if(ret == OK && (!starts || !goals || !distances || !latencies)) {
+        ret = ERRALLOC;
+    }
+    if(ret != OK) {
+        printf("Error: %s\n", message(ret));
+        destroyMap(cityMap);
+        return 1;
+    }
+
+    // The same pairs of cities for every run, picked in file order
+    unsigned int seed = 2463534242u;
+    for (int i = 0; i < routeCount; i++) {
+        seed = seed * 1103515245u + 12345u;
+        starts[i] = cityMap->cities[(seed >> 8) % cityMap->cityCount]->cityName;
+        seed = seed * 1103515245u + 12345u;
+        goals[i] = cityMap->cities[(seed >> 8) % cityMap->cityCount]->cityName;
+    }
+    printf("%d cities, %d routes\n", cityMap->cityCount, routeCount);
+    runRoutes("in memory", cityMap, starts, goals, routeCount, distances, latencies, 1);
+
+    // The number of pages, from the file
+    CityMap *paged = 0;
+    ret = loadPagedMap(args[2], 1, &paged);
+    int pageCount = ret == OK ? paged->paged->pageCount : 0;
+    destroyMap(paged);
+    if(ret != OK) {
+        printf("Error: %s\n", message(ret));
+    }
+
+    int failures = 0;
+    int fractions[] = {64, 16, 4, 1};
+    for (int i = 0; ret == OK && i < 4; i++) {
+        int cachePages = pageCount / fractions[i] ? pageCount / fractions[i] : 1;
+        paged = 0;
+        ret = loadPagedMap(args[2], cachePages, &paged);
+        if(ret != OK) {
+            printf("Error: %s\n", message(ret));
+            destroyMap(paged);
+            return 1;
+        }
+        posix_fadvise(fileno(paged->paged->file), 0, 0, POSIX_FADV_DONTNEED);
+
+        char name[32];
+        snprintf(name, sizeof(name), "%d/%d pages", cachePages, pageCount);
+        int differences = runRoutes(name, paged, starts, goals, routeCount, distances, latencies, 0);
+        if(differences) {
+            printf("%s: %d routes differ from the map in memory\n", name, differences);
+            failures++;
+        }
+        destroyMap(paged);
+    }
+
+    free(starts);
+    free(goals);
+    free(distances);
+    free(latencies);
+    destroyMap(cityMap);
+    return failures || ret != OK ? 1 : 0;
+}
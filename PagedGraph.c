@@ -0,0 +1,494 @@
+/**
+ * @file PagedGraph.c
+ * @brief Paged map files, and the page cache reading the neighbours from them.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "PagedGraph.h"
+#include "Graph.h"
+#include "Renumber.h"
+#include "Components.h"
+#include "LatencyStats.h"
+
+/** Magic number of a paged map file, "PGMP" in native byte order */
+#define PAGED_MAP_MAGIC     (0x504d4750)
+
+/**
+ * Header of a paged map file
+ */
+typedef struct PagedMapHeader {
+    uint32_t magic;
+    int32_t pageSize;
+    int32_t cityCount;
+    int32_t edgeCount;
+    int32_t maxNeighbours;
+    int32_t pageCount;
+    int32_t componentCount;         // 0 when the map had no components
+    int32_t strongComponentCount;
+    int64_t pagesStart;
+    double heuristicScale;
+}PagedMapHeader;
+
+/**
+ * Directory entry of a city, followed by nameLength bytes of its name
+ */
+typedef struct PagedMapCity {
+    int32_t latitude;
+    int32_t longitude;
+    int32_t page;
+    int32_t offset;
+    int32_t component;
+    int32_t strongComponent;
+    int32_t nameLength;
+}PagedMapCity;
+
+/**
+ * Size of the neighbours of a city in a page
+ * @param neighbourCount the number of neighbours
+ * @return the size in bytes
+ */
+static int recordSize(int neighbourCount) {
+    return (int)sizeof(int32_t) * (1 + 2 * neighbourCount);
+}
+
+/**
+ * Put the cities in pages, in the order of a Hilbert curve
+ * @param cityMap the map
+ * @param graph the graph of the map
+ * @param pageSize the size of a page
+ * @param order (out) the cities in the order of the pages
+ * @param cityPage (out) the page of every city
+ * @param cityOffset (out) the offset of every city in its page
+ * @param pageCount (out) the number of pages
+ * @return ERRUNABLE if the neighbours of a city do not fit in a page
+ * @return ERRALLOC if memory allocation failed
+ * @return OK otherwise
+ */
+static status assignPages(CityMap *cityMap, Graph *graph, int pageSize, int *order, int *cityPage, int *cityOffset,
+                          int *pageCount) {
+    status ret = cityOrder(cityMap, CityOrder_Hilbert, cityPage);
+    if(ret != OK) {
+        return ret;
+    }
+    for (int city = 0; city < graph->cityCount; city++) {
+        order[cityPage[city]] = city;
+    }
+    int page = 0;
+    int used = 0;
+    for (int position = 0; position < graph->cityCount; position++) {
+        int city = order[position];
+        int size = recordSize(graph->edgeStart[city + 1] - graph->edgeStart[city]);
+        if(size > pageSize) {
+            printf("The %d neighbours of %s do not fit in a page of %d bytes.\n",
+                   graph->edgeStart[city + 1] - graph->edgeStart[city], cityMap->cities[city]->cityName, pageSize);
+            return ERRUNABLE;
+        }
+        if(used + size > pageSize) {
+            page++;
+            used = 0;
+        }
+        cityPage[city] = page;
+        cityOffset[city] = used;
+        used += size;
+    }
+    *pageCount = graph->cityCount ? page + 1 : 0;
+    return OK;
+}
+
+/**
+ * Write the header, the directory and the pages of a paged map
+ * @param file the file to write to
+ * @param cityMap the map
+ * @param graph the graph of the map
+ * @param header the header, with all but pagesStart filled in
+ * @param order the cities in the order of the pages
+ * @param cityPage the page of every city
+ * @param cityOffset the offset of every city in its page
+ * @param page (work) a buffer of pageSize bytes
+ * @return ERRACCESS if writing failed
+ * @return OK otherwise
+ */
+static status writePages(FILE *file, CityMap *cityMap, Graph *graph, PagedMapHeader *header, int *order,
+                         int *cityPage, int *cityOffset, unsigned char *page) {
+    // The directory, to know where the pages start
+    int64_t directorySize = 0;
+    for (int city = 0; city < graph->cityCount; city++) {
+        directorySize += sizeof(PagedMapCity) + strlen(cityMap->cities[city]->cityName);
+    }
+    int64_t end = (int64_t)sizeof(PagedMapHeader) + directorySize;
+    header->pagesStart = (end + header->pageSize - 1) / header->pageSize * header->pageSize;
+    fwrite(header, sizeof(PagedMapHeader), 1, file);
+
+    Components *components = header->componentCount ? cityMap->components : 0;
+    for (int city = 0; city < graph->cityCount; city++) {
+        PagedMapCity entry;
+        memset(&entry, 0, sizeof(entry));
+        entry.latitude = cityMap->cities[city]->latitude;
+        entry.longitude = cityMap->cities[city]->longitude;
+        entry.page = cityPage[city];
+        entry.offset = cityOffset[city];
+        entry.component = components ? components->component[city] : 0;
+        entry.strongComponent = components ? components->strongComponent[city] : 0;
+        entry.nameLength = (int32_t)strlen(cityMap->cities[city]->cityName);
+        fwrite(&entry, sizeof(entry), 1, file);
+        fwrite(cityMap->cities[city]->cityName, 1, entry.nameLength, file);
+    }
+    for (int64_t padding = end; padding < header->pagesStart; padding++) {
+        fputc(0, file);
+    }
+
+    // The pages, every one full size
+    int position = 0;
+    for (int pageNr = 0; pageNr < header->pageCount; pageNr++) {
+        memset(page, 0, header->pageSize);
+        for (; position < graph->cityCount && cityPage[order[position]] == pageNr; position++) {
+            int city = order[position];
+            int32_t *record = (int32_t*)(page + cityOffset[city]);
+            *record++ = graph->edgeStart[city + 1] - graph->edgeStart[city];
+            for (int edge = graph->edgeStart[city]; edge < graph->edgeStart[city + 1]; edge++) {
+                *record++ = graph->edgeCity[edge];
+                *record++ = graph->edgeDistance[edge];
+            }
+        }
+        fwrite(page, 1, header->pageSize, file);
+    }
+    return ferror(file) ? ERRACCESS : OK;
+}
+
+status writePagedMap(CityMap *cityMap, int pageSize, char *path) {
+    pageSize = pageSize ? pageSize : PAGED_MAP_DEFAULT_PAGE_SIZE;
+    if(pageSize < PAGED_MAP_MIN_PAGE_SIZE || pageSize > PAGED_MAP_MAX_PAGE_SIZE) {
+        return ERRINDEX;
+    }
+    int cityCount = cityMap->cityCount;
+    size_t arraySize = sizeof(int) * (cityCount ? cityCount : 1);
+    int *order = (int*)malloc(arraySize);
+    int *cityPage = (int*)malloc(arraySize);
+    int *cityOffset = (int*)malloc(arraySize);
+    unsigned char *page = (unsigned char*)malloc(pageSize);
+    Graph *graph = 0;
+    status ret = order && cityPage && cityOffset && page ? createGraph(cityMap, &graph) : ERRALLOC;
+
+    PagedMapHeader header;
+    memset(&header, 0, sizeof(header));
+    if(ret == OK) {
+        ret = assignPages(cityMap, graph, pageSize, order, cityPage, cityOffset, &header.pageCount);
+    }
+    if(ret == OK) {
+        header.magic = PAGED_MAP_MAGIC;
+        header.pageSize = pageSize;
+        header.cityCount = cityCount;
+        header.edgeCount = graph->edgeCount;
+        header.maxNeighbours = cityMap->maxNeighbours;
+        header.componentCount = cityMap->components ? cityMap->components->componentCount : 0;
+        header.strongComponentCount = cityMap->components ? cityMap->components->strongComponentCount : 0;
+        header.heuristicScale = cityMap->heuristicScale;
+        FILE *file = fopen(path, "wb");
+        if(!file) {
+            printf("Error while creating: %s\n", path);
+            ret = ERROPEN;
+        }
+        else {
+            ret = writePages(file, cityMap, graph, &header, order, cityPage, cityOffset, page);
+            if(fclose(file) != 0) {
+                ret = ERRACCESS;
+            }
+        }
+    }
+    destroyGraph(graph);
+    free(order);
+    free(cityPage);
+    free(cityOffset);
+    free(page);
+    return ret;
+}
+
+/**
+ * Allocate the page index and the cache of a paged graph
+ * @param paged the paged graph, with the counts and the allocator set
+ * @return ERRALLOC if memory allocation failed, the arrays allocated are freed by destroyPagedGraph()
+ * @return OK otherwise
+ */
+static status allocPagedGraph(PagedGraph *paged) {
+    Allocator *allocator = paged->allocator;
+    int cityCount = paged->cityCount ? paged->cityCount : 1;
+    int pageCount = paged->pageCount ? paged->pageCount : 1;
+    paged->cityPage = (uint32_t*)allocMemory(allocator, sizeof(uint32_t) * cityCount);
+    paged->cityOffset = (uint16_t*)allocMemory(allocator, sizeof(uint16_t) * cityCount);
+    paged->pageFrame = (int*)allocMemory(allocator, sizeof(int) * pageCount);
+    paged->framePage = (int*)allocMemory(allocator, sizeof(int) * paged->cachePages);
+    paged->frameUsed = (unsigned char*)allocZeroedMemory(allocator, paged->cachePages);
+    paged->frames = (unsigned char*)allocMemory(allocator, (size_t)paged->cachePages * paged->pageSize);
+    if(!paged->cityPage || !paged->cityOffset || !paged->pageFrame || !paged->framePage || !paged->frameUsed
+       || !paged->frames) {
+        return ERRALLOC;
+    }
+    for (int page = 0; page < pageCount; page++) {
+        paged->pageFrame[page] = -1;
+    }
+    for (int frame = 0; frame < paged->cachePages; frame++) {
+        paged->framePage[frame] = -1;
+    }
+    return OK;
+}
+
+/**
+ * Read the directory of a paged map: create its cities, fill the page index and the components
+ * @param file the file, after the header
+ * @param header the header
+ * @param cityMap the map, empty
+ * @param paged the paged graph, allocated
+ * @param components the components to fill, 0 if the file has none
+ * @return ERRACCESS if reading failed, or the cities are not in id order
+ * @return ERRALLOC if memory allocation failed
+ * @return OK otherwise
+ */
+static status readDirectory(FILE *file, PagedMapHeader *header, CityMap *cityMap, PagedGraph *paged,
+                            Components *components) {
+    char name[MAX_CITYNAME_LENGTH];
+    for (int id = 0; id < header->cityCount; id++) {
+        PagedMapCity entry;
+        if(fread(&entry, sizeof(entry), 1, file) != 1 || entry.nameLength < 0 || entry.nameLength >= MAX_CITYNAME_LENGTH
+           || fread(name, 1, entry.nameLength, file) != (size_t)entry.nameLength
+           || entry.page < 0 || entry.page >= header->pageCount || entry.offset < 0
+           || entry.offset + recordSize(0) > header->pageSize) {
+            return ERRACCESS;
+        }
+        name[entry.nameLength] = '\0';
+        City *city = 0;
+        status ret = getOrCreateCity(name, cityMap, &city);
+        if(ret != OK) {
+            return ret;
+        }
+        // The names are interned in id order, a name seen before would give an older id
+        if(city->id != id) {
+            return ERRACCESS;
+        }
+        city->latitude = entry.latitude;
+        city->longitude = entry.longitude;
+        paged->cityPage[id] = (uint32_t)entry.page;
+        paged->cityOffset[id] = (uint16_t)entry.offset;
+        if(components) {
+            components->component[id] = entry.component;
+            components->strongComponent[id] = entry.strongComponent;
+        }
+    }
+    return OK;
+}
+
+/**
+ * Create the components of a paged map, to be filled from its directory
+ * @param cityMap the map
+ * @param header the header, with the component counts
+ * @param components (out) the components, 0 if the file has none
+ * @return ERRALLOC if memory allocation failed
+ * @return OK otherwise
+ */
+static status newPagedComponents(CityMap *cityMap, PagedMapHeader *header, Components **components) {
+    *components = 0;
+    if(!header->componentCount) {
+        return OK;
+    }
+    Allocator *allocator = &cityMap->memory.base;
+    size_t arraySize = sizeof(int) * (header->cityCount ? header->cityCount : 1);
+    Components *newComponents = (Components*)allocMemory(allocator, sizeof(Components));
+    if(!newComponents) {
+        return ERRALLOC;
+    }
+    newComponents->allocator = allocator;
+    newComponents->cityCount = header->cityCount;
+    newComponents->componentCount = header->componentCount;
+    newComponents->strongComponentCount = header->strongComponentCount;
+    newComponents->component = (int*)allocMemory(allocator, arraySize);
+    newComponents->strongComponent = (int*)allocMemory(allocator, arraySize);
+    if(!newComponents->component || !newComponents->strongComponent) {
+        destroyComponents(newComponents);
+        return ERRALLOC;
+    }
+    *components = newComponents;
+    return OK;
+}
+
+status loadPagedMap(char *path, int cachePages, CityMap **cityMap) {
+    uint64_t startTime = latencyNow();
+    status ret = createEmptyMap(cityMap, 0);
+    if(ret != OK) {
+        return ret;
+    }
+    FILE *file = fopen(path, "rb");
+    if(!file) {
+        printf("Error while opening: %s\n", path);
+        return ERROPEN;
+    }
+    PagedMapHeader header;
+    if(fread(&header, sizeof(header), 1, file) != 1 || header.magic != PAGED_MAP_MAGIC
+       || header.pageSize < PAGED_MAP_MIN_PAGE_SIZE || header.pageSize > PAGED_MAP_MAX_PAGE_SIZE
+       || header.cityCount < 0 || header.pageCount < 0 || header.edgeCount < 0 || header.maxNeighbours < 0) {
+        fclose(file);
+        return ERRACCESS;
+    }
+
+    Allocator *allocator = &(*cityMap)->memory.base;
+    PagedGraph *paged = (PagedGraph*)allocZeroedMemory(allocator, sizeof(PagedGraph));
+    if(!paged) {
+        fclose(file);
+        return ERRALLOC;
+    }
+    paged->allocator = allocator;
+    paged->file = file;
+    paged->cityCount = header.cityCount;
+    paged->edgeCount = header.edgeCount;
+    paged->maxNeighbours = header.maxNeighbours;
+    paged->pageCount = header.pageCount;
+    paged->pageSize = header.pageSize;
+    paged->pagesStart = header.pagesStart;
+    paged->cachePages = cachePages > 0 ? cachePages : PAGED_MAP_DEFAULT_CACHE_PAGES;
+    pthread_mutex_init(&paged->lock, 0);
+    (*cityMap)->paged = paged;
+
+    Components *components = 0;
+    if((ret = allocPagedGraph(paged)) == OK && (ret = newPagedComponents(*cityMap, &header, &components)) == OK) {
+        (*cityMap)->components = components;
+        ret = readDirectory(file, &header, *cityMap, paged, components);
+    }
+    if(ret == OK) {
+        (*cityMap)->maxNeighbours = header.maxNeighbours;
+        (*cityMap)->heuristicScale = header.heuristicScale;
+        // No read ahead: the next page in the file is seldom the next one needed
+        posix_fadvise(fileno(file), (off_t)header.pagesStart, 0, POSIX_FADV_RANDOM);
+    }
+    recordLatency(LatencyMetric_MapLoad, latencyNow() - startTime);
+    return ret;
+}
+
+/**
+ * Get a frame for a page not in the cache: a free one, or the first not used since the clock hand passed it
+ * @param paged the paged graph, locked
+ * @return the frame, its page no longer cached
+ */
+static int replaceFrame(PagedGraph *paged) {
+    int cachedPages = paged->stats.cachedPages;
+    if(cachedPages < paged->cachePages) {
+        paged->stats.cachedPages++;
+        return cachedPages;
+    }
+    while (paged->frameUsed[paged->clockHand]) {
+        paged->frameUsed[paged->clockHand] = 0;
+        paged->clockHand = (paged->clockHand + 1) % paged->cachePages;
+    }
+    int frame = paged->clockHand;
+    paged->clockHand = (paged->clockHand + 1) % paged->cachePages;
+    if(paged->framePage[frame] >= 0) {
+        paged->pageFrame[paged->framePage[frame]] = -1;
+        paged->framePage[frame] = -1;
+        paged->stats.evictions++;
+    }
+    return frame;
+}
+
+/**
+ * Read a page into a frame
+ * @param paged the paged graph, locked
+ * @param page the page
+ * @param frame the frame
+ * @return ERRACCESS if reading failed
+ * @return OK otherwise
+ */
+static status readPage(PagedGraph *paged, int page, int frame) {
+    unsigned char *bytes = paged->frames + (size_t)frame * paged->pageSize;
+    off_t offset = (off_t)(paged->pagesStart + (int64_t)page * paged->pageSize);
+    size_t done = 0;
+    while (done < (size_t)paged->pageSize) {
+        ssize_t count = pread(fileno(paged->file), bytes + done, paged->pageSize - done, offset + (off_t)done);
+        if(count <= 0) {
+            return ERRACCESS;
+        }
+        done += (size_t)count;
+    }
+    return OK;
+}
+
+int pagedNeighbours(PagedGraph *paged, int cityId, int *cityIds, int *distances) {
+    int page = (int)paged->cityPage[cityId];
+    pthread_mutex_lock(&paged->lock);
+    int frame = paged->pageFrame[page];
+    if(frame >= 0) {
+        paged->stats.hits++;
+    }
+    else {
+        paged->stats.misses++;
+        frame = replaceFrame(paged);
+        if(readPage(paged, page, frame) != OK) {
+            // The frame is left empty and unused, the clock takes it first
+            paged->frameUsed[frame] = 0;
+            pthread_mutex_unlock(&paged->lock);
+            return -1;
+        }
+        paged->framePage[frame] = page;
+        paged->pageFrame[page] = frame;
+    }
+    paged->frameUsed[frame] = 1;
+
+    // The neighbours are copied out under the lock: the frame can be replaced as soon as it is released
+    const unsigned char *record = paged->frames + (size_t)frame * paged->pageSize + paged->cityOffset[cityId];
+    int32_t count;
+    memcpy(&count, record, sizeof(count));
+    if(count < 0 || count > paged->maxNeighbours || paged->cityOffset[cityId] + recordSize(count) > paged->pageSize) {
+        pthread_mutex_unlock(&paged->lock);
+        return -1;
+    }
+    for (int i = 0; i < count; i++) {
+        int32_t edge[2];
+        memcpy(edge, record + recordSize(i), sizeof(edge));
+        if(edge[0] < 0 || edge[0] >= paged->cityCount) {
+            // A corrupt page, its ids would index the cities of the map
+            pthread_mutex_unlock(&paged->lock);
+            return -1;
+        }
+        cityIds[i] = edge[0];
+        distances[i] = edge[1];
+    }
+    pthread_mutex_unlock(&paged->lock);
+    return count;
+}
+
+void pagedGraphStats(PagedGraph *paged, PagedGraphStats *stats) {
+    pthread_mutex_lock(&paged->lock);
+    *stats = paged->stats;
+    stats->cachePages = paged->cachePages;
+    stats->pageCount = paged->pageCount;
+    stats->pageSize = paged->pageSize;
+    pthread_mutex_unlock(&paged->lock);
+}
+
+void resetPagedGraphStats(PagedGraph *paged) {
+    pthread_mutex_lock(&paged->lock);
+    paged->stats.hits = 0;
+    paged->stats.misses = 0;
+    paged->stats.evictions = 0;
+    pthread_mutex_unlock(&paged->lock);
+}
+
+void destroyPagedGraph(PagedGraph *paged) {
+    if(!paged) {
+        return;
+    }
+    Allocator *allocator = paged->allocator;
+    int cityCount = paged->cityCount ? paged->cityCount : 1;
+    int pageCount = paged->pageCount ? paged->pageCount : 1;
+    freeMemory(allocator, paged->cityPage, sizeof(uint32_t) * cityCount);
+    freeMemory(allocator, paged->cityOffset, sizeof(uint16_t) * cityCount);
+    freeMemory(allocator, paged->pageFrame, sizeof(int) * pageCount);
+    freeMemory(allocator, paged->framePage, sizeof(int) * paged->cachePages);
+    freeMemory(allocator, paged->frameUsed, paged->cachePages);
+    freeMemory(allocator, paged->frames, (size_t)paged->cachePages * paged->pageSize);
+    if(paged->file) {
+        fclose(paged->file);
+    }
+    pthread_mutex_destroy(&paged->lock);
+    freeMemory(allocator, paged, sizeof(PagedGraph));
+}
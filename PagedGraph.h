@@ -0,0 +1,129 @@
+/**
+ * @file PagedGraph.h
+ * @brief Out-of-core storage of a map: the neighbours stay on disk, in fixed-size pages read through a bounded cache.
+ *
+ * A paged map file holds, in native byte order after a magic number:
+ *  - a header: page size, counts, the heuristic scale and the number of components
+ *  - a directory, in city id order: position, page and offset of the neighbours, components and name of every city
+ *  - the pages, from a multiple of the page size: for every city its number of neighbours, then
+ *    (city id, distance) per neighbour in the order of createGraph(), as int32 values
+ * Cities are put in pages in the order of a Hilbert curve over their position (see Renumber.h), so the cities
+ * a search expands after each other are mostly in the same page. A city never spans two pages.
+ *
+ * loadPagedMap() keeps the directory in memory (the cities, their names and 6 bytes per city for the page index)
+ * and reads a page into one of cachePages frames when findRoute() or createGraph() needs the neighbours of one
+ * of its cities. When all frames are in use, the clock algorithm replaces a page not used since the hand last
+ * passed it. Pages are read with pread(), the file is advised for random access so the kernel reads no more
+ * than asked. The cache is shared by all searches on the map, under a mutex: a page fault blocks the others.
+ */
+#ifndef ADVANCED_C_CLASS_PAGEDGRAPH_H
+#define ADVANCED_C_CLASS_PAGEDGRAPH_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "Map.h"
+
+/** Default size of a page, in bytes */
+#define PAGED_MAP_DEFAULT_PAGE_SIZE     (4096)
+/** Smallest and largest size of a page, the offset of a city in its page fits 16 bits */
+#define PAGED_MAP_MIN_PAGE_SIZE         (64)
+#define PAGED_MAP_MAX_PAGE_SIZE         (65536)
+/** Default number of pages in the cache */
+#define PAGED_MAP_DEFAULT_CACHE_PAGES   (256)
+
+/**
+ * Counters of the page cache, since loading or the last resetPagedGraphStats()
+ */
+typedef struct PagedGraphStats {
+    long hits;              // Neighbours found in a cached page
+    long misses;            // Neighbours of which the page had to be read
+    long evictions;         // Pages replaced by another
+    int cachedPages;        // Pages in the cache now
+    int cachePages;         // Frames of the cache
+    int pageCount;          // Pages in the file
+    int pageSize;
+}PagedGraphStats;
+
+/**
+ * The page index and the page cache of a paged map
+ */
+typedef struct PagedGraph {
+    int cityCount;
+    int edgeCount;
+    int maxNeighbours;
+    int pageCount;
+    int pageSize;
+    int cachePages;
+    FILE *file;
+    int64_t pagesStart;         // File offset of page 0
+    uint32_t *cityPage;         // Page of the neighbours of every city
+    uint16_t *cityOffset;       // Offset of the neighbours of every city in its page
+    int *pageFrame;             // Frame of every page, -1 when not cached
+    int *framePage;             // Page in every frame, -1 when free
+    unsigned char *frameUsed;   // Reference bit of every frame, for the clock
+    unsigned char *frames;      // cachePages * pageSize bytes
+    int clockHand;
+    pthread_mutex_t lock;
+    PagedGraphStats stats;
+    Allocator *allocator;
+}PagedGraph;
+
+/**
+ * Write a map as paged map file
+ * @param cityMap The map, with its neighbours in lists, packed or paged
+ * @param pageSize The size of a page, 0 for PAGED_MAP_DEFAULT_PAGE_SIZE
+ * @param path Location of the file to write
+ * @return ERRINDEX if the page size is out of range
+ * @return ERRUNABLE if the neighbours of a city do not fit in a page
+ * @return ERROPEN if the file cannot be created
+ * @return ERRACCESS if writing failed
+ * @return ERRALLOC if memory allocation failed
+ * @return OK otherwise
+ */
+status writePagedMap(CityMap *cityMap, int pageSize, char *path);
+
+/**
+ * Load a map from a paged map file: the cities in memory, their neighbours left on disk.
+ * findRoute() and createGraph() read the neighbours through the page cache; a search fails with ERRACCESS
+ * when a page cannot be read. Packing, merging and renumbering a paged map are refused (ERRUNABLE).
+ * @param path Location of the paged map file
+ * @param cachePages The number of pages in the cache, at least 1, 0 for PAGED_MAP_DEFAULT_CACHE_PAGES
+ * @param cityMap Pointer to map pointer which will be assigned to the map, to destroy also after an error
+ * @return ERROPEN if the file cannot be opened
+ * @return ERRACCESS if reading failed or the file is not a paged map (of this byte order)
+ * @return ERRALLOC if memory allocation failed
+ * @return OK otherwise
+ */
+status loadPagedMap(char *path, int cachePages, CityMap **cityMap);
+
+/**
+ * Get the neighbours of a city, through the page cache (thread safe)
+ * @param paged The paged graph
+ * @param cityId The city to get the neighbours of
+ * @param cityIds (out) the ids of the neighbours, room for the map's maxNeighbours
+ * @param distances (out) the distance to each neighbour, room for the map's maxNeighbours
+ * @return the number of neighbours, -1 if its page could not be read or holds a neighbour id outside the map
+ */
+int pagedNeighbours(PagedGraph *paged, int cityId, int *cityIds, int *distances);
+
+/**
+ * Get the counters of the page cache
+ * @param paged The paged graph
+ * @param stats (out) the counters
+ */
+void pagedGraphStats(PagedGraph *paged, PagedGraphStats *stats);
+
+/**
+ * Set the hit, miss and eviction counters to 0, the cached pages stay
+ * @param paged The paged graph
+ */
+void resetPagedGraphStats(PagedGraph *paged);
+
+/**
+ * Clean up a paged graph, closing its file
+ * @param paged The paged graph to destroy, may be 0
+ */
+void destroyPagedGraph(PagedGraph *paged);
+
+#endif //ADVANCED_C_CLASS_PAGEDGRAPH_H
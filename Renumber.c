@@ -0,0 +1,353 @@
+/**
+ * @file Renumber.c
+ * @brief Renumbering the cities of a map along a Hilbert curve or in breadth first order.
+ */
+
+#include <string.h>
+#include "Renumber.h"
+#include "DistanceTable.h"
+#include "StringArena.h"
+#include "ArcFlags.h"
+#include "Components.h"
+#include "Graph.h"
+
+/** Bits per coordinate of the Hilbert curve */
+#define HILBERT_BITS    (16)
+
+/**
+ * City with the key to order it on
+ */
+typedef struct KeyedCity {
+    uint64_t key;
+    int cityId;
+}KeyedCity;
+
+/**
+ * Function to compare two KeyedCities on key, then on id
+ * @param c1 the first city to compare
+ * @param c2 the second city to compare
+ * @return <0 if c1 goes before c2
+ * @return 0 if c1 equals c2
+ * @return >0 otherwise
+ */
+static int compCitiesOnKey(const void *c1, const void *c2) {
+    const KeyedCity *city1 = (const KeyedCity*)c1;
+    const KeyedCity *city2 = (const KeyedCity*)c2;
+    if(city1->key != city2->key) {
+        return (city1->key > city2->key) - (city1->key < city2->key);
+    }
+    return (city1->cityId > city2->cityId) - (city1->cityId < city2->cityId);
+}
+
+/**
+ * Distance along the Hilbert curve through a square of 2^HILBERT_BITS by 2^HILBERT_BITS points
+ * @param x the x coordinate of the point
+ * @param y the y coordinate of the point
+ * @return the distance of the point from the start of the curve
+ */
+static uint64_t hilbertIndex(uint32_t x, uint32_t y) {
+    const uint32_t side = 1u << HILBERT_BITS;
+    uint64_t index = 0;
+    for (uint32_t half = side / 2; half > 0; half /= 2) {
+        uint32_t right = (x & half) != 0;
+        uint32_t upper = (y & half) != 0;
+        index += (uint64_t)half * half * ((3 * right) ^ upper);
+        // Rotate the quadrant, so the curve enters and leaves it as the whole curve does
+        if(!upper) {
+            if(right) {
+                x = side - 1 - x;
+                y = side - 1 - y;
+            }
+            uint32_t swap = x;
+            x = y;
+            y = swap;
+        }
+    }
+    return index;
+}
+
+/**
+ * Order the cities along a Hilbert curve over the bounding box of their positions
+ * @param cityMap the map
+ * @param cities (out) the cities in order, cityCount entries
+ */
+static void hilbertOrder(CityMap *cityMap, KeyedCity *cities) {
+    int minLatitude = 0, maxLatitude = 0, minLongitude = 0, maxLongitude = 0;
+    for (int id = 0; id < cityMap->cityCount; id++) {
+        City *city = cityMap->cities[id];
+        if(id == 0 || city->latitude < minLatitude) minLatitude = city->latitude;
+        if(id == 0 || city->latitude > maxLatitude) maxLatitude = city->latitude;
+        if(id == 0 || city->longitude < minLongitude) minLongitude = city->longitude;
+        if(id == 0 || city->longitude > maxLongitude) maxLongitude = city->longitude;
+    }
+    // Scale the box on the grid of the curve, the same for both coordinates to keep its shape
+    double range = (double)maxLatitude - minLatitude > (double)maxLongitude - minLongitude
+                   ? (double)maxLatitude - minLatitude : (double)maxLongitude - minLongitude;
+    double scale = range > 0 ? ((1u << HILBERT_BITS) - 1) / range : 0;
+    for (int id = 0; id < cityMap->cityCount; id++) {
+        City *city = cityMap->cities[id];
+        cities[id].key = hilbertIndex((uint32_t)((city->longitude - (double)minLongitude) * scale),
+                                      (uint32_t)((city->latitude - (double)minLatitude) * scale));
+        cities[id].cityId = id;
+    }
+    qsort(cities, cityMap->cityCount, sizeof(KeyedCity), compCitiesOnKey);
+}
+
+/**
+ * Order the cities by reverse Cuthill-McKee: breadth first from a city of lowest degree,
+ * the neighbours of a city in order of degree, every component in turn; then reversed
+ * @param cityMap the map
+ * @param cities (out) the cities in order, cityCount entries
+ * @return ERRALLOC if memory allocation failed
+ * @return OK otherwise
+ */
+static status breadthFirstOrder(CityMap *cityMap, KeyedCity *cities) {
+    int cityCount = cityMap->cityCount;
+    Graph *graph = 0;
+    Graph *reverse = 0;
+    KeyedCity *byDegree = (KeyedCity*)malloc(sizeof(KeyedCity) * (cityCount ? cityCount : 1));
+    unsigned char *visited = (unsigned char*)calloc(cityCount ? cityCount : 1, 1);
+    status ret = byDegree && visited ? createGraph(cityMap, &graph) : ERRALLOC;
+    if(ret == OK) {
+        ret = createReverseGraph(graph, &reverse);
+    }
+    if(ret != OK) {
+        destroyGraph(graph);
+        free(byDegree);
+        free(visited);
+        return ret;
+    }
+
+    // The degree of a city counts its edges in both directions
+    for (int id = 0; id < cityCount; id++) {
+        byDegree[id].key = (uint64_t)(graph->edgeStart[id + 1] - graph->edgeStart[id]
+                                      + reverse->edgeStart[id + 1] - reverse->edgeStart[id]);
+        byDegree[id].cityId = id;
+    }
+    qsort(byDegree, cityCount, sizeof(KeyedCity), compCitiesOnKey);
+
+    // cities is the queue: the cities in visiting order, keyed on degree
+    int queued = 0;
+    for (int rootNr = 0; rootNr < cityCount; rootNr++) {
+        int root = byDegree[rootNr].cityId;
+        if(visited[root]) {
+            continue;
+        }
+        visited[root] = 1;
+        cities[queued++] = byDegree[rootNr];
+        for (int head = queued - 1; head < queued; head++) {
+            int city = cities[head].cityId;
+            int firstNew = queued;
+            Graph *directions[] = {graph, reverse};
+            for (int direction = 0; direction < 2; direction++) {
+                Graph *edges = directions[direction];
+                for (int edge = edges->edgeStart[city]; edge < edges->edgeStart[city + 1]; edge++) {
+                    int next = edges->edgeCity[edge];
+                    if(!visited[next]) {
+                        visited[next] = 1;
+                        cities[queued].cityId = next;
+                        cities[queued].key = (uint64_t)(graph->edgeStart[next + 1] - graph->edgeStart[next]
+                                                        + reverse->edgeStart[next + 1] - reverse->edgeStart[next]);
+                        queued++;
+                    }
+                }
+            }
+            qsort(cities + firstNew, queued - firstNew, sizeof(KeyedCity), compCitiesOnKey);
+        }
+    }
+
+    // Reverse
+    for (int front = 0, back = cityCount - 1; front < back; front++, back--) {
+        KeyedCity swap = cities[front];
+        cities[front] = cities[back];
+        cities[back] = swap;
+    }
+    destroyGraph(graph);
+    destroyGraph(reverse);
+    free(byDegree);
+    free(visited);
+    return OK;
+}
+
+status cityOrder(CityMap *cityMap, CityOrder order, int *newIds) {
+    KeyedCity *cities = (KeyedCity*)malloc(sizeof(KeyedCity) * (cityMap->cityCount ? cityMap->cityCount : 1));
+    if(!cities) {
+        return ERRALLOC;
+    }
+    status ret = OK;
+    if(order == CityOrder_Hilbert) {
+        hilbertOrder(cityMap, cities);
+    }
+    else {
+        ret = breadthFirstOrder(cityMap, cities);
+    }
+    for (int position = 0; ret == OK && position < cityMap->cityCount; position++) {
+        newIds[cities[position].cityId] = position;
+    }
+    free(cities);
+    return ret;
+}
+
+/**
+ * Copy a city with its neighbour list and its Neighbours, allocated one after the other:
+ * a search reads a city and its neighbours together. The copied Neighbours point to the same cities.
+ * @param cityMap The map of the city
+ * @param city The city to copy
+ * @param copy (out) The copy
+ * @return ERRALLOC if memory allocation failed, nothing is allocated then
+ * @return OK otherwise
+ */
+static status copyCity(CityMap *cityMap, City *city, City **copy) {
+    Allocator *allocator = &cityMap->memory.base;
+    City *newCity = (City*)allocMemory(allocator, sizeof(City));
+    if(!newCity) {
+        return ERRALLOC;
+    }
+    *newCity = *city;
+    newCity->neighbour = 0;
+    status ret = OK;
+    List *neighbours = city->neighbour;
+    if(neighbours) {
+        newCity->neighbour = newListWithAllocator(ListKind_Linked, neighbours->getComp, neighbours->addComp,
+                                                  neighbours->pr, 0, neighbours->allocator);
+        ret = newCity->neighbour ? OK : ERRALLOC;
+        for (Node *node = neighbours->head; ret == OK && node; node = node->next) {
+            Neighbour *neighbour = (Neighbour*)allocMemory(allocator, sizeof(Neighbour));
+            if(!neighbour) {
+                ret = ERRALLOC;
+                break;
+            }
+            *neighbour = *(Neighbour*)node->val;
+            if((ret = appendList(newCity->neighbour, neighbour)) != OK) {
+                freeMemory(allocator, neighbour, sizeof(Neighbour));
+            }
+        }
+    }
+    if(ret != OK) {
+        releaseNeighbours(cityMap, newCity);
+        freeMemory(allocator, newCity, sizeof(City));
+        return ret;
+    }
+    *copy = newCity;
+    return OK;
+}
+
+/**
+ * Free cities copied by copyCity(), with their neighbours
+ * @param cityMap The map of the cities
+ * @param cities The cities
+ * @param count The number of cities
+ */
+static void freeCities(CityMap *cityMap, City **cities, int count) {
+    for (int position = 0; position < count; position++) {
+        releaseNeighbours(cityMap, cities[position]);
+        freeMemory(&cityMap->memory.base, cities[position], sizeof(City));
+    }
+}
+
+status renumberCities(CityMap *cityMap, const int *newIds) {
+    if(cityMap->packed || cityMap->paged) {
+        return ERRUNABLE;
+    }
+    size_t arraySize = cityMap->cityCount ? cityMap->cityCount : 1;
+    City **cities = (City**)malloc(sizeof(City*) * arraySize);
+    int *values = cityMap->components ? (int*)malloc(sizeof(int) * arraySize) : 0;
+    status ret = cities && (values || !cityMap->components) ? OK : ERRALLOC;
+
+    // Copy the cities in their new order, each followed by its neighbours, so a search walking
+    // near ids walks near memory too. The old cities are freed once all are copied.
+    for (int id = 0; ret == OK && id < cityMap->cityCount; id++) {
+        cities[newIds[id]] = cityMap->cities[id];
+    }
+    int copied = 0;
+    while (ret == OK && copied < cityMap->cityCount) {
+        if((ret = copyCity(cityMap, cities[copied], &cities[copied])) == OK) {
+            copied++;
+        }
+    }
+    // The city list too: its nodes were allocated between the old cities, and would keep
+    // their memory in pieces once those are freed
+    List *cityList = 0;
+    if(ret == OK && cityMap->cityList) {
+        List *old = cityMap->cityList;
+        cityList = newListWithAllocator(ListKind_Linked, old->getComp, old->addComp, old->pr, 0, old->allocator);
+        ret = cityList ? OK : ERRALLOC;
+        for (int id = 0; ret == OK && id < cityMap->cityCount; id++) {
+            ret = appendList(cityList, cities[id]);
+        }
+    }
+    if(ret == OK) {
+        ret = renumberStrings(cityMap->names, newIds);
+    }
+    if(ret != OK) {
+        if(cityList) {
+            delList(cityList);
+        }
+        if(cities) {
+            freeCities(cityMap, cities, copied);
+        }
+        free(cities);
+        free(values);
+        return ret;
+    }
+
+    // The id of a city stays the id of its name
+    for (int id = 0; id < cityMap->cityCount; id++) {
+        City *city = cities[id];
+        city->id = id;
+        for (Node *node = city->neighbour ? city->neighbour->head : 0; node; node = node->next) {
+            Neighbour *neighbour = (Neighbour*)node->val;
+            neighbour->city = cities[newIds[neighbour->city->id]];
+        }
+    }
+    freeCities(cityMap, cityMap->cities, cityMap->cityCount);
+    memcpy(cityMap->cities, cities, sizeof(City*) * cityMap->cityCount);
+    free(cities);
+    if(cityList) {
+        delList(cityMap->cityList);
+        cityMap->cityList = cityList;
+    }
+    // The neighbour lists are ordered on the ids, as the loaders keep them
+    for (int id = 0; id < cityMap->cityCount; id++) {
+        List *neighbours = cityMap->cities[id]->neighbour;
+        if(neighbours) {
+            sortList(neighbours, neighbours->addComp);
+        }
+    }
+
+    // The components move with their cities
+    Components *components = cityMap->components;
+    if(components) {
+        int *arrays[] = {components->component, components->strongComponent};
+        for (int arrayNr = 0; arrayNr < 2; arrayNr++) {
+            for (int id = 0; id < cityMap->cityCount; id++) {
+                values[newIds[id]] = arrays[arrayNr][id];
+            }
+            memcpy(arrays[arrayNr], values, sizeof(int) * cityMap->cityCount);
+        }
+        free(values);
+    }
+
+    // Flags are per edge, in the old order, the distance table per city
+    destroyArcFlags(cityMap->arcFlags);
+    cityMap->arcFlags = 0;
+    destroyDistanceTable(cityMap->distanceTable);
+    cityMap->distanceTable = 0;
+    return OK;
+}
+
+status renumberMap(CityMap *cityMap, CityOrder order) {
+    if(cityMap->packed || cityMap->paged) {
+        return ERRUNABLE;
+    }
+    int *newIds = (int*)malloc(sizeof(int) * (cityMap->cityCount ? cityMap->cityCount : 1));
+    if(!newIds) {
+        return ERRALLOC;
+    }
+    status ret = cityOrder(cityMap, order, newIds);
+    if(ret == OK) {
+        ret = renumberCities(cityMap, newIds);
+    }
+    free(newIds);
+    return ret;
+}
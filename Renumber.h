@@ -0,0 +1,62 @@
+/**
+ * @file Renumber.h
+ * @brief Renumbering the cities of a map, so cities near each other are near in memory.
+ *
+ * Cities are numbered in .MAP file order, which says little about where they are: the neighbours
+ * of a city are spread over the city array, and every expansion of a search misses the cache.
+ * Renumbering gives the cities new ids in an order that keeps neighbours together:
+ *
+ *  - Hilbert: along a Hilbert curve over latitude and longitude, cities close on the map get close ids.
+ *  - Breadth first: reverse Cuthill-McKee over the (undirected) edges, neighbours get close ids.
+ *
+ * The cities array, the ids, the name ids and the components are permuted together, and the
+ * neighbour lists are sorted on the new ids. The cities are allocated again in the new order, each followed
+ * by its neighbour list and Neighbours, so near ids are near in memory too. Renumber before packing the map (packMap()), it packs better afterwards.
+ */
+#ifndef ADVANCED_C_CLASS_RENUMBER_H
+#define ADVANCED_C_CLASS_RENUMBER_H
+
+#include "Map.h"
+
+/**
+ * Orders of the cities
+ */
+typedef enum CityOrder {
+    CityOrder_Hilbert,
+    CityOrder_BreadthFirst
+}CityOrder;
+
+/**
+ * Compute the new id of every city in an order, without changing the map
+ * @param cityMap The map
+ * @param order The order
+ * @param newIds (out) cityCount ids: the new id of city i is newIds[i]
+ * @return ERRALLOC if memory allocation failed
+ * @return OK otherwise
+ */
+status cityOrder(CityMap *cityMap, CityOrder order, int *newIds);
+
+/**
+ * Give the cities of a map new ids. Arc-flags of the map are dropped, build them again after.
+ * Routes, graphs and other per-city data made before hold old ids. The City and Neighbour objects are
+ * replaced by copies in the new order: pointers to them held outside the map are no longer valid.
+ * The copies are made before the old cities are freed, so the cities take twice their memory meanwhile.
+ * @param cityMap The map, not packed or paged
+ * @param newIds The new id of every city, a permutation of 0..cityCount-1 (see cityOrder())
+ * @return ERRUNABLE if the map is packed or paged
+ * @return ERRALLOC if memory allocation failed, the map is unchanged then
+ * @return OK otherwise
+ */
+status renumberCities(CityMap *cityMap, const int *newIds);
+
+/**
+ * Renumber the cities of a map in an order: cityOrder() then renumberCities()
+ * @param cityMap The map, not packed or paged
+ * @param order The order
+ * @return ERRUNABLE if the map is packed or paged
+ * @return ERRALLOC if memory allocation failed, the map is unchanged then
+ * @return OK otherwise
+ */
+status renumberMap(CityMap *cityMap, CityOrder order);
+
+#endif //ADVANCED_C_CLASS_RENUMBER_H
@@ -0,0 +1,270 @@
+/**
+ * @file RenumberBenchmark.c
+ * @brief Benchmark of the city orders of Renumber.h: file order, Hilbert and breadth first.
+ *
+ * For every order the map is loaded again and renumbered, then two workloads run on it:
+ *  - routes: findRoute() between the same pairs of cities (by name) for every order
+ *  - distances: findAllDistances() on the graph of the map, from the same cities
+ *  - packed: the routes again after packMap(), which stores neighbours as id differences:
+ *    the bytes of the neighbour ids are printed too
+ * The route distances are checked to be the same for every order. Where the kernel allows
+ * it (Linux perf events) the cache misses of the workloads are counted, "n/a" otherwise.
+ * Usage: renumberBenchmark map [route count, Default=50]
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE     // syscall()
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "Renumber.h"
+#include "Graph.h"
+#include "Route.h"
+#include "PackedGraph.h"
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+/** Number of findAllDistances() runs, from the start cities of the first routes */
+#define DISTANCE_RUNS   (10)
+
+/**
+ * Counter of the cache misses of this thread
+ */
+typedef struct MissCounter {
+    int fd;
+}MissCounter;
+
+/**
+ * Open a cache miss counter, not counting yet
+ * @param counter (out) the counter, fd -1 if the kernel gives none
+ */
+static void openMissCounter(MissCounter *counter) {
+    counter->fd = -1;
+#ifdef __linux__
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    counter->fd = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+}
+
+/**
+ * Start counting from 0
+ * @param counter the counter
+ */
+static void startMissCounter(MissCounter *counter) {
+#ifdef __linux__
+    if(counter->fd >= 0) {
+        ioctl(counter->fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(counter->fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+}
+
+/**
+ * Stop counting
+ * @param counter the counter
+ * @return the misses since startMissCounter(), -1 if not counted
+ */
+static long long stopMissCounter(MissCounter *counter) {
+    long long misses = -1;
+#ifdef __linux__
+    if(counter->fd >= 0) {
+        ioctl(counter->fd, PERF_EVENT_IOC_DISABLE, 0);
+        if(read(counter->fd, &misses, sizeof(misses)) != sizeof(misses)) {
+            misses = -1;
+        }
+    }
+#endif
+    return misses;
+}
+
+/**
+ * Close a counter
+ * @param counter the counter
+ */
+static void closeMissCounter(MissCounter *counter) {
+#ifdef __linux__
+    if(counter->fd >= 0) {
+        close(counter->fd);
+    }
+#endif
+}
+
+/**
+ * Milliseconds of processor time since a start
+ * @param start the start, from clock()
+ * @return the milliseconds
+ */
+static double elapsed(clock_t start) {
+    return (double)(clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+}
+
+/**
+ * Print the result of a workload
+ * @param workload the name of the workload
+ * @param order the name of the city order
+ * @param milliseconds the time taken
+ * @param count the number of runs
+ * @param misses the cache misses, -1 if not counted
+ */
+static void printResult(char *workload, char *order, double milliseconds, int count, long long misses) {
+    printf("%-10s %-14s %10.1f ms %10.3f ms/run", workload, order, milliseconds, milliseconds / count);
+    if(misses >= 0) {
+        printf(" %12lld misses\n", misses);
+    }
+    else {
+        printf("          n/a misses\n");
+    }
+}
+
+/**
+ * Load the map, renumber it and run the workloads
+ * @param path the path of the map
+ * @param orderName the name of the order
+ * @param order the order, -1 to keep the file order
+ * @param starts the start city names of the routes
+ * @param goals the goal city names of the routes
+ * @param routeCount the number of routes
+ * @param distances (out) the distance of every route, -1 if not found, -2 if different once packed
+ * @param counter the cache miss counter
+ * @return the status of loading, renumbering and packing
+ */
+static status runOrder(char *path, char *orderName, int order, char **starts, char **goals, int routeCount,
+                       int *distances, MissCounter *counter) {
+    CityMap *cityMap = 0;
+    status ret = createMap(path, &cityMap);
+    if(ret == OK && order >= 0) {
+        clock_t start = clock();
+        ret = renumberMap(cityMap, (CityOrder)order);
+        printf("%-10s %-14s %10.1f ms\n", "renumber", orderName, elapsed(start));
+    }
+    Route *route = 0;
+    Graph *graph = 0;
+    int *all = 0;
+    if(ret == OK) {
+        ret = newRoute(cityMap->cityCount, &route);
+    }
+    if(ret == OK) {
+        ret = createGraph(cityMap, &graph);
+    }
+    if(ret == OK) {
+        all = (int*)malloc(sizeof(int) * cityMap->cityCount);
+        ret = all ? OK : ERRALLOC;
+    }
+    if(ret != OK) {
+        destroyRoute(route);
+        destroyGraph(graph);
+        destroyMap(cityMap);
+        return ret;
+    }
+
+    clock_t start = clock();
+    startMissCounter(counter);
+    for (int i = 0; i < routeCount; i++) {
+        distances[i] = findRoute(starts[i], goals[i], cityMap, route) == OK ? route->totalDistance : -1;
+    }
+    long long misses = stopMissCounter(counter);
+    printResult("routes", orderName, elapsed(start), routeCount, misses);
+
+    int runs = routeCount < DISTANCE_RUNS ? routeCount : DISTANCE_RUNS;
+    start = clock();
+    startMissCounter(counter);
+    for (int i = 0; i < runs; i++) {
+        findAllDistances(graph, findCityInMap(starts[i], cityMap)->id, all);
+    }
+    misses = stopMissCounter(counter);
+    printResult("distances", orderName, elapsed(start), runs, misses);
+
+    ret = packMap(cityMap);
+    if(ret == OK) {
+        printf("%-10s %-14s %10u id bytes\n", "packed", orderName, cityMap->packed->byteStart[cityMap->cityCount]);
+        start = clock();
+        startMissCounter(counter);
+        for (int i = 0; i < routeCount; i++) {
+            int distance = findRoute(starts[i], goals[i], cityMap, route) == OK ? route->totalDistance : -1;
+            if(distance != distances[i]) {
+                distances[i] = -2;
+            }
+        }
+        misses = stopMissCounter(counter);
+        printResult("packed", orderName, elapsed(start), routeCount, misses);
+    }
+
+    free(all);
+    destroyRoute(route);
+    destroyGraph(graph);
+    destroyMap(cityMap);
+    return ret;
+}
+
+int main(int argc, char** args) {
+    int routeCount = argc > 2 ? atoi(args[2]) : 50;
+    if(argc < 2 || routeCount <= 0) {
+        printf("Usage: renumberBenchmark map [route count]\n");
+        return 1;
+    }
+    CityMap *cityMap = 0;
+    status ret = createMap(args[1], &cityMap);
+    if(ret != OK) {
+        printf("Error: %s\n", message(ret));
+        return 1;
+    }
+
+    // The same pairs of cities for every order, picked in file order
+    char **starts = (char**)malloc(sizeof(char*) * routeCount);
+    char **goals = (char**)malloc(sizeof(char*) * routeCount);
+    int *expected = (int*)malloc(sizeof(int) * routeCount);
+    int *distances = (int*)malloc(sizeof(int) * routeCount);
+    if(!starts || !goals || !expected || !distances) {
+        printf("Error: %s\n", message(ERRALLOC));
+        return 1;
+    }
+    unsigned int seed = 2463534242u;
+    for (int i = 0; i < routeCount; i++) {
+        seed = seed * 1103515245u + 12345u;
+        starts[i] = strdup(cityMap->cities[(seed >> 8) % cityMap->cityCount]->cityName);
+        seed = seed * 1103515245u + 12345u;
+        goals[i] = strdup(cityMap->cities[(seed >> 8) % cityMap->cityCount]->cityName);
+    }
+    printf("%d cities, %d routes\n", cityMap->cityCount, routeCount);
+    destroyMap(cityMap);
+
+    MissCounter counter;
+    openMissCounter(&counter);
+    char *orderNames[] = {"file order", "Hilbert", "breadth first"};
+    int orders[] = {-1, CityOrder_Hilbert, CityOrder_BreadthFirst};
+    int failures = 0;
+    for (int i = 0; i < 3; i++) {
+        ret = runOrder(args[1], orderNames[i], orders[i], starts, goals, routeCount, i ? distances : expected, &counter);
+        if(ret != OK) {
+            printf("Error: %s\n", message(ret));
+            return 1;
+        }
+        if(i && memcmp(expected, distances, sizeof(int) * routeCount) != 0) {
+            printf("%s: routes differ from file order\n", orderNames[i]);
+            failures++;
+        }
+    }
+    closeMissCounter(&counter);
+
+    for (int i = 0; i < routeCount; i++) {
+        free(starts[i]);
+        free(goals[i]);
+    }
+    free(starts);
+    free(goals);
+    free(expected);
+    free(distances);
+    return failures;
+}
@@ -0,0 +1,113 @@
+/**
+ * @file Route.c
+ * @brief Result of a route search, and its writers.
+ */
+
+#include <stdint.h>
+#include "Route.h"
+
+status newRoute(int capacity, Route **route) {
+    *route = (Route*)malloc(sizeof(Route));
+    if(!*route) {
+        return ERRALLOC;
+    }
+    if(capacity < 1) {
+        capacity = 1;
+    }
+    (*route)->cityCount = 0;
+    (*route)->capacity = capacity;
+    (*route)->totalDistance = 0;
+    (*route)->cityIds = (int*)malloc(sizeof(int) * capacity);
+    (*route)->distances = (int*)malloc(sizeof(int) * capacity);
+    if(!(*route)->cityIds || !(*route)->distances) {
+        destroyRoute(*route);
+        *route = 0;
+        return ERRALLOC;
+    }
+    return OK;
+}
+
+void destroyRoute(Route *route) {
+    if(!route) {
+        return;
+    }
+    free(route->cityIds);
+    free(route->distances);
+    free(route);
+}
+
+status writeRouteText(FILE *file, CityMap *cityMap, Route *route) {
+    fputs("Shortest route:\n", file);
+    for (int i = 0; i < route->cityCount; i++) {
+        fprintf(file, "%s (%d)\n", cityMap->cities[route->cityIds[i]]->cityName, route->distances[i]);
+    }
+    return ferror(file) ? ERRACCESS : OK;
+}
+
+/**
+ * Write a string as JSON string, with quotes and escaped characters
+ * @param file The file to write to
+ * @param string The string to write
+ */
+static void writeJsonString(FILE *file, const char *string) {
+    putc('"', file);
+    for (const unsigned char *c = (const unsigned char*)string; *c; c++) {
+        if(*c == '"' || *c == '\\') {
+            putc('\\', file);
+            putc(*c, file);
+        }
+        else if(*c < 0x20) {
+            fprintf(file, "\\u%04x", *c);
+        }
+        else {
+            putc(*c, file);
+        }
+    }
+    putc('"', file);
+}
+
+status writeRouteJson(FILE *file, CityMap *cityMap, Route *route) {
+    fprintf(file, "{\"distance\":%d,\"route\":[", route->totalDistance);
+    for (int i = 0; i < route->cityCount; i++) {
+        fputs(i ? ",{\"city\":" : "{\"city\":", file);
+        writeJsonString(file, cityMap->cities[route->cityIds[i]]->cityName);
+        fprintf(file, ",\"distance\":%d}", route->distances[i]);
+    }
+    fputs("]}\n", file);
+    return ferror(file) ? ERRACCESS : OK;
+}
+
+/**
+ * Write a 32 bit value, little endian
+ * @param file The file to write to
+ * @param value The value to write
+ */
+static void writeInt32(FILE *file, int value) {
+    uint32_t bits = (uint32_t)value;
+    unsigned char bytes[4] = {
+            (unsigned char)bits, (unsigned char)(bits >> 8), (unsigned char)(bits >> 16), (unsigned char)(bits >> 24)
+    };
+    fwrite(bytes, 1, sizeof(bytes), file);
+}
+
+status writeRouteBinary(FILE *file, Route *route) {
+    writeInt32(file, route->cityCount);
+    writeInt32(file, route->totalDistance);
+    for (int i = 0; i < route->cityCount; i++) {
+        writeInt32(file, route->cityIds[i]);
+        writeInt32(file, route->distances[i]);
+    }
+    return ferror(file) ? ERRACCESS : OK;
+}
+
+status writeRoute(FILE *file, CityMap *cityMap, Route *route, RouteFormat format) {
+    switch (format) {
+        case RouteFormat_Json:
+            return writeRouteJson(file, cityMap, route);
+        case RouteFormat_Binary:
+            return writeRouteBinary(file, route);
+        case RouteFormat_Text:
+        default:
+            return writeRouteText(file, cityMap, route);
+    }
+}
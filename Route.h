@@ -0,0 +1,94 @@
+/**
+ * @file Route.h
+ * @brief Result of a route search: the cities on the route with their cumulative distance.
+ *
+ * A Route is allocated once, with room for every city of the map, and can be reused
+ * for many searches. Writers format a route as text, as a JSON line or in binary.
+ *
+ * Binary format, all values 32 bit little endian:
+ *   cityCount, totalDistance, then cityCount times (cityId, distance)
+ */
+#ifndef ADVANCED_C_CLASS_ROUTE_H
+#define ADVANCED_C_CLASS_ROUTE_H
+
+#include <stdio.h>
+#include "Map.h"
+
+/**
+ * Route from cityIds[0] (the start) to cityIds[cityCount-1] (the goal).
+ * distances[i] is the distance from the start up to cityIds[i].
+ */
+typedef struct Route {
+    int cityCount;
+    int capacity;
+    int totalDistance;
+    int *cityIds;
+    int *distances;
+}Route;
+
+/**
+ * Output formats of a route
+ */
+typedef enum RouteFormat {
+    RouteFormat_Text,
+    RouteFormat_Json,
+    RouteFormat_Binary
+}RouteFormat;
+
+/**
+ * Create an empty route
+ * @param capacity The maximum number of cities on the route, the city count of the map
+ * @param route Pointer to route pointer which will be assigned to the new route
+ * @return ERRALLOC if memory allocation failed
+ * @return OK otherwise
+ */
+status newRoute(int capacity, Route **route);
+
+/**
+ * Clean up a route
+ * @param route The route to destroy, may be 0
+ */
+void destroyRoute(Route *route);
+
+/**
+ * Write the route as text: a line with the name and distance of each city
+ * @param file The file to write to
+ * @param cityMap The map the route was found on
+ * @param route The route to write
+ * @return ERRACCESS if writing failed
+ * @return OK otherwise
+ */
+status writeRouteText(FILE *file, CityMap *cityMap, Route *route);
+
+/**
+ * Write the route as one JSON line:
+ * {"distance":N,"route":[{"city":"name","distance":N},...]}
+ * @param file The file to write to
+ * @param cityMap The map the route was found on
+ * @param route The route to write
+ * @return ERRACCESS if writing failed
+ * @return OK otherwise
+ */
+status writeRouteJson(FILE *file, CityMap *cityMap, Route *route);
+
+/**
+ * Write the route in the binary format (see above)
+ * @param file The file to write to
+ * @param route The route to write
+ * @return ERRACCESS if writing failed
+ * @return OK otherwise
+ */
+status writeRouteBinary(FILE *file, Route *route);
+
+/**
+ * Write the route in the given format
+ * @param file The file to write to
+ * @param cityMap The map the route was found on
+ * @param route The route to write
+ * @param format The format to write in
+ * @return ERRACCESS if writing failed
+ * @return OK otherwise
+ */
+status writeRoute(FILE *file, CityMap *cityMap, Route *route, RouteFormat format);
+
+#endif //ADVANCED_C_CLASS_ROUTE_H
@@ -0,0 +1,263 @@
+/**
+ * @file RoutePool.c
+ * @brief Asynchronous route queries on a pool of worker threads.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <string.h>
+#include "RoutePool.h"
+
+/**
+ * Copy a string
+ * @param string the string to copy
+ * @return the copy, 0 if memory allocation failed
+ */
+static char *copyString(const char *string) {
+    size_t size = strlen(string) + 1;
+    char *copy = (char*)malloc(size);
+    if(copy) {
+        memcpy(copy, string, size);
+    }
+    return copy;
+}
+
+/**
+ * Finish a query: call back, unpin its map, and wake up who waits for it
+ * @param pool The pool of the query
+ * @param query The query
+ * @param result The result of the query
+ */
+static void finishQuery(RoutePool *pool, RouteQuery *query, status result) {
+    query->result = result;
+    if(query->callback) {
+        query->callback(query, query->context);
+    }
+    if(query->pinned) {
+        unpinMap(query->pinned, query->pin);
+        query->pinned = 0;
+    }
+    pthread_mutex_lock(&pool->lock);
+    __atomic_store_n(&query->state, QueryState_Done, __ATOMIC_RELEASE);
+    pthread_cond_broadcast(&pool->done);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/**
+ * Worker: take queries from the queue and answer them, until the pool stops
+ * @param argument the RoutePool
+ * @return 0
+ */
+static void *routeWorker(void *argument) {
+    RoutePool *pool = (RoutePool*)argument;
+    ArenaAllocator scratch;
+    initArenaAllocator(&scratch, "route worker", 0, 0);
+
+    pthread_mutex_lock(&pool->lock);
+    while (1) {
+        while (!pool->head && !pool->stopping) {
+            pthread_cond_wait(&pool->queued, &pool->lock);
+        }
+        if(!pool->head) {
+            break;  // Stopping, and nothing left
+        }
+        RouteQuery *query = pool->head;
+        pool->head = query->next;
+        if(!pool->head) {
+            pool->tail = 0;
+        }
+        __atomic_store_n(&query->state, QueryState_Running, __ATOMIC_RELAXED);
+        pthread_mutex_unlock(&pool->lock);
+
+        // A query cancelled or expired while queued, or stopped by the pool, is not searched nor pins the map
+        RouteOptions options = {&scratch.base, 0, &query->cancelled, query->hasDeadline ? &query->deadline : 0,
+                                pool->maxNodes};
+        status result = __atomic_load_n(&pool->stopping, __ATOMIC_RELAXED) ? ERRCANCELLED : checkInterrupted(&options);
+        if(result == OK) {
+            query->cityMap = pool->cityMap;
+            if(pool->handle) {
+                query->cityMap = pinMap(pool->handle, &query->pin);
+                query->pinned = pool->handle;
+                // The map may have more cities than the one current when the query was queued
+                if(query->route->capacity < query->cityMap->cityCount) {
+                    destroyRoute(query->route);
+                    query->route = 0;
+                    result = newRoute(query->cityMap->cityCount, &query->route);
+                }
+            }
+            if(result == OK) {
+                result = findRouteWithOptions(query->startCityName, query->goalCityName, query->cityMap,
+                                              query->route, &options);
+            }
+        }
+        resetArenaAllocator(&scratch);
+        finishQuery(pool, query, result);
+
+        pthread_mutex_lock(&pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    releaseArenaAllocator(&scratch);
+    return 0;
+}
+
+/**
+ * Create a pool searching a map or the current map of a handle
+ * @param cityMap The map to search, 0 with a handle
+ * @param handle The handle of the map to search, 0 without
+ * @param threadCount The number of workers
+ * @param pool Pointer to pool pointer which will be assigned to the new pool
+ * @return as newRoutePool()
+ */
+static status createRoutePool(CityMap *cityMap, MapHandle *handle, int threadCount, RoutePool **pool) {
+    *pool = (RoutePool*)calloc(1, sizeof(RoutePool));
+    if(!*pool) {
+        return ERRALLOC;
+    }
+    RoutePool *newPool = *pool;
+    newPool->cityMap = cityMap;
+    newPool->handle = handle;
+    newPool->threads = (pthread_t*)malloc(sizeof(pthread_t) * (threadCount > 0 ? threadCount : 1));
+    if(!newPool->threads) {
+        free(newPool);
+        *pool = 0;
+        return ERRALLOC;
+    }
+    pthread_mutex_init(&newPool->lock, 0);
+    pthread_cond_init(&newPool->queued, 0);
+    pthread_cond_init(&newPool->done, 0);
+    for (int threadNr = 0; threadNr < threadCount; threadNr++) {
+        if(pthread_create(&newPool->threads[newPool->threadCount], 0, routeWorker, newPool) == 0) {
+            newPool->threadCount++;
+        }
+    }
+    if(newPool->threadCount == 0) {
+        destroyRoutePool(newPool);
+        *pool = 0;
+        return ERRUNABLE;
+    }
+    return OK;
+}
+
+status newRoutePool(CityMap *cityMap, int threadCount, RoutePool **pool) {
+    return createRoutePool(cityMap, 0, threadCount, pool);
+}
+
+status newRoutePoolOnHandle(MapHandle *handle, int threadCount, RoutePool **pool) {
+    return createRoutePool(0, handle, threadCount, pool);
+}
+
+void deadlineAfter(struct timespec *deadline, long milliseconds) {
+    clock_gettime(CLOCK_MONOTONIC, deadline);
+    long long nanoseconds = (long long)deadline->tv_nsec + (long long)milliseconds * 1000000;
+    long long seconds = nanoseconds / 1000000000;
+    nanoseconds %= 1000000000;
+    if(nanoseconds < 0) {
+        nanoseconds += 1000000000;
+        seconds--;
+    }
+    deadline->tv_sec += seconds;
+    deadline->tv_nsec = (long)nanoseconds;
+}
+
+status submitRoute(RoutePool *pool, char *startCityName, char *goalCityName, struct timespec *deadline,
+                   RouteCallback callback, void *context, RouteQuery **query) {
+    *query = (RouteQuery*)calloc(1, sizeof(RouteQuery));
+    if(!*query) {
+        return ERRALLOC;
+    }
+    RouteQuery *newQuery = *query;
+    int capacity;
+    if(pool->handle) {
+        int pin;
+        capacity = pinMap(pool->handle, &pin)->cityCount;
+        unpinMap(pool->handle, pin);
+    }
+    else {
+        capacity = pool->cityMap->cityCount;
+    }
+    newQuery->startCityName = copyString(startCityName);
+    newQuery->goalCityName = copyString(goalCityName);
+    if(!newQuery->startCityName || !newQuery->goalCityName || newRoute(capacity, &newQuery->route) != OK) {
+        free(newQuery->startCityName);
+        free(newQuery->goalCityName);
+        free(newQuery);
+        *query = 0;
+        return ERRALLOC;
+    }
+    if(deadline) {
+        newQuery->deadline = *deadline;
+        newQuery->hasDeadline = 1;
+    }
+    newQuery->state = QueryState_Queued;
+    newQuery->callback = callback;
+    newQuery->context = context;
+    newQuery->pool = pool;
+
+    pthread_mutex_lock(&pool->lock);
+    if(pool->stopping) {
+        pthread_mutex_unlock(&pool->lock);
+        newQuery->state = QueryState_Done;
+        releaseRoute(newQuery);
+        *query = 0;
+        return ERRUNABLE;
+    }
+    if(pool->tail) {
+        pool->tail->next = newQuery;
+    }
+    else {
+        pool->head = newQuery;
+    }
+    pool->tail = newQuery;
+    pthread_cond_signal(&pool->queued);
+    pthread_mutex_unlock(&pool->lock);
+    return OK;
+}
+
+int pollRoute(RouteQuery *query) {
+    return __atomic_load_n(&query->state, __ATOMIC_ACQUIRE) == QueryState_Done;
+}
+
+status waitRoute(RouteQuery *query) {
+    RoutePool *pool = query->pool;
+    pthread_mutex_lock(&pool->lock);
+    while (__atomic_load_n(&query->state, __ATOMIC_ACQUIRE) != QueryState_Done) {
+        pthread_cond_wait(&pool->done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return query->result;
+}
+
+void cancelRoute(RouteQuery *query) {
+    __atomic_store_n(&query->cancelled, 1, __ATOMIC_RELAXED);
+}
+
+void releaseRoute(RouteQuery *query) {
+    if(!query) {
+        return;
+    }
+    if(!pollRoute(query)) {
+        cancelRoute(query);
+        waitRoute(query);
+    }
+    destroyRoute(query->route);
+    free(query->startCityName);
+    free(query->goalCityName);
+    free(query);
+}
+
+void destroyRoutePool(RoutePool *pool) {
+    if(!pool) {
+        return;
+    }
+    pthread_mutex_lock(&pool->lock);
+    __atomic_store_n(&pool->stopping, 1, __ATOMIC_RELAXED);
+    pthread_cond_broadcast(&pool->queued);
+    pthread_mutex_unlock(&pool->lock);
+    for (int threadNr = 0; threadNr < pool->threadCount; threadNr++) {
+        pthread_join(pool->threads[threadNr], 0);
+    }
+    pthread_cond_destroy(&pool->queued);
+    pthread_cond_destroy(&pool->done);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->threads);
+    free(pool);
+}
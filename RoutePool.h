@@ -0,0 +1,164 @@
+/**
+ * @file RoutePool.h
+ * @brief Asynchronous route queries, answered by a pool of worker threads.
+ *
+ * submitRoute() queues a query and returns at once. The query is answered by findRouteWithOptions()
+ * on one of the workers, which share the map: searches do not change it. The caller polls the query,
+ * waits for it, or is called back from the worker when it is done.
+ *
+ * Every query can carry a deadline and can be cancelled at any time: a queued query is then finished
+ * without searching, a running search stops within ROUTE_CHECK_INTERVAL expansions. Every worker
+ * searches with an arena of its own as scratch allocator, reset after every query, so a stopped query
+ * gives its memory back at once and the worker takes the next query.
+ *
+ * A pool created on a MapHandle (newRoutePoolOnHandle()) searches the current map of the handle: the worker
+ * pins the map for the search and the callback of a query, so a reload never waits for queued queries.
+ */
+#ifndef ADVANCED_C_CLASS_ROUTEPOOL_H
+#define ADVANCED_C_CLASS_ROUTEPOOL_H
+
+#include <pthread.h>
+#include "Map.h"
+#include "Route.h"
+#include "MapHandle.h"
+
+/** Default number of worker threads */
+#define ROUTE_POOL_DEFAULT_THREADS  (4)
+
+struct RouteQuery;
+
+/**
+ * Function called by the worker when a query is done, before waitRoute() returns for it.
+ * It must not release the query.
+ */
+typedef void (*RouteCallback)(struct RouteQuery *query, void *context);
+
+/**
+ * States of a query
+ */
+typedef enum QueryState {
+    QueryState_Queued,
+    QueryState_Running,
+    QueryState_Done
+}QueryState;
+
+/**
+ * A query: its result and route are valid once it is done
+ */
+typedef struct RouteQuery {
+    char *startCityName;
+    char *goalCityName;
+    struct timespec deadline;
+    int hasDeadline;
+    int cancelled;                  // Cancellation token, see cancelRoute()
+    int state;                      // QueryState, read and written atomically
+    status result;
+    Route *route;
+    CityMap *cityMap;               // The map the route was searched on, on a handle only valid in the callback
+    MapHandle *pinned;              // Handle cityMap is pinned on while running, 0 when not pinned
+    int pin;
+    RouteCallback callback;
+    void *context;
+    struct RoutePool *pool;
+    struct RouteQuery *next;        // Next in the queue
+}RouteQuery;
+
+/**
+ * The workers, and the queue of the queries they have not taken yet
+ */
+typedef struct RoutePool {
+    CityMap *cityMap;
+    MapHandle *handle;              // Handle of the map to search instead of cityMap, may be 0
+    pthread_t *threads;
+    int threadCount;
+    pthread_mutex_t lock;
+    pthread_cond_t queued;          // Signalled when a query is queued, or the pool stops
+    pthread_cond_t done;            // Broadcast when a query is done
+    RouteQuery *head;
+    RouteQuery *tail;
+    int stopping;
+    int maxNodes;                   // Search nodes of a query at most (see RouteOptions), 0 for no bound
+}RoutePool;
+
+/**
+ * Create a pool and start its workers. Searches are not bounded: set maxNodes before queueing
+ * to bound the memory of every query.
+ * @param cityMap The map to search, not to be changed while the pool exists
+ * @param threadCount The number of workers, at least 1
+ * @param pool Pointer to pool pointer which will be assigned to the new pool
+ * @return ERRALLOC if memory allocation failed
+ * @return ERRUNABLE if no worker could be started
+ * @return OK otherwise
+ */
+status newRoutePool(CityMap *cityMap, int threadCount, RoutePool **pool);
+
+/**
+ * Create a pool searching the current map of a handle, as newRoutePool(). The map a query was searched on
+ * (its cityMap) is unpinned when the query is done: read the cities of its route in the callback.
+ * @param handle The handle of the map, to destroy after the pool
+ * @param threadCount The number of workers, at least 1
+ * @param pool Pointer to pool pointer which will be assigned to the new pool
+ * @return ERRALLOC if memory allocation failed
+ * @return ERRUNABLE if no worker could be started
+ * @return OK otherwise
+ */
+status newRoutePoolOnHandle(MapHandle *handle, int threadCount, RoutePool **pool);
+
+/**
+ * Set a deadline some time from now
+ * @param deadline (out) the deadline, a CLOCK_MONOTONIC time
+ * @param milliseconds The time from now, negative for a deadline which has passed
+ */
+void deadlineAfter(struct timespec *deadline, long milliseconds);
+
+/**
+ * Queue a route query. The names are copied.
+ * @param pool The pool
+ * @param startCityName Name of the city to start from
+ * @param goalCityName Name of the goal city
+ * @param deadline The time the query has to be answered by (see deadlineAfter()), 0 for none
+ * @param callback Function called when the query is done, may be 0
+ * @param context Given to the callback
+ * @param query Pointer to query pointer which will be assigned to the query, release it with releaseRoute()
+ * @return ERRALLOC if memory allocation failed
+ * @return ERRUNABLE if the pool is stopping
+ * @return OK otherwise
+ */
+status submitRoute(RoutePool *pool, char *startCityName, char *goalCityName, struct timespec *deadline,
+                   RouteCallback callback, void *context, RouteQuery **query);
+
+/**
+ * Tell if a query is done, without waiting
+ * @param query The query
+ * @return non zero if the query is done: its result and route can be read
+ */
+int pollRoute(RouteQuery *query);
+
+/**
+ * Wait until a query is done
+ * @param query The query
+ * @return the result of the query: as findRouteWithOptions(), ERRCANCELLED or ERRTIMEOUT when stopped
+ */
+status waitRoute(RouteQuery *query);
+
+/**
+ * Cancel a query: it is done soon after, with ERRCANCELLED unless it was done already.
+ * Can be called from any thread.
+ * @param query The query
+ */
+void cancelRoute(RouteQuery *query);
+
+/**
+ * Release a query, cancelling and waiting for it when it is not done
+ * @param query The query, may be 0
+ */
+void releaseRoute(RouteQuery *query);
+
+/**
+ * Stop the workers and release the pool. Queries still queued are done with ERRCANCELLED,
+ * running ones are finished. The queries have to be released by their owners.
+ * @param pool The pool, may be 0
+ */
+void destroyRoutePool(RoutePool *pool);
+
+#endif //ADVANCED_C_CLASS_ROUTEPOOL_H
@@ -0,0 +1,218 @@
+/**
+ * @file SearchTrace.c
+ * @brief Per thread ring buffers of search events.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "SearchTrace.h"
+
+/**
+ * The ring of one thread, on the list of all rings. Only the thread owning it writes it.
+ * When its thread ends the ring is released with its records, and the next thread which traces
+ * takes it over, with its number: the list only grows to the most threads tracing at once.
+ */
+typedef struct TraceRing {
+    TraceRecord *records;
+    uint32_t capacity;          // A power of two
+    uint64_t written;           // Records written since the start, the newest at (written - 1) % capacity
+    uint32_t search;
+    uint16_t thread;
+    int inUse;                  // Set while a thread owns the ring, only accessed atomically
+    struct TraceRing *next;
+}TraceRing;
+
+int searchTracingEnabled = 0;
+
+/** Capacity of new rings */
+static int ringCapacity = SEARCH_TRACE_DEFAULT_RECORDS;
+/** Ring of the calling thread, 0 until it traces */
+static __thread TraceRing *threadRing;
+/** Rings of all threads which traced */
+static TraceRing *allRings;
+/** Number of rings created */
+static int ringCount = 0;
+/** Key with the ring of every tracing thread, releasing it when the thread ends */
+static pthread_key_t threadRingKey;
+static pthread_once_t threadRingKeyOnce = PTHREAD_ONCE_INIT;
+static int threadRingKeyCreated;
+
+/** Names of the events, for printing */
+static const char *eventNames[TRACE_EVENT_COUNT] = {
+        "start",
+        "pop",
+        "relax",
+        "reopen",
+        "goal"
+};
+
+void enableSearchTracing(int recordsPerThread) {
+    int capacity = 1;
+    while (capacity < recordsPerThread && capacity < (1 << 30)) {
+        capacity *= 2;
+    }
+    __atomic_store_n(&ringCapacity, recordsPerThread > 0 ? capacity : SEARCH_TRACE_DEFAULT_RECORDS, __ATOMIC_RELAXED);
+    __atomic_store_n(&searchTracingEnabled, 1, __ATOMIC_RELEASE);
+}
+
+void disableSearchTracing(void) {
+    __atomic_store_n(&searchTracingEnabled, 0, __ATOMIC_RELEASE);
+}
+
+/**
+ * Release the ring of an ending thread, for the next thread which traces
+ * @param ring the ring of the thread
+ */
+static void releaseThreadRing(void *ring) {
+    __atomic_store_n(&((TraceRing*)ring)->inUse, 0, __ATOMIC_RELEASE);
+}
+
+/**
+ * Create the key releasing the rings, once
+ */
+static void createThreadRingKey(void) {
+    threadRingKeyCreated = pthread_key_create(&threadRingKey, releaseThreadRing) == 0;
+}
+
+/**
+ * Take over a released ring for the calling thread, or create one and add it to the list of all rings
+ * @return the ring, 0 if memory allocation failed
+ */
+static TraceRing *acquireThreadRing(void) {
+    pthread_once(&threadRingKeyOnce, createThreadRingKey);
+    TraceRing *ring;
+    for (ring = __atomic_load_n(&allRings, __ATOMIC_ACQUIRE); ring; ring = ring->next) {
+        int released = 0;
+        if(__atomic_compare_exchange_n(&ring->inUse, &released, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            break;
+        }
+    }
+    if(!ring) {
+        if(!(ring = (TraceRing*)calloc(1, sizeof(TraceRing)))) {
+            return 0;
+        }
+        ring->capacity = (uint32_t)__atomic_load_n(&ringCapacity, __ATOMIC_RELAXED);
+        ring->records = (TraceRecord*)malloc(sizeof(TraceRecord) * ring->capacity);
+        if(!ring->records) {
+            free(ring);
+            return 0;
+        }
+        ring->thread = (uint16_t)__atomic_fetch_add(&ringCount, 1, __ATOMIC_RELAXED);
+        ring->inUse = 1;
+        ring->next = __atomic_load_n(&allRings, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&allRings, &ring->next, ring, 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    }
+    if(threadRingKeyCreated) {
+        pthread_setspecific(threadRingKey, ring);
+    }
+    return ring;
+}
+
+void traceSearchEvent(TraceEvent event, int cityId, int fromCityId, int g, int f) {
+    TraceRing *ring = threadRing;
+    if(!ring && !(ring = threadRing = acquireThreadRing())) {
+        return;
+    }
+    if(event == TraceEvent_Start) {
+        ring->search++;
+    }
+    TraceRecord *record = &ring->records[ring->written & (ring->capacity - 1)];
+    record->search = ring->search;
+    record->thread = ring->thread;
+    record->event = (uint16_t)event;
+    record->cityId = cityId;
+    record->fromCityId = fromCityId;
+    record->g = g;
+    record->f = f;
+    __atomic_store_n(&ring->written, ring->written + 1, __ATOMIC_RELEASE);
+}
+
+status writeSearchTrace(FILE *file) {
+    uint32_t header[2] = {SEARCH_TRACE_MAGIC, sizeof(TraceRecord)};
+    if(fwrite(header, sizeof(header), 1, file) != 1) {
+        return ERRACCESS;
+    }
+    for (TraceRing *ring = __atomic_load_n(&allRings, __ATOMIC_ACQUIRE); ring; ring = ring->next) {
+        uint64_t written = __atomic_load_n(&ring->written, __ATOMIC_ACQUIRE);
+        uint64_t oldest = written > ring->capacity ? written - ring->capacity : 0;
+        // From the oldest record to the end of the array, then from its start
+        uint32_t first = (uint32_t)(oldest & (ring->capacity - 1));
+        size_t count = (size_t)(written - oldest);
+        size_t tail = count < ring->capacity - first ? count : ring->capacity - first;
+        if(fwrite(ring->records + first, sizeof(TraceRecord), tail, file) != tail
+           || fwrite(ring->records, sizeof(TraceRecord), count - tail, file) != count - tail) {
+            return ERRACCESS;
+        }
+    }
+    return fflush(file) == 0 ? OK : ERRACCESS;
+}
+
+status readSearchTrace(FILE *file, TraceRecord **records, int *count) {
+    uint32_t header[2];
+    if(fread(header, sizeof(header), 1, file) != 1 || header[0] != SEARCH_TRACE_MAGIC
+       || header[1] != sizeof(TraceRecord)) {
+        return ERRACCESS;
+    }
+    int capacity = 1024;
+    *count = 0;
+    *records = (TraceRecord*)malloc(sizeof(TraceRecord) * capacity);
+    while (*records) {
+        *count += (int)fread(*records + *count, sizeof(TraceRecord), capacity - *count, file);
+        if(*count < capacity) {
+            break;
+        }
+        TraceRecord *grown = (TraceRecord*)realloc(*records, sizeof(TraceRecord) * capacity * 2);
+        if(!grown) {
+            free(*records);
+            *records = 0;
+            break;
+        }
+        *records = grown;
+        capacity *= 2;
+    }
+    if(!*records) {
+        return ERRALLOC;
+    }
+    if(ferror(file)) {
+        free(*records);
+        *records = 0;
+        return ERRACCESS;
+    }
+    return OK;
+}
+
+void clearSearchTrace(void) {
+    for (TraceRing *ring = __atomic_load_n(&allRings, __ATOMIC_ACQUIRE); ring; ring = ring->next) {
+        __atomic_store_n(&ring->written, 0, __ATOMIC_RELEASE);
+        ring->search = 0;
+    }
+}
+
+void freeSearchTraces(void) {
+    TraceRing *ring = __atomic_exchange_n(&allRings, 0, __ATOMIC_ACQ_REL);
+    while (ring) {
+        TraceRing *next = ring->next;
+        free(ring->records);
+        free(ring);
+        ring = next;
+    }
+    __atomic_store_n(&ringCount, 0, __ATOMIC_RELAXED);
+    if(threadRing && threadRingKeyCreated) {
+        pthread_setspecific(threadRingKey, 0);
+    }
+    threadRing = 0;
+}
+
+int searchTraceRingCount(void) {
+    int count = 0;
+    for (TraceRing *ring = __atomic_load_n(&allRings, __ATOMIC_ACQUIRE); ring; ring = ring->next) {
+        count++;
+    }
+    return count;
+}
+
+const char *traceEventName(int event) {
+    return event >= 0 && event < TRACE_EVENT_COUNT ? eventNames[event] : "unknown";
+}
@@ -0,0 +1,136 @@
+/**
+ * @file SearchTrace.h
+ * @brief Tracing of route searches: the events of every search as binary records, switchable at runtime.
+ *
+ * While tracing is on, findRoute() writes a fixed size record for every event of a search
+ * (start, pop, relax, reopen, goal) in a ring buffer of the calling thread, without locks:
+ * the oldest records are overwritten when a ring is full. The ring of an ending thread is kept
+ * with its records and taken over by the next thread which traces. While tracing is off, tracing costs
+ * a search one load and one predictable branch per event (see TRACE_SEARCH).
+ *
+ * writeSearchTrace() stores the records of all threads in a file, traceDecoder (TraceDecoder.c)
+ * prints them as text or draws the explored cities of a map as SVG.
+ */
+#ifndef ADVANCED_C_CLASS_SEARCHTRACE_H
+#define ADVANCED_C_CLASS_SEARCHTRACE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "status.h"
+
+/** Default number of records of the ring of a thread */
+#define SEARCH_TRACE_DEFAULT_RECORDS    (1 << 16)
+/** First word of a trace file, "ASTR" in little endian */
+#define SEARCH_TRACE_MAGIC              (0x52545341u)
+
+/**
+ * Events of a search
+ */
+typedef enum TraceEvent {
+    TraceEvent_Start,       // city: the start, from: the first goal, f: the number of goals
+    TraceEvent_Pop,         // city: taken from OPEN to expand, from: its predecessor, -1 for the start
+    TraceEvent_Relax,       // city: added to OPEN for the first time, from: the expanded city
+    TraceEvent_Reopen,      // city: in OPEN or CLOSED, reached shorter from the expanded city
+    TraceEvent_Goal,        // city: the goal reached, from: the start, g: the route distance
+    TRACE_EVENT_COUNT
+}TraceEvent;
+
+/**
+ * A traced event, 24 bytes in native byte order
+ */
+typedef struct TraceRecord {
+    uint32_t search;        // Number of the search in its thread, from 1
+    uint16_t thread;        // Number of the ring of the thread, in order of their first record
+    uint16_t event;         // TraceEvent
+    int32_t cityId;
+    int32_t fromCityId;
+    int32_t g;
+    int32_t f;
+}TraceRecord;
+
+/** Non zero while tracing, read with searchTracing() */
+extern int searchTracingEnabled;
+
+/**
+ * Tell if searches are traced
+ * @return non zero while tracing is on
+ */
+static inline int searchTracing(void) {
+    return __atomic_load_n(&searchTracingEnabled, __ATOMIC_RELAXED);
+}
+
+/** Trace an event when tracing is on, a branch otherwise */
+#define TRACE_SEARCH(event, cityId, fromCityId, g, f)                   \
+    do {                                                                \
+        if(__builtin_expect(searchTracing(), 0)) {                      \
+            traceSearchEvent((event), (cityId), (fromCityId), (g), (f));\
+        }                                                               \
+    } while (0)
+
+/**
+ * Start tracing the searches of all threads
+ * @param recordsPerThread The records kept per thread, rounded up to a power of two, for the rings
+ *                         created from now on; 0 for SEARCH_TRACE_DEFAULT_RECORDS
+ */
+void enableSearchTracing(int recordsPerThread);
+
+/**
+ * Stop tracing, the records are kept
+ */
+void disableSearchTracing(void);
+
+/**
+ * Record an event in the ring of the calling thread (use TRACE_SEARCH). The event is dropped
+ * when the ring cannot be allocated.
+ * @param event The event, TraceEvent_Start starts the next search of the thread
+ * @param cityId The city of the event
+ * @param fromCityId The other city of the event, see TraceEvent
+ * @param g The distance from the start
+ * @param f The distance from the start plus the heuristic
+ */
+void traceSearchEvent(TraceEvent event, int cityId, int fromCityId, int g, int f);
+
+/**
+ * Write the records of all threads to a file: SEARCH_TRACE_MAGIC and the record size as uint32,
+ * then the records of every thread from old to new. Only while no search is traced.
+ * @param file The file to write to, opened in binary mode
+ * @return ERRACCESS if writing failed
+ * @return OK otherwise
+ */
+status writeSearchTrace(FILE *file);
+
+/**
+ * Read the records of a file written by writeSearchTrace()
+ * @param file The file to read from, opened in binary mode
+ * @param records (out) the records, to free()
+ * @param count (out) the number of records
+ * @return ERRACCESS if reading failed or the file holds no trace (of this byte order)
+ * @return ERRALLOC if memory allocation failed
+ * @return OK otherwise
+ */
+status readSearchTrace(FILE *file, TraceRecord **records, int *count);
+
+/**
+ * Forget all records, the rings are kept. Only while no search is traced.
+ */
+void clearSearchTrace(void);
+
+/**
+ * Free the rings of all threads with their records. Only once no other thread which traced is running.
+ */
+void freeSearchTraces(void);
+
+/**
+ * Number of rings: at most the number of threads which traced at the same time
+ * @return the number of rings
+ */
+int searchTraceRingCount(void);
+
+/**
+ * Name of an event
+ * @param event The event
+ * @return the name, "unknown" if not an event
+ */
+const char *traceEventName(int event);
+
+#endif //ADVANCED_C_CLASS_SEARCHTRACE_H
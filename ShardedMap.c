@@ -0,0 +1,154 @@
+/**
+ * @file ShardedMap.c
+ * @brief Loading a map from region files in parallel.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include "ShardedMap.h"
+
+/**
+ * A shard of the map, parsed by its own thread
+ */
+typedef struct MapShard {
+    char path[MAX_SHARD_PATH_LENGTH];
+    CityMap *cityMap;
+    status ret;
+    pthread_t thread;
+    int threadStarted;
+}MapShard;
+
+/**
+ * Thread parsing a shard into a map of its own
+ * @param argument the MapShard
+ * @return 0
+ */
+static void *parseShard(void *argument) {
+    MapShard *shard = (MapShard*)argument;
+    shard->ret = createShardMap(shard->path, &shard->cityMap);
+    return 0;
+}
+
+/**
+ * Thread releasing the map of a shard
+ * @param argument the MapShard
+ * @return 0
+ */
+static void *destroyShard(void *argument) {
+    MapShard *shard = (MapShard*)argument;
+    destroyMap(shard->cityMap);
+    shard->cityMap = 0;
+    return 0;
+}
+
+/**
+ * Run a function on every shard, each on a thread of its own, on this thread when no thread can be started
+ * @param shards the shards
+ * @param shardCount the number of shards
+ * @param function the function, given the MapShard
+ */
+static void runOnShards(MapShard *shards, int shardCount, void *(*function)(void*)) {
+    for (int shardNr = 0; shardNr < shardCount; shardNr++) {
+        shards[shardNr].threadStarted = pthread_create(&shards[shardNr].thread, 0, function, &shards[shardNr]) == 0;
+        if(!shards[shardNr].threadStarted) {
+            function(&shards[shardNr]);
+        }
+    }
+    for (int shardNr = 0; shardNr < shardCount; shardNr++) {
+        if(shards[shardNr].threadStarted) {
+            pthread_join(shards[shardNr].thread, 0);
+        }
+    }
+}
+
+/**
+ * Read the shard paths of a manifest
+ * @param manifestPath Location of the manifest
+ * @param shards (out) the shards, with their paths set, to free
+ * @param shardCount (out) the number of shards
+ * @return ERROPEN if the manifest can not be opened
+ * @return ERRALLOC if memory allocation failed
+ * @return OK otherwise
+ */
+static status readManifest(char *manifestPath, MapShard **shards, int *shardCount) {
+    *shards = 0;
+    *shardCount = 0;
+    FILE *file = fopen(manifestPath, "r");
+    if(!file) {
+        printf("Error while opening: %s\n", manifestPath);
+        return ERROPEN;
+    }
+
+    // Relative shard paths start at the directory of the manifest
+    const char *slash = strrchr(manifestPath, '/');
+    int directoryLength = slash ? (int)(slash - manifestPath) + 1 : 0;
+
+    int capacity = 0;
+    char line[MAX_SHARD_PATH_LENGTH];
+    while (fgets(line, sizeof(line), file)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        char *path = line + strspn(line, " \t");
+        if(*path == '\0' || *path == '#') {
+            continue;
+        }
+        if(*shardCount == capacity) {
+            capacity = capacity ? capacity * 2 : 8;
+            MapShard *grown = (MapShard*)realloc(*shards, sizeof(MapShard) * capacity);
+            if(!grown) {
+                fclose(file);
+                return ERRALLOC;
+            }
+            *shards = grown;
+        }
+        MapShard *shard = &(*shards)[(*shardCount)++];
+        memset(shard, 0, sizeof(MapShard));
+        if(*path == '/') {
+            snprintf(shard->path, sizeof(shard->path), "%s", path);
+        }
+        else {
+            snprintf(shard->path, sizeof(shard->path), "%.*s%s", directoryLength, manifestPath, path);
+        }
+    }
+    fclose(file);
+    return OK;
+}
+
+status createShardedMap(char *manifestPath, CityMap **cityMap) {
+    *cityMap = 0;
+    MapShard *shards = 0;
+    int shardCount = 0;
+    status ret = readManifest(manifestPath, &shards, &shardCount);
+    if(ret == OK && shardCount <= 0) {
+        printf("No map files in: %s\n", manifestPath);
+        ret = ERREMPTY;
+    }
+    if(ret != OK) {
+        free(shards);
+        return ret;
+    }
+
+    // Parse every shard on a thread of its own, the first error is returned
+    runOnShards(shards, shardCount, parseShard);
+    for (int shardNr = 0; ret == OK && shardNr < shardCount; shardNr++) {
+        ret = shards[shardNr].ret;
+    }
+
+    // Stitch the other shards to the first in manifest order, the first keeps its cities and ids
+    CityMap **shardMaps = (CityMap**)malloc(sizeof(CityMap*) * shardCount);
+    if(ret == OK && !shardMaps) {
+        ret = ERRALLOC;
+    }
+    if(ret == OK) {
+        for (int shardNr = 0; shardNr < shardCount; shardNr++) {
+            shardMaps[shardNr] = shards[shardNr].cityMap;
+        }
+        *cityMap = shards[0].cityMap;
+        shards[0].cityMap = 0;
+        ret = mergeMaps(*cityMap, shardMaps + 1, shardCount - 1);
+    }
+    runOnShards(shards, shardCount, destroyShard);
+    free(shardMaps);
+    free(shards);
+    return ret;
+}
@@ -0,0 +1,37 @@
+/**
+ * @file ShardedMap.h
+ * @brief Loading a map kept as separate region files, parsed in parallel and stitched by name.
+ *
+ * A manifest lists the region (shard) files, one .MAP path per line. Blank lines and lines starting
+ * with '#' are skipped, relative paths are relative to the directory of the manifest.
+ * A shard references the border cities of its neighbouring regions by name, as neighbours.
+ *
+ * Every shard is parsed by createShardMap() on a thread of its own, into a map of its own. The other shard
+ * maps are then merged into the first in manifest order with mergeMaps(), which resolves the border
+ * cities by name, then sorts the neighbour lists and computes the heuristic and components once; the
+ * shard maps are released in parallel. The merge copies the cities and neighbours without
+ * parsing, so the load takes about as long as the largest shard plus the merge of the others.
+ */
+#ifndef ADVANCED_C_CLASS_SHARDEDMAP_H
+#define ADVANCED_C_CLASS_SHARDEDMAP_H
+
+#include "Map.h"
+
+/** Maximal length of a shard path in a manifest, including the manifest's directory */
+#define MAX_SHARD_PATH_LENGTH   (4096)
+
+/**
+ * Populate a CityMap from the shards of a manifest, as if their files were concatenated:
+ * cities get their ids in order of appearance, in the shards in manifest order.
+ * As for createMap(), destroyMap() should always be called, also after an error.
+ *
+ * @param manifestPath Location of the manifest
+ * @param cityMap Pointer to map pointer which will be assigned to populated map
+ * @return ERROPEN if the manifest or a shard can not be opened
+ * @return ERREMPTY if the manifest lists no shards
+ * @return ERRALLOC if memory allocation failed
+ * @return OK otherwise
+ */
+status createShardedMap(char *manifestPath, CityMap **cityMap);
+
+#endif //ADVANCED_C_CLASS_SHARDEDMAP_H
@@ -0,0 +1,206 @@
+/**
+ * @file StringArena.c
+ * @brief Interning of strings in one append-only arena.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "StringArena.h"
+
+/** Alignment of the entries, so the length prefix can be read directly */
+#define ENTRY_ALIGNMENT     (sizeof(uint32_t))
+
+/**
+ * FNV-1a hash of a string
+ * @param string the string to hash
+ * @param length (out) the length of the string
+ * @return the hash value
+ */
+static uint32_t hashString(const char *string, size_t *length) {
+    uint32_t hash = 2166136261u;
+    const char *c = string;
+    for (; *c; c++) {
+        hash = (hash ^ (unsigned char)*c) * 16777619u;
+    }
+    *length = (size_t)(c - string);
+    return hash;
+}
+
+/**
+ * Find the hash slot of a string: the slot holding its id, or the empty slot where it belongs
+ * @param arena the arena
+ * @param string the string
+ * @param length the length of the string
+ * @param hash the hash of the string
+ * @return the slot index
+ */
+static int findSlot(StringArena *arena, const char *string, size_t length, uint32_t hash) {
+    int mask = arena->slotCount - 1;
+    int slot = (int)(hash & (uint32_t)mask);
+    while (arena->slots[slot] >= 0) {
+        int id = arena->slots[slot];
+        // Compare the length prefix first, only equal lengths need the characters
+        if((size_t)stringLength(arena, id) == length && memcmp(arena->strings[id], string, length) == 0) {
+            break;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+/**
+ * Double the hash table and the string index, when more than half of the slots are used
+ * @param arena the arena
+ * @return ERRALLOC if memory allocation failed
+ * @return OK otherwise
+ */
+static status growArena(StringArena *arena) {
+    int capacity = arena->capacity * 2;
+    int slotCount = capacity * 2;
+    int *slots = (int*)allocMemory(arena->allocator, sizeof(int) * slotCount);
+    char **strings = slots ? (char**)reallocMemory(arena->allocator, arena->strings, sizeof(char*) * arena->capacity,
+                                                   sizeof(char*) * capacity) : 0;
+    if(!strings) {
+        freeMemory(arena->allocator, slots, sizeof(int) * slotCount);
+        return ERRALLOC;
+    }
+    arena->strings = strings;
+    arena->capacity = capacity;
+
+    // Rehash all strings in the larger table
+    freeMemory(arena->allocator, arena->slots, sizeof(int) * arena->slotCount);
+    arena->slots = slots;
+    arena->slotCount = slotCount;
+    memset(slots, -1, sizeof(int) * slotCount);
+    for (int id = 0; id < arena->count; id++) {
+        size_t length;
+        uint32_t hash = hashString(arena->strings[id], &length);
+        slots[findSlot(arena, arena->strings[id], length, hash)] = id;
+    }
+    return OK;
+}
+
+/**
+ * Reserve room for an entry at the end of the arena
+ * @param arena the arena
+ * @param size the size of the entry
+ * @return the entry memory, 0 if memory allocation failed
+ */
+static char *allocateEntry(StringArena *arena, size_t size) {
+    size = (size + ENTRY_ALIGNMENT - 1) & ~(ENTRY_ALIGNMENT - 1);
+    ArenaBlock *block = arena->blocks;
+    if(!block || block->size - block->used < size) {
+        size_t blockSize = size > STRING_ARENA_BLOCK_SIZE ? size : STRING_ARENA_BLOCK_SIZE;
+        block = (ArenaBlock*)allocMemory(arena->allocator, sizeof(ArenaBlock) + blockSize);
+        if(!block) {
+            return 0;
+        }
+        block->used = 0;
+        block->size = blockSize;
+        block->next = arena->blocks;
+        arena->blocks = block;
+    }
+    char *entry = block->data + block->used;
+    block->used += size;
+    arena->bytes += size;
+    return entry;
+}
+
+status newStringArena(StringArena **arena, Allocator *allocator) {
+    *arena = (StringArena*)allocZeroedMemory(allocator, sizeof(StringArena));
+    if(!*arena) {
+        return ERRALLOC;
+    }
+    (*arena)->allocator = allocator;
+    (*arena)->capacity = 64;
+    (*arena)->slotCount = 128;
+    (*arena)->strings = (char**)allocMemory(allocator, sizeof(char*) * (*arena)->capacity);
+    (*arena)->slots = (int*)allocMemory(allocator, sizeof(int) * (*arena)->slotCount);
+    if(!(*arena)->strings || !(*arena)->slots) {
+        destroyStringArena(*arena);
+        *arena = 0;
+        return ERRALLOC;
+    }
+    memset((*arena)->slots, -1, sizeof(int) * (*arena)->slotCount);
+    return OK;
+}
+
+status internString(StringArena *arena, const char *string, int *id) {
+    size_t length;
+    uint32_t hash = hashString(string, &length);
+    int slot = findSlot(arena, string, length, hash);
+    if(arena->slots[slot] >= 0) {
+        *id = arena->slots[slot];
+        return OK;
+    }
+
+    // New string: grow first when needed, this moves the slots
+    if(arena->count == arena->capacity) {
+        if(growArena(arena) != OK) {
+            return ERRALLOC;
+        }
+        slot = findSlot(arena, string, length, hash);
+    }
+
+    // Append as length prefix, characters and 0
+    char *entry = allocateEntry(arena, sizeof(uint32_t) + length + 1);
+    if(!entry) {
+        return ERRALLOC;
+    }
+    *(uint32_t*)entry = (uint32_t)length;
+    memcpy(entry + sizeof(uint32_t), string, length + 1);
+
+    *id = arena->count++;
+    arena->strings[*id] = entry + sizeof(uint32_t);
+    arena->slots[slot] = *id;
+    return OK;
+}
+
+int findString(StringArena *arena, const char *string) {
+    size_t length;
+    uint32_t hash = hashString(string, &length);
+    return arena->slots[findSlot(arena, string, length, hash)];
+}
+
+char *stringOfId(StringArena *arena, int id) {
+    return arena->strings[id];
+}
+
+int stringLength(StringArena *arena, int id) {
+    return (int)*(uint32_t*)(arena->strings[id] - sizeof(uint32_t));
+}
+
+status renumberStrings(StringArena *arena, const int *newIds) {
+    char **strings = (char**)malloc(sizeof(char*) * (arena->count ? arena->count : 1));
+    if(!strings) {
+        return ERRALLOC;
+    }
+    for (int id = 0; id < arena->count; id++) {
+        strings[newIds[id]] = arena->strings[id];
+    }
+    memcpy(arena->strings, strings, sizeof(char*) * arena->count);
+    free(strings);
+
+    // The hash table keeps its slots, only the ids in them change
+    for (int slot = 0; slot < arena->slotCount; slot++) {
+        if(arena->slots[slot] >= 0) {
+            arena->slots[slot] = newIds[arena->slots[slot]];
+        }
+    }
+    return OK;
+}
+
+void destroyStringArena(StringArena *arena) {
+    if(!arena) {
+        return;
+    }
+    while (arena->blocks) {
+        ArenaBlock *next = arena->blocks->next;
+        freeMemory(arena->allocator, arena->blocks, sizeof(ArenaBlock) + arena->blocks->size);
+        arena->blocks = next;
+    }
+    Allocator *allocator = arena->allocator;
+    freeMemory(allocator, arena->strings, sizeof(char*) * arena->capacity);
+    freeMemory(allocator, arena->slots, sizeof(int) * arena->slotCount);
+    freeMemory(allocator, arena, sizeof(StringArena));
+}
@@ -0,0 +1,103 @@
+/**
+ * @file StringArena.h
+ * @brief Interning of strings in one append-only arena, every distinct string gets an integer id.
+ *
+ * Strings are stored once, as a length followed by the characters and a terminating 0,
+ * in large blocks which are never moved (pointers to the strings stay valid).
+ * Ids are given in order of interning: 0, 1, 2, ...
+ * Two interned strings are equal if and only if their ids are equal.
+ */
+#ifndef ADVANCED_C_CLASS_STRINGARENA_H
+#define ADVANCED_C_CLASS_STRINGARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "status.h"
+#include "Allocator.h"
+
+/** Size of an arena block, larger strings get a block of their own */
+#define STRING_ARENA_BLOCK_SIZE     (64 * 1024)
+
+/**
+ * Block of string memory, the blocks of an arena are chained
+ */
+typedef struct ArenaBlock {
+    struct ArenaBlock *next;
+    size_t used;
+    size_t size;
+    char data[];
+}ArenaBlock;
+
+/**
+ * The arena: the blocks, the string of each id, and a hash table from string to id
+ */
+typedef struct StringArena {
+    ArenaBlock *blocks;
+    char **strings;
+    int count;
+    int capacity;
+    int *slots;
+    int slotCount;
+    size_t bytes;
+    Allocator *allocator;
+}StringArena;
+
+/**
+ * Create an empty arena
+ * @param arena Pointer to arena pointer which will be assigned to the new arena
+ * @param allocator the allocator of the blocks and the index, 0 for malloc
+ * @return ERRALLOC if memory allocation failed
+ * @return OK otherwise
+ */
+status newStringArena(StringArena **arena, Allocator *allocator);
+
+/**
+ * Get the id of a string, adding it to the arena if it is not in yet (O(1) expected).
+ * @param arena the arena
+ * @param string the string to intern
+ * @param id (out) the id of the string
+ * @return ERRALLOC if memory allocation failed
+ * @return OK otherwise
+ */
+status internString(StringArena *arena, const char *string, int *id);
+
+/**
+ * Get the id of a string, without adding it (O(1) expected).
+ * @param arena the arena
+ * @param string the string to search for
+ * @return the id of the string, -1 if the string is not in the arena
+ */
+int findString(StringArena *arena, const char *string);
+
+/**
+ * Get the string of an id (O(1)).
+ * @param arena the arena
+ * @param id the id of the string
+ * @return the 0 terminated string, valid until the arena is destroyed
+ */
+char *stringOfId(StringArena *arena, int id);
+
+/**
+ * Get the length of the string of an id, without scanning it (O(1)).
+ * @param arena the arena
+ * @param id the id of the string
+ * @return the length of the string
+ */
+int stringLength(StringArena *arena, int id);
+
+/**
+ * Give the strings other ids: string id gets newIds[id]. The strings do not move.
+ * @param arena the arena
+ * @param newIds the new id of every string, a permutation of 0..count-1
+ * @return ERRALLOC if memory allocation failed, the ids are unchanged then
+ * @return OK otherwise
+ */
+status renumberStrings(StringArena *arena, const int *newIds);
+
+/**
+ * Release all strings at once, and the arena itself
+ * @param arena the arena to destroy, may be 0
+ */
+void destroyStringArena(StringArena *arena);
+
+#endif //ADVANCED_C_CLASS_STRINGARENA_H
@@ -0,0 +1,190 @@
+/**
+ * @file TraceDecoder.c
+ * @brief Decoder of the trace files of SearchTrace.h: the events as text, or the explored cities as SVG.
+ *
+ * Text: a line per event with thread, search, event, city, from city, g and f; cities by name when
+ * the map is given. SVG: the map with its roads, the cities expanded by the traced searches in red,
+ * the cities only reached in orange, and the routes found in blue.
+ * Usage: traceDecoder traceFile [filepathMap [svg]]
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "SearchTrace.h"
+#include "Graph.h"
+
+/** Option to draw the trace as SVG */
+static char *const SvgOption = "svg";
+/** Pixels per coordinate unit of the SVG */
+#define SVG_SCALE       (0.5)
+/** Margin around the cities in the SVG, in pixels */
+#define SVG_MARGIN      (10)
+
+/**
+ * Name of a city in the text output, its id without a map
+ * @param cityMap the map, may be 0
+ * @param cityId the id, may be -1
+ * @param buffer room for an id
+ * @return the name
+ */
+static char *cityLabel(CityMap *cityMap, int cityId, char *buffer) {
+    if(cityMap && cityId >= 0 && cityId < cityMap->cityCount) {
+        return cityMap->cities[cityId]->cityName;
+    }
+    sprintf(buffer, "%d", cityId);
+    return buffer;
+}
+
+/**
+ * Print the records as text
+ * @param records the records
+ * @param count the number of records
+ * @param cityMap the map to name the cities, may be 0
+ */
+static void printRecords(TraceRecord *records, int count, CityMap *cityMap) {
+    char cityBuffer[16];
+    char fromBuffer[16];
+    printf("thread\tsearch\tevent\tcity\tfrom\tg\tf\n");
+    for (int i = 0; i < count; i++) {
+        TraceRecord *record = &records[i];
+        printf("%u\t%u\t%s\t%s\t%s\t%d\t%d\n", record->thread, record->search, traceEventName(record->event),
+               cityLabel(cityMap, record->cityId, cityBuffer), cityLabel(cityMap, record->fromCityId, fromBuffer),
+               record->g, record->f);
+    }
+}
+
+/**
+ * Tell if a record is about a city of the map
+ * @param record the record
+ * @param cityCount the number of cities of the map
+ * @return non zero if its city and from city are on the map (or -1)
+ */
+static int onMap(TraceRecord *record, int cityCount) {
+    return record->cityId >= 0 && record->cityId < cityCount
+           && record->fromCityId >= -1 && record->fromCityId < cityCount;
+}
+
+/**
+ * Draw the records on the map as SVG
+ * @param records the records
+ * @param count the number of records
+ * @param cityMap the map
+ * @return ERRALLOC if memory allocation failed
+ * @return OK otherwise
+ */
+static status drawRecords(TraceRecord *records, int count, CityMap *cityMap) {
+    int cityCount = cityMap->cityCount;
+    Graph *graph = 0;
+    status ret = createGraph(cityMap, &graph);
+    // Reached (1) or expanded (2) by any search; predecessor of the last search that expanded a city
+    unsigned char *explored = (unsigned char*)calloc(cityCount ? cityCount : 1, 1);
+    int *from = (int*)malloc(sizeof(int) * (cityCount ? cityCount : 1));
+    if(ret != OK || !explored || !from) {
+        destroyGraph(graph);
+        free(explored);
+        free(from);
+        return ERRALLOC;
+    }
+
+    int minX = 0, maxX = 0, minY = 0, maxY = 0;
+    for (int id = 0; id < cityCount; id++) {
+        City *city = cityMap->cities[id];
+        if(id == 0 || city->latitude < minX) minX = city->latitude;
+        if(id == 0 || city->latitude > maxX) maxX = city->latitude;
+        if(id == 0 || city->longitude < minY) minY = city->longitude;
+        if(id == 0 || city->longitude > maxY) maxY = city->longitude;
+    }
+    printf("<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"%d\" height=\"%d\">\n",
+           (int)((maxX - minX) * SVG_SCALE) + 2 * SVG_MARGIN, (int)((maxY - minY) * SVG_SCALE) + 2 * SVG_MARGIN);
+    // North up: the y axis of the SVG goes down
+#define SVG_X(city) (((city)->latitude - minX) * SVG_SCALE + SVG_MARGIN)
+#define SVG_Y(city) ((maxY - (city)->longitude) * SVG_SCALE + SVG_MARGIN)
+
+    printf("<g stroke=\"#ccc\" stroke-width=\"1\">\n");
+    for (int id = 0; id < cityCount; id++) {
+        City *city = cityMap->cities[id];
+        for (int edge = graph->edgeStart[id]; edge < graph->edgeStart[id + 1]; edge++) {
+            City *to = cityMap->cities[graph->edgeCity[edge]];
+            printf("<line x1=\"%.1f\" y1=\"%.1f\" x2=\"%.1f\" y2=\"%.1f\"/>\n", SVG_X(city), SVG_Y(city), SVG_X(to), SVG_Y(to));
+        }
+    }
+    printf("</g>\n");
+
+    for (int i = 0; i < count; i++) {
+        TraceRecord *record = &records[i];
+        if(onMap(record, cityCount) && record->event == TraceEvent_Pop) {
+            explored[record->cityId] = 2;
+        }
+        else if(onMap(record, cityCount) && record->event != TraceEvent_Start && !explored[record->cityId]) {
+            explored[record->cityId] = 1;
+        }
+    }
+    char *colors[] = {"#999", "orange", "red"};
+    for (int id = 0; id < cityCount; id++) {
+        City *city = cityMap->cities[id];
+        printf("<circle cx=\"%.1f\" cy=\"%.1f\" r=\"3\" fill=\"%s\"><title>%s</title></circle>\n",
+               SVG_X(city), SVG_Y(city), colors[explored[id]], city->cityName);
+    }
+
+    // The route of a search: from its goal along the predecessors of the expanded cities
+    printf("<g stroke=\"blue\" stroke-width=\"2\" fill=\"none\">\n");
+    for (int i = 0; i < count; i++) {
+        TraceRecord *record = &records[i];
+        if(!onMap(record, cityCount)) {
+            continue;
+        }
+        if(record->event == TraceEvent_Start) {
+            memset(from, 0xff, sizeof(int) * cityCount);
+        }
+        else if(record->event == TraceEvent_Pop) {
+            from[record->cityId] = record->fromCityId;
+        }
+        else if(record->event == TraceEvent_Goal) {
+            printf("<polyline points=\"");
+            int city = record->cityId;
+            for (int step = 0; city >= 0 && step < cityCount; step++, city = from[city]) {
+                printf("%.1f,%.1f ", SVG_X(cityMap->cities[city]), SVG_Y(cityMap->cities[city]));
+            }
+            printf("\"/>\n");
+        }
+    }
+    printf("</g>\n</svg>\n");
+#undef SVG_X
+#undef SVG_Y
+
+    destroyGraph(graph);
+    free(explored);
+    free(from);
+    return OK;
+}
+
+int main(int argc, char** args) {
+    int svg = argc == 4 && strcmp(args[3], SvgOption) == 0;
+    if(argc < 2 || argc > 4 || (argc == 4 && !svg)) {
+        printf("Usage: traceDecoder traceFile [filepathMap [%s]]\n", SvgOption);
+        return 1;
+    }
+    FILE *file = fopen(args[1], "rb");
+    TraceRecord *records = 0;
+    int count = 0;
+    status ret = file ? readSearchTrace(file, &records, &count) : ERRACCESS;
+    if(file) {
+        fclose(file);
+    }
+    CityMap *cityMap = 0;
+    if(ret == OK && argc >= 3) {
+        ret = createMap(args[2], &cityMap);
+    }
+    if(ret == OK && svg) {
+        ret = drawRecords(records, count, cityMap);
+    }
+    else if(ret == OK) {
+        printRecords(records, count, cityMap);
+    }
+    if(ret != OK) {
+        printf("Error: %s\n", message(ret));
+    }
+    free(records);
+    destroyMap(cityMap);
+    return ret == OK ? 0 : 1;
+}
@@ -0,0 +1,353 @@
+/**
+ * @file TravelTime.c
+ * @brief Time dependent travel times: piecewise linear travel time profiles per edge.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "TravelTime.h"
+#include "Heap.h"
+
+/** Longest line in a profile file */
+#define MAX_PROFILE_LINE_LENGTH     (4096)
+
+status newTravelTimes(Graph *graph, TravelTimes **travelTimes) {
+    *travelTimes = (TravelTimes*)calloc(1, sizeof(TravelTimes));
+    if(!*travelTimes) {
+        return ERRALLOC;
+    }
+    TravelTimes *newTimes = *travelTimes;
+    newTimes->graph = graph;
+    newTimes->lowerBoundFactor = 1.0;
+    newTimes->profileCapacity = 16;
+    newTimes->pointCapacity = 64;
+    newTimes->edgeProfile = (int*)malloc(sizeof(int) * (graph->edgeCount ? graph->edgeCount : 1));
+    newTimes->profileStart = (int*)malloc(sizeof(int) * (newTimes->profileCapacity + 1));
+    newTimes->pointTimes = (int*)malloc(sizeof(int) * newTimes->pointCapacity);
+    newTimes->pointCosts = (int*)malloc(sizeof(int) * newTimes->pointCapacity);
+    if(!newTimes->edgeProfile || !newTimes->profileStart || !newTimes->pointTimes || !newTimes->pointCosts) {
+        destroyTravelTimes(newTimes);
+        *travelTimes = 0;
+        return ERRALLOC;
+    }
+    for (int edge = 0; edge < graph->edgeCount; edge++) {
+        newTimes->edgeProfile[edge] = NO_PROFILE;
+    }
+    newTimes->profileStart[0] = 0;
+    return OK;
+}
+
+void destroyTravelTimes(TravelTimes *travelTimes) {
+    if(!travelTimes) {
+        return;
+    }
+    free(travelTimes->edgeProfile);
+    free(travelTimes->profileStart);
+    free(travelTimes->pointTimes);
+    free(travelTimes->pointCosts);
+    free(travelTimes);
+}
+
+/**
+ * Check a profile: increasing times within the period, no negative travel times, and
+ * no slope below -1 (a later departure may never arrive earlier), also over the period end.
+ * @param times The departure times of the breakpoints
+ * @param costs The travel time at each breakpoint
+ * @param count The number of breakpoints
+ * @return 1 if valid, 0 otherwise
+ */
+static int validProfile(int *times, int *costs, int count) {
+    if(count < 1 || count > MAX_PROFILE_POINTS) {
+        return 0;
+    }
+    for (int i = 0; i < count; i++) {
+        if(times[i] < 0 || times[i] >= TRAVEL_TIME_PERIOD || costs[i] < 0) {
+            return 0;
+        }
+        int next = (i + 1) % count;
+        int duration = next ? times[next] - times[i] : times[0] + TRAVEL_TIME_PERIOD - times[i];
+        if(next && duration <= 0) {
+            return 0;
+        }
+        if(count > 1 && costs[next] - costs[i] < -duration) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * Find a profile with the same breakpoints in the pool, or add it
+ * @param travelTimes The travel times
+ * @param times The departure times of the breakpoints
+ * @param costs The travel time at each breakpoint
+ * @param count The number of breakpoints
+ * @param profile (out) the profile id
+ * @return ERRALLOC if memory allocation failed
+ * @return OK otherwise
+ */
+static status poolProfile(TravelTimes *travelTimes, int *times, int *costs, int count, int *profile) {
+    for (int p = 0; p < travelTimes->profileCount; p++) {
+        int start = travelTimes->profileStart[p];
+        if(travelTimes->profileStart[p + 1] - start == count
+           && memcmp(travelTimes->pointTimes + start, times, sizeof(int) * count) == 0
+           && memcmp(travelTimes->pointCosts + start, costs, sizeof(int) * count) == 0) {
+            *profile = p;
+            return OK;
+        }
+    }
+
+    // Grow the pool when needed
+    if(travelTimes->profileCount == travelTimes->profileCapacity) {
+        int capacity = travelTimes->profileCapacity * 2;
+        int *profileStart = (int*)realloc(travelTimes->profileStart, sizeof(int) * (capacity + 1));
+        if(!profileStart) {
+            return ERRALLOC;
+        }
+        travelTimes->profileStart = profileStart;
+        travelTimes->profileCapacity = capacity;
+    }
+    if(travelTimes->pointCount + count > travelTimes->pointCapacity) {
+        int capacity = (travelTimes->pointCount + count) * 2;
+        int *pointTimes = (int*)realloc(travelTimes->pointTimes, sizeof(int) * capacity);
+        if(pointTimes) {
+            travelTimes->pointTimes = pointTimes;
+        }
+        int *pointCosts = pointTimes ? (int*)realloc(travelTimes->pointCosts, sizeof(int) * capacity) : 0;
+        if(!pointCosts) {
+            return ERRALLOC;
+        }
+        travelTimes->pointCosts = pointCosts;
+        travelTimes->pointCapacity = capacity;
+    }
+
+    memcpy(travelTimes->pointTimes + travelTimes->pointCount, times, sizeof(int) * count);
+    memcpy(travelTimes->pointCosts + travelTimes->pointCount, costs, sizeof(int) * count);
+    travelTimes->pointCount += count;
+    *profile = travelTimes->profileCount++;
+    travelTimes->profileStart[travelTimes->profileCount] = travelTimes->pointCount;
+    return OK;
+}
+
+status setEdgeProfile(TravelTimes *travelTimes, int fromCityId, int toCityId, int *times, int *costs, int count) {
+    Graph *graph = travelTimes->graph;
+    if(fromCityId < 0 || fromCityId >= graph->cityCount) {
+        return ERRABSENT;
+    }
+    if(!validProfile(times, costs, count)) {
+        return ERRUNABLE;
+    }
+
+    // Find the edge
+    int edge = graph->edgeStart[fromCityId];
+    while (edge < graph->edgeStart[fromCityId + 1] && graph->edgeCity[edge] != toCityId) {
+        edge++;
+    }
+    if(edge == graph->edgeStart[fromCityId + 1]) {
+        return ERRABSENT;
+    }
+
+    status ret;
+    int profile;
+    if((ret = poolProfile(travelTimes, times, costs, count, &profile)) != OK) {
+        return ret;
+    }
+    travelTimes->edgeProfile[edge] = profile;
+
+    // Keep the heuristic a lower bound: the fastest travel time never beats the scaled distance
+    int distance = graph->edgeDistance[edge];
+    for (int i = 0; distance > 0 && i < count; i++) {
+        double factor = (double)costs[i] / distance;
+        if(factor < travelTimes->lowerBoundFactor) {
+            travelTimes->lowerBoundFactor = factor;
+        }
+    }
+    return OK;
+}
+
+status loadTravelTimes(char *path, CityMap *cityMap, TravelTimes *travelTimes) {
+    FILE *file = fopen(path, "r");
+    if(!file) {
+        printf("Error while opening: %s\n", path);
+        return ERROPEN;
+    }
+
+    char line[MAX_PROFILE_LINE_LENGTH];
+    int times[MAX_PROFILE_POINTS];
+    int costs[MAX_PROFILE_POINTS];
+    status ret = OK;
+    while (ret == OK && fgets(line, sizeof(line), file)) {
+        char *fromName = strtok(line, " \t\r\n");
+        if(!fromName || fromName[0] == '#') {
+            continue;   // Empty line or comment
+        }
+        char *toName = strtok(0, " \t\r\n");
+        City *fromCity = findCityInMap(fromName, cityMap);
+        City *toCity = toName ? findCityInMap(toName, cityMap) : 0;
+        if(!fromCity || !toCity) {
+            printf("Unknown city in profile: %s %s\n", fromName, toName ? toName : "");
+            ret = ERRABSENT;
+            break;
+        }
+
+        // Read the breakpoints
+        int count = 0;
+        char *point;
+        while ((point = strtok(0, " \t\r\n")) != 0) {
+            if(count == MAX_PROFILE_POINTS || sscanf(point, "%d:%d", &times[count], &costs[count]) != 2) {
+                count = 0;
+                break;
+            }
+            count++;
+        }
+        if((ret = setEdgeProfile(travelTimes, fromCity->id, toCity->id, times, costs, count)) != OK) {
+            printf("Invalid profile for %s %s\n", fromName, toName);
+        }
+    }
+    fclose(file);
+    return ret;
+}
+
+int edgeTravelTime(TravelTimes *travelTimes, int edge, int departure) {
+    int profile = travelTimes->edgeProfile[edge];
+    if(profile == NO_PROFILE) {
+        return travelTimes->graph->edgeDistance[edge];
+    }
+    const int *times = travelTimes->pointTimes + travelTimes->profileStart[profile];
+    const int *costs = travelTimes->pointCosts + travelTimes->profileStart[profile];
+    int count = travelTimes->profileStart[profile + 1] - travelTimes->profileStart[profile];
+    if(count == 1) {
+        return costs[0];
+    }
+
+    int time = departure % TRAVEL_TIME_PERIOD;
+    if(time < 0) {
+        time += TRAVEL_TIME_PERIOD;
+    }
+
+    // Last breakpoint at or before the time, -1 if before the first one
+    int low = -1;
+    int high = count - 1;
+    while (low < high) {
+        int middle = (low + high + 1) / 2;
+        if(times[middle] <= time) {
+            low = middle;
+        }
+        else {
+            high = middle - 1;
+        }
+    }
+
+    // Interpolate, wrapping from the last breakpoint to the first one of the next period
+    int fromTime, fromCost, toTime, toCost;
+    if(low < 0) {
+        fromTime = times[count - 1] - TRAVEL_TIME_PERIOD;
+        fromCost = costs[count - 1];
+        toTime = times[0];
+        toCost = costs[0];
+    }
+    else if(low == count - 1) {
+        fromTime = times[low];
+        fromCost = costs[low];
+        toTime = times[0] + TRAVEL_TIME_PERIOD;
+        toCost = costs[0];
+    }
+    else {
+        fromTime = times[low];
+        fromCost = costs[low];
+        toTime = times[low + 1];
+        toCost = costs[low + 1];
+    }
+    return fromCost + (int)((long long)(toCost - fromCost) * (time - fromTime) / (toTime - fromTime));
+}
+
+/**
+ * Lower bound of the travel time between two cities
+ * @param travelTimes The travel times
+ * @param cityMap The map, for the scale of the heuristic
+ * @param from The city to travel from
+ * @param to The city to travel to
+ * @return the lower bound
+ */
+static int travelTimeLowerBound(TravelTimes *travelTimes, CityMap *cityMap, City *from, City *to) {
+    return (int)(calculateHValue(from, to, cityMap->heuristicScale) * travelTimes->lowerBoundFactor);
+}
+
+status findTimeDependentRoute(TravelTimes *travelTimes, CityMap *cityMap, int startCityId, int goalCityId,
+                              int departure, Route *route) {
+    Graph *graph = travelTimes->graph;
+    if(startCityId < 0 || startCityId >= graph->cityCount || goalCityId < 0 || goalCityId >= graph->cityCount) {
+        return ERRINDEX;
+    }
+
+    int *arrival = (int*)malloc(sizeof(int) * graph->cityCount);
+    int *previous = (int*)malloc(sizeof(int) * graph->cityCount);
+    Heap open;
+    if(!arrival || !previous || initHeap(&open, 64) != OK) {
+        free(arrival);
+        free(previous);
+        return ERRALLOC;
+    }
+    for (int id = 0; id < graph->cityCount; id++) {
+        arrival[id] = UNREACHABLE_DISTANCE;
+        previous[id] = -1;
+    }
+    City *goalCity = cityMap->cities[goalCityId];
+    arrival[startCityId] = 0;
+    status ret = pushHeap(&open, travelTimeLowerBound(travelTimes, cityMap, cityMap->cities[startCityId], goalCity), startCityId);
+
+    // A*: expand the city with the lowest estimated arrival, until the goal is taken
+    HeapEntry entry;
+    int found = 0;
+    while (ret == OK && popHeap(&open, &entry) == OK) {
+        int cityId = entry.cityId;
+        int lowerBound = travelTimeLowerBound(travelTimes, cityMap, cityMap->cities[cityId], goalCity);
+        if(entry.key != arrival[cityId] + lowerBound) {
+            continue;   // Outdated entry
+        }
+        if(cityId == goalCityId) {
+            found = 1;
+            break;
+        }
+        for (int edge = graph->edgeStart[cityId]; edge < graph->edgeStart[cityId + 1]; edge++) {
+            int neighbourId = graph->edgeCity[edge];
+            int time = arrival[cityId] + edgeTravelTime(travelTimes, edge, departure + arrival[cityId]);
+            if(time < arrival[neighbourId]) {
+                arrival[neighbourId] = time;
+                previous[neighbourId] = cityId;
+                int estimate = time + travelTimeLowerBound(travelTimes, cityMap, cityMap->cities[neighbourId], goalCity);
+                if((ret = pushHeap(&open, estimate, neighbourId)) != OK) {
+                    break;
+                }
+            }
+        }
+    }
+
+    // Fill the route from the goal back to the start
+    if(ret == OK && !found) {
+        ret = ERRALGORTIHM;
+    }
+    if(ret == OK) {
+        int count = 0;
+        for (int id = goalCityId; id >= 0; id = previous[id]) {
+            count++;
+        }
+        if(count > route->capacity) {
+            ret = ERRFULL;
+        }
+        else {
+            route->cityCount = count;
+            route->totalDistance = arrival[goalCityId];
+            for (int id = goalCityId; id >= 0; id = previous[id]) {
+                count--;
+                route->cityIds[count] = id;
+                route->distances[count] = arrival[id];
+            }
+        }
+    }
+
+    freeHeap(&open);
+    free(arrival);
+    free(previous);
+    return ret;
+}
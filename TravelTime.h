@@ -0,0 +1,116 @@
+/**
+ * @file TravelTime.h
+ * @brief Time dependent travel times: piecewise linear travel time profiles per edge.
+ *
+ * A profile gives the travel time of an edge as function of the departure time, by breakpoints
+ * (departure time, travel time) with linear interpolation in between. Profiles repeat every
+ * TRAVEL_TIME_PERIOD, so the last breakpoint interpolates towards the first one of the next period.
+ * All breakpoints are stored in one shared pool, equal profiles are stored once.
+ * Edges without profile keep their static distance as travel time.
+ *
+ * Profile file format, one edge per line (empty lines and lines starting with # are skipped):
+ *   FromCity   ToCity   time:travelTime   time:travelTime ...
+ * e.g. "Paris Lyon 0:460 420:460 480:620 600:480"
+ */
+#ifndef ADVANCED_C_CLASS_TRAVELTIME_H
+#define ADVANCED_C_CLASS_TRAVELTIME_H
+
+#include "Graph.h"
+#include "Route.h"
+
+/** Length of the period of all profiles, in minutes: one day */
+#define TRAVEL_TIME_PERIOD      (24 * 60)
+/** Maximum number of breakpoints of one profile */
+#define MAX_PROFILE_POINTS      (96)
+/** Profile id of an edge without profile */
+#define NO_PROFILE              (-1)
+
+/**
+ * Profiles of the edges of one Graph.
+ * Profile p has its breakpoints at pointTimes/pointCosts[profileStart[p] .. profileStart[p+1]-1],
+ * sorted on time. edgeProfile gives the profile of every edge of the graph.
+ */
+typedef struct TravelTimes {
+    Graph *graph;
+    int *edgeProfile;
+    int profileCount;
+    int profileCapacity;
+    int *profileStart;
+    int pointCount;
+    int pointCapacity;
+    int *pointTimes;
+    int *pointCosts;
+    double lowerBoundFactor;        // Smallest ratio travel time / distance, at most 1
+}TravelTimes;
+
+/**
+ * Create travel times for a graph, all edges without profile
+ * @param graph The graph the profiles are for, must stay alive while the travel times are used
+ * @param travelTimes Pointer to pointer which will be assigned to the travel times
+ * @return ERRALLOC if memory allocation failed
+ * @return OK otherwise
+ */
+status newTravelTimes(Graph *graph, TravelTimes **travelTimes);
+
+/**
+ * Clean up travel times
+ * @param travelTimes The travel times to destroy, may be 0
+ */
+void destroyTravelTimes(TravelTimes *travelTimes);
+
+/**
+ * Set the profile of the edge between two cities
+ * @param travelTimes The travel times
+ * @param fromCityId The city the edge starts from
+ * @param toCityId The city the edge goes to
+ * @param times The departure times of the breakpoints, increasing, in [0, TRAVEL_TIME_PERIOD)
+ * @param costs The travel time at each breakpoint, >= 0
+ * @param count The number of breakpoints, 1 to MAX_PROFILE_POINTS
+ * @return ERRABSENT if there is no edge between the cities
+ * @return ERRUNABLE if the profile is invalid, or would let a later departure arrive earlier
+ * @return ERRALLOC if memory allocation failed
+ * @return OK otherwise
+ */
+status setEdgeProfile(TravelTimes *travelTimes, int fromCityId, int toCityId, int *times, int *costs, int count);
+
+/**
+ * Read the profiles of a profile file (see format above)
+ * @param path Location of the profile file
+ * @param cityMap The map the graph of the travel times was created from, to find the cities
+ * @param travelTimes The travel times to set the profiles in
+ * @return ERROPEN if the file can not be opened
+ * @return ERRABSENT if a city or an edge in the file does not exist
+ * @return other errors of setEdgeProfile()
+ * @return OK otherwise
+ */
+status loadTravelTimes(char *path, CityMap *cityMap, TravelTimes *travelTimes);
+
+/**
+ * Travel time of an edge when departing at the given time, without allocation (O(log P)).
+ * @param travelTimes The travel times
+ * @param edge The edge index in the graph
+ * @param departure The departure time, in minutes (any day)
+ * @return the travel time
+ */
+int edgeTravelTime(TravelTimes *travelTimes, int edge, int departure);
+
+/**
+ * Find the fastest route between two cities when departing at the given time.
+ * A* on the graph, with the coordinate heuristic scaled by lowerBoundFactor, so it stays a lower bound.
+ * The distances of the route are the travel times since departure.
+ *
+ * @param travelTimes The travel times, with the graph to search
+ * @param cityMap The map the graph was created from, for the coordinates
+ * @param startCityId The city to start from
+ * @param goalCityId The goal city
+ * @param departure The departure time, in minutes
+ * @param route (out) the fastest route
+ * @return ERRINDEX if a city is not in the graph
+ * @return ERRALGORTIHM if the goal can not be reached
+ * @return ERRALLOC if memory allocation failed
+ * @return OK otherwise
+ */
+status findTimeDependentRoute(TravelTimes *travelTimes, CityMap *cityMap, int startCityId, int goalCityId,
+                              int departure, Route *route);
+
+#endif //ADVANCED_C_CLASS_TRAVELTIME_H
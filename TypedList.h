@@ -0,0 +1,160 @@
+/**
+ * @file TypedList.h
+ * @brief Generation of type specialized sorted lists, with the elements stored in place.
+ *
+ * List.h stores void* and calls its compare functions through pointers, for every element passed.
+ * DEFINE_TYPED_LIST generates the same operations for one element type, as static inline functions:
+ * the compiler sees the compare and can inline it, and elements are stored by value in one array.
+ *
+ *     DEFINE_TYPED_LIST(IntList, int, compareInts, equalInts)
+ *
+ * generates the type IntList and initIntList(), freeIntList(), addIntList(), addIntListAt(),
+ * nthInIntList(), remFromIntListAt(), remFromIntList(), isInIntList(), findIntList(),
+ * searchIntList() and lengthIntList(). compareInts(a, b) orders two elements (ala strcmp()),
+ * equalInts(a, b) tells if two elements are equal for searches (as the getComp function of a List).
+ * isIn..() searches linearly with equalInts, find..() binary with compareInts: only for lists
+ * ordered on the searched key.
+ * Both can be functions or macros, they are given the elements by value.
+ *
+ * Like List, indices start at 0 and a new element goes before its equals. Elements are kept
+ * in a sorted array: adding and removing take O(log N) compares and an O(N) move of elements,
+ * which is cheap for the sizes of the search lists. List.h stays the generic fallback, for
+ * element types unknown at compile time.
+ */
+#ifndef ADVANCED_C_CLASS_TYPEDLIST_H
+#define ADVANCED_C_CLASS_TYPEDLIST_H
+
+#include <string.h>
+#include "status.h"
+#include "Allocator.h"
+
+/** Initial capacity of a typed list, doubled when full */
+#define TYPED_LIST_INITIAL_CAPACITY     (16)
+
+/**
+ * Generate a typed list
+ * @param Name the name of the list type, used in the names of the functions
+ * @param Type the element type
+ * @param COMPARE order of two elements: negative, zero or positive (ala strcmp())
+ * @param EQUAL equality of two elements for the searches of isIn..() and remFrom..()
+ */
+#define DEFINE_TYPED_LIST(Name, Type, COMPARE, EQUAL)                                               \
+                                                                                                    \
+typedef struct Name {                                                                               \
+    Type *items;                                                                                    \
+    int nelts;                                                                                      \
+    int capacity;                                                                                   \
+    Allocator *allocator;                                                                           \
+} Name;                                                                                             \
+                                                                                                    \
+/** Initialise an empty list, allocator 0 for malloc */                                             \
+static inline void init##Name(Name *list, Allocator *allocator) {                                   \
+    list->items = 0;                                                                                \
+    list->nelts = 0;                                                                                \
+    list->capacity = 0;                                                                             \
+    list->allocator = allocator;                                                                    \
+}                                                                                                   \
+                                                                                                    \
+/** Release the elements of the list, it is empty afterwards */                                     \
+static inline void free##Name(Name *list) {                                                         \
+    freeMemory(list->allocator, list->items, sizeof(Type) * list->capacity);                        \
+    init##Name(list, list->allocator);                                                              \
+}                                                                                                   \
+                                                                                                    \
+/** Number of elements */                                                                           \
+static inline int length##Name(Name *list) {                                                        \
+    return list->nelts;                                                                             \
+}                                                                                                   \
+                                                                                                    \
+/** Index of the first element e with COMPARE(value, e) <= 0 (binary search) */                     \
+static inline int search##Name(Name *list, Type value) {                                            \
+    int low = 0;                                                                                    \
+    int high = list->nelts;                                                                         \
+    while (low < high) {                                                                            \
+        int middle = low + (high - low) / 2;                                                        \
+        if(COMPARE(value, list->items[middle]) > 0) {                                               \
+            low = middle + 1;                                                                       \
+        }                                                                                           \
+        else {                                                                                      \
+            high = middle;                                                                          \
+        }                                                                                           \
+    }                                                                                               \
+    return low;                                                                                     \
+}                                                                                                   \
+                                                                                                    \
+/** Insert an element at an index, without checking the order */                                   \
+static inline status addTo##Name(Name *list, int i, Type value) {                                   \
+    if(list->nelts == list->capacity) {                                                             \
+        int capacity = list->capacity ? list->capacity * 2 : TYPED_LIST_INITIAL_CAPACITY;           \
+        Type *items = (Type*)reallocMemory(list->allocator, list->items,                            \
+                                           sizeof(Type) * list->capacity, sizeof(Type) * capacity); \
+        if(!items) {                                                                                \
+            return ERRALLOC;                                                                        \
+        }                                                                                           \
+        list->items = items;                                                                        \
+        list->capacity = capacity;                                                                  \
+    }                                                                                               \
+    memmove(list->items + i + 1, list->items + i, sizeof(Type) * (list->nelts - i));                \
+    list->items[i] = value;                                                                         \
+    list->nelts++;                                                                                  \
+    return OK;                                                                                      \
+}                                                                                                   \
+                                                                                                    \
+/** Add an element in order, before its equals (as addList()) */                                   \
+static inline status add##Name(Name *list, Type value) {                                            \
+    return addTo##Name(list, search##Name(list, value), value);                                     \
+}                                                                                                   \
+                                                                                                    \
+/** Insert an element at a position (as addListAt()): ERRINDEX if out of bounds */                  \
+static inline status add##Name##At(Name *list, int i, Type value) {                                 \
+    if(i < 0 || (i > 0 && i >= list->nelts)) {                                                      \
+        return ERRINDEX;                                                                            \
+    }                                                                                               \
+    return addTo##Name(list, i, value);                                                             \
+}                                                                                                   \
+                                                                                                    \
+/** Get the element at an index: ERRINDEX if out of bounds */                                      \
+static inline status nthIn##Name(Name *list, int i, Type *value) {                                  \
+    if(i < 0 || i >= list->nelts) {                                                                 \
+        return ERRINDEX;                                                                            \
+    }                                                                                               \
+    *value = list->items[i];                                                                        \
+    return OK;                                                                                      \
+}                                                                                                   \
+                                                                                                    \
+/** Remove the element at an index, value may be 0: ERRINDEX if out of bounds */                   \
+static inline status remFrom##Name##At(Name *list, int i, Type *value) {                            \
+    if(i < 0 || i >= list->nelts) {                                                                 \
+        return ERRINDEX;                                                                            \
+    }                                                                                               \
+    if(value) {                                                                                     \
+        *value = list->items[i];                                                                    \
+    }                                                                                               \
+    list->nelts--;                                                                                  \
+    memmove(list->items + i, list->items + i + 1, sizeof(Type) * (list->nelts - i));                \
+    return OK;                                                                                      \
+}                                                                                                   \
+                                                                                                    \
+/** Index of the first element EQUAL to value, -1 if none (linear search) */                        \
+static inline int isIn##Name(Name *list, Type value) {                                              \
+    for (int i = 0; i < list->nelts; i++) {                                                         \
+        if(EQUAL(value, list->items[i])) {                                                          \
+            return i;                                                                               \
+        }                                                                                           \
+    }                                                                                               \
+    return -1;                                                                                      \
+}                                                                                                   \
+                                                                                                    \
+/** Index of the first element COMPARE equal to value, -1 if none (binary search) */               \
+static inline int find##Name(Name *list, Type value) {                                              \
+    int i = search##Name(list, value);                                                              \
+    return i < list->nelts && COMPARE(value, list->items[i]) == 0 ? i : -1;                         \
+}                                                                                                   \
+                                                                                                    \
+/** Remove the first element EQUAL to value: ERRABSENT if none */                                   \
+static inline status remFrom##Name(Name *list, Type value) {                                        \
+    int i = isIn##Name(list, value);                                                                \
+    return i < 0 ? ERRABSENT : remFrom##Name##At(list, i, 0);                                       \
+}
+
+#endif //ADVANCED_C_CLASS_TYPEDLIST_H
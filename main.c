@@ -8,19 +8,65 @@
  * Using A* Algorithm to calculate the optimal route
  * The program takes input parameters to specify names of the start and goal city
  */
+#define _POSIX_C_SOURCE 200809L
 
 #include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
 #include "Map.h"
+#include "Route.h"
+#include "ShardedMap.h"
+#include "LatencyStats.h"
+#include "SearchTrace.h"
+#include "MultiStop.h"
+#include "PackedGraph.h"
+#include "PagedGraph.h"
+#include "MapHandle.h"
+#include "DistanceTable.h"
 
 /** Path to the Map file */
 static char *const DefaultMapFilepath = "./FRANCE.MAP";
 
+/** Option for the long running mode, answering the routes asked on stdin */
+static char *const ServeOption = "--serve";
+/** Option, before all others, to load the maps packed (see PackedGraph.h) */
+static char *const PackedOption = "--packed";
+/** Command of the long running mode to print the latency statistics */
+static char *const StatsCommand = "stats";
+/** Command of the long running mode to switch tracing of the searches on or off */
+static char *const TraceCommand = "trace";
+/** File the long running mode writes the trace to, when tracing is switched off */
+static char *const DefaultTraceFilepath = "./FindRoute.trace";
+/** Command of the long running mode to route through stops: "via startCityName goalCityName stopCityName..." */
+static char *const ViaCommand = "via";
+/** Most stops of a via command */
+#define MAX_VIA_STOPS   (64)
+/** Command of the long running mode to load the map again, or another map: "reload [filepathMap]" */
+static char *const ReloadCommand = "reload";
+/** Command of the long running mode to stop */
+static char *const QuitCommand = "quit";
+
+/** Set by SIGUSR1: print the latency statistics */
+static volatile sig_atomic_t statsRequested = 0;
+/** Set by SIGHUP: load the map file again */
+static volatile sig_atomic_t reloadRequested = 0;
+/** Set by PackedOption: load the maps packed, also when reloading */
+static int packMaps = 0;
+
+/** Extension of a manifest of region map files, loaded with createShardedMap() */
+static char *const ManifestExtension = ".manifest";
+/** Extension of a paged map file, loaded with loadPagedMap(): the neighbours stay on disk */
+static char *const PagedMapExtension = ".pmap";
+
 /** Program input parameter count */
 enum ArgsParamsCount {
     ArgsParamCount_NoInput = 1,
     ArgsParamCount_OnlyStartName = 2,
     ArgsParamCount_StartAndGoalName = 3,
-    ArgsParamCount_ALL = 4,
+    ArgsParamCount_MapPath = 4,
+    ArgsParamCount_ALL = 5,
 };
 
 /** Possible input parameters given to the program*/
@@ -28,17 +74,365 @@ enum ArgsInputParams {
     /*Input_ProgramName = 0,*/
     ArgsInputParam_StartCity = 1,
     ArgsInputParam_GoalCity = 2,
-    ArgsInputParam_MapPath = 3
+    ArgsInputParam_MapPath = 3,
+    ArgsInputParam_Format = 4
 };
 
+/**
+ * Get the route output format from its name
+ * @param name "text", "json" or "binary"
+ * @param format (out) the format
+ * @return ERRABSENT if the name is not a format
+ * @return OK otherwise
+ */
+static status parseRouteFormat(char *name, RouteFormat *format) {
+    if(strcmp(name, "text") == 0) {
+        *format = RouteFormat_Text;
+    }
+    else if(strcmp(name, "json") == 0) {
+        *format = RouteFormat_Json;
+    }
+    else if(strcmp(name, "binary") == 0) {
+        *format = RouteFormat_Binary;
+    }
+    else {
+        return ERRABSENT;
+    }
+    return OK;
+}
+
+/**
+ * Tell if a path ends in an extension
+ * @param path the path
+ * @param extension the extension, with its dot
+ * @return non zero if it does
+ */
+static int hasExtension(char *path, char *extension) {
+    size_t pathLength = strlen(path);
+    size_t extensionLength = strlen(extension);
+    return pathLength > extensionLength && strcmp(path + pathLength - extensionLength, extension) == 0;
+}
+
+/**
+ * Load a map from a .MAP file, from the region files of a manifest or from a paged map file.
+ * The distance table next to it (filepathMap.dist, see DistanceTable.h) is loaded too, when it exists
+ * and was built for the map: findRoute() answers from it.
+ * With packMaps set, a .MAP file is packed as it is read (createPackedMap()) and the map of a manifest once it
+ * is merged (packMap()); a paged map keeps its neighbours on disk.
+ * @param mapFilePath Location of the .MAP file, manifest or paged map
+ * @param cityMap Pointer to map pointer which will be assigned to the map, to destroy also after an error
+ * @return OK if no error
+ * @return Error code when there was an error
+ */
+static status loadMap(char *mapFilePath, CityMap **cityMap) {
+    status ret;
+    if(hasExtension(mapFilePath, ManifestExtension)) {
+        ret = createShardedMap(mapFilePath, cityMap);
+        if(ret == OK && packMaps) {
+            ret = packMap(*cityMap);
+        }
+    }
+    else if(hasExtension(mapFilePath, PagedMapExtension)) {
+        ret = loadPagedMap(mapFilePath, 0, cityMap);
+    }
+    else if(packMaps) {
+        ret = createPackedMap(mapFilePath, cityMap);
+    }
+    else {
+        ret = createMap(mapFilePath, cityMap);
+    }
+
+    char tablePath[4096];
+    if(ret == OK && snprintf(tablePath, sizeof(tablePath), "%s%s", mapFilePath, DISTANCE_TABLE_EXTENSION)
+                    < (int)sizeof(tablePath) && access(tablePath, R_OK) == 0) {
+        status tableRet = loadDistanceTable(*cityMap, tablePath);
+        if(tableRet != OK) {
+            fprintf(stderr, "Distance table %s not used: %s\n", tablePath, message(tableRet));
+        }
+    }
+    return ret;
+}
+
+/**
+ * Print the latency statistics, and the counters of the page cache of a paged map
+ * @param file the file to print to
+ * @param cityMap the map
+ */
+static void printStats(FILE *file, CityMap *cityMap) {
+    printLatencyStats(file);
+    if(cityMap->paged) {
+        PagedGraphStats stats;
+        pagedGraphStats(cityMap->paged, &stats);
+        long lookups = stats.hits + stats.misses;
+        fprintf(file, "page cache: %ld hits, %ld misses (%.1f%% hits), %ld evictions, %d of %d pages of %d bytes cached\n",
+                stats.hits, stats.misses, lookups ? 100.0 * stats.hits / lookups : 0.0, stats.evictions,
+                stats.cachedPages, stats.pageCount, stats.pageSize);
+    }
+}
+
+/**
+ * Answer a via command: the shortest order of the stops found by findMultiStopRoute(), and the route
+ * @param line the command, "via startCityName goalCityName stopCityName...", split in place
+ * @param cityMap the map
+ * @param graph the graph of the map, created by the first via command and kept for the next
+ * @return ERRINDEX if there are no start and goal, or more than MAX_VIA_STOPS stops
+ * @return the status of the search or of writing the route otherwise
+ */
+static status serveViaRoute(char *line, CityMap *cityMap, Graph **graph) {
+    char *names[MAX_VIA_STOPS + 3];
+    int nameCount = 0;
+    for (char *name = strtok(line, " \t\r\n"); name; name = strtok(0, " \t\r\n")) {
+        if(nameCount == MAX_VIA_STOPS + 3) {
+            return ERRINDEX;
+        }
+        names[nameCount++] = name;
+    }
+    if(nameCount < 3) {
+        return ERRINDEX;
+    }
+    int stopCount = nameCount - 3;
+    int stopOrder[MAX_VIA_STOPS];
+    Route *route = 0;
+    status ret = *graph ? OK : createGraph(cityMap, graph);
+    if(ret == OK) {
+        ret = newRoute(cityMap->cityCount * (stopCount + 1), &route);
+    }
+    if(ret == OK) {
+        ret = findMultiStopRoute(names[1], names[2], names + 3, stopCount, cityMap, *graph, route, stopOrder);
+    }
+    if(ret == OK) {
+        printf("Stops:");
+        for (int i = 0; i < stopCount; i++) {
+            printf(" %s", names[3 + stopOrder[i]]);
+        }
+        printf("\n");
+        ret = writeRoute(stdout, cityMap, route, RouteFormat_Text);
+    }
+    destroyRoute(route);
+    return ret;
+}
+
+/**
+ * Signal handler of SIGUSR1: ask for the statistics, printed by the long running mode
+ * @param signalNumber the signal
+ */
+static void requestStats(int signalNumber) {
+    statsRequested = 1;
+}
+
+/**
+ * Signal handler of SIGHUP: ask for the map to be loaded again, by the long running mode
+ * @param signalNumber the signal
+ */
+static void requestReload(int signalNumber) {
+    reloadRequested = 1;
+}
+
+/**
+ * Start loading a map in the background, to replace the map of the long running mode (see MapHandle.h)
+ * @param handle the handle of the map
+ * @param mapFilePath Location of the .MAP file, manifest or paged map
+ */
+static void startReload(MapHandle *handle, char *mapFilePath) {
+    status ret = reloadMap(handle, mapFilePath, loadMap);
+    if(ret == OK) {
+        fprintf(stderr, "Reloading map from %s\n", mapFilePath);
+    }
+    else {
+        fprintf(stderr, "Cannot reload map from %s: %s\n", mapFilePath,
+                ret == ERRUNABLE ? "a reload is running" : message(ret));
+    }
+}
+
+/**
+ * Follow a reload started by serveRoutes(): while it runs, the graph of the via routes is destroyed, so it does not
+ * keep the old map from being destroyed; once it is done, its outcome is printed to stderr
+ * @param handle The handle of the map
+ * @param reloadStarted Set while a reload is followed, cleared once its outcome is printed
+ * @param graph The graph of the via routes, set to 0 when destroyed
+ * @param graphPin The pin of the map of the graph
+ */
+static void followReload(MapHandle *handle, int *reloadStarted, Graph **graph, int graphPin) {
+    if(*reloadStarted && mapReloading(handle) && *graph) {
+        destroyGraph(*graph);
+        *graph = 0;
+        unpinMap(handle, graphPin);
+    }
+    if(*reloadStarted && !mapReloading(handle)) {
+        *reloadStarted = 0;
+        status ret = waitMapReload(handle);
+        if(ret == OK) {
+            fprintf(stderr, "Map reloaded\n");
+        }
+        else {
+            fprintf(stderr, "Error reloading map: %s\n", message(ret));
+        }
+    }
+}
+
+/**
+ * Long running mode: answer the routes asked on stdin, one "startCityName goalCityName" per line,
+ * until "quit" or the end of the input. "stats" prints the latency statistics (and the page cache counters of a
+ * paged map) to stdout, SIGUSR1 prints them to stderr. "trace" switches tracing of the searches on, the next "trace"
+ * switches it off and writes the trace to the trace file (see SearchTrace.h). "via start goal stops..."
+ * routes through the stops, in the order findMultiStopRoute() finds shortest.
+ * "reload [filepathMap]" loads the map file, or another, in the background, SIGHUP loads the map file again:
+ * the routes are answered on the old map until the new one is loaded, and on the new one after (see MapHandle.h).
+ * The outcome of a reload is printed to stderr.
+ * @param mapFilePath Location of the .MAP file, manifest or paged map
+ * @param traceFilePath Location of the trace file
+ * @return 0 OK
+ * @return <0 ERROR CODE
+ */
+static int serveRoutes(char *mapFilePath, char *traceFilePath) {
+    CityMap *pCityMap = 0;
+    MapHandle *handle = 0;
+    Route *route = 0;
+    Graph *graph = 0;
+    CityMap *graphMap = 0;      // The map of the graph, pinned by graphPin while the graph exists
+    int graphPin = 0;
+    status ret = loadMap(mapFilePath, &pCityMap);
+    if(ret == OK && (ret = newMapHandle(pCityMap, 0, &handle)) == OK) {
+        pCityMap = 0;
+        ret = newRoute(handle->cityMap->cityCount, &route);
+    }
+    if(ret != OK) {
+        printf("While populating map from %s\nError: %s\n", mapFilePath, message(ret));
+        destroyMapHandle(handle);
+        destroyMap(pCityMap);
+        return(0-ret);
+    }
+
+    // No SA_RESTART: the signal interrupts a waiting read, so the statistics are printed at once
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = requestStats;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGUSR1, &action, 0);
+    action.sa_handler = requestReload;
+    sigaction(SIGHUP, &action, 0);
+
+    char line[(MAX_VIA_STOPS + 3) * (MAX_CITYNAME_LENGTH + 1)];
+    char startCityName[MAX_CITYNAME_LENGTH];
+    char goalCityName[MAX_CITYNAME_LENGTH];
+    int reloadStarted = 0;
+    while (1) {
+        char *read = fgets(line, sizeof(line), stdin);
+        int pin;
+        pCityMap = pinMap(handle, &pin);
+        if(statsRequested) {
+            statsRequested = 0;
+            printStats(stderr, pCityMap);
+        }
+        if(reloadRequested) {
+            reloadRequested = 0;
+            startReload(handle, mapFilePath);
+            reloadStarted = 1;
+        }
+        if(!read) {
+            unpinMap(handle, pin);
+            if(ferror(stdin) && errno == EINTR) {
+                clearerr(stdin);
+                followReload(handle, &reloadStarted, &graph, graphPin);
+                continue;
+            }
+            break;
+        }
+        // A map with more cities than the route has room for
+        if(route->capacity < pCityMap->cityCount) {
+            destroyRoute(route);
+            route = 0;
+            if((ret = newRoute(pCityMap->cityCount, &route)) != OK) {
+                printf("Error: %s.\n", message(ret));
+                unpinMap(handle, pin);
+                break;
+            }
+        }
+        int wordCount = sscanf(line, CITYNAME_FORMAT " " CITYNAME_FORMAT, startCityName, goalCityName);
+        if(wordCount == 1 && strcmp(startCityName, StatsCommand) == 0) {
+            printStats(stdout, pCityMap);
+        }
+        else if(wordCount == 1 && strcmp(startCityName, TraceCommand) == 0) {
+            if(!searchTracing()) {
+                clearSearchTrace();
+                enableSearchTracing(0);
+                printf("Tracing searches\n");
+            }
+            else {
+                disableSearchTracing();
+                FILE *traceFile = fopen(traceFilePath, "wb");
+                ret = traceFile ? writeSearchTrace(traceFile) : ERRACCESS;
+                if(traceFile && fclose(traceFile) != 0) {
+                    ret = ERRACCESS;
+                }
+                printf(ret == OK ? "Trace written to %s\n" : "Error writing trace to %s\n", traceFilePath);
+            }
+        }
+        else if(wordCount >= 1 && strcmp(startCityName, ViaCommand) == 0) {
+            // The graph is kept for the next via command, with its map pinned, until the map is replaced
+            if(graph && graphMap != pCityMap) {
+                destroyGraph(graph);
+                graph = 0;
+                unpinMap(handle, graphPin);
+            }
+            if(!graph) {
+                graphMap = pinMap(handle, &graphPin);
+            }
+            if((ret = serveViaRoute(line, graphMap, &graph)) != OK) {
+                printf("Error: %s.\n", message(ret));
+            }
+            if(!graph) {
+                unpinMap(handle, graphPin);
+            }
+        }
+        else if(wordCount >= 1 && strcmp(startCityName, ReloadCommand) == 0) {
+            startReload(handle, wordCount == 2 ? goalCityName : mapFilePath);
+            reloadStarted = 1;
+        }
+        else if(wordCount == 1 && strcmp(startCityName, QuitCommand) == 0) {
+            unpinMap(handle, pin);
+            break;
+        }
+        else if(wordCount == 2) {
+            if((ret = findRoute(startCityName, goalCityName, pCityMap, route)) == OK) {
+                ret = writeRoute(stdout, pCityMap, route, RouteFormat_Text);
+            }
+            if(ret != OK) {
+                printf("Error: %s.\n", message(ret));
+            }
+        }
+        else if(wordCount > 0) {
+            printf("Input commands: startCityName goalCityName | %s startCityName goalCityName stopCityName... | %s | %s | %s [filepathMap] | %s\n",
+                   ViaCommand, StatsCommand, TraceCommand, ReloadCommand, QuitCommand);
+        }
+        unpinMap(handle, pin);
+        fflush(stdout);
+        followReload(handle, &reloadStarted, &graph, graphPin);
+    }
+
+    if(graph) {
+        destroyGraph(graph);
+        unpinMap(handle, graphPin);
+    }
+    destroyRoute(route);
+    destroyMapHandle(handle);
+    freeSearchTraces();
+    return 0;
+}
+
 /**
  * Compute the optimal point between two cities
  *   Requires input from the user passed when starting
  *      - Start city, if not given will be asked.
  *      - Stop city, if not given will be asked.
- *      - Optional Path to .MAP file (Default="./FRANCE.MAP" )
+ *      - Optional Path to .MAP file (Default="./FRANCE.MAP" ), to a .manifest of region .MAP files
+ *        or to a .pmap paged map file (see PagedGraph.h); a distance table next to it (filepathMap.dist,
+ *        see DistanceTable.h) answers the routes
+ *      - Optional output format of the route: text, json or binary (Default=text)
+ *   Or, with --serve [filepathMap] [filepathTrace] as parameters, answers routes asked on stdin (see serveRoutes()).
+ *   With --packed before the other parameters, the map is loaded packed (see loadMap()).
  *
- * @param argc amount of arguments given by user, should be 2 or 3
+ * @param argc amount of arguments given by user, should be 1 to 5
  * #param args, 2nd and 3th string should contain start and optional end city Name
  * @return 0 OK
  * #return <0 ERROR CODE
@@ -48,6 +442,19 @@ int main(int argc, char** args) {
     char *startCityName = 0;
     char *goalCityName = 0;
     char *mapFilePath = DefaultMapFilepath;
+    RouteFormat routeFormat = RouteFormat_Text;
+
+    // Packed maps, the other parameters follow as without the option
+    if(argc >= 2 && strcmp(args[1], PackedOption) == 0) {
+        packMaps = 1;
+        argc--;
+        args++;
+    }
+
+    // Long running mode
+    if(argc >= 2 && argc <= 4 && strcmp(args[1], ServeOption) == 0) {
+        return serveRoutes(argc >= 3 ? args[2] : DefaultMapFilepath, argc == 4 ? args[3] : DefaultTraceFilepath);
+    }
 
     // Check program input parameters
     switch(argc){
@@ -57,16 +464,16 @@ int main(int argc, char** args) {
 
             // No parameters given
             printf("What is the starting city?\n");
-            scanf("%s", startCityName);
+            scanf(CITYNAME_FORMAT, startCityName);
             printf("What is the goal city?\n");
-            scanf("%s", goalCityName);
+            scanf(CITYNAME_FORMAT, goalCityName);
             break;
         }
         case ArgsParamCount_OnlyStartName: {
             // Goal city not specified as input param, ask for it.
             goalCityName = (char*)malloc(MAX_CITYNAME_LENGTH);
             printf("Which city do you want to go?\n");
-            scanf("%s", goalCityName);
+            scanf(CITYNAME_FORMAT, goalCityName);
             startCityName = args[ArgsInputParam_StartCity];
             break;
         }
@@ -75,36 +482,61 @@ int main(int argc, char** args) {
             goalCityName = args[ArgsInputParam_GoalCity];
             break;
         }
-        case ArgsParamCount_ALL: {
+        case ArgsParamCount_MapPath: {
             startCityName = args[ArgsInputParam_StartCity];
             goalCityName = args[ArgsInputParam_GoalCity];
             mapFilePath = args[ArgsInputParam_MapPath];
             break;
         }
+        case ArgsParamCount_ALL: {
+            startCityName = args[ArgsInputParam_StartCity];
+            goalCityName = args[ArgsInputParam_GoalCity];
+            mapFilePath = args[ArgsInputParam_MapPath];
+            if(parseRouteFormat(args[ArgsInputParam_Format], &routeFormat) == OK) {
+                break;
+            }
+            // Unknown format, fall through to incorrect input
+        }
         default: {
-            printf("Incorrect input.\nInput commands: startCityName [goalCityName] [filepathMap, Default=\'./FRANCE.MAP\']\n");
+            printf("Incorrect input.\nInput commands: [%s] startCityName [goalCityName] [filepathMap, Default=\'./FRANCE.MAP\'] [text|json|binary, Default=text]\n",
+                   PackedOption);
+            printf("Or: [%s] %s [filepathMap, Default=\'./FRANCE.MAP\'] [filepathTrace, Default=\'%s\'], "
+                   "then startCityName goalCityName | %s | %s | %s [filepathMap] | %s per line\n",
+                   PackedOption, ServeOption, DefaultTraceFilepath, StatsCommand, TraceCommand, ReloadCommand, QuitCommand);
             return 0;
         }
     }
 
-    // Create the list of cities from the .MAP file
-    List *pCityList = 0;
-    status ret = createMap(mapFilePath, &pCityList);
+    // Create the map of cities from the .MAP file, or from the region files of a manifest
+    CityMap *pCityMap = 0;
+    status ret = loadMap(mapFilePath, &pCityMap);
     if(ret != OK) {
         printf("While populating map from %s\nError: %s\n", mapFilePath, message(ret));
         return(0-ret);
     }
 
-    // Start finding Route
-    printf("\nFinding shortest route\nFrom:\t%s\nTo:\t%s\n\n", startCityName, goalCityName);
-    ret = findRoute(startCityName, goalCityName, pCityList);
+    // Start finding Route, only text output gets the header
+    Route *route = 0;
+    if((ret = newRoute(pCityMap->cityCount, &route)) != OK) {
+        printf("Error: %s.\n", message(ret));
+        return(0-ret);
+    }
+    if(routeFormat == RouteFormat_Text) {
+        printf("\nFinding shortest route\nFrom:\t%s\nTo:\t%s\n", startCityName, goalCityName);
+        printf("Heuristic scale: %.4f\n\n", pCityMap->heuristicScale);
+    }
+    ret = findRoute(startCityName, goalCityName, pCityMap, route);
+    if(ret == OK) {
+        ret = writeRoute(stdout, pCityMap, route, routeFormat);
+    }
     if(ret != OK) {
         printf("Error: %s.\n", message(ret));
         return(0-ret);
     }
 
     // Clean up
-    destroyMap(pCityList);
+    destroyRoute(route);
+    destroyMap(pCityMap);
     if(argc == ArgsParamCount_NoInput) {
         free(startCityName);
         free(goalCityName);
@@ -131,11 +563,20 @@ int main(int argc, char** args) {
  *    FindRoute without parameters, default FRANCE.MAP will be used as input map.\n
  *    Start city and destination city will be ask\n
  *    \n
- *    FindRoute With parameters; FindRoute startCityName [goalCityName] [filepathMap, Default='./FRANCE.MAP']\n
+ *    FindRoute With parameters; FindRoute startCityName [goalCityName] [filepathMap, Default='./FRANCE.MAP'] [text|json|binary]\n
  *    e.g.:\n
  *        \li FindRoute "Lyon"\n
  *        \li FindRoute "Lyon" "Rennes"\n
  *        \li FindRoute "Lyon" "Rennes" "./FRANCE.MAP"\n
+ *        \li FindRoute "Lyon" "Rennes" "./FRANCE.MAP" json\n
+ *    \n
+ *    FindRoute --serve [filepathMap] [filepathTrace] answers a route for every "startCityName goalCityName" line
+ *    on stdin, "stats" (or SIGUSR1, to stderr) prints the latency percentiles and page cache hits, "trace" switches tracing of the
+ *    searches on or off (writing filepathTrace, Default='./FindRoute.trace', read it with traceDecoder),
+ *    "via startCityName goalCityName stopCityName..." routes through the stops in the shortest order found,
+ *    "reload [filepathMap]" (or SIGHUP) loads the map again in the background and swaps it in, "quit" stops.\n
+ *    \n
+ *    distanceTableBenchmark filepathMap builds filepathMap.dist, the all-pairs distances FindRoute then answers from.\n
  *
  * \section Code
  *      The code is divided over 4 sources:\n
@@ -27,7 +27,9 @@ static char* msg[] = {
         "Value already exists",
         "index out of bounds",
         "unable to perform operation",
-        "error in A* algorithm"
+        "error in A* algorithm",
+        "operation cancelled",
+        "deadline passed",
 
         "unknown error"
 };
@@ -32,6 +32,8 @@ typedef enum {
     ERRINDEX,
     ERRUNABLE,
     ERRALGORTIHM,
+    ERRCANCELLED,
+    ERRTIMEOUT,
 
     ERRUNKNOWN,
 } status;